@@ -0,0 +1,25 @@
+# Converts the public suffix list into an array of rules that is compiled into viper-core.
+#
+# Usage: cmake -DINPUT_FILE=public_suffix_list.dat -DOUTPUT_FILE=PublicSuffixData.inc -P GeneratePublicSuffixData.cmake
+
+file(STRINGS "${INPUT_FILE}" PSL_LINES ENCODING UTF-8)
+
+set(PSL_RULES "")
+set(PSL_RULE_COUNT 0)
+foreach(PSL_LINE ${PSL_LINES})
+    # Each rule is the first whitespace-delimited token of a line that is not a comment
+    string(REGEX REPLACE "[ \t].*$" "" PSL_RULE "${PSL_LINE}")
+    if (NOT PSL_RULE STREQUAL "" AND NOT PSL_RULE MATCHES "^//")
+        set(PSL_RULES "${PSL_RULES}    \"${PSL_RULE}\",\n")
+        math(EXPR PSL_RULE_COUNT "${PSL_RULE_COUNT} + 1")
+    endif()
+endforeach()
+
+file(WRITE "${OUTPUT_FILE}"
+     "// Generated from public_suffix_list.dat by GeneratePublicSuffixData.cmake. Do not edit.\n\n"
+     "/// Number of rules in the public suffix list\n"
+     "static const int PublicSuffixRuleCount = ${PSL_RULE_COUNT};\n\n"
+     "/// Rules of the public suffix list, encoded in UTF-8\n"
+     "static const char *const PublicSuffixRules[] = {\n"
+     "${PSL_RULES}"
+     "};\n")
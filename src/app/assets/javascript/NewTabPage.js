@@ -134,11 +134,35 @@ document.addEventListener('click', function(e) {
     }
 });
 
+// Thumbnails that were not loaded when the page list was fetched are filled in as they arrive
+var onThumbnailLoaded = function(url, thumbnail) {
+    for (let i = 0; i < pageList.length; ++i) {
+        let item = pageList[i];
+        if (item == null || item.url !== url)
+            continue;
+
+        let hadThumbnail = (item.thumbnail != '');
+        item.thumbnail = thumbnail;
+        if (hadThumbnail || i >= nextItem)
+            continue;
+
+        let closeElem = document.querySelector('span[data-elemid="' + i + '"]');
+        if (closeElem == null)
+            continue;
+
+        closeElem.parentNode.parentNode.outerHTML = cellTemplate.replace(/{{id}}/g, i)
+                                                                .replace(/{{url}}/g, item.url)
+                                                                .replace(/{{imgSrc}}/g, item.thumbnail)
+                                                                .replace(/{{title}}/g, item.title);
+    }
+};
+
 getFavoritePages().then(function(result) {
     if (!result)
         return;
     
     pageList = result;
+    window.viper.favoritePageManager.thumbnailLoaded.connect(onThumbnailLoaded);
 
     var mainContainer = document.getElementById('mainGrid');
     const maxResults = result.length < 8 ? result.length : 8;
@@ -148,12 +148,19 @@ int main(int argc, char *argv[])
 
     SchemeRegistry::registerSchemes();
 
-    // Check if any application arguments include URLs
+    // Check if any application arguments include URLs, or if the startup trace should be printed
     std::vector<QUrl> appArgUrls;
+    bool showStartupTrace = false;
     if (argc > 1)
     {
         for (int i = 1; i < argc; ++i)
         {
+            if (strcmp(argv[i], "--startup-trace") == 0)
+            {
+                showStartupTrace = true;
+                continue;
+            }
+
             QString arg(argv[i]);
             QUrl url = QUrl::fromUserInput(arg);
             if (!url.isEmpty() && !url.scheme().isEmpty() && url.isValid())
@@ -265,6 +272,9 @@ int main(int argc, char *argv[])
         MainWindow *mainWindow = a.getNewWindow();
         mainWindow->show();
 
+        if (showStartupTrace)
+            std::cout << a.getStartupTrace().toStdString() << std::flush;
+
         WelcomeWindow welcomeWindow(a.getSettings(), a.getAdBlockManager());
         welcomeWindow.show();
 
@@ -283,5 +293,8 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (showStartupTrace)
+        std::cout << a.getStartupTrace().toStdString() << std::flush;
+
     return a.exec();
 }
@@ -1,6 +1,5 @@
 #include "AdBlockFilter.h"
 #include "Bitfield.h"
-#include "FastHash.h"
 #include "URL.h"
 
 #include <algorithm>
@@ -11,7 +10,7 @@ namespace adblock
 
 Filter::Filter(const QString &rule) :
     m_category(FilterCategory::None),
-    m_ruleString(rule),
+    m_ruleString(rule.toUtf8()),
     m_evalString(),
     m_contentSecurityPolicy(),
     m_exception(false),
@@ -26,9 +25,8 @@ Filter::Filter(const QString &rule) :
     m_domainBlacklist(),
     m_domainWhitelist(),
     m_regExp(nullptr),
-    m_differenceHash(0),
-    m_evalStringHash(0),
-    m_needleWStr()
+    m_decodedRule(nullptr),
+    m_hitCount(0)
 {
 }
 
@@ -48,10 +46,9 @@ Filter::Filter(const Filter &other) :
     m_matchAll(other.m_matchAll),
     m_domainBlacklist(other.m_domainBlacklist),
     m_domainWhitelist(other.m_domainWhitelist),
-    m_regExp(other.m_regExp ? std::make_unique<QRegularExpression>(*other.m_regExp) : nullptr),
-    m_differenceHash(other.m_differenceHash),
-    m_evalStringHash(other.m_evalStringHash),
-    m_needleWStr(other.m_needleWStr)
+    m_regExp(nullptr),
+    m_decodedRule(nullptr),
+    m_hitCount(other.getHitCount())
 {
 }
 
@@ -71,10 +68,9 @@ Filter::Filter(Filter &&other) noexcept :
     m_matchAll(other.m_matchAll),
     m_domainBlacklist(std::move(other.m_domainBlacklist)),
     m_domainWhitelist(std::move(other.m_domainWhitelist)),
-    m_regExp(std::move(other.m_regExp)),
-    m_differenceHash(other.m_differenceHash),
-    m_evalStringHash(other.m_evalStringHash),
-    m_needleWStr(std::move(other.m_needleWStr))
+    m_regExp(other.m_regExp.exchange(nullptr)),
+    m_decodedRule(other.m_decodedRule.exchange(nullptr)),
+    m_hitCount(other.getHitCount())
 {
 }
 
@@ -97,10 +93,9 @@ Filter &Filter::operator =(const Filter &other)
         m_matchAll = other.m_matchAll;
         m_domainBlacklist = other.m_domainBlacklist;
         m_domainWhitelist = other.m_domainWhitelist;
-        m_regExp = (other.m_regExp ? std::make_unique<QRegularExpression>(*other.m_regExp) : nullptr);
-        m_differenceHash = other.m_differenceHash;
-        m_evalStringHash = other.m_evalStringHash;
-        m_needleWStr = other.m_needleWStr;
+        delete m_regExp.exchange(nullptr);
+        delete m_decodedRule.exchange(nullptr);
+        m_hitCount.store(other.getHitCount(), std::memory_order_relaxed);
     }
 
     return *this;
@@ -125,16 +120,17 @@ Filter &Filter::operator =(Filter &&other) noexcept
         m_matchAll = other.m_matchAll;
         m_domainBlacklist = std::move(other.m_domainBlacklist);
         m_domainWhitelist = std::move(other.m_domainWhitelist);
-        m_regExp = std::move(other.m_regExp);
-        m_differenceHash = other.m_differenceHash;
-        m_evalStringHash = other.m_evalStringHash;
-        m_needleWStr = other.m_needleWStr;
+        delete m_regExp.exchange(other.m_regExp.exchange(nullptr));
+        delete m_decodedRule.exchange(other.m_decodedRule.exchange(nullptr));
+        m_hitCount.store(other.getHitCount(), std::memory_order_relaxed);
     }
     return *this;
 }
 
 Filter::~Filter()
 {
+    delete m_regExp.load();
+    delete m_decodedRule.load();
 }
 
 FilterCategory Filter::getCategory() const
@@ -144,12 +140,28 @@ FilterCategory Filter::getCategory() const
 
 void Filter::setRule(const QString &rule)
 {
-    m_ruleString = rule;
+    m_ruleString = rule.toUtf8();
+    delete m_decodedRule.exchange(nullptr);
 }
 
-const QString &Filter::getRule() const
+QString Filter::getRule() const
 {
-    return m_ruleString;
+    return QString::fromUtf8(m_ruleString);
+}
+
+const QString &Filter::getMatchedRule() const
+{
+    QString *decodedRule = m_decodedRule.load(std::memory_order_acquire);
+    if (decodedRule != nullptr)
+        return *decodedRule;
+
+    std::unique_ptr<QString> decoded = std::make_unique<QString>(QString::fromUtf8(m_ruleString));
+
+    // Another thread may have decoded the rule in the meantime, in which case its copy is used instead
+    if (m_decodedRule.compare_exchange_strong(decodedRule, decoded.get(), std::memory_order_acq_rel))
+        decodedRule = decoded.release();
+
+    return *decodedRule;
 }
 
 const QString &Filter::getEvalString() const
@@ -232,14 +244,10 @@ bool Filter::isMatch(const QString &baseUrl, const QString &requestUrl, const QS
                 match = (requestUrl.compare(m_evalString, caseSensitivity) == 0);
                 break;
             case FilterCategory::StringContains:
-            {
-                QString haystack = (m_matchCase ? requestUrl : requestUrl.toLower());
-                std::wstring haystackWStr = haystack.toStdWString();
-                match = FastHash::isMatch(m_needleWStr, haystackWStr, m_evalStringHash, m_differenceHash);
+                match = requestUrl.contains(m_evalString, caseSensitivity);
                 break;
-            }
             case FilterCategory::RegExp:
-                match = m_regExp->match(requestUrl).hasMatch();
+                match = getRegExp().match(requestUrl).hasMatch();
                 break;
             default:
                 break;
@@ -300,12 +308,62 @@ bool Filter::isDomainStyleMatch(const QString &domain) const
 
 void Filter::addDomainToWhitelist(const QString &domainStr)
 {
-    m_domainWhitelist.insert(domainStr);
+    insertDomain(m_domainWhitelist, domainStr);
 }
 
 void Filter::addDomainToBlacklist(const QString &domainStr)
 {
-    m_domainBlacklist.insert(domainStr);
+    insertDomain(m_domainBlacklist, domainStr);
+}
+
+const QRegularExpression &Filter::getRegExp() const
+{
+    QRegularExpression *regExp = m_regExp.load(std::memory_order_acquire);
+    if (regExp != nullptr)
+        return *regExp;
+
+    const QRegularExpression::PatternOptions options = m_matchCase ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption;
+    std::unique_ptr<QRegularExpression> compiled = std::make_unique<QRegularExpression>(m_evalString, options);
+
+    // Another thread may have created the same regular expression in the meantime, in which case it is used instead
+    if (m_regExp.compare_exchange_strong(regExp, compiled.get(), std::memory_order_acq_rel))
+        regExp = compiled.release();
+
+    return *regExp;
+}
+
+void Filter::insertDomain(std::vector<QString> &domainList, const QString &domain)
+{
+    auto it = std::lower_bound(domainList.begin(), domainList.end(), domain);
+    if (it != domainList.end() && *it == domain)
+        return;
+
+    domainList.insert(it, domain);
+}
+
+void Filter::writeDomainList(QDataStream &out, const std::vector<QString> &domainList)
+{
+    out << static_cast<quint32>(domainList.size());
+    for (const QString &domain : domainList)
+        out << domain;
+}
+
+void Filter::readDomainList(QDataStream &in, std::vector<QString> &domainList)
+{
+    domainList.clear();
+
+    quint32 numDomains = 0;
+    in >> numDomains;
+    if (in.status() != QDataStream::Ok)
+        return;
+
+    domainList.reserve(numDomains);
+    for (quint32 i = 0; i < numDomains && in.status() == QDataStream::Ok; ++i)
+    {
+        QString domain;
+        in >> domain;
+        insertDomain(domainList, domain);
+    }
 }
 
 void Filter::setEvalString(const QString &evalString)
@@ -342,19 +400,63 @@ bool Filter::isDomainStartMatch(const QString &requestUrl, const QString &second
     return false;
 }
 
-void Filter::hashEvalString()
+void Filter::setContentSecurityPolicy(const QString &csp)
 {
-    if (m_matchAll || m_evalString.isEmpty())
-        return;
+    m_contentSecurityPolicy = csp;
+}
 
-    m_needleWStr = m_evalString.toStdWString();
-    m_differenceHash = FastHash::getDifferenceHash(static_cast<quint64>(m_evalString.size()));
-    m_evalStringHash = FastHash::getNeedleHash(m_needleWStr);
+QDataStream &operator<<(QDataStream &out, const Filter &filter)
+{
+    out << static_cast<qint32>(filter.m_category)
+        << filter.m_ruleString
+        << filter.m_evalString
+        << filter.m_contentSecurityPolicy
+        << filter.m_exception
+        << filter.m_important
+        << filter.m_disabled
+        << filter.m_redirect
+        << filter.m_redirectName
+        << static_cast<quint64>(filter.m_allowedTypes)
+        << static_cast<quint64>(filter.m_blockedTypes)
+        << filter.m_matchCase
+        << filter.m_matchAll;
+
+    Filter::writeDomainList(out, filter.m_domainBlacklist);
+    Filter::writeDomainList(out, filter.m_domainWhitelist);
+    return out;
 }
 
-void Filter::setContentSecurityPolicy(const QString &csp)
+QDataStream &operator>>(QDataStream &in, Filter &filter)
 {
-    m_contentSecurityPolicy = csp;
+    qint32 category = 0;
+    quint64 allowedTypes = 0, blockedTypes = 0;
+
+    in >> category
+       >> filter.m_ruleString
+       >> filter.m_evalString
+       >> filter.m_contentSecurityPolicy
+       >> filter.m_exception
+       >> filter.m_important
+       >> filter.m_disabled
+       >> filter.m_redirect
+       >> filter.m_redirectName
+       >> allowedTypes
+       >> blockedTypes
+       >> filter.m_matchCase
+       >> filter.m_matchAll;
+
+    Filter::readDomainList(in, filter.m_domainBlacklist);
+    Filter::readDomainList(in, filter.m_domainWhitelist);
+
+    filter.m_category = static_cast<FilterCategory>(category);
+    filter.m_allowedTypes = static_cast<ElementType>(allowedTypes);
+    filter.m_blockedTypes = static_cast<ElementType>(blockedTypes);
+
+    // The regular expression and the decoded rule are created again on first use
+    delete filter.m_regExp.exchange(nullptr);
+    delete filter.m_decodedRule.exchange(nullptr);
+
+    return in;
 }
 
 }
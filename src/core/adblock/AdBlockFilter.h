@@ -3,9 +3,14 @@
 
 #include "Bitfield.h"
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <tuple>
+#include <vector>
+
+#include <QByteArray>
+#include <QDataStream>
 #include <QHash>
 #include <QRegularExpression>
 #include <QSet>
@@ -105,8 +110,14 @@ class Filter
 {
     friend class FilterContainer;
     friend class FilterParser;
+    friend class FilterDomainIndex;
+    friend class FilterSegment;
+    friend class FilterTokenIndex;
     friend class AdBlockManager;
 
+    friend QDataStream &operator<<(QDataStream &out, const Filter &filter);
+    friend QDataStream &operator>>(QDataStream &in, Filter &filter);
+
 public:
     /// Constructs the filter given the corresponding rule (a line in an adblock plus-formatted file)
     explicit Filter(const QString &rule);
@@ -130,7 +141,11 @@ class Filter
     FilterCategory getCategory() const;
 
     /// Returns the original filter rule as a QString
-    const QString &getRule() const;
+    QString getRule() const;
+
+    /// Returns the original filter rule, decoding it once on the first call. Used for filters that match
+    /// network requests, so that only those keep a decoded copy of their rule
+    const QString &getMatchedRule() const;
 
     /// Returns the evaluation string of the rule
     const QString &getEvalString() const;
@@ -166,6 +181,18 @@ class Filter
     /// Returns true if this rule is of the Stylesheet category and applies to the given domain, returns false if else.
     bool isDomainStyleMatch(const QString &domain) const;
 
+    /// Increments the number of times that the filter has matched a network request
+    inline void recordHit() const
+    {
+        m_hitCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Returns the number of times that the filter has matched a network request
+    inline quint32 getHitCount() const
+    {
+        return m_hitCount.load(std::memory_order_relaxed);
+    }
+
     /// Returns true if the given ElementType bitfield is set for the bit associated with the target ElementType
     inline bool hasElementType(ElementType subject, ElementType target) const
     {
@@ -185,9 +212,6 @@ class Filter
     /// Evaluates the rule, setting the filter to reflect the corresponding value(s)
     void setRule(const QString &rule);
 
-    /// Calculates the hash value of the evaluation string and the difference hash variable, used in Rabin-Karp string matching algorithm
-    void hashEvalString();
-
     /// Sets the content security policy of the filter
     void setContentSecurityPolicy(const QString &csp);
 
@@ -195,6 +219,18 @@ class Filter
     /// Returns true if the given domain matches the base domain string, false if else
     bool isDomainMatch(QString base, const QString &domainStr) const;
 
+    /// Returns the regular expression of a filter in the RegExp category, compiling it on first use
+    const QRegularExpression &getRegExp() const;
+
+    /// Inserts the domain into the sorted domain list, if not already present
+    static void insertDomain(std::vector<QString> &domainList, const QString &domain);
+
+    /// Writes a domain list to the data stream
+    static void writeDomainList(QDataStream &out, const std::vector<QString> &domainList);
+
+    /// Reads a domain list from the data stream
+    static void readDomainList(QDataStream &in, std::vector<QString> &domainList);
+
     /// Compares the requested domain the evaluation string, returning true if the filter matches the request, false if else
     bool isDomainStartMatch(const QString &requestUrl, const QString &secondLevelDomain) const;
 
@@ -202,10 +238,10 @@ class Filter
     /// Filter category
     FilterCategory m_category;
 
-    /// Original rule string
-    QString m_ruleString;
+    /// Original rule string, encoded in UTF-8 as rules are almost entirely ASCII
+    QByteArray m_ruleString;
 
-    /// Comparison string for evaluating rules (only used if category of filter is not RegExp)
+    /// Comparison string for evaluating rules. For filters of the RegExp category, this is the pattern of the regular expression
     QString m_evalString;
 
     /// Content security policy for filters with blocking type CSP
@@ -238,26 +274,29 @@ class Filter
     /// Set to true if evaluation string is empty. Requests will still be checked based on domain blacklist/whitelist and allowed/blocked element types, etc
     bool m_matchAll;
 
-    /// List of domains that the filter rule applies to. Specified by the domain filter option
-    QSet<QString> m_domainBlacklist;
+    /// Sorted list of domains that the filter rule applies to. Specified by the domain filter option
+    std::vector<QString> m_domainBlacklist;
 
-    /// List of domains that the filter rule does not apply to. Specified by the domain filter option
-    QSet<QString> m_domainWhitelist;
+    /// Sorted list of domains that the filter rule does not apply to. Specified by the domain filter option
+    std::vector<QString> m_domainWhitelist;
 
-    /// Unique pointer to a regular expression used by the filter, if filter is of the category RegExp
-    std::unique_ptr<QRegularExpression> m_regExp;
+    /// Regular expression used by the filter, if filter is of the category RegExp. It is only created
+    /// once the filter is compared against a request, as most regular expression filters never are
+    mutable std::atomic<QRegularExpression*> m_regExp;
 
-private:
-    /// Used for string hash computations in rabin-karp matching algorithm
-    quint64 m_differenceHash;
-
-    /// Contains a hash of the evaluation string, used if filter category is StringContains
-    quint64 m_evalStringHash;
+    /// Decoded copy of the rule string, created by \ref getMatchedRule
+    mutable std::atomic<QString*> m_decodedRule;
 
-    /// Wide-string used in rabin-karp string matching algorithm
-    std::wstring m_needleWStr;
+    /// Number of times that the filter has matched a network request. Only used to order filters, so it is updated without synchronization
+    mutable std::atomic<quint32> m_hitCount;
 };
 
+/// Serializes the parsed state of the filter into the data stream
+QDataStream &operator<<(QDataStream &out, const Filter &filter);
+
+/// Deserializes the parsed state of a filter from the data stream
+QDataStream &operator>>(QDataStream &in, Filter &filter);
+
 }
 
 #endif // ADBLOCKFILTER_H
@@ -2,30 +2,34 @@
 #include "URL.h"
 
 #include <algorithm>
+#include <atomic>
+#include <QFileInfo>
 #include <QHash>
+#include <QSet>
 
 namespace adblock
 {
 
+/// Source of the generation numbers of the filter containers
+static std::atomic<uint64_t> nextGeneration { 1 };
+
+FilterContainer::FilterContainer() :
+    m_generation(nextGeneration.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+uint64_t FilterContainer::getGeneration() const
+{
+    return m_generation;
+}
+
 Filter *FilterContainer::findImportantBlockingFilter(
         const QString &baseUrl,
         const QString &requestUrl,
         const QString &requestDomain,
-        ElementType typeMask)
+        ElementType typeMask) const
 {
-    for (auto it = m_importantBlockFilters.begin(); it != m_importantBlockFilters.end(); ++it)
-    {
-        Filter *filter = *it;
-        if (filter->isMatch(baseUrl, requestUrl, requestDomain, typeMask))
-        {
-            it = m_importantBlockFilters.erase(it);
-            m_importantBlockFilters.push_front(filter);
-
-            return filter;
-        }
-    }
-
-    return nullptr;
+    return m_importantBlockIndex.findMatch(baseUrl, requestUrl, requestDomain, typeMask);
 }
 
 Filter *FilterContainer::findBlockingRequestFilter(
@@ -33,47 +37,40 @@ Filter *FilterContainer::findBlockingRequestFilter(
         const QString &baseUrl,
         const QString &requestUrl,
         const QString &requestDomain,
-        ElementType typeMask)
+        ElementType typeMask) const
 {
     Filter *matchingBlockFilter = nullptr;
-    auto checkFiltersForMatch = [&](std::deque<Filter*> &filterContainer) {
-        for (auto it = filterContainer.begin(); it != filterContainer.end(); ++it)
+
+    // Filters of each domain are sorted by the number of hits they had in the previous filter container
+    auto itr = m_blockFiltersByDomain.constFind(requestSecondLevelDomain);
+    if (itr != m_blockFiltersByDomain.constEnd())
+    {
+        for (Filter *filter : *itr)
         {
-            Filter *filter = *it;
             if (filter->isMatch(baseUrl, requestUrl, requestDomain, typeMask))
             {
+                filter->recordHit();
                 matchingBlockFilter = filter;
-                it = filterContainer.erase(it);
-                filterContainer.push_front(filter);
-                return;
+                break;
             }
         }
-    };
-
-    auto itr = m_blockFiltersByDomain.find(requestSecondLevelDomain);
-    if (itr != m_blockFiltersByDomain.end())
-        checkFiltersForMatch(*itr);
+    }
 
     if (matchingBlockFilter == nullptr)
-        checkFiltersForMatch(m_blockFilters);
+        matchingBlockFilter = m_blockIndex.findMatch(baseUrl, requestUrl, requestDomain, typeMask);
 
     if (matchingBlockFilter == nullptr)
-        checkFiltersForMatch(m_blockFiltersByPattern);
+        matchingBlockFilter = m_blockPatternMatcher.findMatch(baseUrl, requestUrl, requestDomain, typeMask);
 
     return matchingBlockFilter;
 }
 
-Filter *FilterContainer::findWhitelistingFilter(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask)
+Filter *FilterContainer::findWhitelistingFilter(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask) const
 {
-    for (Filter *filter : m_allowFilters)
-    {
-        if (filter->isMatch(baseUrl, requestUrl, requestDomain, typeMask))
-        {
-            return filter;
-        }
-    }
+    if (Filter *filter = m_allowIndex.findMatch(baseUrl, requestUrl, requestDomain, typeMask))
+        return filter;
 
-    return nullptr;
+    return m_allowPatternMatcher.findMatch(baseUrl, requestUrl, requestDomain, typeMask);
 }
 
 bool FilterContainer::hasGenericHideFilter(const QString &requestUrl, const QString &secondLevelDomain) const
@@ -97,15 +94,12 @@ std::vector<Filter*> FilterContainer::getDomainBasedHidingFilters(const QString
     std::vector<Filter*> result;
     std::vector<Filter*> matches;
     QHash<QString, bool> whitelistedFilters;
-    for (Filter *filter : m_domainStyleFilters)
+    for (Filter *filter : m_domainStyleFilters.findMatches(domain))
     {
-        if (filter->isDomainStyleMatch(domain))
-        {
-            if (filter->isException())
-                whitelistedFilters.insert(filter->getEvalString(), true);
-            else
-                matches.push_back(filter);
-        }
+        if (filter->isException())
+            whitelistedFilters.insert(filter->getEvalString(), true);
+        else
+            matches.push_back(filter);
     }
     for (Filter *filter : matches)
     {
@@ -117,35 +111,17 @@ std::vector<Filter*> FilterContainer::getDomainBasedHidingFilters(const QString
 
 std::vector<Filter*> FilterContainer::getDomainBasedCustomHidingFilters(const QString &domain) const
 {
-    std::vector<Filter*> result;
-    for (Filter *filter : m_customStyleFilters)
-    {
-        if (filter->isDomainStyleMatch(domain))
-            result.push_back(filter);
-    }
-    return result;
+    return m_customStyleFilters.findMatches(domain);
 }
 
 std::vector<Filter*> FilterContainer::getDomainBasedScriptInjectionFilters(const QString &domain) const
 {
-    std::vector<Filter*> result;
-    for (Filter *filter : m_domainJSFilters)
-    {
-        if (filter->isDomainStyleMatch(domain))
-            result.push_back(filter);
-    }
-    return result;
+    return m_domainJSFilters.findMatches(domain);
 }
 
 std::vector<Filter*> FilterContainer::getDomainBasedCosmeticProceduralFilters(const QString &domain) const
 {
-    std::vector<Filter*> result;
-    for (Filter *filter : m_domainProceduralFilters)
-    {
-        if (filter->isDomainStyleMatch(domain))
-            result.push_back(filter);
-    }
-    return result;
+    return m_domainProceduralFilters.findMatches(domain);
 }
 
 std::vector<Filter*> FilterContainer::getMatchingCSPFilters(const QString &requestUrl, const QString &domain) const
@@ -173,7 +149,7 @@ std::vector<Filter*> FilterContainer::getMatchingCSPFilters(const QString &reque
 
 const Filter *FilterContainer::findInlineScriptBlockingFilter(const QString &requestUrl, const QString &domain) const
 {
-    auto filterCSPCheck = [&](const std::deque<Filter*> &filterContainer) -> const Filter* {
+    auto filterCSPCheck = [&](const std::vector<Filter*> &filterContainer) -> const Filter* {
         for (const Filter *filter : filterContainer)
         {
             if (filter->isMatch(requestUrl, requestUrl, domain, ElementType::InlineScript))
@@ -184,7 +160,7 @@ const Filter *FilterContainer::findInlineScriptBlockingFilter(const QString &req
         return nullptr;
     };
 
-    const Filter *result = filterCSPCheck(m_importantBlockFilters);
+    const Filter *result = m_importantBlockIndex.findMatch(requestUrl, requestUrl, domain, ElementType::InlineScript);
 
     if (!result)
     {
@@ -196,32 +172,139 @@ const Filter *FilterContainer::findInlineScriptBlockingFilter(const QString &req
     }
 
     if (!result)
-        result = filterCSPCheck(m_blockFilters);
+        result = m_blockIndex.findMatch(requestUrl, requestUrl, domain, ElementType::InlineScript);
 
     if (!result)
-        result = filterCSPCheck(m_blockFiltersByPattern);
+        result = m_blockPatternMatcher.findMatch(requestUrl, requestUrl, domain, ElementType::InlineScript);
 
     return result;
 }
 
-void FilterContainer::clearFilters()
+std::shared_ptr<const FilterSegment> FilterContainer::findCurrentSegment(const QString &filePath) const
 {
-    m_importantBlockFilters.clear();
-    m_allowFilters.clear();
-    m_blockFilters.clear();
-    m_blockFiltersByPattern.clear();
-    m_blockFiltersByDomain.clear();
-    m_stylesheet.clear();
-    m_domainStyleFilters.clear();
-    m_domainJSFilters.clear();
-    m_domainProceduralFilters.clear();
-    m_customStyleFilters.clear();
-    m_genericHideFilters.clear();
-    m_cspFilters.clear();
+    for (const std::shared_ptr<const FilterSegment> &segment : m_segments)
+    {
+        if (segment->getFilePath() != filePath)
+            continue;
+
+        if (segment->isCurrent(QFileInfo(filePath)))
+            return segment;
+
+        break;
+    }
+
+    return nullptr;
 }
 
-void FilterContainer::extractFilters(std::vector<Subscription> &subscriptions)
+std::vector< std::shared_ptr<const FilterSegment> > FilterContainer::getChangedSegments(const FilterContainer &other) const
 {
+    std::vector< std::shared_ptr<const FilterSegment> > result;
+
+    auto collectMissing = [&result](const FilterContainer &source, const FilterContainer &target) {
+        for (const std::shared_ptr<const FilterSegment> &segment : source.m_segments)
+        {
+            if (std::find(target.m_segments.begin(), target.m_segments.end(), segment) == target.m_segments.end())
+                result.push_back(segment);
+        }
+    };
+
+    collectMissing(*this, other);
+    collectMissing(other, *this);
+    return result;
+}
+
+/// Returns the number of elements that the storage of a deque of filters has room for, assuming
+/// that it is allocated in blocks of 512 bytes
+static std::size_t getAllocatedSize(const std::deque<Filter*> &filters)
+{
+    constexpr std::size_t blockSize = 512 / sizeof(Filter*);
+    return (filters.size() + blockSize - 1) / blockSize * blockSize;
+}
+
+FilterMemoryReport FilterContainer::getMemoryReport() const
+{
+    FilterMemoryReport report {};
+
+    auto stringBytes = [](const QString &str) -> std::size_t {
+        if (str.isNull())
+            return 0;
+        return sizeof(QArrayData) + static_cast<std::size_t>(str.capacity() + 1) * sizeof(QChar);
+    };
+
+    QSet<const QChar*> sharedDomains;
+
+    auto addFilter = [&](const Filter *filter) {
+        ++report.NumFilters;
+        report.FilterBytes += sizeof(Filter);
+
+        if (!filter->m_ruleString.isNull())
+            report.RuleBytes += sizeof(QArrayData) + static_cast<std::size_t>(filter->m_ruleString.capacity() + 1);
+        if (const QString *decodedRule = filter->m_decodedRule.load(std::memory_order_acquire))
+            report.RuleBytes += sizeof(QString) + stringBytes(*decodedRule);
+
+        report.EvalStringBytes += stringBytes(filter->m_evalString)
+                + stringBytes(filter->m_contentSecurityPolicy)
+                + stringBytes(filter->m_redirectName);
+
+        report.DomainListBytes += (filter->m_domainBlacklist.capacity() + filter->m_domainWhitelist.capacity()) * sizeof(QString);
+
+        // Domains are shared by the filters of a subscription, so each string is only counted once
+        for (const std::vector<QString> *domainList : { &filter->m_domainBlacklist, &filter->m_domainWhitelist })
+        {
+            for (const QString &domain : *domainList)
+            {
+                if (sharedDomains.contains(domain.constData()))
+                    continue;
+
+                sharedDomains.insert(domain.constData());
+                ++report.NumInternedDomains;
+                report.InternedDomainBytes += stringBytes(domain);
+            }
+        }
+
+        if (filter->m_category == FilterCategory::RegExp)
+        {
+            ++report.NumRegExpFilters;
+            if (filter->m_regExp.load(std::memory_order_relaxed) != nullptr)
+                ++report.NumCompiledRegExps;
+        }
+    };
+
+    for (const std::shared_ptr<const FilterSegment> &segment : m_segments)
+    {
+        for (std::size_t i = 0; i < segment->size(); ++i)
+            addFilter(segment->getFilter(i));
+    }
+    for (const std::unique_ptr<Filter> &filter : m_modifiedFilters)
+        addFilter(filter.get());
+
+    report.IndexBytes = m_importantBlockIndex.getMemoryUsage()
+            + m_blockIndex.getMemoryUsage()
+            + m_allowIndex.getMemoryUsage()
+            + m_blockPatternMatcher.getMemoryUsage()
+            + m_allowPatternMatcher.getMemoryUsage()
+            + m_domainStyleFilters.getMemoryUsage()
+            + m_domainJSFilters.getMemoryUsage()
+            + m_domainProceduralFilters.getMemoryUsage()
+            + m_customStyleFilters.getMemoryUsage();
+
+    // Like the rest of the report, lists are measured by the storage they have allocated. Deques
+    // allocate their storage in blocks and do not report it, so they are rounded up to whole blocks
+    const std::size_t numListedFilters = getAllocatedSize(m_importantBlockFilters) + getAllocatedSize(m_blockFilters)
+            + getAllocatedSize(m_blockFiltersByPattern) + m_allowFilters.capacity() + m_genericHideFilters.capacity() + m_cspFilters.capacity();
+    report.IndexBytes += numListedFilters * sizeof(Filter*);
+
+    for (auto it = m_blockFiltersByDomain.cbegin(); it != m_blockFiltersByDomain.cend(); ++it)
+        report.IndexBytes += sizeof(void*) + stringBytes(it.key()) + sizeof(std::vector<Filter*>) + it.value().capacity() * sizeof(Filter*);
+
+    report.StylesheetBytes = stringBytes(m_stylesheet);
+    return report;
+}
+
+void FilterContainer::extractFilters(const std::vector< std::shared_ptr<const FilterSegment> > &segments, const FilterContainer *previous)
+{
+    m_segments = segments;
+
     // Used to store css rules for the global stylesheet and domain-specific stylesheets
     QHash<QString, Filter*> stylesheetFilterMap;
     QHash<QString, Filter*> stylesheetExceptionMap;
@@ -232,23 +315,22 @@ void FilterContainer::extractFilters(std::vector<Subscription> &subscriptions)
     // Setup global stylesheet string
     m_stylesheet = QLatin1String("<style>");
 
-    auto isDuplicate = [](const Filter *filter, const std::deque<Filter*> &container) -> bool {
-        const QString &filterText = filter->getRule();
-        const auto match = std::find_if(std::begin(container), std::end(container), [&filterText](const Filter *f) {
-            return filterText.compare(f->getRule()) == 0;
-        });
-        return match != std::end(container);
+    // Rules of the (non-important) blocking filters that have been added. A given rule always ends up in the same
+    // container, so a single set is enough to detect duplicates across lists
+    QSet<QString> blockingRules;
+    auto isDuplicate = [&blockingRules](const Filter *filter) -> bool {
+        const int numRules = blockingRules.size();
+        blockingRules.insert(filter->getRule());
+        return blockingRules.size() == numRules;
     };
 
-    for (Subscription &sub : subscriptions)
+    for (const std::shared_ptr<const FilterSegment> &segment : m_segments)
     {
         // Add filters to appropriate containers
-        const size_t numFilters = sub.getNumFilters();
-        for (size_t i = 0; i < numFilters; ++i)
+        const std::size_t numFilters = segment->size();
+        for (std::size_t i = 0; i < numFilters; ++i)
         {
-            Filter *filter = sub.getFilter(i);
-            if (!filter || filter->getCategory() == FilterCategory::None || filter->getCategory() == FilterCategory::NotImplemented)
-                continue;
+            Filter *filter = segment->getFilter(i);
 
             if (filter->getCategory() == FilterCategory::Stylesheet)
             {
@@ -259,15 +341,15 @@ void FilterContainer::extractFilters(std::vector<Subscription> &subscriptions)
             }
             else if (filter->getCategory() == FilterCategory::StylesheetJS)
             {
-                m_domainProceduralFilters.push_back(filter);
+                m_domainProceduralFilters.add(filter);
             }
             else if (filter->getCategory() == FilterCategory::Scriptlet)
             {
-                m_domainJSFilters.push_back(filter);
+                m_domainJSFilters.add(filter);
             }
             else if (filter->getCategory() == FilterCategory::StylesheetCustom)
             {
-                m_customStyleFilters.push_back(filter);
+                m_customStyleFilters.add(filter);
             }
             else if (filter->hasElementType(filter->m_blockedTypes, ElementType::BadFilter))
             {
@@ -296,27 +378,19 @@ void FilterContainer::extractFilters(std::vector<Subscription> &subscriptions)
                 }
                 else if (filter->getCategory() == FilterCategory::StringContains)
                 {
-                    if (!isDuplicate(filter, m_blockFiltersByPattern))
+                    if (!isDuplicate(filter))
                         m_blockFiltersByPattern.push_back(filter);
                 }
                 else if (filter->getCategory() == FilterCategory::Domain)
                 {
+                    if (isDuplicate(filter))
+                        continue;
+
                     const URL filterUrl { QUrl::fromUserInput(filter->getEvalString()) };
                     const QString filterDomain = filterUrl.getSecondLevelDomain();
-                    auto it = m_blockFiltersByDomain.find(filterDomain);
-                    if (it != m_blockFiltersByDomain.end())
-                    {
-                        if (!isDuplicate(filter, it.value()))
-                            it->push_back(filter);
-                    }
-                    else
-                    {
-                        std::deque<Filter*> queue;
-                        queue.push_back(filter);
-                        m_blockFiltersByDomain.insert(filterDomain, queue);
-                    }
+                    m_blockFiltersByDomain[filterDomain].push_back(filter);
                 }
-                else if (!isDuplicate(filter, m_blockFilters))
+                else if (!isDuplicate(filter))
                 {
                     m_blockFilters.push_back(filter);
                 }
@@ -324,24 +398,17 @@ void FilterContainer::extractFilters(std::vector<Subscription> &subscriptions)
         }
     }
 
-    // Remove bad filters from all applicable filter containers
-    auto removeBadFiltersFromVector = [&badFilters](std::vector<Filter*> &filterContainer) {
-        for (auto it = filterContainer.begin(); it != filterContainer.end();)
-        {
-            if (badFilters.contains((*it)->getRule()))
-                it = filterContainer.erase(it);
-            else
-                ++it;
-        }
+    // Remove bad filters from all applicable filter containers, in a single pass over each container
+    auto isBadFilter = [&badFilters](const Filter *filter) -> bool {
+        return badFilters.contains(filter->getRule());
     };
-    auto removeBadFiltersFromDeque = [&badFilters](std::deque<Filter*> &filterContainer) {
-        for (auto it = filterContainer.begin(); it != filterContainer.end();)
-        {
-            if (badFilters.contains((*it)->getRule()))
-                it = filterContainer.erase(it);
-            else
-                ++it;
-        }
+    auto removeBadFiltersFromVector = [&badFilters, &isBadFilter](std::vector<Filter*> &filterContainer) {
+        if (!badFilters.isEmpty())
+            filterContainer.erase(std::remove_if(filterContainer.begin(), filterContainer.end(), isBadFilter), filterContainer.end());
+    };
+    auto removeBadFiltersFromDeque = [&badFilters, &isBadFilter](std::deque<Filter*> &filterContainer) {
+        if (!badFilters.isEmpty())
+            filterContainer.erase(std::remove_if(filterContainer.begin(), filterContainer.end(), isBadFilter), filterContainer.end());
     };
 
     removeBadFiltersFromVector(m_allowFilters);
@@ -349,14 +416,66 @@ void FilterContainer::extractFilters(std::vector<Subscription> &subscriptions)
     removeBadFiltersFromDeque(m_blockFilters);
     removeBadFiltersFromDeque(m_blockFiltersByPattern);
 
-    for (std::deque<Filter*> &queue : m_blockFiltersByDomain)
+    for (std::vector<Filter*> &domainFilters : m_blockFiltersByDomain)
     {
-        removeBadFiltersFromDeque(queue);
+        removeBadFiltersFromVector(domainFilters);
+    }
+
+    // Check the filters that matched most often in the previous container first
+    if (previous != nullptr)
+    {
+        QHash<QString, quint32> previousHitCounts;
+        for (const std::vector<Filter*> &domainFilters : previous->m_blockFiltersByDomain)
+        {
+            for (const Filter *filter : domainFilters)
+            {
+                if (const quint32 hitCount = filter->getHitCount())
+                    previousHitCounts.insert(filter->getRule(), hitCount);
+            }
+        }
+
+        if (!previousHitCounts.isEmpty())
+        {
+            for (std::vector<Filter*> &domainFilters : m_blockFiltersByDomain)
+            {
+                // Filters of segments that were kept from the previous container already have their hit counts
+                for (Filter *filter : domainFilters)
+                {
+                    if (filter->getHitCount() == 0)
+                        filter->m_hitCount.store(previousHitCounts.value(filter->getRule(), 0), std::memory_order_relaxed);
+                }
+
+                std::stable_sort(domainFilters.begin(), domainFilters.end(), [](const Filter *a, const Filter *b) {
+                    return a->getHitCount() > b->getHitCount();
+                });
+            }
+        }
     }
 
     removeBadFiltersFromVector(m_cspFilters);
     removeBadFiltersFromVector(m_genericHideFilters);
 
+    // Build the token indices and pattern matchers used to match network requests
+    for (Filter *filter : m_importantBlockFilters)
+        m_importantBlockIndex.add(filter);
+    for (Filter *filter : m_blockFilters)
+        m_blockIndex.add(filter);
+    for (Filter *filter : m_blockFiltersByPattern)
+        m_blockPatternMatcher.add(filter);
+    for (Filter *filter : m_allowFilters)
+    {
+        if (filter->getCategory() == FilterCategory::StringContains)
+            m_allowPatternMatcher.add(filter);
+        else
+            m_allowIndex.add(filter);
+    }
+
+    m_importantBlockIndex.build();
+    m_blockIndex.build();
+    m_blockPatternMatcher.build();
+    m_allowIndex.build();
+    m_allowPatternMatcher.build();
+
     // Parse stylesheet exceptions
     QHashIterator<QString, Filter*> it(stylesheetExceptionMap);
     while (it.hasNext())
@@ -367,8 +486,13 @@ void FilterContainer::extractFilters(std::vector<Subscription> &subscriptions)
         if (!stylesheetFilterMap.contains(it.key()))
             continue;
 
+        // Apply the exception to a copy of the blocking rule, as the original may be in use by other containers
         Filter *filter = it.value();
-        stylesheetFilterMap.value(it.key())->m_domainWhitelist.unite(filter->m_domainBlacklist);
+        std::unique_ptr<Filter> modifiedFilter = std::make_unique<Filter>(*stylesheetFilterMap.value(it.key()));
+        for (const QString &domain : filter->m_domainBlacklist)
+            modifiedFilter->addDomainToWhitelist(domain);
+        stylesheetFilterMap.insert(it.key(), modifiedFilter.get());
+        m_modifiedFilters.push_back(std::move(modifiedFilter));
     }
 
     // Parse stylesheet blocking rules
@@ -381,7 +505,7 @@ void FilterContainer::extractFilters(std::vector<Subscription> &subscriptions)
 
         if (filter->hasDomainRules())
         {
-            m_domainStyleFilters.push_back(filter);
+            m_domainStyleFilters.add(filter);
             continue;
         }
 
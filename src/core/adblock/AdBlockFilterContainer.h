@@ -3,30 +3,94 @@
 
 #include "AdBlockFilter.h"
 #include "AdBlockSubscription.h"
+#include "FilterDomainIndex.h"
+#include "FilterSegment.h"
+#include "FilterPatternMatcher.h"
+#include "FilterTokenIndex.h"
 
+#include <cstdint>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <vector>
 
 #include <QHash>
 #include <QObject>
 #include <QString>
 
+class AdBlockFilterTest;
+
 namespace adblock
 {
 
+/**
+ * @struct FilterMemoryReport
+ * @brief Approximate breakdown of the memory used by the filters of a \ref FilterContainer, in bytes
+ * @ingroup AdBlock
+ */
+struct FilterMemoryReport
+{
+    /// Number of filters owned by the container's segments, including the modified copies of stylesheet filters
+    std::size_t NumFilters;
+
+    /// Size of the filter objects themselves
+    std::size_t FilterBytes;
+
+    /// Original rule strings of the filters, and the decoded copies kept by filters that matched a request
+    std::size_t RuleBytes;
+
+    /// Evaluation strings, content security policies and redirect names of the filters
+    std::size_t EvalStringBytes;
+
+    /// Domain lists of the filters, excluding the domain strings that they share
+    std::size_t DomainListBytes;
+
+    /// Number of distinct domain strings referred to by the domain lists of the filters
+    std::size_t NumInternedDomains;
+
+    /// Domain strings referred to by the domain lists of the filters, counting shared strings once
+    std::size_t InternedDomainBytes;
+
+    /// Number of regular expressions that have been compiled, out of the NumRegExpFilters filters that use one
+    std::size_t NumCompiledRegExps;
+
+    /// Number of filters of the RegExp category
+    std::size_t NumRegExpFilters;
+
+    /// Token indices, pattern matchers, domain indices and filter containers used for lookups
+    std::size_t IndexBytes;
+
+    /// Global stylesheet
+    std::size_t StylesheetBytes;
+
+    /// Returns the sum of all byte counts in the report
+    std::size_t getTotalBytes() const
+    {
+        return FilterBytes + RuleBytes + EvalStringBytes + DomainListBytes + InternedDomainBytes + IndexBytes + StylesheetBytes;
+    }
+};
+
 /**
  * @class FilterContainer
  * @brief Stores filter rules in various containers, optimized for fastest lookup time.
+ *
+ * The filters are owned by the \ref FilterSegment of each subscription, which the container shares with
+ * the containers built before and after it. The container is not modified after the extraction, so that
+ * it may be queried from several threads at once.
  * @ingroup AdBlock
  */
 class FilterContainer
 {
     friend class AdBlockManager;
+    friend class AdBlockBenchmark;
+    friend class ::AdBlockFilterTest;
 
 public:
-    /// Default constructor
-    FilterContainer() = default;
+    /// Default constructor, which gives the container a new generation number
+    FilterContainer();
+
+    /// Returns the generation number of the container, which no other container in the process shares
+    uint64_t getGeneration() const;
 
     /**
      * @brief Searches the important blocking filter container for the first match
@@ -36,7 +100,7 @@ class FilterContainer
      * @param typeMask Element type(s) associated with the request.
      * @return A pointer to the first matching filter rule, or a nullptr if not found
      */
-    Filter *findImportantBlockingFilter(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask);
+    Filter *findImportantBlockingFilter(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask) const;
 
     /**
      * @brief Searches the blocking filter containers (excluding the important blocking filter container) for the first network request match
@@ -48,7 +112,7 @@ class FilterContainer
      * @return A pointer to the first matching filter rule, or a nullptr if not found
      */
     Filter *findBlockingRequestFilter(const QString &requestSecondLevelDomain, const QString &baseUrl,
-                                             const QString &requestUrl, const QString &requestDomain, ElementType typeMask);
+                                             const QString &requestUrl, const QString &requestDomain, ElementType typeMask) const;
 
     /**
      * @brief Searches the whitelisting filter container for the first match
@@ -58,7 +122,7 @@ class FilterContainer
      * @param typeMask Element type(s) associated with the request.
      * @return A pointer to the first matching filter rule, or a nullptr if not found
      */
-    Filter *findWhitelistingFilter(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask);
+    Filter *findWhitelistingFilter(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask) const;
 
     /// Searches for a matching domain-specific filters of which the generic element hiding rules do not apply.
     /// Returns true if a matching filter was found, or false otherwise.
@@ -90,14 +154,36 @@ class FilterContainer
      */
     const Filter *findInlineScriptBlockingFilter(const QString &requestUrl, const QString &domain) const;
 
-protected:
-    /// Clears current filter data
-    void clearFilters();
+    /// Returns the segment of the subscription with the given file path, if the file has not changed since the segment was loaded.
+    /// Returns a nullptr if the segment is not found or is outdated
+    std::shared_ptr<const FilterSegment> findCurrentSegment(const QString &filePath) const;
+
+    /// Returns the segments that belong to only one of this container and the other container
+    std::vector< std::shared_ptr<const FilterSegment> > getChangedSegments(const FilterContainer &other) const;
 
-    /// Extracts ad blocking filter rules from the given container of filter list subscriptions.
-    void extractFilters(std::vector<Subscription> &subscriptions);
+    /// Returns an approximate breakdown of the memory used by the filters of the container and by its lookup structures
+    FilterMemoryReport getMemoryReport() const;
+
+protected:
+    /**
+     * @brief Places the ad blocking filter rules of the given segments into the appropriate containers
+     * @param segments Filter segments of the enabled subscriptions, in the order of the subscription list
+     * @param previous The filter container that is being replaced, if any. The hit counts of its filters are carried
+     *                 over to the equivalent filters of this container, to determine the order in which they are checked
+     */
+    void extractFilters(const std::vector< std::shared_ptr<const FilterSegment> > &segments, const FilterContainer *previous);
 
 private:
+    /// Generation number of the container
+    uint64_t m_generation;
+
+    /// Segments that own the filters of the container
+    std::vector< std::shared_ptr<const FilterSegment> > m_segments;
+
+    /// Copies of the stylesheet filters that have been modified by the stylesheet exceptions of this container.
+    /// The filters of a segment are shared with other containers, so they are never modified
+    std::vector< std::unique_ptr<Filter> > m_modifiedFilters;
+
     /// Global adblock stylesheet
     QString m_stylesheet;
 
@@ -111,28 +197,43 @@ class FilterContainer
     std::deque<Filter*> m_blockFiltersByPattern;
 
     /// Hashmap of filters that are of the Domain category (||some.domain.com^ style filter rules)
-    QHash<QString, std::deque<Filter*>> m_blockFiltersByDomain;
+    QHash<QString, std::vector<Filter*>> m_blockFiltersByDomain;
 
     /// Container of filters that whitelist content
     std::vector<Filter*> m_allowFilters;
 
-    /// Container of filters that have domain-specific stylesheet rules
-    std::vector<Filter*> m_domainStyleFilters;
+    /// Index of filters that have domain-specific stylesheet rules
+    FilterDomainIndex m_domainStyleFilters;
 
-    /// Container of filters that have domain-specific javascript rules
-    std::vector<Filter*> m_domainJSFilters;
+    /// Index of filters that have domain-specific javascript rules
+    FilterDomainIndex m_domainJSFilters;
 
-    /// Container of filters that have domain-specific procedural filter rules
-    std::vector<Filter*> m_domainProceduralFilters;
+    /// Index of filters that have domain-specific procedural filter rules
+    FilterDomainIndex m_domainProceduralFilters;
 
-    /// Container of filters that have custom stylesheet values (:style filter option)
-    std::vector<Filter*> m_customStyleFilters;
+    /// Index of filters that have custom stylesheet values (:style filter option)
+    FilterDomainIndex m_customStyleFilters;
 
     /// Container of domain-specific filters for which the generic element hiding rules do not apply
     std::vector<Filter*> m_genericHideFilters;
 
     /// Container of filters that set the content security policy for a matching domain
     std::vector<Filter*> m_cspFilters;
+
+    /// Token index of the important blocking filters
+    FilterTokenIndex m_importantBlockIndex;
+
+    /// Token index of the blocking filters that are neither matched by domain nor by partial string match
+    FilterTokenIndex m_blockIndex;
+
+    /// Multi-pattern matcher of the blocking filters that match based on a partial string match
+    FilterPatternMatcher m_blockPatternMatcher;
+
+    /// Token index of the whitelisting filters, excluding those of the StringContains category
+    FilterTokenIndex m_allowIndex;
+
+    /// Multi-pattern matcher of the whitelisting filters of the StringContains category
+    FilterPatternMatcher m_allowPatternMatcher;
 };
 
 }
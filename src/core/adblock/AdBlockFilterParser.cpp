@@ -5,7 +5,6 @@
 
 #include <algorithm>
 #include <array>
-#include <QRegularExpression>
 #include <QDebug>
 
 namespace adblock
@@ -28,8 +27,11 @@ QHash<QString, ElementType> eOptionMap = {
     { QStringLiteral("popunder"), ElementType::NotImplemented },       { QStringLiteral("other"), ElementType::Other }
 };
 
+const quint32 FilterParser::Version = 2;
+
 FilterParser::FilterParser(AdBlockManager *adBlockManager) :
-    m_adBlockManager(adBlockManager)
+    m_adBlockManager(adBlockManager),
+    m_internedDomains()
 {
 }
 
@@ -78,9 +80,7 @@ std::unique_ptr<Filter> FilterParser::makeFilter(QString rule) const
         rule = rule.mid(1);
         rule = rule.left(rule.size() - 1);
 
-        QRegularExpression::PatternOptions options =
-                (filterPtr->m_matchCase ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption);
-        filterPtr->m_regExp = std::make_unique<QRegularExpression>(rule, options);
+        filterPtr->m_evalString = rule;
         return filter;
     }
 
@@ -136,9 +136,7 @@ std::unique_ptr<Filter> FilterParser::makeFilter(QString rule) const
     // Ad block format -> regular expression conversion
     if (maybeRegExp || rule.contains(QChar('|')))
     {
-        QRegularExpression::PatternOptions options =
-                (filterPtr->m_matchCase ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption);
-        filterPtr->m_regExp = std::make_unique<QRegularExpression>(parseRegExp(rule), options);
+        filterPtr->m_evalString = parseRegExp(rule);
         filterPtr->m_category = FilterCategory::RegExp;
         return filter;
     }
@@ -157,13 +155,8 @@ std::unique_ptr<Filter> FilterParser::makeFilter(QString rule) const
 
     // If no category set by now, it is a string contains type
     if (filterPtr->getCategory() == FilterCategory::None)
-    {
         filterPtr->m_category = FilterCategory::StringContains;
 
-        // Pre-calculate hash of evaluation string for Rabin-Karp string matching
-        filterPtr->hashEvalString();
-    }
-
     return filter;
 }
 
@@ -677,12 +670,28 @@ void FilterParser::parseDomains(const QString &domainString, QChar delimiter, Fi
             domain = domain.left(domain.size() - 1);
 
         if (domain.at(0) == QChar('~'))
-            filter->addDomainToWhitelist(domain.mid(1));
+            filter->addDomainToWhitelist(internDomain(domain.mid(1)));
         else
-            filter->addDomainToBlacklist(domain);
+            filter->addDomainToBlacklist(internDomain(domain));
     }
 }
 
+void FilterParser::internDomains(Filter *filter) const
+{
+    for (QString &domain : filter->m_domainBlacklist)
+        domain = internDomain(domain);
+    for (QString &domain : filter->m_domainWhitelist)
+        domain = internDomain(domain);
+}
+
+QString FilterParser::internDomain(const QString &domain) const
+{
+    auto it = m_internedDomains.constFind(domain);
+    if (it == m_internedDomains.constEnd())
+        it = m_internedDomains.insert(domain);
+    return *it;
+}
+
 void FilterParser::parseOptions(const QString &optionString, Filter *filter) const
 {
     QStringList optionsList = optionString.split(QChar(','), QStringSplitFlag::SkipEmptyParts);
@@ -760,10 +769,10 @@ void FilterParser::parseOptions(const QString &optionString, Filter *filter) con
     // (so the hash can be made and compared to other filters for removal)
     if (filter->hasElementType(filter->m_blockedTypes, ElementType::BadFilter))
     {
-        if (filter->m_ruleString.endsWith(QStringLiteral(",badfilter")))
-            filter->m_ruleString = filter->m_ruleString.left(filter->m_ruleString.indexOf(QStringLiteral(",badfilter")));
-        else if (filter->m_ruleString.endsWith(QStringLiteral("$badfilter")))
-            filter->m_ruleString = filter->m_ruleString.left(filter->m_ruleString.indexOf(QStringLiteral("$badfilter")));
+        if (filter->m_ruleString.endsWith(",badfilter"))
+            filter->m_ruleString.chop(static_cast<int>(qstrlen(",badfilter")));
+        else if (filter->m_ruleString.endsWith("$badfilter"))
+            filter->m_ruleString.chop(static_cast<int>(qstrlen("$badfilter")));
     }
 
     if (filter->hasElementType(filter->m_blockedTypes, ElementType::NotImplemented)
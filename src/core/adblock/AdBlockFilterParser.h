@@ -4,6 +4,7 @@
 #include "AdBlockFilter.h"
 
 #include <memory>
+#include <QSet>
 #include <QString>
 
 namespace adblock
@@ -58,16 +59,26 @@ struct CosmeticJSCallback
  * @ingroup AdBlock
  * @brief Instantiates \ref Filter objects from rule strings formatted
  *        as per the AdBlock Plus or uBlock Origin specifications
+ *
+ * The filters created by a parser share the string data of the domains in their domain lists.
+ * A parser is used by one thread at a time, and its table of domains is released along with it.
  */
 class FilterParser
 {
 public:
+    /// Version of the parser's output. Must be incremented whenever a change to the parser alters the state of the filters it creates
+    static const quint32 Version;
+
     /// Constructs the filter parser
     FilterParser(AdBlockManager *adBlockManager);
 
     /// Instantiates and returns an Filter given a filter rule
     std::unique_ptr<Filter> makeFilter(QString rule) const;
 
+    /// Makes the domain lists of a filter that was read from a cache share their string data
+    /// with the other filters of this parser
+    void internDomains(Filter *filter) const;
+
 private:
     /// Returns true if the given rule string is able to be interpreted as a domain anchor rule with no regular expressions.
     /// Example [will return true]: ||my.adserver.com^
@@ -106,9 +117,15 @@ class FilterParser
     /// Parses the given AdBlock Plus -formatted regular expression, returning the equivalent string used for a QRegularExpression
     QString parseRegExp(const QString &regExpString) const;
 
+    /// Returns the copy of the given domain that is shared by the filters of this parser
+    QString internDomain(const QString &domain) const;
+
 private:
     /// Pointer to the ad blocker
     AdBlockManager *m_adBlockManager;
+
+    /// Distinct domain strings referred to by the domain lists of the filters created by this parser
+    mutable QSet<QString> m_internedDomains;
 };
 
 }
@@ -1,82 +1,166 @@
 #include "AdBlockLog.h"
 
-#include <algorithm>
+#include <unordered_map>
+
+#include <QHash>
 
 namespace adblock
 {
 
+const std::size_t AdBlockLog::Capacity = 4096;
+
+/// Number of characters in the text buffer of the log's string table
+static const std::size_t StringTableCapacity = 1 << 20;
+
+/// Number of slots in the hash index of the log's string table
+static const std::size_t StringTableIndexSize = 4096;
+
+/// Maximum number of characters of the request URL stored for each record. The request URLs of a full ring of
+/// records fill at most half of the string table. As shared strings are never older than a quarter of the table,
+/// the last quarter is left for the new rules and first party URLs written while a record is live
+static const int MaxRequestUrlLength = static_cast<int>(StringTableCapacity / (2 * AdBlockLog::Capacity));
+
 AdBlockLog::AdBlockLog(QObject *parent) :
     QObject(parent),
-    m_entries(),
-    m_timerId(0)
+    m_slots(new LogSlot[Capacity]),
+    m_writeIndex(0),
+    m_strings(StringTableCapacity, StringTableIndexSize),
+    m_startTime(std::chrono::steady_clock::now()),
+    m_startDateTime(QDateTime::currentDateTime())
 {
-    // Prune logs every 30 minutes
-    m_timerId = startTimer(1000 * 60 * 30);
+    for (std::size_t i = 0; i < Capacity; ++i)
+    {
+        LogSlot &slot = m_slots[i];
+        slot.Sequence.store(0, std::memory_order_relaxed);
+        slot.Action.store(0, std::memory_order_relaxed);
+        slot.ResourceType.store(0, std::memory_order_relaxed);
+        slot.RuleId.store(0, std::memory_order_relaxed);
+        slot.FirstPartyUrlId.store(0, std::memory_order_relaxed);
+        slot.FirstPartyUrlHash.store(0, std::memory_order_relaxed);
+        slot.RequestUrlId.store(0, std::memory_order_relaxed);
+        slot.Timestamp.store(0, std::memory_order_relaxed);
+    }
 }
 
 AdBlockLog::~AdBlockLog()
 {
-    killTimer(m_timerId);
 }
 
 void AdBlockLog::addEntry(FilterAction action, const QUrl &firstPartyUrl, const QUrl &requestUrl,
-              ElementType resourceType, const QString &rule, const QDateTime &timestamp)
+              ElementType resourceType, const QString &rule)
 {
-    auto it = m_entries.find(firstPartyUrl);
-    if (it != m_entries.end())
-        it->push_back({ action, firstPartyUrl, requestUrl, resourceType, rule, timestamp });
-    else
-        m_entries[firstPartyUrl] = { { action, firstPartyUrl, requestUrl, resourceType, rule, timestamp } };
-}
+    const int64_t timestamp = getElapsedTime();
+    const QString firstPartyUrlStr = firstPartyUrl.toString().left(LogStringTable::MaxStringLength);
+    const uint64_t ruleId = m_strings.intern(rule);
+    const uint64_t firstPartyUrlId = m_strings.intern(firstPartyUrlStr);
+    const uint firstPartyUrlHash = qHash(firstPartyUrlStr);
+    const uint64_t requestUrlId = m_strings.append(requestUrl.toString().left(MaxRequestUrlLength));
 
-std::vector<LogEntry> AdBlockLog::getAllEntries() const
-{
-    // Combine all entries
-    std::vector<LogEntry> entries;
-    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
-    {
-        for (const LogEntry &logEntry : *it)
-            entries.push_back(logEntry);
-    }
+    const uint64_t index = m_writeIndex.fetch_add(1, std::memory_order_relaxed);
+    LogSlot &slot = m_slots[index & (Capacity - 1)];
 
-    // Sort entries from newest to oldest
-    std::sort(entries.begin(), entries.end(), [](const LogEntry &a, const LogEntry &b){
-        return a.Timestamp < b.Timestamp;
-    });
+    // Take ownership of the slot. If another writer is still filling it, or has already stored a newer
+    // record in it, this record would be overwritten anyway and is dropped
+    uint64_t sequence = slot.Sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) != 0 || sequence > 2 * index
+            || !slot.Sequence.compare_exchange_strong(sequence, 2 * index + 1, std::memory_order_relaxed))
+        return;
 
-    return entries;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.Action.store(static_cast<int>(action), std::memory_order_relaxed);
+    slot.ResourceType.store(static_cast<uint64_t>(resourceType), std::memory_order_relaxed);
+    slot.RuleId.store(ruleId, std::memory_order_relaxed);
+    slot.FirstPartyUrlId.store(firstPartyUrlId, std::memory_order_relaxed);
+    slot.FirstPartyUrlHash.store(firstPartyUrlHash, std::memory_order_relaxed);
+    slot.RequestUrlId.store(requestUrlId, std::memory_order_relaxed);
+    slot.Timestamp.store(timestamp, std::memory_order_relaxed);
+
+    slot.Sequence.store(2 * index + 2, std::memory_order_release);
 }
 
-const std::vector<LogEntry> &AdBlockLog::getEntriesFor(const QUrl &firstPartyUrl)
+std::vector<LogRecord> AdBlockLog::getAllEntries() const
 {
-    auto it = m_entries.find(firstPartyUrl);
-    if (it != m_entries.end())
-        return *it;
-
-    std::vector<LogEntry> entriesForUrl;
-    it = m_entries.insert(firstPartyUrl, entriesForUrl);
-    return *it;
+    return takeSnapshot([](const LogRecord &) { return true; });
 }
 
-void AdBlockLog::timerEvent(QTimerEvent */*event*/)
+std::vector<LogRecord> AdBlockLog::getEntriesFor(const QUrl &firstPartyUrl) const
 {
-    pruneLogs();
+    const QString firstPartyUrlStr = firstPartyUrl.toString().left(LogStringTable::MaxStringLength);
+    const uint firstPartyUrlHash = qHash(firstPartyUrlStr);
+
+    // Most records of a page share the same handle for its URL, so only resolve each handle once
+    std::unordered_map<uint64_t, bool> matchingUrlIds;
+
+    return takeSnapshot([&](const LogRecord &record) {
+        if (record.FirstPartyUrlHash != firstPartyUrlHash)
+            return false;
+
+        auto it = matchingUrlIds.find(record.FirstPartyUrlId);
+        if (it == matchingUrlIds.end())
+        {
+            // A URL that has been overwritten can only be compared by its hash
+            const QString url = m_strings.lookup(record.FirstPartyUrlId);
+            it = matchingUrlIds.emplace(record.FirstPartyUrlId, url.isNull() || url == firstPartyUrlStr).first;
+        }
+        return it->second;
+    });
 }
 
-void AdBlockLog::pruneLogs()
+LogEntry AdBlockLog::getEntry(const LogRecord &record) const
 {
-    const quint64 pruneThreshold = 1000 * 60 * 30;
-    const QDateTime now = QDateTime::currentDateTime();
-    auto removeCheck = [&](const LogEntry &logEntry) {
-        return static_cast<quint64>(logEntry.Timestamp.msecsTo(now)) >= pruneThreshold;
+    return LogEntry {
+        record.Action,
+        QUrl(m_strings.lookup(record.FirstPartyUrlId)),
+        QUrl(m_strings.lookup(record.RequestUrlId)),
+        record.ResourceType,
+        m_strings.lookup(record.RuleId),
+        m_startDateTime.addMSecs(record.Timestamp)
     };
+}
 
-    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+template <typename Predicate>
+std::vector<LogRecord> AdBlockLog::takeSnapshot(Predicate &&predicate) const
+{
+    std::vector<LogRecord> records;
+
+    const uint64_t endIndex = m_writeIndex.load(std::memory_order_acquire);
+    const uint64_t startIndex = endIndex > Capacity ? endIndex - Capacity : 0;
+    records.reserve(static_cast<std::size_t>(endIndex - startIndex));
+
+    for (uint64_t index = startIndex; index < endIndex; ++index)
     {
-        std::vector<LogEntry> &entries = *it;
-        auto newEnd = std::remove_if(entries.begin(), entries.end(), removeCheck);
-        entries.erase(newEnd, entries.end());
+        const LogSlot &slot = m_slots[index & (Capacity - 1)];
+
+        // Skip records that are still being written, or that were overwritten while being copied
+        const uint64_t sequence = slot.Sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2)
+            continue;
+
+        LogRecord record {
+            static_cast<FilterAction>(slot.Action.load(std::memory_order_relaxed)),
+            static_cast<ElementType>(slot.ResourceType.load(std::memory_order_relaxed)),
+            slot.RuleId.load(std::memory_order_relaxed),
+            slot.FirstPartyUrlId.load(std::memory_order_relaxed),
+            slot.FirstPartyUrlHash.load(std::memory_order_relaxed),
+            slot.RequestUrlId.load(std::memory_order_relaxed),
+            slot.Timestamp.load(std::memory_order_relaxed)
+        };
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.Sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        if (predicate(record))
+            records.push_back(record);
     }
+
+    return records;
+}
+
+int64_t AdBlockLog::getElapsedTime() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_startTime).count();
 }
 
 }
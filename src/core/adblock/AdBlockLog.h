@@ -2,13 +2,19 @@
 #define ADBLOCKLOG_H
 
 #include "AdBlockFilter.h"
+#include "LogStringTable.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 #include <QDateTime>
-#include <QHash>
+#include <QObject>
+#include <QString>
 #include <QUrl>
 
-#include <vector>
-
 namespace adblock
 {
 
@@ -46,11 +52,45 @@ struct LogEntry
     QDateTime Timestamp;
 };
 
+/**
+ * @struct LogRecord
+ * @brief Compact form of a \ref LogEntry, as it is stored in the \ref AdBlockLog. Strings are referred
+ *        to by their handles in the log's string table
+ * @ingroup AdBlock
+ */
+struct LogRecord
+{
+    /// The action that was done to the request
+    FilterAction Action;
+
+    /// The type or types associated with the requested resource
+    ElementType ResourceType;
+
+    /// Handle of the filter rule that was applied to the request
+    uint64_t RuleId;
+
+    /// Handle of the source from which the request was made
+    uint64_t FirstPartyUrlId;
+
+    /// Hash of the source from which the request was made. Used to find the record after its handle has been overwritten
+    uint FirstPartyUrlHash;
+
+    /// Handle of the resource that was requested
+    uint64_t RequestUrlId;
+
+    /// Time of the log entry, in milliseconds on the steady clock since the log was created
+    int64_t Timestamp;
+};
+
 /**
  * @class AdBlockLog
- * @brief This class stores information about any recent network requests that were affected by
+ * @brief This class stores information about the most recent network requests that were affected by
  *        an \ref AdBlockFilter
  * @ingroup AdBlock
+ *
+ * Entries are stored in a fixed-capacity ring buffer of compact records, which overwrites its oldest records
+ * once full, so the memory used by the log does not grow over time. Entries may be added from any thread
+ * without locking. Readers take a snapshot of the records and resolve them into \ref LogEntry objects on demand.
  */
 class AdBlockLog : public QObject
 {
@@ -70,32 +110,67 @@ class AdBlockLog : public QObject
      * @param requestUrl The resource that was requested
      * @param resourceType The type or types associated with the requested resource
      * @param rule The filter rule that was applied to the request
-     * @param timestamp The time of the network action
      */
     void addEntry(FilterAction action, const QUrl &firstPartyUrl, const QUrl &requestUrl,
-                  ElementType resourceType, const QString &rule, const QDateTime &timestamp);
+                  ElementType resourceType, const QString &rule);
 
-    /// Returns all log entries
-    std::vector<LogEntry> getAllEntries() const;
+    /// Returns a snapshot of all records in the log, from oldest to newest
+    std::vector<LogRecord> getAllEntries() const;
 
-    /// Returns all log entries associated with the given first party request url, or
-    /// an empty container if no entries are found
-    const std::vector<LogEntry> &getEntriesFor(const QUrl &firstPartyUrl);
+    /// Returns a snapshot of the records associated with the given first party request url, from oldest to newest.
+    /// This includes records whose first party URL has since been overwritten in the string table
+    std::vector<LogRecord> getEntriesFor(const QUrl &firstPartyUrl) const;
 
-protected:
-    /// Called on a regular interval to prune older log entries
-    void timerEvent(QTimerEvent *event) override;
+    /// Resolves the strings and timestamp of a record into a log entry. Strings that have since been
+    /// overwritten in the string table are left empty
+    LogEntry getEntry(const LogRecord &record) const;
 
-private Q_SLOTS:
-    /// Removes any entries from the logs that are more than 30 minutes old
-    void pruneLogs();
+    /// Maximum number of records kept in the log
+    static const std::size_t Capacity;
 
 private:
-    /// Hashmap of first party URLs associated with requests, to containers of their associated log entries
-    QHash<QUrl, std::vector<LogEntry>> m_entries;
+    /**
+     * @struct LogSlot
+     * @brief Slot of the ring buffer. The sequence number is odd while the slot is being written, and equal
+     *        to twice the index of its record plus two once the record is complete
+     */
+    struct LogSlot
+    {
+        /// Sequence number of the slot
+        std::atomic<uint64_t> Sequence;
+
+        /// Fields of the \ref LogRecord stored in the slot
+        std::atomic<int> Action;
+        std::atomic<uint64_t> ResourceType;
+        std::atomic<uint64_t> RuleId;
+        std::atomic<uint64_t> FirstPartyUrlId;
+        std::atomic<uint> FirstPartyUrlHash;
+        std::atomic<uint64_t> RequestUrlId;
+        std::atomic<int64_t> Timestamp;
+    };
+
+    /// Copies the records accepted by the given predicate
+    template <typename Predicate>
+    std::vector<LogRecord> takeSnapshot(Predicate &&predicate) const;
+
+    /// Returns the number of milliseconds elapsed on the steady clock since the log was created
+    int64_t getElapsedTime() const;
+
+private:
+    /// Ring buffer of log records
+    std::unique_ptr<LogSlot[]> m_slots;
+
+    /// Index of the next record to be written. Incremented by every writer
+    std::atomic<uint64_t> m_writeIndex;
+
+    /// Interned filter rules and URLs of the log records
+    LogStringTable m_strings;
+
+    /// Time at which the log was created, on the steady clock
+    const std::chrono::steady_clock::time_point m_startTime;
 
-    /// Unique identifier of the log pruning timer
-    int m_timerId;
+    /// Time at which the log was created, on the system clock. Used to display the time of each entry
+    const QDateTime m_startDateTime;
 };
 
 }
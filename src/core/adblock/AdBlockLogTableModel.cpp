@@ -1,5 +1,7 @@
 #include "AdBlockLogTableModel.h"
 
+#include <utility>
+
 #include <QString>
 
 namespace adblock
@@ -7,7 +9,10 @@ namespace adblock
 
 LogTableModel::LogTableModel(QObject *parent) :
     QAbstractTableModel(parent),
-    m_logEntries()
+    m_log(nullptr),
+    m_logRecords(),
+    m_logEntries(),
+    m_isEntryResolved()
 {
 }
 
@@ -37,7 +42,7 @@ int LogTableModel::rowCount(const QModelIndex &parent) const
     if (parent.isValid())
         return 0;
 
-    return static_cast<int>(m_logEntries.size());
+    return static_cast<int>(m_logRecords.size());
 }
 
 int LogTableModel::columnCount(const QModelIndex &parent) const
@@ -51,13 +56,13 @@ int LogTableModel::columnCount(const QModelIndex &parent) const
 
 QVariant LogTableModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() >= static_cast<int>(m_logEntries.size()))
+    if (!index.isValid() || index.row() >= static_cast<int>(m_logRecords.size()))
         return QVariant();
 
     if (role != Qt::DisplayRole)
         return QVariant();
 
-    const LogEntry &entry = m_logEntries.at(index.row());
+    const LogEntry &entry = getEntry(index.row());
     switch (index.column())
     {
         // Timestamp column
@@ -162,10 +167,26 @@ QString LogTableModel::elementTypeToString(ElementType type) const
     return result;
 }
 
-void LogTableModel::setLogEntries(const std::vector<LogEntry> &entries)
+const LogEntry &LogTableModel::getEntry(int row) const
+{
+    const std::size_t index = static_cast<std::size_t>(row);
+    if (!m_isEntryResolved[index])
+    {
+        m_logEntries[index] = m_log->getEntry(m_logRecords[index]);
+        m_isEntryResolved[index] = true;
+    }
+
+    return m_logEntries[index];
+}
+
+void LogTableModel::setLogEntries(const AdBlockLog *log, std::vector<LogRecord> records)
 {
     beginResetModel();
-    m_logEntries = entries;
+    m_log = log;
+    m_logRecords = std::move(records);
+    m_logEntries.clear();
+    m_logEntries.resize(m_logRecords.size());
+    m_isEntryResolved.assign(m_logRecords.size(), false);
     endResetModel();
 }
 
@@ -31,16 +31,29 @@ class LogTableModel : public QAbstractTableModel
     /// Returns the data associated at the index with the given role
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 
-    /// Sets the log entry data to be shown in the table
-    void setLogEntries(const std::vector<LogEntry> &entries);
+    /// Sets the log records to be shown in the table. Each record is resolved into a \ref LogEntry
+    /// by the log once it is first displayed
+    void setLogEntries(const AdBlockLog *log, std::vector<LogRecord> records);
 
 private:
     /// Returns the element typemask as a formatted string ("type1[, type2, ..., typeN]")
     QString elementTypeToString(ElementType type) const;
 
+    /// Returns the log entry shown in the given row, resolving it from its record if needed
+    const LogEntry &getEntry(int row) const;
+
 private:
-    /// Logs stored in the table model
-    std::vector<LogEntry> m_logEntries;
+    /// Log from which the records were taken
+    const AdBlockLog *m_log;
+
+    /// Snapshot of the log records shown in the table
+    std::vector<LogRecord> m_logRecords;
+
+    /// Log entries of the rows that have been displayed, indexed by row
+    mutable std::vector<LogEntry> m_logEntries;
+
+    /// Flags indicating which rows have been resolved into a log entry
+    mutable std::vector<bool> m_isEntryResolved;
 };
 
 }
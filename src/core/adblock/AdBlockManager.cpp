@@ -10,10 +10,12 @@
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
+#include <QFutureWatcher>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonValue>
 #include <QNetworkRequest>
+#include <QtConcurrent>
 #include <QtGlobal>
 
 #include <QDebug>
@@ -23,7 +25,8 @@ namespace adblock
 
 AdBlockManager::AdBlockManager(const ViperServiceLocator &serviceLocator, QObject *parent) :
     QObject(parent),
-    m_filterContainer(),
+    m_filterEngine(),
+    m_filterGeneration(0),
     m_downloadManager(nullptr),
     m_enabled(true),
     m_configFile(),
@@ -81,6 +84,7 @@ AdBlockManager::AdBlockManager(const ViperServiceLocator &serviceLocator, QObjec
     },
     m_resourceMap(),
     m_resourceContentTypeMap(),
+    m_resourceLock(),
     m_domainStylesheetCache(24),
     m_jsInjectionCache(24),
     m_emptyStr(),
@@ -114,11 +118,16 @@ AdBlockManager::AdBlockManager(const ViperServiceLocator &serviceLocator, QObjec
     m_log = new AdBlockLog(this);
 
     // Instantiate the network request handler
-    m_requestHandler = new RequestHandler(m_filterContainer, m_log, this);
+    m_requestHandler = new RequestHandler(m_filterEngine, m_log, this);
 }
 
 AdBlockManager::~AdBlockManager()
 {
+    // Filter rebuilds refer to the ad block manager, and must finish before it is destroyed
+    const auto watchers = findChildren<QFutureWatcher<std::shared_ptr<FilterContainer>>*>();
+    for (auto watcher : watchers)
+        watcher->waitForFinished();
+
     save();
 }
 
@@ -133,7 +142,7 @@ void AdBlockManager::setEnabled(bool value)
     // filter data from subscriptions if being set to enabled
     clearFilters();
     if (value)
-        extractFilters();
+        rebuildFilters();
 }
 
 void AdBlockManager::updateSubscriptions()
@@ -164,6 +173,7 @@ void AdBlockManager::updateSubscriptions()
                     {
                         QFile oldFile(subPtr->getFilePath());
                         oldFile.remove();
+                        QFile::remove(subPtr->getCacheFilePath());
                         subPtr->setFilePath(filePath);
                     }
                     item->deleteLater();
@@ -212,8 +222,7 @@ void AdBlockManager::installSubscription(const QUrl &url)
             m_adBlockModel->endInsertRows();
 
         // Reload filters
-        clearFilters();
-        extractFilters();
+        rebuildFilters();
     });
 }
 
@@ -261,18 +270,20 @@ AdBlockModel *AdBlockManager::getModel()
     return m_adBlockModel;
 }
 
-const QString &AdBlockManager::getStylesheet(const URL &url) const
+QString AdBlockManager::getStylesheet(const URL &url) const
 {
+    const std::shared_ptr<const FilterContainer> filters = m_filterEngine.getFilters();
+
     // Check generic hide filters
     QString requestUrl = url.toString(URL::FullyEncoded).toLower();
     QString secondLevelDomain = url.getSecondLevelDomain();
     if (secondLevelDomain.isEmpty())
         secondLevelDomain = url.host();
 
-    if (m_filterContainer.hasGenericHideFilter(requestUrl, secondLevelDomain))
-        return m_emptyStr;
+    if (filters->hasGenericHideFilter(requestUrl, secondLevelDomain))
+        return QString();
 
-    return m_filterContainer.getCombinedFilterStylesheet();
+    return filters->getCombinedFilterStylesheet();
 }
 
 const QString &AdBlockManager::getDomainStylesheet(const URL &url)
@@ -319,9 +330,11 @@ const QString &AdBlockManager::getDomainStylesheet(const URL &url)
                                           "  }\n"
                                           "})();");
 
+    const std::shared_ptr<const FilterContainer> filters = m_filterEngine.getFilters();
+
     QString stylesheet;
     QString stylesheetCustom;
-    std::vector<Filter*> domainBasedHidingFilters = m_filterContainer.getDomainBasedHidingFilters(domain);
+    std::vector<Filter*> domainBasedHidingFilters = filters->getDomainBasedHidingFilters(domain);
     for (Filter *filter : domainBasedHidingFilters)
     {
         QString filterArg = filter->getEvalString();
@@ -329,7 +342,7 @@ const QString &AdBlockManager::getDomainStylesheet(const URL &url)
     }
 
     // Check for custom stylesheet rules
-    domainBasedHidingFilters = m_filterContainer.getDomainBasedCustomHidingFilters(domain);
+    domainBasedHidingFilters = filters->getDomainBasedCustomHidingFilters(domain);
     for (Filter *filter : domainBasedHidingFilters)
     {
         stylesheetCustom.append(filter->getEvalString());
@@ -393,23 +406,25 @@ const QString &AdBlockManager::getDomainJavaScript(const URL &url)
     if (m_jsInjectionCache.has(requestHostStdStr))
         return m_jsInjectionCache.get(requestHostStdStr);
 
+    const std::shared_ptr<const FilterContainer> filters = m_filterEngine.getFilters();
+
     QString scriptlets;
     QString proceduralFilters;
     std::vector<QString> cspDirectives;
 
-    std::vector<Filter*> domainBasedScripts = m_filterContainer.getDomainBasedScriptInjectionFilters(domain);
+    std::vector<Filter*> domainBasedScripts = filters->getDomainBasedScriptInjectionFilters(domain);
     for (Filter *filter : domainBasedScripts)
         scriptlets.append(filter->getEvalString());
 
-    std::vector<Filter*> cosmeticProceduralFilters = m_filterContainer.getDomainBasedCosmeticProceduralFilters(domain);
+    std::vector<Filter*> cosmeticProceduralFilters = filters->getDomainBasedCosmeticProceduralFilters(domain);
     for (Filter *filter : cosmeticProceduralFilters)
         proceduralFilters.append(filter->getEvalString());
 
-    const Filter *inlineScriptBlockingRule = m_filterContainer.findInlineScriptBlockingFilter(requestUrl, domain);
+    const Filter *inlineScriptBlockingRule = filters->findInlineScriptBlockingFilter(requestUrl, domain);
     if (inlineScriptBlockingRule != nullptr)
         cspDirectives.push_back(QLatin1String("script-src 'unsafe-eval' * blob: data:"));
 
-    std::vector<Filter*> cspFilters = m_filterContainer.getMatchingCSPFilters(requestUrl, domain);
+    std::vector<Filter*> cspFilters = filters->getMatchingCSPFilters(requestUrl, domain);
     for (Filter *filter : cspFilters)
         cspDirectives.push_back(filter->getContentSecurityPolicy());
 
@@ -456,8 +471,20 @@ int AdBlockManager::getNumberAdsBlocked(const QUrl &url) const
     return m_requestHandler->getNumberAdsBlocked(url);
 }
 
+quint64 AdBlockManager::getDecisionCacheHitCount() const
+{
+    return m_requestHandler->getDecisionCacheHitCount();
+}
+
+quint64 AdBlockManager::getDecisionCacheMissCount() const
+{
+    return m_requestHandler->getDecisionCacheMissCount();
+}
+
 QString AdBlockManager::getResource(const QString &key) const
 {
+    QReadLocker lock(&m_resourceLock);
+
     QString keyNoSuffix = key;
     keyNoSuffix = keyNoSuffix.replace(QRegularExpression("(\\.[a-zA-Z]+)$"), QString());
     const bool hasKey = m_resourceMap.contains(key);
@@ -480,6 +507,7 @@ QString AdBlockManager::getResourceFromAlias(const QString &alias) const
 
 QString AdBlockManager::getResourceContentType(const QString &key) const
 {
+    QReadLocker lock(&m_resourceLock);
     return m_resourceContentTypeMap.value(key);
 }
 
@@ -523,6 +551,7 @@ void AdBlockManager::removeSubscription(int index)
         if (!subFile.remove())
             qDebug() << "[Advertisement Blocker]: Could not remove subscription file " << subFile.fileName();
     }
+    QFile::remove(it->getCacheFilePath());
 
     m_subscriptions.erase(it);
 
@@ -531,11 +560,8 @@ void AdBlockManager::removeSubscription(int index)
 
 void AdBlockManager::reloadSubscriptions()
 {
-    m_domainStylesheetCache.clear();
-    m_jsInjectionCache.clear();
-
-    clearFilters();
-    extractFilters();
+    // The current filters stay active until the rebuilt filters are published
+    rebuildFilters();
 }
 
 QString AdBlockManager::getSecondLevelDomain(const QUrl &url) const
@@ -611,6 +637,8 @@ void AdBlockManager::loadResourceFile(const QString &path)
             {
                 currentKey = line.left(sepIdx);
                 mimeType = line.mid(sepIdx + 1);
+
+                QWriteLocker lock(&m_resourceLock);
                 m_resourceContentTypeMap.insert(currentKey, mimeType);
             }
             readingValue = true;
@@ -627,6 +655,7 @@ void AdBlockManager::loadResourceFile(const QString &path)
             else
             {
                 // Insert key-value pair into map once an empty line is reached and search for next key
+                QWriteLocker lock(&m_resourceLock);
                 m_resourceMap.insert(currentKey, QString(currentValue));
                 currentValue.clear();
                 readingValue = false;
@@ -703,23 +732,126 @@ void AdBlockManager::loadSubscriptions()
         m_subscriptions.push_back(std::move(subscription));
     }
 
-    extractFilters();
+    rebuildFilters();
 }
 
 void AdBlockManager::clearFilters()
 {
-    m_filterContainer.clearFilters();
+    ++m_filterGeneration;
+
+    m_filterEngine.publish(std::make_shared<FilterContainer>());
+    m_domainStylesheetCache.clear();
+    m_jsInjectionCache.clear();
+    m_requestHandler->clearDecisionCache();
+}
+
+void AdBlockManager::rebuildFilters()
+{
+    const quint64 generation = ++m_filterGeneration;
+
+    auto subscriptions = std::make_shared<std::vector<Subscription>>(copySubscriptionSettings());
+    std::shared_ptr<const FilterContainer> previous = m_filterEngine.getFilters();
+
+    auto watcher = new QFutureWatcher<std::shared_ptr<FilterContainer>>(this);
+    connect(watcher, &QFutureWatcher<std::shared_ptr<FilterContainer>>::finished, this, [this, watcher, generation, subscriptions](){
+        // Discard the result if the filters were cleared or rebuilt again in the meantime
+        if (generation == m_filterGeneration)
+            publishFilters(*subscriptions, watcher->result());
+
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([this, subscriptions, previous](){
+        return buildFilters(*subscriptions, previous);
+    }));
+}
+
+std::shared_ptr<FilterContainer> AdBlockManager::buildFilters(std::vector<Subscription> &subscriptions, std::shared_ptr<const FilterContainer> previous)
+{
+    // Reuse the filters of each subscription whose file has not changed since it was last loaded
+    std::vector< std::shared_ptr<const FilterSegment> > segments(subscriptions.size());
+    std::vector<Subscription*> pendingSubscriptions;
+    for (std::size_t i = 0; i < subscriptions.size(); ++i)
+    {
+        Subscription &subscription = subscriptions.at(i);
+        if (!subscription.isEnabled())
+            continue;
+
+        if (previous)
+            segments[i] = previous->findCurrentSegment(subscription.getFilePath());
+
+        if (!segments[i])
+            pendingSubscriptions.push_back(&subscription);
+    }
+
+    // Subscriptions do not depend on each other, so they are parsed concurrently. Their filters are then
+    // extracted in the order of the subscription list, regardless of which one finished loading first
+    QtConcurrent::blockingMap(pendingSubscriptions, [this](Subscription *s) {
+        s->load(this);
+    });
+
+    std::vector< std::shared_ptr<const FilterSegment> > enabledSegments;
+    for (std::size_t i = 0; i < subscriptions.size(); ++i)
+    {
+        Subscription &subscription = subscriptions.at(i);
+        if (!subscription.isEnabled())
+            continue;
+
+        if (!segments[i])
+            segments[i] = std::make_shared<FilterSegment>(subscription);
+
+        enabledSegments.push_back(segments[i]);
+    }
+
+    std::shared_ptr<FilterContainer> filters = std::make_shared<FilterContainer>();
+    filters->extractFilters(enabledSegments, previous.get());
+    return filters;
 }
 
-void AdBlockManager::extractFilters()
+void AdBlockManager::publishFilters(const std::vector<Subscription> &loadedSubscriptions, std::shared_ptr<const FilterContainer> filters)
 {
-    for (Subscription &s : m_subscriptions)
+    // The subscription list may have changed while the filters were being built, so
+    // the metadata is only copied to the subscriptions that are still present
+    for (const Subscription &loaded : loadedSubscriptions)
+    {
+        for (Subscription &subscription : m_subscriptions)
+        {
+            if (subscription.getFilePath() != loaded.getFilePath())
+                continue;
+
+            subscription.m_name = loaded.getName();
+            subscription.setNextUpdate(loaded.getNextUpdate());
+            break;
+        }
+    }
+
+    // Only the domains that the added or removed segments refer to can have different stylesheets or scripts
+    const std::vector< std::shared_ptr<const FilterSegment> > changedSegments = filters->getChangedSegments(*m_filterEngine.getFilters());
+    if (!changedSegments.empty())
     {
-        // calling load() does nothing if subscription is disabled
-        s.load(this);
+        auto isAffected = [&changedSegments](const std::string &host, const QString &) -> bool {
+            const QString hostStr = QString::fromStdString(host);
+            for (const std::shared_ptr<const FilterSegment> &segment : changedSegments)
+            {
+                if (segment->affectsHost(hostStr))
+                    return true;
+            }
+            return false;
+        };
+        m_domainStylesheetCache.removeIf(isAffected);
+        m_jsInjectionCache.removeIf(isAffected);
     }
 
-    m_filterContainer.extractFilters(m_subscriptions);
+    m_filterEngine.publish(std::move(filters));
+    m_requestHandler->clearDecisionCache();
+}
+
+std::vector<Subscription> AdBlockManager::copySubscriptionSettings() const
+{
+    std::vector<Subscription> subscriptions;
+    subscriptions.reserve(m_subscriptions.size());
+    for (const Subscription &subscription : m_subscriptions)
+        subscriptions.push_back(subscription.copySettings());
+    return subscriptions;
 }
 
 void AdBlockManager::save()
@@ -4,6 +4,7 @@
 #include "AdBlockFilter.h"
 #include "AdBlockFilterContainer.h"
 #include "AdBlockSubscription.h"
+#include "FilterEngine.h"
 #include "LRUCache.h"
 #include "ServiceLocator.h"
 #include "Settings.h"
@@ -12,10 +13,12 @@
 
 #include <QHash>
 #include <QObject>
+#include <QReadWriteLock>
 #include <QString>
 #include <QWebEngineUrlRequestInfo>
 
 #include <deque>
+#include <memory>
 #include <vector>
 
 class BrowserApplication;
@@ -64,7 +67,7 @@ class AdBlockManager : public QObject, public ISettingsObserver
     AdBlockModel *getModel();
 
     /// Returns the base stylesheet for elements to be blocked. If the given url matches a generichide filter, this will return an empty string
-    const QString &getStylesheet(const URL &url) const;
+    QString getStylesheet(const URL &url) const;
 
     /// Returns the domain-specific blocking stylesheet, or an empty string if not applicable
     const QString &getDomainStylesheet(const URL &url);
@@ -81,6 +84,12 @@ class AdBlockManager : public QObject, public ISettingsObserver
     /// Returns the number of ads that were blocked on the page with the given URL during its last page load
     int getNumberAdsBlocked(const QUrl &url) const;
 
+    /// Returns the number of network requests that were handled with a cached decision
+    quint64 getDecisionCacheHitCount() const;
+
+    /// Returns the number of network requests that were compared against the filters
+    quint64 getDecisionCacheMissCount() const;
+
     /// Searches for and returns the value from the resource map that is associated with the given key. Returns an empty string if not found
     QString getResource(const QString &key) const;
 
@@ -128,7 +137,7 @@ public Q_SLOTS:
 
 // Called by BrowserApplication:
 protected:
-    /// Loads active subscriptions
+    /// Reads the list of subscriptions, and starts building their filters on a worker thread
     void loadSubscriptions();
 
 private Q_SLOTS:
@@ -155,15 +164,35 @@ private Q_SLOTS:
     /// Clears current filter data
     void clearFilters();
 
-    /// Extracts pointers to filters from subscriptions into the appropriate containers
-    void extractFilters();
+    /// Loads the subscriptions and builds a new set of filters on a worker thread. The active filters
+    /// remain in use until the new set is published
+    void rebuildFilters();
+
+    /**
+     * @brief Builds a new filter container from the given subscriptions. Safe to call from a worker thread
+     * @param subscriptions Copies of the subscription settings, without any filters
+     * @param previous The active filter container. Its segments are reused for the subscriptions that have not changed,
+     *                 so only the other subscriptions are loaded
+     * @return The new filter container
+     */
+    std::shared_ptr<FilterContainer> buildFilters(std::vector<Subscription> &subscriptions, std::shared_ptr<const FilterContainer> previous);
+
+    /// Copies the metadata that was read from the subscription files back into the subscription list, makes the
+    /// given filters active, and discards the cached stylesheets and scripts of the domains affected by the change
+    void publishFilters(const std::vector<Subscription> &loadedSubscriptions, std::shared_ptr<const FilterContainer> filters);
+
+    /// Returns a copy of the settings of each subscription, without any filters
+    std::vector<Subscription> copySubscriptionSettings() const;
 
     /// Saves subscription information to disk, called by destructor
     void save();
 
 private:
-    /// Stores the union of all subscription list filters
-    FilterContainer m_filterContainer;
+    /// Publishes the union of all subscription list filters
+    FilterEngine m_filterEngine;
+
+    /// Incremented every time the filters are cleared or rebuilt, so the result of an outdated rebuild can be discarded
+    quint64 m_filterGeneration;
 
     /// Download manager, required to update subscription lists
     DownloadManager *m_downloadManager;
@@ -192,6 +221,9 @@ private Q_SLOTS:
     /// Mapping of resource names, from the resource map, to their respective content types
     QHash<QString, QString> m_resourceContentTypeMap;
 
+    /// Guards the resource maps, which are read by the filter parser while filters are rebuilt on a worker thread
+    mutable QReadWriteLock m_resourceLock;
+
     /// A cache of the most recently used domain-specific stylesheets
     LRUCache<std::string, QString> m_domainStylesheetCache;
 
@@ -2,6 +2,7 @@
 #include "AdBlockLog.h"
 #include "AdBlockManager.h"
 #include "AdBlockRequestHandler.h"
+#include "PublicSuffixList.h"
 #include "URL.h"
 
 #include <QDateTime>
@@ -10,12 +11,14 @@
 namespace adblock
 {
 
-RequestHandler::RequestHandler(FilterContainer &filterContainer, AdBlockLog *log, QObject *parent) :
+RequestHandler::RequestHandler(const FilterEngine &filterEngine, AdBlockLog *log, QObject *parent) :
     QObject(parent),
-    m_filterContainer(filterContainer),
+    m_filterEngine(filterEngine),
     m_log(log),
     m_numRequestsBlocked(0),
-    m_pageAdBlockCount()
+    m_pageAdBlockCount(),
+    m_decisionCache(1024),
+    m_decisionCacheMutex()
 {
 }
 
@@ -43,76 +46,114 @@ void RequestHandler::setTotalNumberOfBlockedRequests(quint64 count)
     m_numRequestsBlocked = count;
 }
 
+quint64 RequestHandler::getDecisionCacheHitCount() const
+{
+    QMutexLocker lock(&m_decisionCacheMutex);
+    return m_decisionCache.getHitCount();
+}
+
+quint64 RequestHandler::getDecisionCacheMissCount() const
+{
+    QMutexLocker lock(&m_decisionCacheMutex);
+    return m_decisionCache.getMissCount();
+}
+
+void RequestHandler::clearDecisionCache()
+{
+    QMutexLocker lock(&m_decisionCacheMutex);
+    m_decisionCache.clear();
+}
+
 bool RequestHandler::shouldBlockRequest(QWebEngineUrlRequestInfo &info, const QUrl &firstPartyUrl)
 {
     // Get request URL and the originating URL
     const QUrl requestUrl = info.requestUrl();
     const QString requestUrlStr = info.requestUrl().toString(QUrl::FullyEncoded).toLower();
 
-    //const URL firstPartyUrlWrapper { firstPartyUrl };
-    const URL requestUrlWrapper { requestUrl };
-
     const QString baseUrl = firstPartyUrl.host().toLower();
-    //QString baseUrl = firstPartyUrlWrapper.getSecondLevelDomain().toLower();
-    //if (baseUrl.isEmpty())
-    //    baseUrl = firstPartyUrl.host().toLower();
-
-    // Get request domain
-    QString domain = requestUrl.host().toLower();
-    if (domain.startsWith(QLatin1String("www.")))
-        domain = domain.mid(4);
-
-    if (domain.isEmpty())
-        domain = requestUrlWrapper.getSecondLevelDomain();
 
     // Convert QWebEngine request type to AdBlockFilter request type
     ElementType elemType = getRequestType(info, firstPartyUrl);
 
-    // Compare to filters
-    Filter *matchingBlockFilter = m_filterContainer.findImportantBlockingFilter(baseUrl, requestUrlStr, domain, elemType);
-    if (matchingBlockFilter != nullptr)
-    {
-        ++m_numRequestsBlocked;
-        ++m_pageAdBlockCount[firstPartyUrl];
+    // Take a snapshot of the active filters, which stays valid even if the filters are rebuilt while handling the request
+    const std::shared_ptr<const FilterContainer> filters = m_filterEngine.getFilters();
 
-        if (matchingBlockFilter->isRedirect())
+    // Only compare the request to the filters if the same request has not recently been handled
+    const DecisionKey key { baseUrl, requestUrlStr, elemType };
+    Decision decision;
+    bool isCached = false;
+    {
+        QMutexLocker lock(&m_decisionCacheMutex);
+        const Decision *cachedDecision = m_decisionCache.find(key);
+        if (cachedDecision != nullptr && cachedDecision->Generation == filters->getGeneration())
         {
-            info.redirect(QUrl(QString("blocked:%1").arg(matchingBlockFilter->getRedirectName())));
-            m_log->addEntry(FilterAction::Redirect, firstPartyUrl, requestUrl, elemType, matchingBlockFilter->getRule(), QDateTime::currentDateTime());
-            return false;
+            decision = *cachedDecision;
+            isCached = true;
         }
-
-        m_log->addEntry(FilterAction::Block, firstPartyUrl, requestUrl, elemType, matchingBlockFilter->getRule(), QDateTime::currentDateTime());
-        return true;
     }
 
-    matchingBlockFilter = m_filterContainer.findBlockingRequestFilter(requestUrlWrapper.getSecondLevelDomain(), baseUrl, requestUrlStr, domain, elemType);
+    if (!isCached)
+    {
+        decision = findDecision(filters, baseUrl, requestUrl, requestUrlStr, elemType);
 
-    // Stop here if we did not find a blocking filter - let the request proceed
-    if (matchingBlockFilter == nullptr)
+        // Replaces any decision made with an older filter container
+        QMutexLocker lock(&m_decisionCacheMutex);
+        m_decisionCache.put(key, decision);
+    }
+
+    // Let the request proceed if no filter applies to it
+    if (decision.MatchingFilter == nullptr)
         return false;
 
-    if (Filter *filter = m_filterContainer.findWhitelistingFilter(baseUrl, requestUrlStr, domain, elemType))
-    {
-        m_log->addEntry(FilterAction::Allow, firstPartyUrl, requestUrl, elemType, filter->getRule(), QDateTime::currentDateTime());
+    m_log->addEntry(decision.Action, firstPartyUrl, requestUrl, elemType, decision.MatchingFilter->getMatchedRule());
+
+    if (decision.Action == FilterAction::Allow)
         return false;
-    }
 
-    // If we reach this point, then the matching block filter is applied to the request
     ++m_numRequestsBlocked;
     ++m_pageAdBlockCount[firstPartyUrl];
 
-    if (matchingBlockFilter->isRedirect())
+    if (decision.Action == FilterAction::Redirect)
     {
-        info.redirect(QUrl(QString("blocked:%1").arg(matchingBlockFilter->getRedirectName())));
-        m_log->addEntry(FilterAction::Redirect, firstPartyUrl, requestUrl, elemType, matchingBlockFilter->getRule(), QDateTime::currentDateTime());
+        info.redirect(QUrl(QString("blocked:%1").arg(decision.MatchingFilter->getRedirectName())));
         return false;
     }
 
-    m_log->addEntry(FilterAction::Block, firstPartyUrl, requestUrl, elemType, matchingBlockFilter->getRule(), QDateTime::currentDateTime());
     return true;
 }
 
+RequestHandler::Decision RequestHandler::findDecision(const std::shared_ptr<const FilterContainer> &filters, const QString &baseUrl, const QUrl &requestUrl,
+                                                     const QString &requestUrlStr, ElementType elemType) const
+{
+    const QString requestHost = requestUrl.host();
+    const QString requestSecondLevelDomain = PublicSuffixList::instance().getRegistrableDomain(requestHost).toString();
+
+    // Get request domain
+    QString domain = requestHost.toLower();
+    if (domain.startsWith(QLatin1String("www.")))
+        domain = domain.mid(4);
+
+    if (domain.isEmpty())
+        domain = requestSecondLevelDomain;
+
+    // Compare to filters
+    Filter *matchingBlockFilter = filters->findImportantBlockingFilter(baseUrl, requestUrlStr, domain, elemType);
+    if (matchingBlockFilter != nullptr)
+        return { matchingBlockFilter->isRedirect() ? FilterAction::Redirect : FilterAction::Block, matchingBlockFilter, filters->getGeneration() };
+
+    matchingBlockFilter = filters->findBlockingRequestFilter(requestSecondLevelDomain, baseUrl, requestUrlStr, domain, elemType);
+
+    // Stop here if we did not find a blocking filter - let the request proceed
+    if (matchingBlockFilter == nullptr)
+        return { FilterAction::Allow, nullptr, filters->getGeneration() };
+
+    if (Filter *filter = filters->findWhitelistingFilter(baseUrl, requestUrlStr, domain, elemType))
+        return { FilterAction::Allow, filter, filters->getGeneration() };
+
+    // If we reach this point, then the matching block filter is applied to the request
+    return { matchingBlockFilter->isRedirect() ? FilterAction::Redirect : FilterAction::Block, matchingBlockFilter, filters->getGeneration() };
+}
+
 ElementType RequestHandler::getRequestType(const QWebEngineUrlRequestInfo &info, const QUrl &firstPartyUrl) const
 {
     const URL firstPartyUrlWrapper { firstPartyUrl };
@@ -184,10 +225,23 @@ ElementType RequestHandler::getRequestType(const QWebEngineUrlRequestInfo &info,
     if (firstPartyUrlWrapper.isEmpty()
             || (firstPartyUrlWrapper.toString().compare(QLatin1String(".")) == 0)
             || (firstPartyUrlWrapper.toString().compare(QLatin1String("data;,")) == 0)
-            || (requestUrl.getSecondLevelDomain() != firstPartyUrlWrapper.getSecondLevelDomain()))
+            || PublicSuffixList::instance().isThirdParty(requestUrl.host(), firstPartyUrlWrapper.host()))
         elemType |= ElementType::ThirdParty;
 
     return elemType;
 }
 
+bool RequestHandler::DecisionKey::operator==(const DecisionKey &other) const
+{
+    return Type == other.Type
+            && RequestUrl == other.RequestUrl
+            && FirstPartyHost == other.FirstPartyHost;
+}
+
+std::size_t RequestHandler::DecisionKeyHash::operator()(const DecisionKey &key) const
+{
+    const uint seed = qHash(key.FirstPartyHost) ^ qHash(static_cast<quint64>(key.Type));
+    return qHash(key.RequestUrl, seed);
+}
+
 }
@@ -3,12 +3,17 @@
 
 #include "AdBlockFilter.h"
 #include "AdBlockFilterContainer.h"
+#include "AdBlockLog.h"
 #include "AdBlockSubscription.h"
+#include "FilterEngine.h"
+#include "LRUCache.h"
 
 #include <deque>
+#include <memory>
 #include <vector>
 
 #include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QString>
 #include <QWebEngineUrlRequestInfo>
@@ -16,8 +21,6 @@
 namespace adblock
 {
 
-class AdBlockLog;
-
 /**
  * @class RequestHandler
  * @brief Examines network requests to see if they should be blocked, whitelisted or redirected based
@@ -27,12 +30,13 @@ class AdBlockLog;
 class RequestHandler : public QObject
 {
     friend class AdBlockManager;
+    friend class AdBlockBenchmark;
 
     Q_OBJECT
 
 public:
     /// Constructs the request handler with the given parent
-    explicit RequestHandler(FilterContainer &filterContainer, AdBlockLog *log, QObject *parent);
+    explicit RequestHandler(const FilterEngine &filterEngine, AdBlockLog *log, QObject *parent);
 
     /// Returns the number of ads that were blocked on the page with the given URL during its last page load
     int getNumberAdsBlocked(const QUrl &url) const;
@@ -43,6 +47,12 @@ class RequestHandler : public QObject
     /// Returns true if the given request should be blocked, false if else
     bool shouldBlockRequest(QWebEngineUrlRequestInfo &info, const QUrl &firstPartyUrl);
 
+    /// Returns the number of requests that were handled with a decision from the cache
+    quint64 getDecisionCacheHitCount() const;
+
+    /// Returns the number of requests that had to be compared against the filters
+    quint64 getDecisionCacheMissCount() const;
+
 protected:
     /// Sets the counter that stores the total number of network requests that have been blocked
     void setTotalNumberOfBlockedRequests(quint64 count);
@@ -50,13 +60,57 @@ class RequestHandler : public QObject
     /// Begins to keep track of the number of ads that were blocked on the page with the given url
     void loadStarted(const QUrl &url);
 
+    /// Discards all cached decisions. Must be called whenever the filters are cleared or rebuilt
+    void clearDecisionCache();
+
 private:
+    /// Identifies a network request, for the purpose of caching the decision that was made about it
+    struct DecisionKey
+    {
+        /// Host of the first party URL
+        QString FirstPartyHost;
+
+        /// Lower-case, fully encoded form of the request URL
+        QString RequestUrl;
+
+        /// Element type(s) associated with the request
+        ElementType Type;
+
+        /// Returns true if both keys refer to the same request, false if else
+        bool operator==(const DecisionKey &other) const;
+    };
+
+    /// Computes the hash of a \ref DecisionKey
+    struct DecisionKeyHash
+    {
+        std::size_t operator()(const DecisionKey &key) const;
+    };
+
+    /// Result of comparing a network request against the filters
+    struct Decision
+    {
+        /// Action to take on the request
+        FilterAction Action;
+
+        /// Filter that determined the action, or a nullptr if no filter matched the request
+        Filter *MatchingFilter;
+
+        /// Generation of the filter container that the decision was made with, which owns the matching filter.
+        /// A cached decision is only valid while that container is the one being used. The container itself is
+        /// not referenced, so that a cached decision does not keep a replaced set of filters in memory
+        uint64_t Generation;
+    };
+
     /// Returns the \ref ElementType of the network request, which is used to check for filter option/type matches
     ElementType getRequestType(const QWebEngineUrlRequestInfo &info, const QUrl &firstPartyUrl) const;
 
+    /// Compares the network request against the important, blocking and whitelisting filters, returning the resulting decision
+    Decision findDecision(const std::shared_ptr<const FilterContainer> &filters, const QString &baseUrl, const QUrl &requestUrl,
+                          const QString &requestUrlStr, ElementType elemType) const;
+
 private:
-    /// Reference to the filter container
-    FilterContainer &m_filterContainer;
+    /// Reference to the filter engine, which provides the active filter container
+    const FilterEngine &m_filterEngine;
 
     /// Logging instance
     AdBlockLog *m_log;
@@ -66,6 +120,12 @@ class RequestHandler : public QObject
 
     /// Hash map of URLs to the number of requests that were blocked on that given URL
     QHash<QUrl, int> m_pageAdBlockCount;
+
+    /// Cache of the decisions made about recent requests, so repeated requests do not need to be compared against the filters
+    LRUCache<DecisionKey, Decision, DecisionKeyHash> m_decisionCache;
+
+    /// Guards the decision cache, as requests may be intercepted on more than one thread
+    mutable QMutex m_decisionCacheMutex;
 };
 
 }
@@ -1,14 +1,19 @@
 #include "AdBlockSubscription.h"
 #include "AdBlockFilterParser.h"
 
+#include <QDataStream>
 #include <QDir>
 #include <QFile>
+#include <QSaveFile>
 #include <QTextStream>
 #include <QDebug>
 
 namespace adblock
 {
 
+const quint32 Subscription::CacheMagic = 0x56414243;
+const quint32 Subscription::CacheFormatVersion = 1;
+
 Subscription::Subscription() :
     m_enabled(true),
     m_filePath(),
@@ -97,15 +102,25 @@ void Subscription::load(AdBlockManager *adBlockManager)
     if (!m_enabled || m_filePath.isEmpty())
         return;
 
-    // Load subscription file
-    QFile subFile(m_filePath);
-    if (!subFile.exists() || !subFile.open(QIODevice::ReadOnly))
+    QFileInfo subInfo(m_filePath);
+    if (!subInfo.exists())
         return;
 
     m_filters.clear();
 
     FilterParser parser(adBlockManager);
 
+    // Skip parsing if the filters of the current file have already been compiled
+    if (loadCache(subInfo, parser))
+        return;
+
+    // Load subscription file
+    QFile subFile(m_filePath);
+    if (!subFile.open(QIODevice::ReadOnly))
+        return;
+
+    int updateIntervalDays = 0;
+
     QString line;
     QTextStream stream(&subFile);
     while (stream.readLineInto(&line))
@@ -134,9 +149,8 @@ void Subscription::load(AdBlockManager *adBlockManager)
                 if (!ok || numDays == 0)
                     continue;
 
-                // Add the number of days to the last update and set as next update
-                QDateTime updateDate = getLastUpdate();
-                m_nextUpdate = updateDate.addDays(numDays);
+                updateIntervalDays = numDays;
+                setUpdateInterval(numDays);
             }
 
             continue;
@@ -164,6 +178,115 @@ void Subscription::load(AdBlockManager *adBlockManager)
         int sepIdx = m_filePath.lastIndexOf(QDir::separator());
         m_name = m_filePath.mid(sepIdx + 1);
     }
+
+    saveCache(subInfo, updateIntervalDays);
+}
+
+bool Subscription::loadCache(const QFileInfo &fileInfo, const FilterParser &parser)
+{
+    QFile cacheFile(getCacheFilePath());
+    if (!cacheFile.exists() || !cacheFile.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 cacheSize = cacheFile.size();
+    uchar *cacheData = cacheFile.map(0, cacheSize);
+    if (cacheData == nullptr)
+        return false;
+
+    const QByteArray buffer = QByteArray::fromRawData(reinterpret_cast<const char*>(cacheData), static_cast<int>(cacheSize));
+    QDataStream stream(buffer);
+    stream.setVersion(QDataStream::Qt_5_9);
+
+    // The cache is only valid for the exact version of the file and parser that produced it
+    quint32 magic = 0, formatVersion = 0, parserVersion = 0;
+    QString sourcePath;
+    qint64 sourceModified = 0, sourceSize = 0;
+    stream >> magic >> formatVersion >> parserVersion >> sourcePath >> sourceModified >> sourceSize;
+
+    if (stream.status() != QDataStream::Ok
+            || magic != CacheMagic
+            || formatVersion != CacheFormatVersion
+            || parserVersion != FilterParser::Version
+            || sourcePath != fileInfo.absoluteFilePath()
+            || sourceModified != fileInfo.lastModified().toMSecsSinceEpoch()
+            || sourceSize != fileInfo.size())
+    {
+        cacheFile.unmap(cacheData);
+        return false;
+    }
+
+    QString name;
+    qint32 updateIntervalDays = 0;
+    quint32 numFilters = 0;
+    stream >> name >> updateIntervalDays >> numFilters;
+
+    std::vector< std::unique_ptr<Filter> > filters;
+    filters.reserve(numFilters);
+    for (quint32 i = 0; i < numFilters && stream.status() == QDataStream::Ok; ++i)
+    {
+        auto filter = std::make_unique<Filter>(QString());
+        stream >> *filter;
+        parser.internDomains(filter.get());
+
+        // Scriptlets embed the current contents of the resources they inject, so they are always parsed again
+        if (filter->getCategory() == FilterCategory::Scriptlet)
+            filter = parser.makeFilter(filter->getRule());
+
+        filters.push_back(std::move(filter));
+    }
+
+    const bool ok = stream.status() == QDataStream::Ok && filters.size() == numFilters;
+    cacheFile.unmap(cacheData);
+
+    if (!ok)
+    {
+        qWarning() << "Subscription::loadCache - cache file " << cacheFile.fileName() << " is corrupt";
+        return false;
+    }
+
+    m_filters = std::move(filters);
+    if (m_name.isEmpty())
+        m_name = name;
+    if (updateIntervalDays > 0)
+        setUpdateInterval(updateIntervalDays);
+
+    return true;
+}
+
+void Subscription::saveCache(const QFileInfo &fileInfo, int updateIntervalDays) const
+{
+    QSaveFile cacheFile(getCacheFilePath());
+    if (!cacheFile.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Subscription::saveCache - could not open cache file " << cacheFile.fileName();
+        return;
+    }
+
+    QDataStream stream(&cacheFile);
+    stream.setVersion(QDataStream::Qt_5_9);
+
+    stream << CacheMagic
+           << CacheFormatVersion
+           << FilterParser::Version
+           << fileInfo.absoluteFilePath()
+           << fileInfo.lastModified().toMSecsSinceEpoch()
+           << fileInfo.size()
+           << m_name
+           << static_cast<qint32>(updateIntervalDays)
+           << static_cast<quint32>(m_filters.size());
+
+    for (const std::unique_ptr<Filter> &filter : m_filters)
+        stream << *filter;
+
+    if (stream.status() != QDataStream::Ok || !cacheFile.commit())
+        qWarning() << "Subscription::saveCache - could not write cache file " << cacheFile.fileName();
+}
+
+void Subscription::setUpdateInterval(int numDays)
+{
+    // Add the number of days to the last update and set as next update
+    QDateTime updateDate = getLastUpdate();
+    m_nextUpdate = updateDate.addDays(numDays);
 }
 
 void Subscription::setLastUpdate(const QDateTime &date)
@@ -210,4 +333,20 @@ void Subscription::setFilePath(const QString &filePath)
     m_filePath = filePath;
 }
 
+QString Subscription::getCacheFilePath() const
+{
+    return m_filePath + QStringLiteral(".cache");
+}
+
+Subscription Subscription::copySettings() const
+{
+    Subscription other(m_filePath);
+    other.m_enabled = m_enabled;
+    other.m_name = m_name;
+    other.m_sourceUrl = m_sourceUrl;
+    other.m_lastUpdate = m_lastUpdate;
+    other.m_nextUpdate = m_nextUpdate;
+    return other;
+}
+
 }
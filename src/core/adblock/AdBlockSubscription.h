@@ -6,6 +6,7 @@
 #include <memory>
 #include <vector>
 #include <QDateTime>
+#include <QFileInfo>
 #include <QString>
 #include <QUrl>
 
@@ -13,6 +14,7 @@ namespace adblock
 {
 
 class AdBlockManager;
+class FilterParser;
 
 /**
  * @class Subscription
@@ -24,8 +26,10 @@ class AdBlockManager;
 class Subscription
 {
     friend class FilterContainer;
+    friend class FilterSegment;
     friend class AdBlockManager;
     friend class AdBlockRequestHandler;
+    friend class AdBlockBenchmark;
 
 public:
     /// Constructs the Subscription object
@@ -95,7 +99,34 @@ class Subscription
     /// Updates the path of the subscription file - called after completion of an update if the file name is different
     void setFilePath(const QString &filePath);
 
+    /// Returns the path of the precompiled filter cache that belongs to the subscription file
+    QString getCacheFilePath() const;
+
+    /// Returns a subscription with the same file, settings and metadata as this subscription, but without any filters
+    Subscription copySettings() const;
+
+private:
+    /**
+     * @brief Attempts to load the filters from the precompiled cache of the subscription file
+     * @param fileInfo Information about the subscription file, used to determine if the cache is still valid
+     * @param parser Filter parser, used for filters that depend on the resources of the AdBlockManager
+     * @return True if the filters were loaded from the cache, false if the cache is missing or stale
+     */
+    bool loadCache(const QFileInfo &fileInfo, const FilterParser &parser);
+
+    /// Writes the parsed filters to the precompiled cache of the subscription file. Also stores the update interval, in days, declared in the file
+    void saveCache(const QFileInfo &fileInfo, int updateIntervalDays) const;
+
+    /// Sets the time of the next update from the time of the last update and the given interval, in days
+    void setUpdateInterval(int numDays);
+
 private:
+    /// Identifies a precompiled filter cache file
+    static const quint32 CacheMagic;
+
+    /// Version of the cache file format
+    static const quint32 CacheFormatVersion;
+
     /// True if subscription is enabled, false if else
     bool m_enabled;
 
@@ -0,0 +1,108 @@
+#include "FilterDomainIndex.h"
+
+#include <algorithm>
+
+namespace adblock
+{
+
+FilterDomainIndex::FilterDomainIndex() :
+    m_filters(),
+    m_genericFilters(),
+    m_domainMap()
+{
+}
+
+void FilterDomainIndex::clear()
+{
+    m_filters.clear();
+    m_genericFilters.clear();
+    m_domainMap.clear();
+}
+
+void FilterDomainIndex::add(Filter *filter)
+{
+    if (filter == nullptr)
+        return;
+
+    const uint32_t index = static_cast<uint32_t>(m_filters.size());
+    m_filters.push_back(filter);
+
+    if (filter->m_domainBlacklist.empty() && filter->m_domainWhitelist.empty())
+    {
+        m_genericFilters.push_back(index);
+        return;
+    }
+
+    // A filter that only has excluded domains does not apply to any domain (see Filter::isDomainStyleMatch),
+    // so it is not stored under any key
+    for (const QString &domain : filter->m_domainBlacklist)
+        m_domainMap[domain].push_back(index);
+}
+
+std::size_t FilterDomainIndex::size() const
+{
+    return m_filters.size();
+}
+
+std::size_t FilterDomainIndex::getMemoryUsage() const
+{
+    std::size_t result = m_filters.capacity() * sizeof(Filter*) + m_genericFilters.capacity() * sizeof(uint32_t);
+
+    // The domain keys share their string data with the domain lists of the filters
+    result += static_cast<std::size_t>(m_domainMap.capacity()) * sizeof(void*);
+    for (auto it = m_domainMap.cbegin(); it != m_domainMap.cend(); ++it)
+        result += sizeof(void*) + sizeof(uint) + sizeof(QString) + sizeof(std::vector<uint32_t>) + it.value().capacity() * sizeof(uint32_t);
+
+    return result;
+}
+
+std::vector<Filter*> FilterDomainIndex::findMatches(const QString &domain) const
+{
+    std::vector<Filter*> result;
+    if (domain.isEmpty() || m_filters.empty())
+        return result;
+
+    std::vector<uint32_t> indices = m_genericFilters;
+
+    if (!m_domainMap.isEmpty())
+    {
+        collectSuffixMatches(domain, indices);
+
+        // Entity filters (ex: "google.") are matched against the domain without its last label
+        const int lastDotIdx = domain.lastIndexOf(QChar('.'));
+        if (lastDotIdx > 0)
+            collectSuffixMatches(domain.left(lastDotIdx + 1), indices);
+    }
+
+    // Restore the original ordering of the filters, which also removes filters found under more than one key
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+    // Candidates may still be excluded from the domain, or disabled
+    for (uint32_t index : indices)
+    {
+        Filter *filter = m_filters.at(index);
+        if (filter->isDomainStyleMatch(domain))
+            result.push_back(filter);
+    }
+
+    return result;
+}
+
+void FilterDomainIndex::collectSuffixMatches(const QString &name, std::vector<uint32_t> &indices) const
+{
+    int pos = 0;
+    while (pos < name.size())
+    {
+        auto it = m_domainMap.constFind(name.mid(pos));
+        if (it != m_domainMap.constEnd())
+            indices.insert(indices.end(), it->begin(), it->end());
+
+        pos = name.indexOf(QChar('.'), pos);
+        if (pos < 0)
+            break;
+        ++pos;
+    }
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef FILTERDOMAININDEX_H
+#define FILTERDOMAININDEX_H
+
+#include "AdBlockFilter.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+namespace adblock
+{
+
+/**
+ * @class FilterDomainIndex
+ * @ingroup AdBlock
+ * @brief Maps the domains that cosmetic and scriptlet filters are restricted to, onto the filters themselves.
+ *
+ * A filter is stored under each domain of its "domain=" (or "example.com##") list, including entity
+ * domains such as "google.". Looking up the filters of a page only requires one hash lookup per label
+ * suffix of its host (a.b.example.com, b.example.com, example.com, com) and per label suffix of its
+ * entity form (a.b.example., b.example., example.), plus the filters that apply to every domain.
+ */
+class FilterDomainIndex
+{
+public:
+    /// Constructs an empty domain index
+    FilterDomainIndex();
+
+    /// Removes all filters from the index
+    void clear();
+
+    /// Adds the filter to the index
+    void add(Filter *filter);
+
+    /// Returns the number of filters stored in the index
+    std::size_t size() const;
+
+    /// Returns the approximate number of bytes allocated by the index, excluding the filters themselves
+    std::size_t getMemoryUsage() const;
+
+    /// Returns all filters that apply to the given domain, in the order that they were added
+    std::vector<Filter*> findMatches(const QString &domain) const;
+
+private:
+    /// Appends the indices of the filters stored under each label suffix of the given name to the container
+    void collectSuffixMatches(const QString &name, std::vector<uint32_t> &indices) const;
+
+private:
+    /// All filters in the index, in the order that they were added
+    std::vector<Filter*> m_filters;
+
+    /// Indices of the filters without any domain restrictions
+    std::vector<uint32_t> m_genericFilters;
+
+    /// Hash map of domains (and entities) to the indices of the filters that are restricted to them
+    QHash<QString, std::vector<uint32_t>> m_domainMap;
+};
+
+}
+
+#endif // FILTERDOMAININDEX_H
@@ -0,0 +1,26 @@
+#include "FilterEngine.h"
+
+#include <atomic>
+
+namespace adblock
+{
+
+FilterEngine::FilterEngine() :
+    m_filters(std::make_shared<FilterContainer>())
+{
+}
+
+std::shared_ptr<const FilterContainer> FilterEngine::getFilters() const
+{
+    return std::atomic_load_explicit(&m_filters, std::memory_order_acquire);
+}
+
+void FilterEngine::publish(std::shared_ptr<const FilterContainer> filters)
+{
+    if (!filters)
+        filters = std::make_shared<FilterContainer>();
+
+    std::atomic_store_explicit(&m_filters, std::move(filters), std::memory_order_release);
+}
+
+}
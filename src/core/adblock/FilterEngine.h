@@ -0,0 +1,39 @@
+#ifndef FILTERENGINE_H
+#define FILTERENGINE_H
+
+#include "AdBlockFilterContainer.h"
+
+#include <memory>
+
+namespace adblock
+{
+
+/**
+ * @class FilterEngine
+ * @ingroup AdBlock
+ * @brief Publishes the active set of filters, in the form of an immutable \ref FilterContainer.
+ *
+ * Readers take a reference-counted snapshot of the active container with getFilters(), and may use it
+ * from any thread without further synchronization. A rebuilt container is swapped in atomically with
+ * publish(). The previous container is destroyed once the last reader has released its snapshot.
+ */
+class FilterEngine
+{
+public:
+    /// Constructs the filter engine with an empty filter container
+    FilterEngine();
+
+    /// Returns a snapshot of the active filter container
+    std::shared_ptr<const FilterContainer> getFilters() const;
+
+    /// Replaces the active filter container
+    void publish(std::shared_ptr<const FilterContainer> filters);
+
+private:
+    /// The active filter container. Only accessed through the atomic shared_ptr functions
+    std::shared_ptr<const FilterContainer> m_filters;
+};
+
+}
+
+#endif // FILTERENGINE_H
@@ -0,0 +1,259 @@
+#include "FilterPatternMatcher.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace adblock
+{
+
+/// Returns the given UTF-16 code unit, converted to lower case if it is an ASCII letter
+static inline ushort toLowerAscii(ushort c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<ushort>(c + 32) : c;
+}
+
+FilterPatternMatcher::FilterPatternMatcher() :
+    m_filters(),
+    m_states(),
+    m_edges(),
+    m_outputs(),
+    m_rootTransitions()
+{
+    m_rootTransitions.fill(-1);
+}
+
+void FilterPatternMatcher::clear()
+{
+    m_filters.clear();
+    m_states.clear();
+    m_edges.clear();
+    m_outputs.clear();
+    m_rootTransitions.fill(-1);
+}
+
+void FilterPatternMatcher::add(Filter *filter)
+{
+    if (filter != nullptr)
+        m_filters.push_back(filter);
+}
+
+void FilterPatternMatcher::build()
+{
+    m_states.clear();
+    m_edges.clear();
+    m_outputs.clear();
+    m_rootTransitions.fill(-1);
+
+    if (m_filters.empty())
+        return;
+
+    // Insert each evaluation string into a temporary trie. The strings are folded to lower case, like the request URL
+    // during a scan, and filters with the match-case option are checked against the original URL after a hit
+    struct TrieNode
+    {
+        std::vector<Edge> Edges;
+        std::vector<Filter*> Filters;
+    };
+
+    std::vector<TrieNode> trie(1);
+    for (Filter *filter : m_filters)
+    {
+        int32_t node = 0;
+        for (const QChar &c : filter->getEvalString())
+        {
+            const ushort character = toLowerAscii(c.unicode());
+
+            int32_t next = -1;
+            for (const Edge &edge : trie[node].Edges)
+            {
+                if (edge.Character == character)
+                {
+                    next = edge.Target;
+                    break;
+                }
+            }
+
+            if (next < 0)
+            {
+                next = static_cast<int32_t>(trie.size());
+                trie[node].Edges.push_back({ character, next });
+                trie.emplace_back();
+            }
+
+            node = next;
+        }
+
+        trie[node].Filters.push_back(filter);
+    }
+
+    // Flatten the trie into contiguous arrays
+    m_states.resize(trie.size());
+    for (std::size_t i = 0; i < trie.size(); ++i)
+    {
+        TrieNode &node = trie[i];
+        std::sort(node.Edges.begin(), node.Edges.end(), [](const Edge &a, const Edge &b) {
+            return a.Character < b.Character;
+        });
+
+        State &state = m_states[i];
+        state.FirstEdge = static_cast<uint32_t>(m_edges.size());
+        state.NumEdges = static_cast<uint32_t>(node.Edges.size());
+        state.Failure = 0;
+        state.OutputLink = -1;
+        state.FirstOutput = static_cast<uint32_t>(m_outputs.size());
+        state.NumOutputs = static_cast<uint32_t>(node.Filters.size());
+
+        m_edges.insert(m_edges.end(), node.Edges.begin(), node.Edges.end());
+        m_outputs.insert(m_outputs.end(), node.Filters.begin(), node.Filters.end());
+
+        // Release memory of the temporary node as we go
+        std::vector<Edge>().swap(node.Edges);
+        std::vector<Filter*>().swap(node.Filters);
+    }
+
+    const State &root = m_states[0];
+    for (uint32_t i = root.FirstEdge; i < root.FirstEdge + root.NumEdges; ++i)
+    {
+        const Edge &edge = m_edges[i];
+        if (edge.Character < m_rootTransitions.size())
+            m_rootTransitions[edge.Character] = edge.Target;
+    }
+
+    // Compute failure and output links in breadth-first order, so the links of shallower states are always available
+    std::deque<int32_t> queue;
+    for (uint32_t i = root.FirstEdge; i < root.FirstEdge + root.NumEdges; ++i)
+        queue.push_back(m_edges[i].Target);
+
+    while (!queue.empty())
+    {
+        const int32_t parent = queue.front();
+        queue.pop_front();
+
+        const State &parentState = m_states[parent];
+        for (uint32_t i = parentState.FirstEdge; i < parentState.FirstEdge + parentState.NumEdges; ++i)
+        {
+            const Edge &edge = m_edges[i];
+
+            int32_t fallback = parentState.Failure;
+            while (fallback != 0 && findTransition(fallback, edge.Character) < 0)
+                fallback = m_states[fallback].Failure;
+
+            const int32_t failure = findTransition(fallback, edge.Character);
+
+            State &child = m_states[edge.Target];
+            child.Failure = (failure >= 0 && failure != edge.Target) ? failure : 0;
+
+            const State &failureState = m_states[child.Failure];
+            child.OutputLink = (child.Failure != 0 && failureState.NumOutputs > 0) ? child.Failure : failureState.OutputLink;
+
+            queue.push_back(edge.Target);
+        }
+    }
+}
+
+std::size_t FilterPatternMatcher::size() const
+{
+    return m_filters.size();
+}
+
+std::size_t FilterPatternMatcher::getMemoryUsage() const
+{
+    return m_filters.capacity() * sizeof(Filter*)
+            + m_states.capacity() * sizeof(State)
+            + m_edges.capacity() * sizeof(Edge)
+            + m_outputs.capacity() * sizeof(Filter*);
+}
+
+Filter *FilterPatternMatcher::findMatch(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask) const
+{
+    if (m_states.empty())
+        return nullptr;
+
+    auto checkOutputs = [&](int32_t stateIndex) -> Filter* {
+        const State &state = m_states[stateIndex];
+        for (uint32_t i = state.FirstOutput; i < state.FirstOutput + state.NumOutputs; ++i)
+        {
+            Filter *filter = m_outputs[i];
+            if (filter->isMatch(baseUrl, requestUrl, requestDomain, typeMask))
+                return filter;
+        }
+        return nullptr;
+    };
+
+    // Filters with an empty evaluation string are stored at the root, and apply to every request
+    if (Filter *filter = checkOutputs(0))
+        return filter;
+
+    // States whose outputs have already been checked during this scan are stamped with the scan's generation.
+    // The stamps are kept per thread, since requests may be matched on several threads at once
+    thread_local std::vector<uint32_t> visitedStamps;
+    thread_local uint32_t generation = 0;
+
+    if (visitedStamps.size() < m_states.size())
+        visitedStamps.resize(m_states.size(), 0);
+
+    if (++generation == 0)
+    {
+        std::fill(visitedStamps.begin(), visitedStamps.end(), 0);
+        generation = 1;
+    }
+
+    int32_t state = 0;
+    const QChar *data = requestUrl.constData();
+    const int length = requestUrl.size();
+    for (int i = 0; i < length; ++i)
+    {
+        state = nextState(state, toLowerAscii(data[i].unicode()));
+
+        int32_t outputState = m_states[state].NumOutputs > 0 ? state : m_states[state].OutputLink;
+        while (outputState > 0)
+        {
+            // Every state along the output chain of a visited state has also been visited
+            if (visitedStamps[outputState] == generation)
+                break;
+
+            visitedStamps[outputState] = generation;
+            if (Filter *filter = checkOutputs(outputState))
+                return filter;
+
+            outputState = m_states[outputState].OutputLink;
+        }
+    }
+
+    return nullptr;
+}
+
+int32_t FilterPatternMatcher::findTransition(int32_t state, ushort c) const
+{
+    if (state == 0 && c < m_rootTransitions.size())
+        return m_rootTransitions[c];
+
+    const State &s = m_states[state];
+    auto first = m_edges.begin() + s.FirstEdge;
+    auto last = first + s.NumEdges;
+    auto it = std::lower_bound(first, last, c, [](const Edge &edge, ushort character) {
+        return edge.Character < character;
+    });
+
+    if (it != last && it->Character == c)
+        return it->Target;
+
+    return -1;
+}
+
+int32_t FilterPatternMatcher::nextState(int32_t state, ushort c) const
+{
+    while (true)
+    {
+        const int32_t next = findTransition(state, c);
+        if (next >= 0)
+            return next;
+
+        if (state == 0)
+            return 0;
+
+        state = m_states[state].Failure;
+    }
+}
+
+}
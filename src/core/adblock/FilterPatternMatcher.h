@@ -0,0 +1,114 @@
+#ifndef FILTERPATTERNMATCHER_H
+#define FILTERPATTERNMATCHER_H
+
+#include "AdBlockFilter.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <QString>
+
+namespace adblock
+{
+
+/**
+ * @class FilterPatternMatcher
+ * @ingroup AdBlock
+ * @brief An Aho-Corasick automaton built over the evaluation strings of StringContains filters.
+ *
+ * The automaton scans a request URL a single time, in its native UTF-16 form, and reports every
+ * filter whose evaluation string occurs within it. Both the evaluation strings and the URL are folded
+ * to lower case, so the candidates are then checked against the original URL, including the match-case
+ * option, and against the remaining filter options (domain, element type, etc).
+ */
+class FilterPatternMatcher
+{
+public:
+    /// Constructs an empty pattern matcher
+    FilterPatternMatcher();
+
+    /// Removes all filters from the automaton
+    void clear();
+
+    /// Adds the filter to the set of needles that will be compiled on the next call to build()
+    void add(Filter *filter);
+
+    /// Compiles the trie, failure links and output links of the automaton from all filters that have been added
+    void build();
+
+    /// Returns the number of filters stored in the automaton
+    std::size_t size() const;
+
+    /// Returns the approximate number of bytes allocated by the automaton, excluding the filters themselves
+    std::size_t getMemoryUsage() const;
+
+    /**
+     * @brief Scans the request URL for the evaluation strings of all filters, returning the first filter that matches the request
+     * @param baseUrl URL of the original network request
+     * @param requestUrl URL of the actual network request
+     * @param requestDomain Domain of the request URL
+     * @param typeMask Element type(s) associated with the request.
+     * @return A pointer to the first matching filter rule, or a nullptr if not found
+     */
+    Filter *findMatch(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask) const;
+
+private:
+    /// Returns the state reached from the given state after reading the character c, or -1 if there is no such edge in the trie
+    int32_t findTransition(int32_t state, ushort c) const;
+
+    /// Returns the state that the automaton moves into from the given state after reading the character c
+    int32_t nextState(int32_t state, ushort c) const;
+
+private:
+    /// An edge of the trie, labeled with a UTF-16 code unit
+    struct Edge
+    {
+        /// Character associated with the edge
+        ushort Character;
+
+        /// Index of the state that the edge points to
+        int32_t Target;
+    };
+
+    /// A state of the automaton
+    struct State
+    {
+        /// Index of the first outgoing edge in the edge array. Edges of a state are sorted by character
+        uint32_t FirstEdge;
+
+        /// Number of outgoing edges
+        uint32_t NumEdges;
+
+        /// State to fall back on when there is no edge for the next character
+        int32_t Failure;
+
+        /// Nearest state along the failure chain that has at least one output, or -1 if none exists
+        int32_t OutputLink;
+
+        /// Index of the first filter ending at this state, in the output array
+        uint32_t FirstOutput;
+
+        /// Number of filters ending at this state
+        uint32_t NumOutputs;
+    };
+
+    /// Filters whose evaluation strings are compiled into the automaton
+    std::vector<Filter*> m_filters;
+
+    /// States of the automaton. The root is always at index 0
+    std::vector<State> m_states;
+
+    /// Edges of all states, grouped by their source state
+    std::vector<Edge> m_edges;
+
+    /// Filters associated with each state, grouped by state
+    std::vector<Filter*> m_outputs;
+
+    /// Direct lookup table of the root's transitions for ASCII characters, since most of the scanning happens at the root
+    std::array<int32_t, 128> m_rootTransitions;
+};
+
+}
+
+#endif // FILTERPATTERNMATCHER_H
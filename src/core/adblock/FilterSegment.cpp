@@ -0,0 +1,130 @@
+#include "FilterSegment.h"
+
+namespace adblock
+{
+
+FilterSegment::FilterSegment(Subscription &subscription) :
+    m_filePath(subscription.getFilePath()),
+    m_lastModified(),
+    m_fileSize(-1),
+    m_filters(),
+    m_affectedDomains(),
+    m_affectsAllDomains(false)
+{
+    const QFileInfo fileInfo(m_filePath);
+    if (fileInfo.exists())
+    {
+        m_lastModified = fileInfo.lastModified();
+        m_fileSize = fileInfo.size();
+    }
+
+    m_filters.reserve(subscription.m_filters.size());
+    for (std::unique_ptr<Filter> &filter : subscription.m_filters)
+    {
+        if (!filter || filter->getCategory() == FilterCategory::None || filter->getCategory() == FilterCategory::NotImplemented)
+            continue;
+
+        addAffectedDomains(filter.get());
+        m_filters.push_back(std::move(filter));
+    }
+
+    subscription.m_filters.clear();
+}
+
+const QString &FilterSegment::getFilePath() const
+{
+    return m_filePath;
+}
+
+bool FilterSegment::isCurrent(const QFileInfo &fileInfo) const
+{
+    if (!fileInfo.exists())
+        return m_fileSize < 0;
+
+    return fileInfo.size() == m_fileSize && fileInfo.lastModified() == m_lastModified;
+}
+
+std::size_t FilterSegment::size() const
+{
+    return m_filters.size();
+}
+
+Filter *FilterSegment::getFilter(std::size_t index) const
+{
+    return m_filters.at(index).get();
+}
+
+bool FilterSegment::affectsHost(const QString &host) const
+{
+    if (m_affectsAllDomains)
+        return true;
+
+    if (m_affectedDomains.isEmpty() || host.isEmpty())
+        return false;
+
+    // Check each label suffix of the host (a.example.com, example.com, com), along with its entity form (a.example., example.)
+    QString domain = host;
+    while (!domain.isEmpty())
+    {
+        if (m_affectedDomains.contains(domain))
+            return true;
+
+        const int lastDotIdx = domain.lastIndexOf(QChar('.'));
+        if (lastDotIdx > 0 && m_affectedDomains.contains(domain.left(lastDotIdx + 1)))
+            return true;
+
+        const int dotIdx = domain.indexOf(QChar('.'));
+        if (dotIdx < 0)
+            break;
+
+        domain = domain.mid(dotIdx + 1);
+    }
+
+    return false;
+}
+
+void FilterSegment::addAffectedDomains(const Filter *filter)
+{
+    if (m_affectsAllDomains)
+        return;
+
+    switch (filter->getCategory())
+    {
+        case FilterCategory::Stylesheet:
+            // Generic element hiding rules are part of the global stylesheet, which is not cached by domain
+            if (!filter->hasDomainRules())
+                return;
+            break;
+        case FilterCategory::StylesheetJS:
+        case FilterCategory::StylesheetCustom:
+        case FilterCategory::Scriptlet:
+            break;
+        default:
+        {
+            // Network filters only affect the injected scripts through the content security policy
+            if (!filter->hasElementType(filter->m_blockedTypes, ElementType::CSP)
+                    && !filter->hasElementType(filter->m_blockedTypes, ElementType::InlineScript))
+                return;
+
+            if (!filter->hasDomainRules() && filter->getCategory() == FilterCategory::Domain && !filter->getEvalString().isEmpty())
+            {
+                m_affectedDomains.insert(filter->getEvalString().toLower());
+                return;
+            }
+            break;
+        }
+    }
+
+    if (!filter->hasDomainRules())
+    {
+        m_affectsAllDomains = true;
+        return;
+    }
+
+    for (const QString &domain : filter->m_domainBlacklist)
+        m_affectedDomains.insert(domain);
+    for (const QString &domain : filter->m_domainWhitelist)
+        m_affectedDomains.insert(domain);
+}
+
+}
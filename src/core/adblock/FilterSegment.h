@@ -0,0 +1,79 @@
+#ifndef FILTERSEGMENT_H
+#define FILTERSEGMENT_H
+
+#include "AdBlockFilter.h"
+#include "AdBlockSubscription.h"
+
+#include <memory>
+#include <vector>
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSet>
+#include <QString>
+
+namespace adblock
+{
+
+/**
+ * @class FilterSegment
+ * @ingroup AdBlock
+ * @brief Owns the filters that were loaded from a single subscription file.
+ *
+ * Segments are immutable, and shared between successive \ref FilterContainer instances. When one
+ * subscription is added, removed, toggled or updated, only its own segment has to be loaded again,
+ * and only the cached cosmetic and script injection results of the domains that the segment
+ * refers to need to be discarded.
+ */
+class FilterSegment
+{
+public:
+    /// Takes the filters of the loaded subscription. Filters that cannot be applied are discarded
+    explicit FilterSegment(Subscription &subscription);
+
+    /// Returns the path of the subscription file that the filters were loaded from
+    const QString &getFilePath() const;
+
+    /// Returns true if the segment was loaded from the current version of the given file, false if else
+    bool isCurrent(const QFileInfo &fileInfo) const;
+
+    /// Returns the number of filters in the segment
+    std::size_t size() const;
+
+    /// Returns the filter at the given index
+    Filter *getFilter(std::size_t index) const;
+
+    /**
+     * @brief Returns true if the cosmetic or script injection filters of the segment may apply to the given host
+     * @param host Host of a page, such as "www.example.com"
+     * @return True if the domain-specific stylesheet or script of the host may depend on this segment, false if else
+     */
+    bool affectsHost(const QString &host) const;
+
+private:
+    /// Records the domains that the given filter refers to, if it is used for domain-specific stylesheets or scripts
+    void addAffectedDomains(const Filter *filter);
+
+private:
+    /// Path of the subscription file
+    QString m_filePath;
+
+    /// Time at which the subscription file was last modified, when the segment was loaded
+    QDateTime m_lastModified;
+
+    /// Size of the subscription file, when the segment was loaded
+    qint64 m_fileSize;
+
+    /// Filters of the subscription
+    std::vector< std::unique_ptr<Filter> > m_filters;
+
+    /// Domains (including entity domains, such as "google.") that the cosmetic, scriptlet and CSP filters of the segment refer to
+    QSet<QString> m_affectedDomains;
+
+    /// True if at least one cosmetic, scriptlet or CSP filter of the segment applies to every domain
+    bool m_affectsAllDomains;
+};
+
+}
+
+#endif // FILTERSEGMENT_H
@@ -0,0 +1,275 @@
+#include "FilterTokenIndex.h"
+
+#include <algorithm>
+#include <array>
+
+namespace adblock
+{
+
+const uint32_t FilterTokenIndex::TokenHashSeed = 2166136261u;
+const uint32_t FilterTokenIndex::CommonTokenPenalty = 1u << 20;
+
+FilterTokenIndex::FilterTokenIndex() :
+    m_buckets(),
+    m_untokenizedFilters(),
+    m_pendingFilters(),
+    m_numFilters(0)
+{
+}
+
+void FilterTokenIndex::clear()
+{
+    m_buckets.clear();
+    m_untokenizedFilters.clear();
+    m_pendingFilters.clear();
+    m_numFilters = 0;
+}
+
+void FilterTokenIndex::add(Filter *filter)
+{
+    if (filter != nullptr)
+        m_pendingFilters.push_back(filter);
+}
+
+void FilterTokenIndex::build()
+{
+    if (m_pendingFilters.empty())
+        return;
+
+    // Count the number of filters that each token could be used for
+    std::vector<std::vector<uint32_t>> filterTokens;
+    filterTokens.reserve(m_pendingFilters.size());
+
+    std::unordered_map<uint32_t, uint32_t> tokenFrequency;
+    for (const Filter *filter : m_pendingFilters)
+    {
+        filterTokens.push_back(getSafeTokens(filter));
+        for (uint32_t token : filterTokens.back())
+            ++tokenFrequency[token];
+    }
+
+    // Tokens such as "http" and "com" are found in almost every request, making them a poor choice of bucket
+    static const std::array<QString, 10> commonTokens = {
+        QStringLiteral("com"), QStringLiteral("http"), QStringLiteral("https"), QStringLiteral("icon"),
+        QStringLiteral("images"), QStringLiteral("img"), QStringLiteral("js"), QStringLiteral("net"),
+        QStringLiteral("news"), QStringLiteral("www")
+    };
+    for (const QString &commonToken : commonTokens)
+    {
+        auto it = tokenFrequency.find(hashToken(commonToken));
+        if (it != tokenFrequency.end())
+            it->second += CommonTokenPenalty;
+    }
+
+    // Place each filter into the bucket of its least frequent token
+    for (std::size_t i = 0; i < m_pendingFilters.size(); ++i)
+    {
+        Filter *filter = m_pendingFilters.at(i);
+        const std::vector<uint32_t> &tokens = filterTokens.at(i);
+        if (tokens.empty())
+        {
+            m_untokenizedFilters.push_back(filter);
+            continue;
+        }
+
+        uint32_t bestToken = tokens.front();
+        uint32_t bestFrequency = tokenFrequency[bestToken];
+        for (uint32_t token : tokens)
+        {
+            const uint32_t frequency = tokenFrequency[token];
+            if (frequency < bestFrequency)
+            {
+                bestToken = token;
+                bestFrequency = frequency;
+            }
+        }
+
+        m_buckets[bestToken].push_back(filter);
+    }
+
+    m_numFilters += m_pendingFilters.size();
+    m_pendingFilters.clear();
+    m_pendingFilters.shrink_to_fit();
+}
+
+std::size_t FilterTokenIndex::size() const
+{
+    return m_numFilters;
+}
+
+std::size_t FilterTokenIndex::getMemoryUsage() const
+{
+    // Each node of the hash map holds the key, the bucket and the link to the next node
+    std::size_t result = m_buckets.bucket_count() * sizeof(void*);
+    for (const auto &bucket : m_buckets)
+        result += sizeof(void*) + sizeof(bucket) + bucket.second.capacity() * sizeof(Filter*);
+
+    result += m_untokenizedFilters.capacity() * sizeof(Filter*);
+    result += m_pendingFilters.capacity() * sizeof(Filter*);
+    return result;
+}
+
+Filter *FilterTokenIndex::findMatch(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask) const
+{
+    if (m_numFilters == 0)
+        return nullptr;
+
+    if (!m_buckets.empty())
+    {
+        const std::vector<uint32_t> requestTokens = tokenizeUrl(requestUrl);
+        for (uint32_t token : requestTokens)
+        {
+            auto it = m_buckets.find(token);
+            if (it == m_buckets.end())
+                continue;
+
+            for (Filter *filter : it->second)
+            {
+                if (filter->isMatch(baseUrl, requestUrl, requestDomain, typeMask))
+                    return filter;
+            }
+        }
+    }
+
+    for (Filter *filter : m_untokenizedFilters)
+    {
+        if (filter->isMatch(baseUrl, requestUrl, requestDomain, typeMask))
+            return filter;
+    }
+
+    return nullptr;
+}
+
+std::vector<uint32_t> FilterTokenIndex::tokenizeUrl(const QString &url)
+{
+    std::vector<uint32_t> tokens;
+    tokens.reserve(32);
+
+    const QChar *data = url.constData();
+    const int length = url.size();
+
+    uint32_t hash = TokenHashSeed;
+    bool inToken = false;
+    for (int i = 0; i < length; ++i)
+    {
+        const ushort c = data[i].unicode();
+        if (isTokenChar(c))
+        {
+            hash = hashTokenChar(hash, c);
+            inToken = true;
+        }
+        else if (inToken)
+        {
+            tokens.push_back(hash);
+            hash = TokenHashSeed;
+            inToken = false;
+        }
+    }
+
+    if (inToken)
+        tokens.push_back(hash);
+
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    return tokens;
+}
+
+std::vector<uint32_t> FilterTokenIndex::getSafeTokens(const Filter *filter)
+{
+    std::vector<uint32_t> tokens;
+    if (filter->m_matchAll)
+        return tokens;
+
+    switch (filter->getCategory())
+    {
+        case FilterCategory::Domain:
+        case FilterCategory::DomainStart:
+        case FilterCategory::StringStartMatch:
+        case FilterCategory::StringEndMatch:
+        case FilterCategory::StringExactMatch:
+        case FilterCategory::StringContains:
+        case FilterCategory::RegExp:
+            break;
+        default:
+            return tokens;
+    }
+
+    // Recover the pattern of the rule, without the exception prefix or any filter options
+    QString pattern = filter->getRule();
+    if (pattern.startsWith(QStringLiteral("@@")))
+        pattern = pattern.mid(2);
+
+    int optionPos = pattern.indexOf(QLatin1Char('$'));
+    if (optionPos >= 0 && optionPos + 1 < pattern.size() && pattern.at(optionPos + 1).isLetter())
+        pattern = pattern.left(optionPos);
+
+    // Regular expressions written in their native syntax are not tokenized
+    if (filter->getCategory() == FilterCategory::RegExp
+            && pattern.size() > 1 && pattern.startsWith(QLatin1Char('/')) && pattern.endsWith(QLatin1Char('/')))
+        return tokens;
+
+    // An anchor guarantees that the first or last token of the pattern is delimited in the request URL.
+    // Domain start filters are excluded, as they can match in the middle of a host label
+    int start = 0, end = pattern.size();
+    bool leftDelimited = false, rightDelimited = false;
+    if (pattern.startsWith(QStringLiteral("||")))
+    {
+        start = 2;
+        leftDelimited = filter->getCategory() != FilterCategory::DomainStart;
+    }
+    else if (pattern.startsWith(QLatin1Char('|')))
+    {
+        start = 1;
+        leftDelimited = true;
+    }
+
+    if (end > start && pattern.at(end - 1) == QLatin1Char('|'))
+    {
+        --end;
+        rightDelimited = true;
+    }
+
+    // Wildcards may expand into token characters, so tokens adjacent to them are not safe
+    auto isDelimiter = [](QChar c) {
+        return c != QLatin1Char('*') && c != QLatin1Char('|');
+    };
+
+    const QChar *data = pattern.constData();
+    int i = start;
+    while (i < end)
+    {
+        ushort c = data[i].unicode();
+        if (!isTokenChar(c))
+        {
+            ++i;
+            continue;
+        }
+
+        const int tokenStart = i;
+        uint32_t hash = TokenHashSeed;
+        while (i < end && isTokenChar(c = data[i].unicode()))
+        {
+            hash = hashTokenChar(hash, c);
+            ++i;
+        }
+
+        const bool safeLeft = tokenStart > start ? isDelimiter(data[tokenStart - 1]) : leftDelimited;
+        const bool safeRight = i < end ? isDelimiter(data[i]) : rightDelimited;
+        if (safeLeft && safeRight)
+            tokens.push_back(hash);
+    }
+
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    return tokens;
+}
+
+uint32_t FilterTokenIndex::hashToken(const QString &token)
+{
+    uint32_t hash = TokenHashSeed;
+    for (const QChar &c : token)
+        hash = hashTokenChar(hash, c.unicode());
+    return hash;
+}
+
+}
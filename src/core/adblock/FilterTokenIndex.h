@@ -0,0 +1,102 @@
+#ifndef FILTERTOKENINDEX_H
+#define FILTERTOKENINDEX_H
+
+#include "AdBlockFilter.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <QString>
+
+namespace adblock
+{
+
+/**
+ * @class FilterTokenIndex
+ * @ingroup AdBlock
+ * @brief Buckets network filters by the hash of the rarest token found in their rule pattern.
+ *
+ * A token is a maximal run of the characters [a-z0-9%]. A filter can only match a request if every
+ * token that is fully delimited within its pattern also appears as a token of the request URL, so
+ * the request only needs to be compared against the filters stored in the buckets of its own tokens,
+ * plus the (usually small) set of filters from which no safe token could be extracted.
+ */
+class FilterTokenIndex
+{
+public:
+    /// Constructs an empty token index
+    FilterTokenIndex();
+
+    /// Removes all filters from the index
+    void clear();
+
+    /// Adds the filter to the set of filters that will be indexed on the next call to build()
+    void add(Filter *filter);
+
+    /// Assigns each filter that was added since the last build to the bucket of its rarest token
+    void build();
+
+    /// Returns the number of filters stored in the index
+    std::size_t size() const;
+
+    /// Returns the approximate number of bytes allocated by the index, excluding the filters themselves
+    std::size_t getMemoryUsage() const;
+
+    /**
+     * @brief Searches the index for the first filter that matches the network request
+     * @param baseUrl URL of the original network request
+     * @param requestUrl URL of the actual network request
+     * @param requestDomain Domain of the request URL
+     * @param typeMask Element type(s) associated with the request.
+     * @return A pointer to the first matching filter rule, or a nullptr if not found
+     */
+    Filter *findMatch(const QString &baseUrl, const QString &requestUrl, const QString &requestDomain, ElementType typeMask) const;
+
+    /// Returns the sorted, de-duplicated set of token hashes contained in the given URL
+    static std::vector<uint32_t> tokenizeUrl(const QString &url);
+
+private:
+    /// Returns the hashes of all tokens in the filter's pattern that are guaranteed to be tokens of any URL the filter matches
+    static std::vector<uint32_t> getSafeTokens(const Filter *filter);
+
+    /// Returns the hash of the given token string
+    static uint32_t hashToken(const QString &token);
+
+    /// Returns true if the given character may be part of a token
+    static inline bool isTokenChar(ushort c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '%' || (c >= 'A' && c <= 'Z');
+    }
+
+    /// Updates the running FNV-1a hash of a token with the next character. ASCII letters are folded to lowercase
+    static inline uint32_t hashTokenChar(uint32_t hash, ushort c)
+    {
+        if (c >= 'A' && c <= 'Z')
+            c += 32;
+        return (hash ^ static_cast<uint32_t>(c)) * 16777619u;
+    }
+
+    /// Initial value of a token hash (FNV-1a offset basis)
+    static const uint32_t TokenHashSeed;
+
+    /// Penalty added to the frequency of tokens that are present in nearly every URL, so they are only chosen as a last resort
+    static const uint32_t CommonTokenPenalty;
+
+private:
+    /// Filters that are bucketed by the hash of their rarest token
+    std::unordered_map<uint32_t, std::vector<Filter*>> m_buckets;
+
+    /// Filters without any safe token, which must be compared against every request
+    std::vector<Filter*> m_untokenizedFilters;
+
+    /// Filters that have been added but not yet placed in a bucket
+    std::vector<Filter*> m_pendingFilters;
+
+    /// Number of filters that have been placed in the index
+    std::size_t m_numFilters;
+};
+
+}
+
+#endif // FILTERTOKENINDEX_H
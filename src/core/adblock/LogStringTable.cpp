@@ -0,0 +1,135 @@
+#include "LogStringTable.h"
+
+#include <algorithm>
+
+#include <QHash>
+
+namespace adblock
+{
+
+const int LogStringTable::MaxStringLength = 2048;
+
+/// Number of low bits of a handle that store the length of its string
+static const int HandleLengthBits = 16;
+
+/// Returns the position in the text buffer, since the creation of the table, of the string identified by the handle
+static inline uint64_t getHandlePosition(uint64_t handle)
+{
+    return handle >> HandleLengthBits;
+}
+
+/// Returns the length of the string identified by the handle
+static inline int getHandleLength(uint64_t handle)
+{
+    return static_cast<int>(handle & ((uint64_t(1) << HandleLengthBits) - 1));
+}
+
+LogStringTable::LogStringTable(std::size_t capacity, std::size_t indexSize) :
+    m_capacity(capacity),
+    m_indexSize(indexSize),
+    m_text(new std::atomic<uint16_t>[capacity]),
+    m_index(new std::atomic<uint64_t>[indexSize]),
+    m_writePosition(0)
+{
+    for (std::size_t i = 0; i < m_capacity; ++i)
+        m_text[i].store(0, std::memory_order_relaxed);
+
+    for (std::size_t i = 0; i < m_indexSize; ++i)
+        m_index[i].store(EmptyHandle, std::memory_order_relaxed);
+}
+
+uint64_t LogStringTable::intern(const QString &str)
+{
+    const QString text = str.size() > MaxStringLength ? str.left(MaxStringLength) : str;
+    const int length = text.size();
+    if (length == 0)
+        return EmptyHandle;
+
+    const QChar *data = text.constData();
+    const uint hash = qHash(text);
+
+    std::atomic<uint64_t> &indexSlot = m_index[hash & (m_indexSize - 1)];
+    const uint64_t indexedHandle = indexSlot.load(std::memory_order_acquire);
+    if (getHandleLength(indexedHandle) == length && isRecent(indexedHandle) && isEqual(indexedHandle, data, length))
+        return indexedHandle;
+
+    const uint64_t handle = write(data, length);
+    indexSlot.store(handle, std::memory_order_release);
+    return handle;
+}
+
+uint64_t LogStringTable::append(const QString &str)
+{
+    const int length = std::min(str.size(), MaxStringLength);
+    if (length == 0)
+        return EmptyHandle;
+
+    return write(str.constData(), length);
+}
+
+uint64_t LogStringTable::write(const QChar *str, int length)
+{
+    // Reserve space for the string, then publish the reservation before writing any text, so that readers
+    // of older strings at the same position can tell that their text is being overwritten
+    const uint64_t position = m_writePosition.fetch_add(static_cast<uint64_t>(length), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const std::size_t mask = m_capacity - 1;
+    for (int i = 0; i < length; ++i)
+        m_text[(position + static_cast<uint64_t>(i)) & mask].store(str[i].unicode(), std::memory_order_relaxed);
+
+    return (position << HandleLengthBits) | static_cast<uint64_t>(length);
+}
+
+QString LogStringTable::lookup(uint64_t handle) const
+{
+    const int length = getHandleLength(handle);
+    if (length == 0 || !isValid(handle))
+        return QString();
+
+    QString result(length, Qt::Uninitialized);
+    QChar *data = result.data();
+
+    const uint64_t position = getHandlePosition(handle);
+    const std::size_t mask = m_capacity - 1;
+    for (int i = 0; i < length; ++i)
+        data[i] = QChar(m_text[(position + static_cast<uint64_t>(i)) & mask].load(std::memory_order_relaxed));
+
+    if (!isValid(handle))
+        return QString();
+
+    return result;
+}
+
+bool LogStringTable::isEqual(uint64_t handle, const QChar *str, int length) const
+{
+    if (!isValid(handle))
+        return false;
+
+    const uint64_t position = getHandlePosition(handle);
+    const std::size_t mask = m_capacity - 1;
+    for (int i = 0; i < length; ++i)
+    {
+        if (m_text[(position + static_cast<uint64_t>(i)) & mask].load(std::memory_order_relaxed) != str[i].unicode())
+            return false;
+    }
+
+    return isValid(handle);
+}
+
+bool LogStringTable::isValid(uint64_t handle) const
+{
+    // Orders the preceding loads of the text before the load of the write position. If any of them observed
+    // text from a newer string, the reservation of that string is visible below
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // The first character of the string is overwritten as soon as the write position moves a full buffer past it
+    return m_writePosition.load(std::memory_order_relaxed) <= getHandlePosition(handle) + m_capacity;
+}
+
+bool LogStringTable::isRecent(uint64_t handle) const
+{
+    return m_writePosition.load(std::memory_order_relaxed) - getHandlePosition(handle) <= m_capacity / 4;
+}
+
+}
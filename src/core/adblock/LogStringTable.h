@@ -0,0 +1,84 @@
+#ifndef LOGSTRINGTABLE_H
+#define LOGSTRINGTABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <QString>
+
+namespace adblock
+{
+
+/**
+ * @class LogStringTable
+ * @ingroup AdBlock
+ * @brief Interns the strings referenced by the ad block log in a fixed-size circular text buffer.
+ *
+ * Strings are identified by a handle that encodes their position and length in the buffer. Recently
+ * interned strings are found again through a small hash index, so repeated strings such as first party
+ * URLs and filter rules share a single copy. A string outside the newest quarter of the buffer is copied
+ * again instead of being shared, so a handle returned by intern() stays valid while another three quarters of
+ * the buffer is written. Once the buffer wraps around, the oldest strings are overwritten and their handles no longer resolve.
+ *
+ * Strings may be interned from any number of threads without locking. Looking up a handle validates that
+ * its text was not overwritten while being copied, in the manner of a sequence lock.
+ */
+class LogStringTable
+{
+public:
+    /// Handle of the empty string
+    static constexpr uint64_t EmptyHandle = 0;
+
+    /// Constructs the string table, given the capacity of its text buffer, in characters, and the
+    /// number of slots of its hash index. Both sizes must be powers of two, and the capacity must be
+    /// larger than \ref MaxStringLength
+    LogStringTable(std::size_t capacity, std::size_t indexSize);
+
+    /// Returns the handle of the given string, copying it into the table if it was not recently interned.
+    /// Strings longer than \ref MaxStringLength are truncated
+    uint64_t intern(const QString &str);
+
+    /// Copies the given string into the table and returns its handle, without looking for or indexing
+    /// a previous copy. Used for strings that are unlikely to repeat, so they do not evict others from the index
+    uint64_t append(const QString &str);
+
+    /// Returns the string identified by the handle, or a null string if it has been overwritten
+    QString lookup(uint64_t handle) const;
+
+    /// Maximum number of characters stored for a single string
+    static const int MaxStringLength;
+
+private:
+    /// Copies the first length characters of the string into the text buffer, returning their handle
+    uint64_t write(const QChar *str, int length);
+
+    /// Returns true if the text stored at the handle's position is equal to the given string
+    bool isEqual(uint64_t handle, const QChar *str, int length) const;
+
+    /// Returns true if no writer has started to overwrite the text at the handle's position
+    bool isValid(uint64_t handle) const;
+
+    /// Returns true if the string identified by the handle is in the newest quarter of the text buffer
+    bool isRecent(uint64_t handle) const;
+
+private:
+    /// Number of characters in the text buffer
+    const std::size_t m_capacity;
+
+    /// Number of slots in the hash index
+    const std::size_t m_indexSize;
+
+    /// Circular text buffer. Accessed with relaxed atomic operations so that readers may race with writers
+    std::unique_ptr<std::atomic<uint16_t>[]> m_text;
+
+    /// Hash index of recently interned strings, mapping a string's hash to its handle
+    std::unique_ptr<std::atomic<uint64_t>[]> m_index;
+
+    /// Total number of characters reserved by writers since the table was created
+    std::atomic<uint64_t> m_writePosition;
+};
+
+}
+
+#endif // LOGSTRINGTABLE_H
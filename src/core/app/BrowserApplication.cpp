@@ -38,6 +38,8 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QPluginLoader>
+#include <QThread>
+#include <QTimer>
 #include <QUrl>
 #include <QDebug>
 #include <QWebEngineCookieStore>
@@ -49,7 +51,10 @@
 #include <QtWebEngineCoreVersion>
 
 BrowserApplication::BrowserApplication(BrowserIPC *ipc, int &argc, char **argv) :
-    QApplication(argc, argv)
+    QApplication(argc, argv),
+    m_startupGraph(),
+    m_startupTime(std::chrono::steady_clock::now()),
+    m_firstWindowDelay(0)
 {
     QCoreApplication::setOrganizationName(QLatin1String("Vaccarelli"));
     QCoreApplication::setApplicationName(QLatin1String("Viper-Browser"));
@@ -73,88 +78,150 @@ BrowserApplication::BrowserApplication(BrowserIPC *ipc, int &argc, char **argv)
     m_settings = new Settings;
     registerService(m_settings);
 
+    // Services are initialized in the order of their dependencies. Those that only read from their own files,
+    // and do not use the service locator, are loaded on the thread pool while the others are created here
+    QThread *guiThread = thread();
+    const QString faviconPath = m_settings->getPathValue(BrowserSetting::FaviconPath);
+    const QString extStoragePath = m_settings->getPathValue(BrowserSetting::ExtensionStoragePath);
+    const QString searchEnginesFile = m_settings->getPathValue(BrowserSetting::SearchEnginesFile);
+    SearchEngineManager &searchEngineManager = SearchEngineManager::instance();
+
     // Initialize favicon storage module
-    //m_databaseScheduler.addWorker("FaviconStore",
-    //                              std::bind(DatabaseFactory::createDBWorker<FaviconStore>, m_settings->getPathValue(BrowserSetting::FaviconPath)));
-    m_faviconMgr = new FaviconManager(m_settings->getPathValue(BrowserSetting::FaviconPath));
-    registerService(m_faviconMgr);
+    m_startupGraph.addTask(QLatin1String("FaviconStore"), {}, StartupThread::Worker, [this, guiThread, faviconPath](){
+        m_faviconMgr = new FaviconManager(faviconPath);
+        m_faviconMgr->moveToThread(guiThread);
+    });
+    m_startupGraph.addTask(QLatin1String("FaviconManager"), { QLatin1String("FaviconStore") }, StartupThread::Main, [this](){
+        registerService(m_faviconMgr);
+    });
 
     // Bookmark setup
-    m_databaseScheduler.addWorker("BookmarkStore",
-                                  std::bind(DatabaseFactory::createDBWorker<BookmarkStore>, m_settings->getPathValue(BrowserSetting::BookmarkPath)));
-    m_bookmarkManager = new BookmarkManager(m_serviceLocator, m_databaseScheduler, nullptr);
-    registerService(m_bookmarkManager);
+    m_startupGraph.addTask(QLatin1String("BookmarkManager"), { QLatin1String("FaviconManager") }, StartupThread::Main, [this](){
+        m_databaseScheduler.addWorker("BookmarkStore",
+                                      std::bind(DatabaseFactory::createDBWorker<BookmarkStore>, m_settings->getPathValue(BrowserSetting::BookmarkPath)));
+        m_bookmarkManager = new BookmarkManager(m_serviceLocator, m_databaseScheduler, nullptr);
+        registerService(m_bookmarkManager);
+    });
 
     // Initialize cookie jar and cookie manager UI
-    m_cookieJar = new CookieJar(m_settings, false);
-    registerService(m_cookieJar);
+    m_startupGraph.addTask(QLatin1String("CookieJar"), {}, StartupThread::Main, [this](){
+        m_cookieJar = new CookieJar(m_settings, false);
+        registerService(m_cookieJar);
 
-    m_cookieUI = new CookieWidget();
-    registerService(m_cookieUI);
+        m_cookieUI = new CookieWidget();
+        registerService(m_cookieUI);
 
-    // Get default profile and load cookies now that the cookie jar is instantiated
-    auto webProfile = QWebEngineProfile::defaultProfile();
-    webProfile->cookieStore()->loadAllCookies();
+        // Get default profile and load cookies now that the cookie jar is instantiated
+        QWebEngineProfile::defaultProfile()->cookieStore()->loadAllCookies();
+    });
 
     // Initialize auto fill manager
-    m_autoFill = new AutoFill(m_settings);
-    registerService(m_autoFill);
+    m_startupGraph.addTask(QLatin1String("AutoFill"), {}, StartupThread::Main, [this](){
+        m_autoFill = new AutoFill(m_settings);
+        registerService(m_autoFill);
+    });
 
     // Initialize download manager
-    const std::vector<QWebEngineProfile*> webProfiles { webProfile, m_privateProfile };
-    m_downloadMgr = new DownloadManager(m_settings, webProfiles);
-    registerService(m_downloadMgr);
+    m_startupGraph.addTask(QLatin1String("DownloadManager"), {}, StartupThread::Main, [this](){
+        const std::vector<QWebEngineProfile*> webProfiles { QWebEngineProfile::defaultProfile(), m_privateProfile };
+        m_downloadMgr = new DownloadManager(m_settings, webProfiles);
+        registerService(m_downloadMgr);
+    });
 
-    // Initialize advertisement blocking system
-    m_adBlockManager = new adblock::AdBlockManager(m_serviceLocator, m_settings);
-    registerService(m_adBlockManager);
+    // Initialize advertisement blocking system. Its subscriptions are loaded after the first window is shown
+    m_startupGraph.addTask(QLatin1String("AdBlockManager"), { QLatin1String("DownloadManager") }, StartupThread::Main, [this](){
+        m_adBlockManager = new adblock::AdBlockManager(m_serviceLocator, m_settings);
+        registerService(m_adBlockManager);
+    });
 
     // Instantiate the history manager and related systems
-    m_databaseScheduler.addWorker("HistoryStore",
-                                  std::bind(DatabaseFactory::createDBWorker<HistoryStore>, m_settings->getPathValue(BrowserSetting::HistoryPath)));
-    m_historyMgr = new HistoryManager(m_serviceLocator, m_databaseScheduler);
-    registerService(m_historyMgr);
+    m_startupGraph.addTask(QLatin1String("HistoryManager"), { QLatin1String("BookmarkManager") }, StartupThread::Main, [this](){
+        m_databaseScheduler.addWorker("HistoryStore",
+                                      std::bind(DatabaseFactory::createDBWorker<HistoryStore>, m_settings->getPathValue(BrowserSetting::HistoryPath)));
+        m_historyMgr = new HistoryManager(m_serviceLocator, m_databaseScheduler);
+        registerService(m_historyMgr);
+    });
+
+    // Start loading bookmarks and history as soon as their workers have been registered
+    m_startupGraph.addTask(QLatin1String("DatabaseScheduler"), { QLatin1String("BookmarkManager"), QLatin1String("HistoryManager") },
+                           StartupThread::Main, [this](){
+        m_databaseScheduler.run();
+    });
 
-    m_thumbnailStore = DatabaseFactory::createWorker<WebPageThumbnailStore>(m_serviceLocator, m_settings->getPathValue(BrowserSetting::ThumbnailPath));
-    registerService(m_thumbnailStore.get());
+    m_startupGraph.addTask(QLatin1String("WebPageThumbnailStore"), { QLatin1String("BookmarkManager"), QLatin1String("HistoryManager") },
+                           StartupThread::Main, [this](){
+        m_thumbnailStore = DatabaseFactory::createWorker<WebPageThumbnailStore>(m_serviceLocator, m_settings->getPathValue(BrowserSetting::ThumbnailPath));
+        registerService(m_thumbnailStore.get());
+    });
 
-    m_favoritePagesMgr = new FavoritePagesManager(m_historyMgr, m_thumbnailStore.get(), m_settings->getPathValue(BrowserSetting::FavoritePagesFile));
-    registerService(m_favoritePagesMgr);
+    m_startupGraph.addTask(QLatin1String("FavoritePagesManager"), { QLatin1String("HistoryManager"), QLatin1String("WebPageThumbnailStore") },
+                           StartupThread::Main, [this](){
+        m_favoritePagesMgr = new FavoritePagesManager(m_historyMgr, m_thumbnailStore.get(), m_settings->getPathValue(BrowserSetting::FavoritePagesFile));
+        registerService(m_favoritePagesMgr);
+    });
 
     // Create network access manager
-    m_networkAccessMgr = new NetworkAccessManager;
-    m_networkAccessMgr->setCookieJar(m_cookieJar);
-    registerService(m_networkAccessMgr);
-
-    m_downloadMgr->setNetworkAccessManager(m_networkAccessMgr);
-    m_faviconMgr->setNetworkAccessManager(m_networkAccessMgr);
+    m_startupGraph.addTask(QLatin1String("NetworkAccessManager"),
+                           { QLatin1String("CookieJar"), QLatin1String("DownloadManager"), QLatin1String("FaviconManager") },
+                           StartupThread::Main, [this](){
+        m_networkAccessMgr = new NetworkAccessManager;
+        m_networkAccessMgr->setCookieJar(m_cookieJar);
+        registerService(m_networkAccessMgr);
+
+        m_downloadMgr->setNetworkAccessManager(m_networkAccessMgr);
+        m_faviconMgr->setNetworkAccessManager(m_networkAccessMgr);
+    });
 
     // Setup user agent manager before settings
-    m_userAgentMgr = new UserAgentManager(m_settings);
-    registerService(m_userAgentMgr);
+    m_startupGraph.addTask(QLatin1String("UserAgentManager"), {}, StartupThread::Main, [this](){
+        m_userAgentMgr = new UserAgentManager(m_settings);
+        registerService(m_userAgentMgr);
+    });
 
     // Setup user script manager
-    m_userScriptMgr = new UserScriptManager(m_downloadMgr, m_settings);
-    registerService(m_userScriptMgr);
+    m_startupGraph.addTask(QLatin1String("UserScriptManager"), { QLatin1String("DownloadManager") }, StartupThread::Main, [this](){
+        m_userScriptMgr = new UserScriptManager(m_downloadMgr, m_settings);
+        registerService(m_userScriptMgr);
+    });
 
     // Setup extension storage manager
-    m_extStorage = DatabaseFactory::createWorker<ExtStorage>(m_settings->getPathValue(BrowserSetting::ExtensionStoragePath));
-    registerService(m_extStorage.get());
+    m_startupGraph.addTask(QLatin1String("ExtStorageDatabase"), {}, StartupThread::Worker, [this, guiThread, extStoragePath](){
+        m_extStorage = DatabaseFactory::createWorker<ExtStorage>(extStoragePath);
+        m_extStorage->moveToThread(guiThread);
+    });
+    m_startupGraph.addTask(QLatin1String("ExtStorage"), { QLatin1String("ExtStorageDatabase") }, StartupThread::Main, [this](){
+        registerService(m_extStorage.get());
+    });
 
     // Apply global web scripts
-    installGlobalWebScripts();
+    m_startupGraph.addTask(QLatin1String("GlobalWebScripts"), {}, StartupThread::Main, [this](){
+        installGlobalWebScripts();
+    });
 
     // Apply web settings
-    m_webSettings = new WebSettings(m_serviceLocator, QWebEngineSettings::defaultSettings(), QWebEngineProfile::defaultProfile(), m_privateProfile);
+    m_startupGraph.addTask(QLatin1String("WebSettings"), { QLatin1String("CookieJar"), QLatin1String("UserAgentManager") },
+                           StartupThread::Main, [this](){
+        m_webSettings = new WebSettings(m_serviceLocator, QWebEngineSettings::defaultSettings(), QWebEngineProfile::defaultProfile(), m_privateProfile);
+    });
 
     // Load search engine information
-    SearchEngineManager::instance().loadSearchEngines(m_settings->getPathValue(BrowserSetting::SearchEnginesFile));
+    m_startupGraph.addTask(QLatin1String("SearchEngines"), {}, StartupThread::Worker, [&searchEngineManager, searchEnginesFile](){
+        searchEngineManager.loadSearchEngines(searchEnginesFile);
+    });
+
+    if (!m_startupGraph.run())
+        qFatal("BrowserApplication - could not initialize the browser services");
 
-    // Load ad block subscriptions (will do nothing if disabled)
-    m_adBlockManager->loadSubscriptions();
+    // Load the ad block subscriptions once the event loop has started (will do nothing if disabled). Their filters
+    // are built on a worker thread, and requests are not filtered until they have been published
+    QTimer::singleShot(0, this, [this](){
+        m_adBlockManager->loadSubscriptions();
+    });
 
     // Set browser's saved sessions file
     m_sessionMgr.setSessionFile(m_settings->getPathValue(BrowserSetting::SessionFile));
+    m_sessionMgr.setFaviconManager(m_faviconMgr);
+    m_sessionMgr.setWarmUpTabCount(m_settings->getValue(BrowserSetting::SessionWarmUpTabs).toInt());
 
     // Inject services into the security manager
     SecurityManager::instance().setServiceLocator(m_serviceLocator);
@@ -166,8 +233,6 @@ BrowserApplication::BrowserApplication(BrowserIPC *ipc, int &argc, char **argv)
     const std::vector<QString> urlSchemes { QLatin1String("http"), QLatin1String("https"), QLatin1String("viper") };
     for (const QString &scheme : urlSchemes)
         QDesktopServices::setUrlHandler(scheme, this, "openUrl");
-
-    m_databaseScheduler.run();
 }
 
 BrowserApplication::~BrowserApplication()
@@ -257,6 +322,15 @@ QObject *BrowserApplication::getService(const QString &serviceName) const
     return m_serviceLocator.getService(serviceName.toStdString());
 }
 
+QString BrowserApplication::getStartupTrace() const
+{
+    QString result = m_startupGraph.formatTrace();
+    if (m_firstWindowDelay.count() > 0)
+        result.append(QStringLiteral("First window shown after %1 ms\n")
+                      .arg(static_cast<double>(m_firstWindowDelay.count()) / 1000.0, 0, 'f', 1));
+    return result;
+}
+
 void BrowserApplication::prepareToQuit()
 {
     beforeBrowserQuit();
@@ -277,10 +351,17 @@ MainWindow *BrowserApplication::getNewWindow()
 
     w->show();
 
+    // Record the window in the session. The first window is recorded once the startup mode has been handled
+    if (!firstWindow && static_cast<StartupMode>(m_settings->getValue(BrowserSetting::StartupMode).toInt()) == StartupMode::RestoreSession)
+        m_sessionMgr.addWindow(w);
+
     // Check if this is the first window since the application has started - if so, handle
     // the startup mode behavior depending on the user's configuration setting
     if (firstWindow)
     {
+        if (m_firstWindowDelay.count() == 0)
+            m_firstWindowDelay = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startupTime);
+
         loadPlugins();
 
         StartupMode mode = static_cast<StartupMode>(m_settings->getValue(BrowserSetting::StartupMode).toInt());
@@ -300,6 +381,10 @@ MainWindow *BrowserApplication::getNewWindow()
                 break;
         }
 
+        // The first window is recorded after the session is restored into it, so the restored tabs replace the saved ones
+        if (mode == StartupMode::RestoreSession)
+            m_sessionMgr.addWindow(w);
+
         m_adBlockManager->updateSubscriptions();
     }
 
@@ -1,6 +1,7 @@
 #ifndef BROWSERAPPLICATION_H
 #define BROWSERAPPLICATION_H
 
+#include <chrono>
 #include <memory>
 #include <QApplication>
 #include <QDateTime>
@@ -13,6 +14,7 @@
 #include "ServiceLocator.h"
 #include "SessionManager.h"
 #include "Settings.h"
+#include "StartupGraph.h"
 
 namespace adblock {
     class AdBlockManager;
@@ -90,6 +92,9 @@ class BrowserApplication : public QApplication
     /// Wrapper around service locator call
     QObject *getService(const QString &serviceName) const;
 
+    /// Returns a report of the time taken to initialize each browser service, and to show the first window
+    QString getStartupTrace() const;
+
 Q_SIGNALS:
     /// Emitted when any and all runtime plugins have been loaded into the application
     void pluginsLoaded();
@@ -224,6 +229,15 @@ private Q_SLOTS:
 
     /// Database worker task scheduler
     DatabaseTaskScheduler m_databaseScheduler;
+
+    /// Initializes the browser services in the order of their dependencies
+    StartupGraph m_startupGraph;
+
+    /// Time at which the application began to initialize its services
+    std::chrono::steady_clock::time_point m_startupTime;
+
+    /// Time taken from the start of initialization until the first browser window was shown
+    std::chrono::microseconds m_firstWindowDelay;
 };
 
 #define sBrowserApplication BrowserApplication::instance()
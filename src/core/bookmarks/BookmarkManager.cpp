@@ -4,12 +4,16 @@
 #include "CommonUtil.h"
 #include "FaviconManager.h"
 
+#include <algorithm>
 #include <deque>
 #include <memory>
 
 #include <QTimer>
 #include <QtConcurrent>
 
+/// Name of the bookmark database worker in the task scheduler
+static const std::string BookmarkStoreWorker = "BookmarkStore";
+
 BookmarkManager::BookmarkManager(const ViperServiceLocator &serviceLocator, DatabaseTaskScheduler &taskScheduler, QObject *parent) :
     QObject(parent),
     m_taskScheduler(taskScheduler),
@@ -17,7 +21,10 @@ BookmarkManager::BookmarkManager(const ViperServiceLocator &serviceLocator, Data
     m_bookmarkBar(nullptr),
     m_bookmarkStore(nullptr),
     m_faviconManager(nullptr),
-    m_lookupCache(24),
+    m_urlIndex(),
+    m_hostIndex(),
+    m_shortcutIndex(),
+    m_indexMutex(),
     m_nodeList(),
     m_canUpdateList(true),
     m_nextBookmarkId(0),
@@ -30,11 +37,11 @@ BookmarkManager::BookmarkManager(const ViperServiceLocator &serviceLocator, Data
 
     QTimer::singleShot(250, this, &BookmarkManager::checkIfLoaded);
 
-    m_taskScheduler.onInit([this](){
-        m_bookmarkStore = static_cast<BookmarkStore*>(m_taskScheduler.getWorker("BookmarkStore"));
+    m_taskScheduler.onInit(BookmarkStoreWorker, [this](){
+        m_bookmarkStore = static_cast<BookmarkStore*>(m_taskScheduler.getWorker(BookmarkStoreWorker));
     });
 
-    m_taskScheduler.post([this](){
+    m_taskScheduler.post(BookmarkStoreWorker, [this](){
         m_nextBookmarkId = m_bookmarkStore->getMaxUniqueId() + 1;
         setRootNode(m_bookmarkStore->getRootNode());
     });
@@ -59,65 +66,62 @@ BookmarkNode *BookmarkManager::getBookmark(const QUrl &url)
     if (url.isEmpty())
         return nullptr;
 
-    const std::string urlStdStr = url.toString().toStdString();
-    if (m_lookupCache.has(urlStdStr))
-    {
-        BookmarkNode *node = m_lookupCache.get(urlStdStr);
-        if (node != nullptr)
-            return node;
-    }
-
-    if (!m_nodeListFuture.isCanceled() && m_nodeListFuture.isRunning())
-        m_nodeListFuture.waitForFinished();
-
-    for (BookmarkNode *node : m_nodeList)
-    {
-        if (node->getType() == BookmarkNode::Bookmark
-                && CommonUtil::doUrlsMatch(url, node->getURL(), true))
-            return node;
-    }
+    const URLMatchKey urlKey(url, true);
 
-    return nullptr;
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    auto it = m_urlIndex.find(urlKey);
+    return it != m_urlIndex.end() ? it->second : nullptr;
 }
 
 bool BookmarkManager::isBookmarked(const QUrl &url)
 {
-    if (url.isEmpty() || !m_rootNode.get())
-        return false;
+    return getBookmark(url) != nullptr;
+}
 
-    const std::string urlStdStr = url.toString().toStdString();
-    if (m_lookupCache.has(urlStdStr) && m_lookupCache.get(urlStdStr) != nullptr)
-        return true;
+std::vector<BookmarkSnapshot> BookmarkManager::findBookmarksWithHostPrefix(const QString &hostPrefix, std::size_t limit) const
+{
+    std::vector<BookmarkSnapshot> result;
 
-    std::deque<BookmarkNode*> queue;
-    queue.push_back(m_rootNode.get());
-    while (!queue.empty())
-    {
-        BookmarkNode *n = queue.front();
+    const QString prefixKey = getHostKey(hostPrefix);
+    if (prefixKey.isEmpty())
+        return result;
 
-        for (const auto &node : n->m_children)
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    for (auto it = m_hostIndex.lower_bound(prefixKey); it != m_hostIndex.end() && it->first.startsWith(prefixKey); ++it)
+    {
+        for (BookmarkNode *node : it->second)
         {
-            BookmarkNode *childNode = node.get();
-            if (!childNode)
-                continue;
-
-            if (childNode->getType() == BookmarkNode::Folder)
-            {
-                queue.push_back(childNode);
-                continue;
-            }
+            if (result.size() >= limit)
+                return result;
 
-            if (CommonUtil::doUrlsMatch(url, childNode->getURL(), true))
-            {
-                m_lookupCache.put(urlStdStr, childNode);
-                return true;
-            }
+            result.push_back(getSnapshot(node));
         }
+    }
 
-        queue.pop_front();
+    return result;
+}
+
+std::vector<BookmarkSnapshot> BookmarkManager::findBookmarksWithShortcutIn(const QString &text) const
+{
+    std::vector<BookmarkSnapshot> result;
+
+    const QString textUpper = text.toUpper();
+
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    if (m_shortcutIndex.empty())
+        return result;
+
+    for (int length = 1; length <= textUpper.size(); ++length)
+    {
+        auto it = m_shortcutIndex.find(textUpper.left(length));
+        if (it == m_shortcutIndex.end())
+            continue;
+
+        for (const BookmarkNode *node : it->second)
+            result.push_back(getSnapshot(node));
     }
 
-    return false;
+    return result;
 }
 
 void BookmarkManager::appendBookmark(const QString &name, const QUrl &url, BookmarkNode *folder)
@@ -132,7 +136,13 @@ void BookmarkManager::appendBookmark(const QString &name, const QUrl &url, Bookm
     BookmarkNode *bookmark = folder->appendNode(std::make_unique<BookmarkNode>(BookmarkNode::Bookmark, name));
     bookmark->setUniqueId(bookmarkId);
     bookmark->setURL(url);
-    bookmark->setIcon(m_faviconManager ? m_faviconManager->getFavicon(url) : QIcon());
+
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        addToIndex(bookmark);
+    }
+
+    loadIcon(bookmark);
 
     m_numBookmarks++;
 
@@ -157,7 +167,13 @@ void BookmarkManager::insertBookmark(const QString &name, const QUrl &url, Bookm
     BookmarkNode *bookmark = folder->insertNode(std::make_unique<BookmarkNode>(BookmarkNode::Bookmark, name), position);
     bookmark->setUniqueId(bookmarkId);
     bookmark->setURL(url);
-    bookmark->setIcon(m_faviconManager ? m_faviconManager->getFavicon(url) : QIcon());
+
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        addToIndex(bookmark);
+    }
+
+    loadIcon(bookmark);
 
     m_numBookmarks++;
 
@@ -190,35 +206,8 @@ BookmarkNode *BookmarkManager::addFolder(const QString &name, BookmarkNode *pare
 
 void BookmarkManager::removeBookmark(const QUrl &url)
 {
-    if (url.isEmpty())
-        return;
-
-    if (m_lookupCache.has(url.toString().toStdString()))
-    {
-        BookmarkNode * const &node = m_lookupCache.get(url.toString().toStdString());
-        if (node != nullptr)
-        {
-            BookmarkNode *nodeCopy = node;
-            removeBookmark(nodeCopy);
-            return;
-        }
-    }
-
-    if (!m_nodeListFuture.isCanceled() && m_nodeListFuture.isRunning())
-        m_nodeListFuture.waitForFinished();
-
-    for (BookmarkNode *node : m_nodeList)
-    {
-        if (node->getType() != BookmarkNode::Bookmark)
-            continue;
-
-        // Bookmark URLs are unique, once match is found, remove bookmark and return
-        if (CommonUtil::doUrlsMatch(url, node->getURL(), true))
-        {
-            removeBookmark(node);
-            return;
-        }
-    }
+    if (BookmarkNode *node = getBookmark(url))
+        removeBookmark(node);
 }
 
 void BookmarkManager::removeBookmark(BookmarkNode *item)
@@ -245,9 +234,8 @@ void BookmarkManager::removeBookmark(BookmarkNode *item)
                 processQueue.push_back(child);
             else if (child->m_type == BookmarkNode::Bookmark)
             {
-                const std::string urlStdStr = child->m_url.toString().toStdString();
-                if (m_lookupCache.has(urlStdStr))
-                    m_lookupCache.put(urlStdStr, nullptr);
+                std::lock_guard<std::mutex> lock(m_indexMutex);
+                removeFromIndex(child);
             }
         }
 
@@ -264,7 +252,7 @@ void BookmarkManager::removeBookmark(BookmarkNode *item)
             parent = m_rootNode.get();
 
         if (m_bookmarkStore)
-            m_taskScheduler.post(&BookmarkStore::removeNode, std::ref(m_bookmarkStore), node->getUniqueId(),
+            m_taskScheduler.post(BookmarkStoreWorker, &BookmarkStore::removeNode, std::ref(m_bookmarkStore), node->getUniqueId(),
                                  parent->getUniqueId(), node->getPosition());
         //emit bookmarkDeleted(node->getUniqueId(), parent->getUniqueId(), node->getPosition());
 
@@ -273,9 +261,8 @@ void BookmarkManager::removeBookmark(BookmarkNode *item)
 
     if (item->m_type == BookmarkNode::Bookmark)
     {
-        const std::string urlStdStr = item->m_url.toString().toStdString();
-        if (m_lookupCache.has(urlStdStr))
-            m_lookupCache.put(urlStdStr, nullptr);
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        removeFromIndex(item);
     }
 
     if (BookmarkNode *parent = item->getParent())
@@ -290,7 +277,10 @@ void BookmarkManager::setBookmarkName(BookmarkNode *bookmark, const QString &nam
     if (!bookmark || bookmark->getName() == name)
         return;
 
-    bookmark->setName(name);
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        bookmark->setName(name);
+    }
 
     scheduleBookmarkUpdate(bookmark);
 }
@@ -353,6 +343,10 @@ void BookmarkManager::setBookmarkPosition(BookmarkNode *bookmark, int position)
     if (position < 0 || position >= parent->getNumChildren() || position == currentPos)
         return;
 
+    // The node is replaced by a new one in its new position
+    std::unique_lock<std::mutex> lock(m_indexMutex);
+    removeFromIndex(bookmark);
+
     // Adjust position of node in parent's child list
     if (position > currentPos)
         ++position;
@@ -361,6 +355,9 @@ void BookmarkManager::setBookmarkPosition(BookmarkNode *bookmark, int position)
 
     bookmark = parent->getNode(position);
 
+    addToIndex(bookmark);
+    lock.unlock();
+
     scheduleBookmarkUpdate(bookmark);
     scheduleResetList();
 }
@@ -370,7 +367,12 @@ void BookmarkManager::setBookmarkShortcut(BookmarkNode *bookmark, const QString
     if (!bookmark || bookmark->getShortcut() == shortcut)
         return;
 
-    bookmark->setShortcut(shortcut);
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        removeFromIndex(bookmark);
+        bookmark->setShortcut(shortcut);
+        addToIndex(bookmark);
+    }
 
     scheduleBookmarkUpdate(bookmark);
 }
@@ -380,15 +382,14 @@ void BookmarkManager::setBookmarkURL(BookmarkNode *bookmark, const QUrl &url)
     if (!bookmark || bookmark->getURL().matches(url, QUrl::None))
         return;
 
-    const QUrl oldUrl = bookmark->getURL();
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        removeFromIndex(bookmark);
+        bookmark->setURL(url);
+        addToIndex(bookmark);
+    }
 
-    // Update cache if applicable
-    const std::string oldUrlStr = oldUrl.toString().toStdString();
-    if (m_lookupCache.has(oldUrlStr))
-        m_lookupCache.put(oldUrlStr, nullptr);
-
-    bookmark->setURL(url);
-    bookmark->setIcon(m_faviconManager ? m_faviconManager->getFavicon(url) : QIcon());
+    loadIcon(bookmark);
 
     scheduleBookmarkUpdate(bookmark);
 }
@@ -413,6 +414,8 @@ void BookmarkManager::setRootNode(std::shared_ptr<BookmarkNode> node)
 
     if (!m_bookmarkBar)
         m_bookmarkBar = m_rootNode.get();
+
+    rebuildIndex();
 }
 
 void BookmarkManager::checkIfLoaded()
@@ -438,7 +441,7 @@ void BookmarkManager::checkIfLoaded()
                     continue;
 
                 if (childNode->getType() == BookmarkNode::Bookmark)
-                    childNode->setIcon(m_faviconManager->getFavicon(childNode->getURL()));
+                    loadIcon(childNode);
                 else if (childNode->getType() == BookmarkNode::Folder)
                     queue.push_back(childNode);
             }
@@ -456,7 +459,7 @@ void BookmarkManager::scheduleBookmarkInsert(const BookmarkNode *node)
         return;
 
     // params: int nodeId, int parentId, int nodeType, const QString &name, const QUrl &url, int position
-    m_taskScheduler.post(&BookmarkStore::insertNode, std::ref(m_bookmarkStore),
+    m_taskScheduler.post(BookmarkStoreWorker, &BookmarkStore::insertNode, std::ref(m_bookmarkStore),
                          node->getUniqueId(), node->getParent()->getUniqueId(),
                          static_cast<int>(node->getType()), node->getName(),
                          node->getURL(), node->getPosition());
@@ -468,7 +471,7 @@ void BookmarkManager::scheduleBookmarkUpdate(const BookmarkNode *node)
         return;
 
     // params: int nodeId, int parentId, const QString &name, const QString &url, const QString &shortcut, int position
-    m_taskScheduler.post(&BookmarkStore::updateNode, std::ref(m_bookmarkStore),
+    m_taskScheduler.post(BookmarkStoreWorker, &BookmarkStore::updateNode, std::ref(m_bookmarkStore),
                          node->getUniqueId(), node->getParent()->getUniqueId(),
                          node->getName(), node->getURL(), node->getShortcut(),
                          node->getPosition());
@@ -526,3 +529,127 @@ void BookmarkManager::resetBookmarkList()
     m_nodeList = std::move(nodeList);
     emit bookmarksChanged();
 }
+
+void BookmarkManager::loadIcon(BookmarkNode *bookmark)
+{
+    if (!m_faviconManager)
+    {
+        bookmark->setIcon(QIcon());
+        return;
+    }
+
+    // The bookmark is looked up again once its icon is loaded, since it may have been removed in the meantime
+    const QUrl url = bookmark->getURL();
+    m_faviconManager->loadFavicon(url, this, [this, url](const QIcon &icon){
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        auto it = m_urlIndex.find(URLMatchKey(url, true));
+        if (it != m_urlIndex.end())
+            it->second->setIcon(icon);
+    });
+}
+
+BookmarkSnapshot BookmarkManager::getSnapshot(const BookmarkNode *node)
+{
+    return BookmarkSnapshot { node->getUniqueId(), node->getName(), node->getURL(), node->getShortcut(), node->getIcon() };
+}
+
+void BookmarkManager::rebuildIndex()
+{
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+
+    m_urlIndex.clear();
+    m_hostIndex.clear();
+    m_shortcutIndex.clear();
+
+    if (!m_rootNode.get())
+        return;
+
+    std::deque<BookmarkNode*> queue;
+    queue.push_back(m_rootNode.get());
+    while (!queue.empty())
+    {
+        BookmarkNode *n = queue.front();
+
+        for (const auto &node : n->m_children)
+        {
+            BookmarkNode *childNode = node.get();
+            if (!childNode)
+                continue;
+
+            if (childNode->getType() == BookmarkNode::Folder)
+                queue.push_back(childNode);
+            else
+                addToIndex(childNode);
+        }
+
+        queue.pop_front();
+    }
+}
+
+void BookmarkManager::addToIndex(BookmarkNode *node)
+{
+    if (node->getType() != BookmarkNode::Bookmark)
+        return;
+
+    // Bookmark URLs are expected to be unique. If they are not, the first bookmark with the URL is found by lookups
+    m_urlIndex.emplace(node->getURLKey(), node);
+    m_hostIndex[getHostKey(node->getURL().host())].push_back(node);
+
+    const QString shortcut = node->getShortcut().toUpper();
+    if (!shortcut.isEmpty())
+        m_shortcutIndex[shortcut].push_back(node);
+}
+
+void BookmarkManager::removeFromIndex(BookmarkNode *node)
+{
+    if (node->getType() != BookmarkNode::Bookmark)
+        return;
+
+    auto hostIt = m_hostIndex.find(getHostKey(node->getURL().host()));
+    if (hostIt != m_hostIndex.end())
+    {
+        std::vector<BookmarkNode*> &nodes = hostIt->second;
+        nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+    }
+
+    const URLMatchKey &urlKey = node->getURLKey();
+    auto urlIt = m_urlIndex.find(urlKey);
+    if (urlIt != m_urlIndex.end() && urlIt->second == node)
+    {
+        m_urlIndex.erase(urlIt);
+
+        // Another bookmark with the same URL would be indexed under the same host
+        if (hostIt != m_hostIndex.end())
+        {
+            for (BookmarkNode *other : hostIt->second)
+            {
+                if (other->getURLKey() == urlKey)
+                {
+                    m_urlIndex.emplace(urlKey, other);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (hostIt != m_hostIndex.end() && hostIt->second.empty())
+        m_hostIndex.erase(hostIt);
+
+    const QString shortcut = node->getShortcut().toUpper();
+    auto shortcutIt = m_shortcutIndex.find(shortcut);
+    if (shortcutIt != m_shortcutIndex.end())
+    {
+        std::vector<BookmarkNode*> &nodes = shortcutIt->second;
+        nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+        if (nodes.empty())
+            m_shortcutIndex.erase(shortcutIt);
+    }
+}
+
+QString BookmarkManager::getHostKey(const QString &host)
+{
+    QString key = host.toLower();
+    if (key.startsWith(QLatin1String("www.")))
+        key.remove(0, 4);
+    return key;
+}
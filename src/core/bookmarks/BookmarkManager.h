@@ -1,17 +1,20 @@
 #ifndef BOOKMARKNODEMANAGER_H
 #define BOOKMARKNODEMANAGER_H
 
+#include "CommonUtil.h"
 #include "DatabaseTaskScheduler.h"
-#include "LRUCache.h"
 #include "ServiceLocator.h"
+#include "URLMatchKey.h"
 
 #include <atomic>
+#include <map>
 #include <mutex>
-#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <QFuture>
 #include <QObject>
+#include <QString>
 
 class BookmarkNode;
 class BookmarkStore;
@@ -63,6 +66,17 @@ class BookmarkManager : public QObject
     /// Checks if the given url is bookmarked, returning true if it is
     bool isBookmarked(const QUrl &url);
 
+    /**
+     * @brief Searches for bookmarks whose host, without any "www." prefix, starts with the given string
+     * @param hostPrefix Start of the host, in any case
+     * @param limit Maximum number of bookmarks to return
+     * @return Copies of the matching bookmarks, ordered by their host. May be called from any thread
+     */
+    std::vector<BookmarkSnapshot> findBookmarksWithHostPrefix(const QString &hostPrefix, std::size_t limit) const;
+
+    /// Returns copies of the bookmarks whose shortcut, in any case, is a prefix of the given text. May be called from any thread
+    std::vector<BookmarkSnapshot> findBookmarksWithShortcutIn(const QString &text) const;
+
     /**
      * @brief appendBookmark Adds a bookmark to the collection, at the end of its parent folder
      * @param name Name to display as a reference to the bookmark
@@ -150,6 +164,24 @@ private Q_SLOTS:
     /// Resets the flat list of bookmark node pointers, used for iteration & bookmark searches
     void resetBookmarkList();
 
+    /// Sets the icon of the bookmark to the favicon of its URL, once it has been loaded. The bookmark must be indexed
+    void loadIcon(BookmarkNode *bookmark);
+
+    /// Rebuilds the URL, host and shortcut indices from the bookmark tree
+    void rebuildIndex();
+
+    /// Adds the given bookmark to the URL, host and shortcut indices. Must be called with m_indexMutex held
+    void addToIndex(BookmarkNode *node);
+
+    /// Removes the given bookmark from the URL, host and shortcut indices. Must be called with m_indexMutex held
+    void removeFromIndex(BookmarkNode *node);
+
+    /// Returns a copy of the properties of the given bookmark. Must be called with m_indexMutex held
+    static BookmarkSnapshot getSnapshot(const BookmarkNode *node);
+
+    /// Returns the key of the given host in the host index: the host in lower case, without any "www." prefix
+    static QString getHostKey(const QString &host);
+
 private:
     /// Reference to the task scheduler. Needed to queue work for the \ref BookmarkStore
     DatabaseTaskScheduler &m_taskScheduler;
@@ -166,8 +198,17 @@ private Q_SLOTS:
     /// Pointer to the favicon manager
     FaviconManager *m_faviconManager;
 
-    /// Cache of bookmark nodes that were recently searched for within the application
-    LRUCache<std::string, BookmarkNode*> m_lookupCache;
+    /// Map of bookmark URL match keys to their bookmarks
+    std::unordered_map<URLMatchKey, BookmarkNode*> m_urlIndex;
+
+    /// Map of host keys to the bookmarks with that host. Ordered, so that hosts can be searched for by their prefix
+    std::map<QString, std::vector<BookmarkNode*>> m_hostIndex;
+
+    /// Map of upper-case bookmark shortcuts to their bookmarks
+    std::unordered_map<QString, std::vector<BookmarkNode*>> m_shortcutIndex;
+
+    /// Guards the URL, host and shortcut indices, which are read from other threads
+    mutable std::mutex m_indexMutex;
 
     /// Container of bookmark node pointers, flattened version of tree structure used for bookmark iteration
     std::vector<BookmarkNode*> m_nodeList;
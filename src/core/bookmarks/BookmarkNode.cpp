@@ -8,6 +8,7 @@ BookmarkNode::BookmarkNode() :
     m_id(0),
     m_name(),
     m_url(),
+    m_urlKey(),
     m_icon(),
     m_shortcut(),
     m_type(BookmarkNode::Bookmark)
@@ -19,6 +20,7 @@ BookmarkNode::BookmarkNode(BookmarkNode::NodeType type, const QString &name) :
     m_id(0),
     m_name(name),
     m_url(),
+    m_urlKey(),
     m_icon(),
     m_shortcut(),
     m_type(type)
@@ -30,6 +32,7 @@ BookmarkNode::BookmarkNode(BookmarkNode &&other) noexcept
     m_id = other.m_id;
     m_name = other.m_name;
     m_url = other.m_url;
+    m_urlKey = other.m_urlKey;
     m_shortcut = other.m_shortcut;
     m_type = other.m_type;
     m_parent = other.m_parent;
@@ -86,9 +89,15 @@ const QUrl &BookmarkNode::getURL() const
     return m_url;
 }
 
+const URLMatchKey &BookmarkNode::getURLKey() const
+{
+    return m_urlKey;
+}
+
 void BookmarkNode::setURL(const QUrl &url)
 {
     m_url = url;
+    m_urlKey = URLMatchKey(url, true);
 }
 
 const QIcon &BookmarkNode::getIcon() const
@@ -5,6 +5,7 @@
 #include "../database/bindings/QtSQLite.h"
 
 #include "TreeNode.h"
+#include "URLMatchKey.h"
 
 #include <QDataStream>
 #include <QIcon>
@@ -12,6 +13,29 @@
 #include <QString>
 #include <QUrl>
 
+/**
+ * @struct BookmarkSnapshot
+ * @brief Copy of the properties of a bookmark, which remains valid after the bookmark is changed or removed
+ * @ingroup Bookmarks
+ */
+struct BookmarkSnapshot
+{
+    /// Unique identifier of the bookmark
+    int UniqueId;
+
+    /// Name of the bookmark
+    QString Name;
+
+    /// URL of the bookmark
+    QUrl URL;
+
+    /// Shortcut used to load the bookmark
+    QString Shortcut;
+
+    /// Icon of the bookmark
+    QIcon Icon;
+};
+
 /**
  * @class BookmarkNode
  * @brief Individual node that is a part of the Bookmarks tree. Each node
@@ -52,6 +76,9 @@ class BookmarkNode : public TreeNode<BookmarkNode> , public sqlite::Row
     /// Returns the URL of the node if its type is bookmark, returns an empty QString otherwise
     const QUrl &getURL() const;
 
+    /// Returns the match key of the node's URL, which is computed when the URL is set
+    const URLMatchKey &getURLKey() const;
+
     /// Returns the icon associated with the node
     const QIcon &getIcon() const;
 
@@ -87,6 +114,9 @@ class BookmarkNode : public TreeNode<BookmarkNode> , public sqlite::Row
     /// URL associated with the node. Will be empty if the node type is Folder
     QUrl m_url;
 
+    /// Match key of the URL, used to look up the bookmark by URL
+    URLMatchKey m_urlKey;
+
     /// Icon associated with the node. For folders, will be standard folder icon. For bookmarks, will be favicon
     QIcon m_icon;
 
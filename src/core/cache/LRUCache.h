@@ -1,6 +1,8 @@
 #ifndef LRUCACHE_H
 #define LRUCACHE_H
 
+#include <cstdint>
+#include <functional>
 #include <list>
 #include <stdexcept>
 #include <unordered_map>
@@ -9,7 +11,7 @@
  * @class LRUCache
  * @brief An implementation of a fixed-capacity least recently used cache
  */
-template <typename KeyType, typename ValueType>
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>>
 class LRUCache
 {
     typedef typename std::pair<KeyType, ValueType> Node;
@@ -17,7 +19,7 @@ class LRUCache
 
 public:
     /// Constructs the LRU cache with a given maximum capacity
-    explicit LRUCache(size_t maxSize) : m_maxSize(maxSize), m_list(), m_map() {}
+    explicit LRUCache(size_t maxSize) : m_maxSize(maxSize), m_list(), m_map(), m_hitCount(0), m_missCount(0) {}
 
     /// Returns true if the cache contains an item associated with the given key, false if else
     bool has(const KeyType &key) const
@@ -39,6 +41,23 @@ class LRUCache
         return it->second->second;
     }
 
+    /// Returns a pointer to the value associated with the given key, moving it to the front of the cache,
+    /// or a nullptr if the key is not in the cache. Updates the hit and miss counters
+    const ValueType *find(const KeyType &key)
+    {
+        auto it = m_map.find(key);
+        if (it == m_map.end())
+        {
+            ++m_missCount;
+            return nullptr;
+        }
+
+        ++m_hitCount;
+        m_list.splice(m_list.begin(), m_list, it->second);
+
+        return &it->second->second;
+    }
+
     /// Places the key-value pair into the front of the cache
     void put(const KeyType &key, const ValueType &value)
     {
@@ -72,6 +91,46 @@ class LRUCache
         m_list.clear();
     }
 
+    /// Removes each key-value pair for which the predicate, called with the key and the value, returns true
+    template <typename Predicate>
+    void removeIf(Predicate predicate)
+    {
+        for (auto it = m_list.begin(); it != m_list.end();)
+        {
+            if (predicate(it->first, it->second))
+            {
+                m_map.erase(it->first);
+                it = m_list.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+
+    /// Returns the number of key-value pairs in the cache
+    size_t size() const
+    {
+        return m_list.size();
+    }
+
+    /// Returns the maximum number of key-value pairs in the cache
+    size_t capacity() const
+    {
+        return m_maxSize;
+    }
+
+    /// Returns the number of calls to find() that returned a value
+    uint64_t getHitCount() const
+    {
+        return m_hitCount;
+    }
+
+    /// Returns the number of calls to find() for a key that was not in the cache
+    uint64_t getMissCount() const
+    {
+        return m_missCount;
+    }
+
 private:
     /// The maximum number of key-value pairs in the cache
     size_t m_maxSize;
@@ -80,7 +139,13 @@ class LRUCache
     std::list<Node> m_list;
 
     /// A hashmap of keys pointing to corresponding key-value pair iterators in the list
-    std::unordered_map<KeyType, ListIterator> m_map;
+    std::unordered_map<KeyType, ListIterator, Hash> m_map;
+
+    /// Number of lookups that found a value in the cache
+    uint64_t m_hitCount;
+
+    /// Number of lookups that did not find a value in the cache
+    uint64_t m_missCount;
 };
 
 #endif // LRUCACHE_H
@@ -0,0 +1,164 @@
+#ifndef WEIGHTEDLRUCACHE_H
+#define WEIGHTEDLRUCACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+
+/**
+ * @class WeightedLRUCache
+ * @brief A least recently used cache whose capacity is a total weight, such as a number of bytes,
+ *        rather than a number of items. Each item is given a weight when it is placed into the cache
+ */
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>>
+class WeightedLRUCache
+{
+    struct Node
+    {
+        KeyType Key;
+        ValueType Value;
+        size_t Weight;
+    };
+
+    typedef typename std::list<Node>::iterator ListIterator;
+
+public:
+    /// Constructs the cache with a given maximum total weight
+    explicit WeightedLRUCache(size_t maxWeight) :
+        m_maxWeight(maxWeight),
+        m_weight(0),
+        m_list(),
+        m_map(),
+        m_hitCount(0),
+        m_missCount(0),
+        m_evictionCount(0)
+    {
+    }
+
+    /// Returns true if the cache contains an item associated with the given key, false if else
+    bool has(const KeyType &key) const
+    {
+        return m_map.find(key) != m_map.end();
+    }
+
+    /// Returns a pointer to the value associated with the given key, moving it to the front of the cache,
+    /// or a nullptr if the key is not in the cache. Updates the hit and miss counters
+    const ValueType *find(const KeyType &key)
+    {
+        auto it = m_map.find(key);
+        if (it == m_map.end())
+        {
+            ++m_missCount;
+            return nullptr;
+        }
+
+        ++m_hitCount;
+        m_list.splice(m_list.begin(), m_list, it->second);
+
+        return &it->second->Value;
+    }
+
+    /// Places the key-value pair with the given weight into the front of the cache, evicting the least recently
+    /// used items until the total weight is within the capacity. An item heavier than the capacity is not cached
+    void put(const KeyType &key, const ValueType &value, size_t weight)
+    {
+        remove(key);
+
+        if (weight > m_maxWeight)
+            return;
+
+        m_list.push_front(Node { key, value, weight });
+        m_map[key] = m_list.begin();
+        m_weight += weight;
+
+        while (m_weight > m_maxWeight)
+        {
+            const Node &lruNode = m_list.back();
+            m_weight -= lruNode.Weight;
+            m_map.erase(lruNode.Key);
+            m_list.pop_back();
+            ++m_evictionCount;
+        }
+    }
+
+    /// Removes the item associated with the given key, if it is in the cache
+    void remove(const KeyType &key)
+    {
+        auto it = m_map.find(key);
+        if (it == m_map.end())
+            return;
+
+        m_weight -= it->second->Weight;
+        m_list.erase(it->second);
+        m_map.erase(it);
+    }
+
+    /// Clears the cache
+    void clear()
+    {
+        m_map.clear();
+        m_list.clear();
+        m_weight = 0;
+    }
+
+    /// Returns the number of key-value pairs in the cache
+    size_t size() const
+    {
+        return m_list.size();
+    }
+
+    /// Returns the total weight of the items in the cache
+    size_t getWeight() const
+    {
+        return m_weight;
+    }
+
+    /// Returns the maximum total weight of the items in the cache
+    size_t capacity() const
+    {
+        return m_maxWeight;
+    }
+
+    /// Returns the number of calls to find() that returned a value
+    uint64_t getHitCount() const
+    {
+        return m_hitCount;
+    }
+
+    /// Returns the number of calls to find() for a key that was not in the cache
+    uint64_t getMissCount() const
+    {
+        return m_missCount;
+    }
+
+    /// Returns the number of items that were removed to keep the total weight within the capacity
+    uint64_t getEvictionCount() const
+    {
+        return m_evictionCount;
+    }
+
+private:
+    /// The maximum total weight of the items in the cache
+    size_t m_maxWeight;
+
+    /// The total weight of the items in the cache
+    size_t m_weight;
+
+    /// A doubly-linked list of key-value pairs and their weights, from the most to the least recently used
+    std::list<Node> m_list;
+
+    /// A hashmap of keys pointing to corresponding nodes in the list
+    std::unordered_map<KeyType, ListIterator, Hash> m_map;
+
+    /// Number of lookups that found a value in the cache
+    uint64_t m_hitCount;
+
+    /// Number of lookups that did not find a value in the cache
+    uint64_t m_missCount;
+
+    /// Number of items removed to stay within the capacity
+    uint64_t m_evictionCount;
+};
+
+#endif // WEIGHTEDLRUCACHE_H
@@ -6,7 +6,6 @@
 
 #include <chrono>
 #include <QByteArray>
-#include <QBuffer>
 #include <QFile>
 #include <QSet>
 #include <QJsonArray>
@@ -19,16 +18,11 @@ const QString FavoritePagesManager::Version = QStringLiteral("1.1");
 
 QString WebPageInformation::getThumbnailInBase64() const
 {
-    QString result = QLatin1String("data:image/png;base64, ");
-
-    QByteArray data;
-    QBuffer buffer(&data);
-    Thumbnail.save(&buffer, "PNG");
-
-    if (data.isEmpty())
+    if (Thumbnail.isEmpty())
         return QString();
 
-    result.append(data.toBase64());
+    QString result = QLatin1String("data:image/png;base64, ");
+    result.append(Thumbnail.toBase64());
     return result;
 }
 
@@ -108,7 +102,6 @@ void FavoritePagesManager::addFavorite(const QUrl &url, const QString &title)
     pageInfo.Position = static_cast<int>(m_favoritePages.size());
     pageInfo.URL = url;
     pageInfo.Title = title;
-    pageInfo.Thumbnail = m_thumbnailStore->getThumbnail(url);
 
     if (title.isEmpty())
     {
@@ -117,6 +110,7 @@ void FavoritePagesManager::addFavorite(const QUrl &url, const QString &title)
     }
 
     m_favoritePages.push_back(pageInfo);
+    loadThumbnail(url);
 }
 
 void FavoritePagesManager::removeEntry(const QUrl &url)
@@ -152,8 +146,9 @@ void FavoritePagesManager::timerEvent(QTimerEvent *event)
 
 bool FavoritePagesManager::isUrlHidden(const QUrl &url)
 {
-    auto it = std::find_if(m_excludedPages.begin(), m_excludedPages.end(), [url](const NewTabHiddenEntry &entry) {
-        return CommonUtil::doUrlsMatch(entry.URL, url, false);
+    const URLMatchKey urlKey(url, false);
+    auto it = std::find_if(m_excludedPages.begin(), m_excludedPages.end(), [&urlKey](const NewTabHiddenEntry &entry) {
+        return entry.Key == urlKey;
     });
 
     return it != m_excludedPages.end();
@@ -192,10 +187,10 @@ void FavoritePagesManager::loadFavorites()
         pageInfo.Position = currentPage.value(QLatin1String("position")).toInt();
         pageInfo.Title = currentPage.value(QLatin1String("title")).toString();
         pageInfo.URL = QUrl(currentPage.value(QLatin1String("url")).toString());
-        pageInfo.Thumbnail = m_thumbnailStore->getThumbnail(pageInfo.URL);
 
         m_favoritePages.push_back(pageInfo);
         favoritedUrls.insert(pageInfo.URL);
+        loadThumbnail(pageInfo.URL);
     }
 
     QJsonArray excludedArray = rootObject.value(QLatin1String("excludes")).toArray();
@@ -218,6 +213,7 @@ void FavoritePagesManager::loadFavorites()
 
             NewTabHiddenEntry entry;
             entry.URL = QUrl(pageInfo.value(QLatin1String("url")).toString());
+            entry.Key = URLMatchKey(entry.URL, false);
 
             if (favoritedUrls.contains(entry.URL))
                 continue;
@@ -249,12 +245,44 @@ void FavoritePagesManager::loadFromHistory()
                 it = m_mostVisitedPages.erase(it);
             else
             {
-                // Set position and get the thumbnail if we will keep this result
                 it->Position = itemPosition++;
-                it->Thumbnail = m_thumbnailStore->getThumbnail(it->URL);
                 ++it;
             }
         }
+
+        // Thumbnails are delivered later, on the thread of the thumbnail store
+        for (const WebPageInformation &pageInfo : m_mostVisitedPages)
+            loadThumbnail(pageInfo.URL);
+    });
+}
+
+void FavoritePagesManager::loadThumbnail(const QUrl &url)
+{
+    if (!m_thumbnailStore)
+        return;
+
+    m_thumbnailStore->getThumbnail(url, this, [this, url](const QByteArray &thumbnail){
+        if (thumbnail.isEmpty())
+            return;
+
+        const WebPageInformation *updatedPage = nullptr;
+        auto setThumbnail = [&](std::vector<WebPageInformation> &pageContainer) {
+            for (auto &pageInfo : pageContainer)
+            {
+                if (pageInfo.URL == url)
+                {
+                    pageInfo.Thumbnail = thumbnail;
+                    updatedPage = &pageInfo;
+                }
+            }
+        };
+
+        setThumbnail(m_favoritePages);
+        setThumbnail(m_mostVisitedPages);
+
+        // The new tab page may already be showing the page without its thumbnail
+        if (updatedPage != nullptr)
+            emit thumbnailLoaded(url, updatedPage->getThumbnailInBase64());
     });
 }
 
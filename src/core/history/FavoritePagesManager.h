@@ -1,10 +1,12 @@
 #ifndef FAVORITEPAGESMANAGER_H
 #define FAVORITEPAGESMANAGER_H
 
+#include "URLMatchKey.h"
+
 #include <vector>
 
+#include <QByteArray>
 #include <QDateTime>
-#include <QImage>
 #include <QMetaType>
 #include <QObject>
 #include <QString>
@@ -28,8 +30,8 @@ struct WebPageInformation
     /// URL of the page
     QUrl URL;
 
-    /// A small image of the web page
-    QImage Thumbnail;
+    /// A small PNG-encoded image of the web page
+    QByteArray Thumbnail;
 
     /// Returns the thumbnail as a base-64 encoded string
     QString getThumbnailInBase64() const;
@@ -41,14 +43,17 @@ struct NewTabHiddenEntry
     /// Url of the hidden entry
     QUrl URL;
 
+    /// Match key of the URL, used to check whether a page is hidden
+    URLMatchKey Key;
+
     /// Date and time when the entry expires from the list of hidden pages
     QDateTime ExpiresOn;
 
     /// Default constructor
-    NewTabHiddenEntry() : URL(), ExpiresOn() {}
+    NewTabHiddenEntry() : URL(), Key(), ExpiresOn() {}
 
     /// Constructs the entry with a URL and expiry time
-    NewTabHiddenEntry(const QUrl &url, QDateTime expiresOn) : URL(url), ExpiresOn(expiresOn) {}
+    NewTabHiddenEntry(const QUrl &url, QDateTime expiresOn) : URL(url), Key(url, false), ExpiresOn(expiresOn) {}
 };
 
 /**
@@ -74,6 +79,11 @@ class FavoritePagesManager : public QObject
     /// Returns true if the given URL is in the collection of favorite pages, false if it wasn't found
     bool isPresent(const QUrl &url) const;
 
+Q_SIGNALS:
+    /// Emitted when the thumbnail of a page has been loaded, after the page was returned by getFavorites() without it.
+    /// The thumbnail is given as a base-64 encoded data URL
+    void thumbnailLoaded(const QUrl &url, const QString &thumbnail);
+
 public Q_SLOTS:
     /// Returns a list of the user's favorite web pages. The QVariants in the list may be converted to \ref WebPageInformation
     QVariantList getFavorites() const;
@@ -102,6 +112,9 @@ public Q_SLOTS:
     /// Loads the user's most frequently visited web pages
     void loadFromHistory();
 
+    /// Requests the thumbnail of the web page with the given URL, setting it on the page once it has been loaded
+    void loadThumbnail(const QUrl &url);
+
     /// Saves the lists of favorite pages and excluded pages to disk
     void save();
 
@@ -0,0 +1,76 @@
+#include "Frecency.h"
+
+#include <algorithm>
+#include <cmath>
+
+/// Number of milliseconds in a day
+static const double MSecsPerDay = 86400000.0;
+
+const double Frecency::HalfLifeDays = 30.0;
+
+/// Returns the exponent contributed by a visit at the given time, which is its day divided by the half-life
+static double getExponent(const QDateTime &visitTime)
+{
+    return static_cast<double>(visitTime.toMSecsSinceEpoch()) / MSecsPerDay / Frecency::HalfLifeDays;
+}
+
+/// Returns log2(2^a + 2^b) without overflowing
+static double addExponents(double a, double b)
+{
+    const double maxExponent = std::max(a, b);
+    return maxExponent + std::log2(std::exp2(a - maxExponent) + std::exp2(b - maxExponent));
+}
+
+double Frecency::getEmptyKey()
+{
+    return 0.0;
+}
+
+double Frecency::addVisit(double key, int numVisits, const QDateTime &visitTime)
+{
+    if (!visitTime.isValid())
+        return key;
+
+    if (numVisits <= 0)
+        return getExponent(visitTime);
+
+    return addExponents(key, getExponent(visitTime));
+}
+
+double Frecency::combine(double keyA, int numVisitsA, double keyB, int numVisitsB)
+{
+    if (numVisitsA <= 0)
+        return numVisitsB > 0 ? keyB : getEmptyKey();
+
+    if (numVisitsB <= 0)
+        return keyA;
+
+    return addExponents(keyA, keyB);
+}
+
+double Frecency::getKey(const std::vector<QDateTime> &visits)
+{
+    std::vector<double> exponents;
+    exponents.reserve(visits.size());
+    for (const QDateTime &visit : visits)
+    {
+        if (visit.isValid())
+            exponents.push_back(getExponent(visit));
+    }
+
+    if (exponents.empty())
+        return getEmptyKey();
+
+    const double maxExponent = *std::max_element(exponents.begin(), exponents.end());
+
+    double sum = 0.0;
+    for (double exponent : exponents)
+        sum += std::exp2(exponent - maxExponent);
+
+    return maxExponent + std::log2(sum);
+}
+
+double Frecency::getScore(double key, const QDateTime &now)
+{
+    return std::exp2(key - getExponent(now));
+}
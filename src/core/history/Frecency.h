@@ -0,0 +1,44 @@
+#ifndef FRECENCY_H
+#define FRECENCY_H
+
+#include <vector>
+
+#include <QDateTime>
+
+/**
+ * @class Frecency
+ * @brief Computes the frecency of a history entry, which combines the number of visits made to the
+ *        entry with how recently each of them was made.
+ *
+ * Each visit is worth one point on the day it was made, and half as much every \ref HalfLifeDays after.
+ * Rather than the score itself, which changes as time passes, entries store the key
+ * log2(sum of 2^(visit day / half-life)) over all of their visits. The key never changes between visits,
+ * so it can be kept in the history database and indexed, and ordering entries by their key orders them
+ * by their current score.
+ */
+class Frecency
+{
+public:
+    Frecency() = default;
+
+    /// Returns the key of an entry that was never visited
+    static double getEmptyKey();
+
+    /// Returns the key of an entry after a visit at the given time, given its key and number of visits before the visit
+    static double addVisit(double key, int numVisits, const QDateTime &visitTime);
+
+    /// Returns the key of an entry that combines the visits of two entries, given their keys and numbers of visits
+    static double combine(double keyA, int numVisitsA, double keyB, int numVisitsB);
+
+    /// Computes and returns the key of an entry from all of its visits
+    static double getKey(const std::vector<QDateTime> &visits);
+
+    /// Returns the score of an entry with the given key at the given time, which is the number of its visits
+    /// as counted with their decay
+    static double getScore(double key, const QDateTime &now);
+
+    /// Number of days after which a visit is worth half as much
+    static const double HalfLifeDays;
+};
+
+#endif // FRECENCY_H
@@ -1,21 +1,39 @@
+#include "BookmarkManager.h"
+#include "BookmarkNode.h"
 #include "CommonUtil.h"
+#include "Frecency.h"
 #include "HistoryManager.h"
 #include "HistoryStore.h"
 #include "Settings.h"
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
 
 #include <QDateTime>
 #include <QUrl>
 
 #include <QDebug>
 
+/// Name of the history database worker in the task scheduler
+static const std::string HistoryStoreWorker = "HistoryStore";
+
+/// Time after a visit at which it is written to the history database, unless enough visits were queued to be written sooner
+static const std::chrono::milliseconds VisitFlushDelay { 5000 };
+
 HistoryManager::HistoryManager(const ViperServiceLocator &serviceLocator, DatabaseTaskScheduler &taskScheduler) :
     QObject(nullptr),
     m_taskScheduler(taskScheduler),
     m_historyItems(),
     m_recentItems(),
+    m_searchIndex(),
+    m_visitLog(),
+    m_visitLogStart(0),
+    m_numIndexedVisits(0),
+    m_pendingClears(),
+    m_clearGeneration(0),
+    m_visitLogMutex(),
+    m_bookmarkManager(nullptr),
     m_storagePolicy(HistoryStoragePolicy::Remember),
     m_historyStore(nullptr),
     m_lastVisitId(0)
@@ -31,15 +49,21 @@ HistoryManager::HistoryManager(const ViperServiceLocator &serviceLocator, Databa
     else
         qWarning() << "Could not fetch application settings in history manager!";
 
-    m_taskScheduler.onInit([this](){
-        m_historyStore = static_cast<HistoryStore*>(m_taskScheduler.getWorker("HistoryStore"));
+    m_bookmarkManager = serviceLocator.getServiceAs<BookmarkManager>("BookmarkManager");
+    if (m_bookmarkManager)
+        connect(m_bookmarkManager, &BookmarkManager::bookmarksChanged, this, &HistoryManager::onBookmarksChanged);
+
+    m_taskScheduler.onInit(HistoryStoreWorker, [this](){
+        m_historyStore = static_cast<HistoryStore*>(m_taskScheduler.getWorker(HistoryStoreWorker));
     });
 
-    m_taskScheduler.post([this](){
+    m_taskScheduler.post(HistoryStoreWorker, [this](){
         //onHistoryRecordsLoaded(m_historyStore->getEntries());
         onRecentItemsLoaded(m_historyStore->getRecentItems());
 
         m_lastVisitId = m_historyStore->getLastVisitId();
+
+        m_searchIndex.load(m_historyStore->getAllEntries());
     });
 }
 
@@ -62,7 +86,13 @@ void HistoryManager::clearAllHistory()
     m_recentItems.clear();
     m_historyItems.clear();
 
-    m_taskScheduler.post(&HistoryStore::clearAllHistory, std::ref(m_historyStore));
+    {
+        std::lock_guard<std::mutex> lock(m_visitLogMutex);
+        ++m_clearGeneration;
+        m_searchIndex.clear();
+    }
+
+    m_taskScheduler.post(HistoryStoreWorker, &HistoryStore::clearAllHistory, std::ref(m_historyStore));
 }
 
 void HistoryManager::clearHistoryFrom(const QDateTime &start)
@@ -72,12 +102,21 @@ void HistoryManager::clearHistoryFrom(const QDateTime &start)
 
 void HistoryManager::clearHistoryInRange(std::pair<QDateTime, QDateTime> range)
 {
-    m_taskScheduler.post([this, range](){
+    uint64_t clearGeneration = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_visitLogMutex);
+        m_pendingClears.push_back(m_numIndexedVisits);
+        clearGeneration = m_clearGeneration;
+    }
+
+    m_taskScheduler.post(HistoryStoreWorker, [this, range, clearGeneration](){
         m_recentItems.clear();
 
         m_historyStore->clearHistoryInRange(range);
 
         onRecentItemsLoaded(m_historyStore->getRecentItems());
+
+        reloadSearchIndex(m_historyStore->getAllEntries(), clearGeneration);
         emit historyCleared();
     });
 
@@ -103,6 +142,7 @@ void HistoryManager::clearHistoryInRange(std::pair<QDateTime, QDateTime> range)
         {
             record.m_historyEntry.NumVisits = static_cast<int>(visits.size());
             record.m_historyEntry.LastVisit = visits.at(visits.size() - 1);
+            record.m_historyEntry.Frecency = Frecency::getKey(visits);
         }
 
         ++it;
@@ -115,9 +155,13 @@ void HistoryManager::addVisit(const QUrl &url, const QString &title, const QDate
             || url.toString(QUrl::FullyEncoded).startsWith(QLatin1String("data:"), Qt::CaseInsensitive))
         return;
 
-    m_taskScheduler.post(&HistoryStore::addVisit, std::ref(m_historyStore), QUrl(url), QString(title),
+    m_taskScheduler.post(HistoryStoreWorker, &HistoryStore::addVisit, std::ref(m_historyStore), QUrl(url), QString(title),
                          QDateTime(visitTime), QUrl(requestedUrl), wasTypedByUser);
 
+    m_taskScheduler.postCoalesced(HistoryStoreWorker, "flushVisits", VisitFlushDelay, [this](){
+        m_historyStore->flushVisits();
+    });
+
     if (!CommonUtil::doUrlsMatch(requestedUrl, url))
     {
         QDateTime visit = visitTime.addSecs(-1);
@@ -146,6 +190,10 @@ void HistoryManager::addVisitToLocalStore(const QUrl &url, const QString &title,
         record.addVisit(visit);
 
         m_recentItems.push_front(record.m_historyEntry);
+
+        HistoryEntry indexEntry = record.m_historyEntry;
+        indexEntry.Title = title;
+        addVisitToSearchIndex(indexEntry, wasTypedByUser);
     }
     else
     {
@@ -156,30 +204,70 @@ void HistoryManager::addVisitToLocalStore(const QUrl &url, const QString &title,
         entry.Title = title;
         entry.URL = url;
         entry.URLTypedCount = wasTypedByUser ? 1 : 0;
+        entry.Frecency = Frecency::addVisit(Frecency::getEmptyKey(), 0, visitTime);
         std::vector<VisitEntry> visits {visit};
 
-        m_historyItems.insert(std::make_pair(url.toString().toUpper(), URLRecord(std::move(entry), std::move(visits))));
+        addVisitToSearchIndex(entry, wasTypedByUser);
         m_recentItems.push_front(entry);
+        m_historyItems.insert(std::make_pair(url.toString().toUpper(), URLRecord(std::move(entry), std::move(visits))));
+    }
+}
+
+void HistoryManager::addVisitToSearchIndex(const HistoryEntry &entry, bool wasTypedByUser)
+{
+    std::lock_guard<std::mutex> lock(m_visitLogMutex);
+
+    m_searchIndex.addVisit(entry, wasTypedByUser);
+    ++m_numIndexedVisits;
+
+    if (m_pendingClears.empty())
+        m_visitLogStart = m_numIndexedVisits;
+    else
+        m_visitLog.push_back(IndexedVisit { entry, wasTypedByUser });
+}
+
+void HistoryManager::reloadSearchIndex(std::vector<HistoryEntry> &&entries, uint64_t clearGeneration)
+{
+    std::lock_guard<std::mutex> lock(m_visitLogMutex);
+
+    const uint64_t clearStart = m_pendingClears.front();
+    m_pendingClears.pop_front();
+
+    // The index was emptied when all history was cleared, after this clear was requested
+    if (clearGeneration == m_clearGeneration)
+    {
+        m_searchIndex.reload(std::move(entries));
+
+        for (auto it = m_visitLog.begin() + static_cast<std::ptrdiff_t>(clearStart - m_visitLogStart); it != m_visitLog.end(); ++it)
+            m_searchIndex.addVisit(it->Entry, it->WasTypedByUser);
+    }
+
+    // Only the visits made since the next pending clear was requested need to be applied again
+    const uint64_t nextClearStart = m_pendingClears.empty() ? m_numIndexedVisits : m_pendingClears.front();
+    while (m_visitLogStart < nextClearStart)
+    {
+        m_visitLog.pop_front();
+        ++m_visitLogStart;
     }
 }
 
 void HistoryManager::getHistoryBetween(const QDateTime &startDate, const QDateTime &endDate, std::function<void(std::vector<URLRecord>)> callback)
 {
-    m_taskScheduler.post([this, startDate, endDate, callback](){
+    m_taskScheduler.post(HistoryStoreWorker, [this, startDate, endDate, callback](){
         callback(m_historyStore->getHistoryBetween(startDate, endDate));
     });
 }
 
 void HistoryManager::getHistoryFrom(const QDateTime &startDate, std::function<void(std::vector<URLRecord>)> callback)
 {
-    m_taskScheduler.post([this, startDate, callback](){
+    m_taskScheduler.post(HistoryStoreWorker, [this, startDate, callback](){
         callback(m_historyStore->getHistoryFrom(startDate));
     });
 }
 
 void HistoryManager::contains(const QUrl &url, std::function<void(bool)> callback)
 {
-    m_taskScheduler.post([this, url, callback](){
+    m_taskScheduler.post(HistoryStoreWorker, [this, url, callback](){
         callback(m_historyStore->contains(url));
     });
 }
@@ -195,9 +283,17 @@ HistoryEntry HistoryManager::getEntry(const QUrl &url) const
     return result;
 }
 
+VisitQueueStats HistoryManager::getVisitQueueStats() const
+{
+    if (m_historyStore == nullptr)
+        return VisitQueueStats { 0, 0, 0 };
+
+    return m_historyStore->getVisitQueueStats();
+}
+
 void HistoryManager::getTimesVisitedHost(const QUrl &host, std::function<void(int)> callback)
 {
-    m_taskScheduler.post([this, host, callback](){
+    m_taskScheduler.post(HistoryStoreWorker, [this, host, callback](){
         callback(m_historyStore->getTimesVisitedHost(host));
     });
 }
@@ -221,6 +317,18 @@ void HistoryManager::onSettingChanged(BrowserSetting setting, const QVariant &va
         setStoragePolicy(static_cast<HistoryStoragePolicy>(value.toInt()));
 }
 
+void HistoryManager::onBookmarksChanged()
+{
+    QSet<QString> bookmarkedUrls;
+    for (const BookmarkNode *node : *m_bookmarkManager)
+    {
+        if (node->getType() == BookmarkNode::Bookmark)
+            bookmarkedUrls.insert(node->getURL().toString().toUpper());
+    }
+
+    m_searchIndex.setBookmarkedUrls(bookmarkedUrls);
+}
+
 void HistoryManager::onRecentItemsLoaded(std::deque<HistoryEntry> &&entries)
 {
     m_recentItems = std::move(entries);
@@ -238,21 +346,21 @@ void HistoryManager::onHistoryRecordsLoaded(std::vector<URLRecord> &&records)
 
 void HistoryManager::loadMostVisitedEntries(int limit, std::function<void(std::vector<WebPageInformation>)> callback)
 {
-    m_taskScheduler.post([this, limit, callback](){
+    m_taskScheduler.post(HistoryStoreWorker, [this, limit, callback](){
         callback(m_historyStore->loadMostVisitedEntries(limit));
     });
 }
 
 void HistoryManager::loadWordDatabase(std::function<void(std::map<int, QString>)> callback)
 {
-    m_taskScheduler.post([this, callback](){
+    m_taskScheduler.post(HistoryStoreWorker, [this, callback](){
         callback(m_historyStore->getWords());
     });
 }
 
 void HistoryManager::loadHistoryWordMapping(std::function<void(std::map<int, std::vector<int>>)> callback)
 {
-    m_taskScheduler.post([this, callback](){
+    m_taskScheduler.post(HistoryStoreWorker, [this, callback](){
         callback(m_historyStore->getEntryWordMapping());
     });
 }
@@ -8,6 +8,7 @@
 #include "ServiceLocator.h"
 #include "ISettingsObserver.h"
 #include "URLRecord.h"
+#include "URLSearchIndex.h"
 
 #include <QDateTime>
 #include <QHash>
@@ -16,11 +17,15 @@
 #include <QMetaType>
 #include <QUrl>
 
+#include <cstdint>
 #include <deque>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
+class BookmarkManager;
 class HistoryStore;
+struct VisitQueueStats;
 
 /// Available policies for storage of browsing history data
 enum class HistoryStoragePolicy
@@ -66,7 +71,8 @@ class HistoryManager : public QObject, public ISettingsObserver
     /// Clears history within the given {start,end} date-time pair
     void clearHistoryInRange(std::pair<QDateTime, QDateTime> range);
 
-    /// Adds an entry to the history data store, given the URL, page title, time of visit, and the requested URL
+    /// Adds an entry to the history data store, given the URL, page title, time of visit, and the requested URL.
+    /// Visits are written to the database in batches, which are flushed at the latest when the task scheduler stops
     void addVisit(const QUrl &url, const QString &title, const QDateTime &visitTime, const QUrl &requestedUrl, bool wasTypedByUser);
 
     /// Loads a list of all \ref URLRecord visited between the given start date and end dates, passing them on to
@@ -88,6 +94,12 @@ class HistoryManager : public QObject, public ISettingsObserver
     /// Returns a queue of recently visited items, with the most recent visits being at the front of the queue
     const std::deque<HistoryEntry> &getRecentItems() const { return m_recentItems; }
 
+    /// Returns the full-text index of the browsing history, which is used to suggest URLs as the user types
+    const URLSearchIndex &getSearchIndex() const { return m_searchIndex; }
+
+    /// Returns the counters of visits queued for, and written to, the history database
+    VisitQueueStats getVisitQueueStats() const;
+
     /// Fetches the number of times the host was visited, passing it to the given callback when the
     /// result has been retrieved
     void getTimesVisitedHost(const QUrl &host, std::function<void(int)> callback);
@@ -120,10 +132,31 @@ private Q_SLOTS:
     /// Listens for any settings changes that affect the history manager
     void onSettingChanged(BrowserSetting setting, const QVariant &value) override;
 
+    /// Updates the bookmark flags of the search index after a change to the bookmark collection
+    void onBookmarksChanged();
+
 private:
+    /// A visit recorded in the search index while a range of the history is being cleared
+    struct IndexedVisit
+    {
+        /// History entry of the visited URL
+        HistoryEntry Entry;
+
+        /// True if the URL was typed by the user
+        bool WasTypedByUser;
+    };
+
     /// Adds the history visit to the in-memory history store.
     void addVisitToLocalStore(const QUrl &url, const QString &title, const QDateTime &visitTime, bool wasTypedByUser);
 
+    /// Records the visit in the search index, keeping it in the visit log while a range of the history is being cleared
+    void addVisitToSearchIndex(const HistoryEntry &entry, bool wasTypedByUser);
+
+    /// Replaces the search index with the given entries, which were read from the history database once the oldest
+    /// pending range of the history was cleared, and applies the visits made since that clear was requested.
+    /// Called from the history database worker
+    void reloadSearchIndex(std::vector<HistoryEntry> &&entries, uint64_t clearGeneration);
+
     /// Handles the recent history record load event - called during instantiation of the \ref HistoryStore
     void onRecentItemsLoaded(std::deque<HistoryEntry> &&entries);
 
@@ -140,6 +173,32 @@ private Q_SLOTS:
     /// Queue of recently visited items
     std::deque<HistoryEntry> m_recentItems;
 
+    /// Full-text index of the browsing history
+    URLSearchIndex m_searchIndex;
+
+    /// Visits recorded in the search index since the oldest pending range clear was requested. Their history
+    /// database writes are queued after the clear, so they are missing from the entries that the index is reloaded with
+    std::deque<IndexedVisit> m_visitLog;
+
+    /// Number of visits recorded in the search index before the first visit in \ref m_visitLog
+    uint64_t m_visitLogStart;
+
+    /// Number of visits recorded in the search index
+    uint64_t m_numIndexedVisits;
+
+    /// Number of visits that had been recorded in the search index when each pending range clear was requested,
+    /// from the oldest to the newest
+    std::deque<uint64_t> m_pendingClears;
+
+    /// Incremented when all history is cleared, so that range clears requested before then do not reload the index
+    uint64_t m_clearGeneration;
+
+    /// Guards the visit log and the pending range clears, which are used on the UI thread and by the history database worker
+    std::mutex m_visitLogMutex;
+
+    /// Bookmark manager, used to determine which entries of the search index are bookmarked
+    BookmarkManager *m_bookmarkManager;
+
     /// History storage policy
     HistoryStoragePolicy m_storagePolicy;
 
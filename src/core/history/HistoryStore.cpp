@@ -1,25 +1,41 @@
 #include "CommonUtil.h"
+#include "Frecency.h"
 #include "HistoryStore.h"
 
+#include <algorithm>
+#include <limits>
+
 #include <QDateTime>
+#include <QSet>
 #include <QUrl>
 #include <QDebug>
 
+const std::size_t HistoryStore::MaxPendingVisits = 32;
+
 HistoryStore::HistoryStore(const QString &databaseFile) :
     DatabaseWorker(databaseFile),
     m_lastVisitID(0),
-    m_statements()
+    m_statements(),
+    m_pendingVisits(),
+    m_numQueuedVisits(0),
+    m_numFlushedVisits(0),
+    m_numFlushes(0)
 {
     m_database.execute("PRAGMA foreign_keys=\"0\"");
 }
 
 HistoryStore::~HistoryStore()
 {
+    flushVisits();
+
     m_statements.clear();
 }
 
 void HistoryStore::clearAllHistory()
 {
+    // Visits still waiting to be written were made before the history was cleared
+    m_pendingVisits.clear();
+
     if (!exec(QLatin1String("DELETE FROM URLWords")))
         qWarning() << "In HistoryStore::clearAllHistory - Unable to clear History Word Mapping table.";
 
@@ -35,35 +51,37 @@ void HistoryStore::clearAllHistory()
 
 void HistoryStore::clearHistoryFrom(const QDateTime &start)
 {
-    auto stmt = m_database.prepare(R"(DELETE FROM Visits WHERE Date >= ?)");
-    stmt << start;
-    if (!stmt.execute())
-        qWarning() << "In HistoryStore::clearHistoryFrom - Unable to clear history.";
+    flushVisits();
 
-    if (!m_database.execute("DELETE FROM History WHERE VisitID NOT IN (SELECT DISTINCT VisitID FROM Visits)"))
+    if (!removeVisits(start.toMSecsSinceEpoch(), std::numeric_limits<qint64>::max()))
         qWarning() << "In HistoryStore::clearHistoryFrom - Unable to clear history.";
 }
 
 void HistoryStore::clearHistoryInRange(std::pair<QDateTime, QDateTime> range)
 {
-    auto stmt = m_database.prepare(R"(DELETE FROM Visits WHERE Date >= ? AND Date <= ?)");
-    stmt << range.first
-         << range.second;
-    if (!stmt.execute())
-        qWarning() << "In HistoryStore::clearHistoryInRange - Unable to clear history.";
+    flushVisits();
 
-    if (!m_database.execute("DELETE FROM History WHERE VisitID NOT IN (SELECT DISTINCT VisitID FROM Visits)"))
-        qWarning() << "In HistoryStore::clearHistoryInRange - Unable to clear history. ";
+    if (!removeVisits(range.first.toMSecsSinceEpoch(), range.second.toMSecsSinceEpoch()))
+        qWarning() << "In HistoryStore::clearHistoryInRange - Unable to clear history.";
 }
 
-bool HistoryStore::contains(const QUrl &url) const
+bool HistoryStore::contains(const QUrl &url)
 {
+    flushVisits();
+
     auto stmt = m_database.prepare(R"(SELECT VisitID FROM History WHERE URL = ?)");
     stmt << url;
     return stmt.next();
 }
 
 HistoryEntry HistoryStore::getEntry(const QUrl &url)
+{
+    flushVisits();
+
+    return findEntry(url);
+}
+
+HistoryEntry HistoryStore::findEntry(const QUrl &url)
 {
     HistoryEntry result;
     result.URL = url;
@@ -80,6 +98,8 @@ HistoryEntry HistoryStore::getEntry(const QUrl &url)
 
 std::vector<VisitEntry> HistoryStore::getVisits(const HistoryEntry &record)
 {
+    flushVisits();
+
     std::vector<VisitEntry> result;
 
     auto stmt = m_database.prepare(R"(SELECT Date FROM Visits WHERE VisitID = ? ORDER BY Date ASC)");
@@ -96,10 +116,12 @@ std::vector<VisitEntry> HistoryStore::getVisits(const HistoryEntry &record)
 
 std::deque<HistoryEntry> HistoryStore::getRecentItems()
 {
+    flushVisits();
+
     std::deque<HistoryEntry> result;
 
     auto stmt = m_database.prepare(R"(SELECT Visits.VisitID, History.URL, History.Title,
-     History.URLTypedCount, 1, Visits.Date FROM Visits
+     History.URLTypedCount, 1, Visits.Date, History.Frecency FROM Visits
      INNER JOIN History ON Visits.VisitID = History.VisitID
      ORDER BY Visits.Date DESC LIMIT 15;)");
 
@@ -113,13 +135,34 @@ std::deque<HistoryEntry> HistoryStore::getRecentItems()
     return result;
 }
 
-std::vector<URLRecord> HistoryStore::getHistoryFrom(const QDateTime &startDate) const
+std::vector<HistoryEntry> HistoryStore::getAllEntries()
+{
+    flushVisits();
+
+    std::vector<HistoryEntry> result;
+
+    auto stmt = m_database.prepare(R"(SELECT VisitID, URL, Title, URLTypedCount, VisitCount, LastVisit, Frecency
+                                   FROM History WHERE VisitCount > 0)");
+
+    while (stmt.next())
+    {
+        HistoryEntry entry;
+        stmt >> entry;
+        result.push_back(std::move(entry));
+    }
+
+    return result;
+}
+
+std::vector<URLRecord> HistoryStore::getHistoryFrom(const QDateTime &startDate)
 {
     return getHistoryBetween(startDate, QDateTime::currentDateTime());
 }
 
-std::vector<URLRecord> HistoryStore::getHistoryBetween(const QDateTime &startDate, const QDateTime &endDate) const
+std::vector<URLRecord> HistoryStore::getHistoryBetween(const QDateTime &startDate, const QDateTime &endDate)
 {
+    flushVisits();
+
     std::vector<URLRecord> result;
 
     if (!startDate.isValid() || !endDate.isValid())
@@ -127,7 +170,7 @@ std::vector<URLRecord> HistoryStore::getHistoryBetween(const QDateTime &startDat
 
     auto queryVisitIds = m_database.prepare(R"(SELECT DISTINCT VisitID FROM Visits WHERE Date >= ? AND Date <= ?
                                             ORDER BY Date ASC)");
-    auto queryHistoryItem = m_database.prepare(R"(SELECT URL, Title, URLTypedCount FROM History WHERE VisitID = ?)");
+    auto queryHistoryItem = m_database.prepare(R"(SELECT URL, Title, URLTypedCount, Frecency FROM History WHERE VisitID = ?)");
     auto queryVisitDates = m_database.prepare(R"(SELECT Date FROM Visits WHERE VisitID = ?
                                               AND Date >= ? AND Date <= ? ORDER BY Date ASC)");
 
@@ -147,7 +190,8 @@ std::vector<URLRecord> HistoryStore::getHistoryBetween(const QDateTime &startDat
         entry.VisitID = visitId;
         queryHistoryItem >> entry.URL
                          >> entry.Title
-                         >> entry.URLTypedCount;
+                         >> entry.URLTypedCount
+                         >> entry.Frecency;
 
         std::vector<VisitEntry> visits;
         queryVisitDates.reset();
@@ -169,11 +213,11 @@ std::vector<URLRecord> HistoryStore::getHistoryBetween(const QDateTime &startDat
     return result;
 }
 
-int HistoryStore::getTimesVisitedHost(const QUrl &url) const
+int HistoryStore::getTimesVisitedHost(const QUrl &url)
 {
-    auto query = m_database.prepare(R"(SELECT COUNT(NumVisits) FROM (SELECT VisitID, COUNT(VisitID) AS NumVisits
-                                    FROM Visits INDEXED BY Visit_ID_Index GROUP BY VisitID ) WHERE VisitID IN (SELECT VisitID FROM History
-                                    WHERE URL LIKE ?))");
+    flushVisits();
+
+    auto query = m_database.prepare(R"(SELECT COUNT(VisitID) FROM History WHERE VisitCount > 0 AND URL LIKE ?)");
     std::string param = QString("%%1%").arg(url.host().remove(QRegularExpression("^www\\.")).toLower()).toStdString();
     query << param;
     if (query.next())
@@ -186,27 +230,26 @@ int HistoryStore::getTimesVisitedHost(const QUrl &url) const
     return 0;
 }
 
-int HistoryStore::getTimesVisited(const QUrl &url) const
+int HistoryStore::getTimesVisited(const QUrl &url)
 {
-    auto query = m_database.prepare(R"(SELECT h.VisitID, v.NumVisits FROM History AS h
-                                    INNER JOIN (SELECT VisitID, COUNT(VisitID) AS NumVisits
-                                    FROM Visits INDEXED BY Visit_ID_Index GROUP BY VisitID) AS v
-                                    ON h.VisitID = v.VisitID WHERE h.URL = ?)");
+    flushVisits();
+
+    auto query = m_database.prepare(R"(SELECT VisitCount FROM History WHERE URL = ?)");
     query << url;
     if (query.next())
     {
-        int visitId = 0,
-            numVisits = 0;
-        query >> visitId
-              >> numVisits;
+        int numVisits = 0;
+        query >> numVisits;
         return numVisits;
     }
 
     return 0;
 }
 
-std::map<int, QString> HistoryStore::getWords() const
+std::map<int, QString> HistoryStore::getWords()
 {
+    flushVisits();
+
     std::map<int, QString> result;
 
     auto stmt = m_database.prepare(R"(SELECT WordID, Word FROM Words ORDER BY WordID ASC)");
@@ -226,8 +269,10 @@ std::map<int, QString> HistoryStore::getWords() const
     return result;
 }
 
-std::map<int, std::vector<int>> HistoryStore::getEntryWordMapping() const
+std::map<int, std::vector<int>> HistoryStore::getEntryWordMapping()
 {
+    flushVisits();
+
     std::map<int, std::vector<int>> result;
 
     auto queryDistinctHistoryId = m_database.prepare(R"(SELECT DISTINCT(HistoryID) FROM URLWords ORDER BY HistoryID ASC)");
@@ -262,59 +307,124 @@ void HistoryStore::addVisit(const QUrl &url, const QString &title, const QDateTi
     if (url.toString(QUrl::FullyEncoded).startsWith(QStringLiteral("data:")))
         return;
 
-    auto existingEntry = getEntry(url);
+    const std::size_t numPendingVisits = m_pendingVisits.size();
+    m_pendingVisits.push_back(PendingVisit { url, title, visitTime, wasTypedByUser });
+
+    if (!CommonUtil::doUrlsMatch(url, requestedUrl, true))
+    {
+        QDateTime requestDateTime = visitTime.addMSecs(-100);
+        if (!requestDateTime.isValid())
+            requestDateTime = visitTime;
+
+        m_pendingVisits.push_back(PendingVisit { requestedUrl, title, requestDateTime, wasTypedByUser });
+    }
+
+    m_numQueuedVisits += static_cast<uint64_t>(m_pendingVisits.size() - numPendingVisits);
+
+    if (m_pendingVisits.size() >= MaxPendingVisits)
+        flushVisits();
+}
+
+void HistoryStore::flushVisits()
+{
+    if (m_pendingVisits.empty())
+        return;
+
+    if (!m_database.beginTransaction())
+    {
+        qWarning() << "HistoryStore::flushVisits - could not start transaction";
+        return;
+    }
+
+    // Words are collected for the whole batch, so that each word of a page is only saved once
+    std::map<int, QSet<QString>> wordsByEntry;
+    for (const PendingVisit &visit : m_pendingVisits)
+        saveVisit(visit, wordsByEntry);
+
+    saveWords(wordsByEntry);
+
+    if (!m_database.commitTransaction())
+    {
+        qWarning() << "HistoryStore::flushVisits - could not commit transaction. Message: "
+                   << QString::fromStdString(m_database.getLastError());
+        m_database.rollbackTransaction();
+        return;
+    }
+
+    m_numFlushedVisits += static_cast<uint64_t>(m_pendingVisits.size());
+    ++m_numFlushes;
+
+    m_pendingVisits.clear();
+}
+
+VisitQueueStats HistoryStore::getVisitQueueStats() const
+{
+    return VisitQueueStats { m_numQueuedVisits.load(), m_numFlushedVisits.load(), m_numFlushes.load() };
+}
+
+void HistoryStore::saveVisit(const PendingVisit &visit, std::map<int, QSet<QString>> &wordsByEntry)
+{
+    auto existingEntry = findEntry(visit.URL);
     qulonglong visitId = existingEntry.VisitID >= 0 ? static_cast<qulonglong>(existingEntry.VisitID) : ++m_lastVisitID;
     if (existingEntry.VisitID >= 0)
     {
-        if (wasTypedByUser)
+        if (visit.WasTypedByUser)
             existingEntry.URLTypedCount++;
 
-        existingEntry.Title = title;
+        existingEntry.Title = visit.Title;
 
         sqlite::PreparedStatement &stmtUpdate = m_statements.at(Statement::UpdateHistoryRecord);
         stmtUpdate.reset();
-        stmtUpdate << existingEntry;
+        stmtUpdate << existingEntry.Title
+                   << existingEntry.URLTypedCount
+                   << existingEntry.VisitID;
 
         if (!stmtUpdate.execute())
-            qWarning() << "HistoryStore::addVisit - could not save entry to database.";
+            qWarning() << "HistoryStore::saveVisit - could not save entry to database.";
 
-        tokenizeAndSaveUrl(static_cast<int>(visitId), url, title);
+        tokenizeUrl(visit.URL, visit.Title, wordsByEntry[static_cast<int>(visitId)]);
     }
     else
     {
-        const int urlTypedCount = wasTypedByUser ? 1 : 0;
+        const int urlTypedCount = visit.WasTypedByUser ? 1 : 0;
 
         sqlite::PreparedStatement &stmtNew = m_statements.at(Statement::CreateHistoryRecord);
         stmtNew.reset();
 
         stmtNew << visitId
-                << url
-                << title
+                << visit.URL
+                << visit.Title
                 << urlTypedCount;
 
         if (stmtNew.execute())
-            tokenizeAndSaveUrl(static_cast<int>(visitId), url, title);
+            tokenizeUrl(visit.URL, visit.Title, wordsByEntry[static_cast<int>(visitId)]);
         else
-            qWarning() << "HistoryStore::addVisit - could not save entry to database.";
+            qWarning() << "HistoryStore::saveVisit - could not save entry to database.";
     }
 
     sqlite::PreparedStatement &stmtVisit = m_statements.at(Statement::CreateVisitRecord);
     stmtVisit.reset();
 
     stmtVisit << visitId
-              << visitTime;
-
-    if (!stmtVisit.execute())
-        qWarning() << "HistoryStore::addVisit - could not save visit to database.";
+              << visit.VisitTime;
 
-    if (!CommonUtil::doUrlsMatch(url, requestedUrl, true))
+    if (stmtVisit.execute())
     {
-        QDateTime requestDateTime = visitTime.addMSecs(-100);
-        if (!requestDateTime.isValid())
-            requestDateTime = visitTime;
+        const int numVisits = existingEntry.VisitID >= 0 ? existingEntry.NumVisits : 0;
+        const double frecency = Frecency::addVisit(existingEntry.Frecency, numVisits, visit.VisitTime);
 
-        addVisit(requestedUrl, title, requestDateTime, requestedUrl, wasTypedByUser);
+        sqlite::PreparedStatement &stmtAggregates = m_statements.at(Statement::AddVisitToAggregates);
+        stmtAggregates.reset();
+
+        stmtAggregates << visit.VisitTime
+                       << frecency
+                       << visitId;
+
+        if (!stmtAggregates.execute())
+            qWarning() << "HistoryStore::saveVisit - could not update visit count of entry.";
     }
+    else
+        qWarning() << "HistoryStore::saveVisit - could not save visit to database.";
 }
 
 uint64_t HistoryStore::getLastVisitId() const
@@ -322,27 +432,44 @@ uint64_t HistoryStore::getLastVisitId() const
     return m_lastVisitID;
 }
 
-void HistoryStore::tokenizeAndSaveUrl(int visitId, const QUrl &url, const QString &title)
+void HistoryStore::tokenizeUrl(const QUrl &url, const QString &title, QSet<QString> &words)
 {
-    QStringList urlWords = CommonUtil::tokenizePossibleUrl(url.toString().toUpper());
+    const QStringList urlWords = CommonUtil::tokenizePossibleUrl(url.toString().toUpper());
+    for (const QString &word : urlWords)
+        words.insert(word);
 
     if (!title.startsWith(QLatin1String("http"), Qt::CaseInsensitive))
-        urlWords = urlWords + title.toUpper().split(QLatin1Char(' '), QStringSplitFlag::SkipEmptyParts);
+    {
+        const QStringList titleWords = title.toUpper().split(QLatin1Char(' '), QStringSplitFlag::SkipEmptyParts);
+        for (const QString &word : titleWords)
+            words.insert(word);
+    }
+}
 
+void HistoryStore::saveWords(const std::map<int, QSet<QString>> &wordsByEntry)
+{
     sqlite::PreparedStatement &stmtInsertWord = m_statements.at(Statement::CreateWordRecord);
     sqlite::PreparedStatement &stmtAssociateWord = m_statements.at(Statement::CreateUrlWordRecord);
 
-    for (const QString &word : qAsConst(urlWords))
+    QSet<QString> savedWords;
+    for (const auto &it : wordsByEntry)
     {
-        stmtInsertWord.reset();
-        stmtAssociateWord.reset();
-
-        stmtInsertWord << word;
-        stmtInsertWord.execute();
-
-        stmtAssociateWord << visitId
-                          << word;
-        stmtAssociateWord.execute();
+        for (const QString &word : it.second)
+        {
+            if (!savedWords.contains(word))
+            {
+                stmtInsertWord.reset();
+                stmtInsertWord << word;
+                stmtInsertWord.execute();
+
+                savedWords.insert(word);
+            }
+
+            stmtAssociateWord.reset();
+            stmtAssociateWord << it.first
+                              << word;
+            stmtAssociateWord.execute();
+        }
     }
 }
 
@@ -355,7 +482,7 @@ bool HistoryStore::hasProperStructure()
 void HistoryStore::setup()
 {
     if (!exec(QLatin1String("CREATE TABLE IF NOT EXISTS History(VisitID INTEGER PRIMARY KEY AUTOINCREMENT, URL TEXT UNIQUE NOT NULL, Title TEXT, "
-                                  "URLTypedCount INTEGER DEFAULT 0)")))
+                                  "URLTypedCount INTEGER DEFAULT 0, VisitCount INTEGER DEFAULT 0, LastVisit INTEGER DEFAULT 0, Frecency REAL DEFAULT 0)")))
     {
         qWarning() << "In HistoryStore::setup - unable to create history table.";
     }
@@ -381,8 +508,8 @@ void HistoryStore::setup()
 
 void HistoryStore::load()
 {
-    purgeOldEntries();
     checkForUpdate();
+    purgeOldEntries();
 
     if (!exec(QLatin1String("CREATE INDEX IF NOT EXISTS Visit_ID_Index ON Visits(VisitID)")))
         qWarning() << "In HistoryStore::load - unable to create index on the visit ID column of the visit table.";
@@ -393,22 +520,21 @@ void HistoryStore::load()
     if (!exec(QLatin1String("CREATE INDEX IF NOT EXISTS Word_Index ON Words(Word)")))
         qWarning() << "In HistoryStore::load - unable to create index on the word column of the words table.";
 
+    if (!exec(QLatin1String("CREATE INDEX IF NOT EXISTS History_Frecency_Index ON History(Frecency)")))
+        qWarning() << "In HistoryStore::load - unable to create index on the frecency column of the history table.";
+
     // Create and cache our prepared statements
     auto cacheStatement = [this](Statement statement, const std::string &sql) {
         m_statements.insert(std::make_pair(statement, m_database.prepare(sql)));
     };
 
     cacheStatement(Statement::CreateHistoryRecord, R"(INSERT INTO History(VisitID, URL, Title, URLTypedCount) VALUES(?, ?, ?, ?))");
-    cacheStatement(Statement::UpdateHistoryRecord, R"(INSERT OR REPLACE INTO History(VisitID, URL, Title, URLTypedCount) VALUES(?, ?, ?, ?))");
+    cacheStatement(Statement::UpdateHistoryRecord, R"(UPDATE History SET Title = ?, URLTypedCount = ? WHERE VisitID = ?)");
     cacheStatement(Statement::CreateVisitRecord, R"(INSERT INTO Visits(VisitID, Date) VALUES (?, ?))");
+    cacheStatement(Statement::AddVisitToAggregates, R"(UPDATE History SET VisitCount = VisitCount + 1, LastVisit = MAX(LastVisit, ?), Frecency = ? WHERE VisitID = ?)");
     cacheStatement(Statement::CreateWordRecord, R"(INSERT OR IGNORE INTO Words(Word) VALUES (?))");
     cacheStatement(Statement::CreateUrlWordRecord, R"(INSERT OR IGNORE INTO URLWords(HistoryID, WordID) VALUES (?, (SELECT WordID FROM Words WHERE Word = ?)))");
-    cacheStatement(Statement::GetHistoryRecord, "SELECT History.VisitID, History.URL, History.Title, History.URLTypedCount, V.NumVisits, "
-                                                " V.RecentVisit FROM History INNER JOIN"
-                                                " (SELECT VisitID, MAX(Date) AS RecentVisit, COUNT(Date) AS NumVisits "
-                                                " FROM Visits INDEXED BY Visit_ID_Index GROUP BY VisitID) AS V"
-                                                " ON History.VisitID = V.VisitID "
-                                                " WHERE History.URL = ?");
+    cacheStatement(Statement::GetHistoryRecord, R"(SELECT VisitID, URL, Title, URLTypedCount, VisitCount, LastVisit, Frecency FROM History WHERE URL = ?)");
 
     auto stmt = m_database.prepare(R"(SELECT MAX(VisitID) FROM History)");
     if (stmt.next())
@@ -422,8 +548,9 @@ void HistoryStore::checkForUpdate()
     if (!stmt.execute())
         return;
 
-    bool hasUrlTypeCountColumn = false;
+    bool hasUrlTypeCountColumn = false, hasVisitCountColumn = false;
     const QString urlTypeCountColumn("URLTypedCount");
+    const QString visitCountColumn("VisitCount");
 
     while (stmt.next())
     {
@@ -434,10 +561,9 @@ void HistoryStore::checkForUpdate()
              >> colName;
 
         if (colName.compare(urlTypeCountColumn) == 0)
-        {
             hasUrlTypeCountColumn = true;
-            break;
-        }
+        else if (colName.compare(visitCountColumn) == 0)
+            hasVisitCountColumn = true;
     }
 
     if (!hasUrlTypeCountColumn)
@@ -445,6 +571,38 @@ void HistoryStore::checkForUpdate()
         if (!exec(QLatin1String("ALTER TABLE History ADD URLTypedCount INTEGER DEFAULT 0")))
             qDebug() << "Error updating history table with url typed count column";
     }
+
+    if (!hasVisitCountColumn)
+    {
+        if (!exec(QLatin1String("ALTER TABLE History ADD VisitCount INTEGER DEFAULT 0"))
+                || !exec(QLatin1String("ALTER TABLE History ADD LastVisit INTEGER DEFAULT 0"))
+                || !exec(QLatin1String("ALTER TABLE History ADD Frecency REAL DEFAULT 0")))
+        {
+            qDebug() << "Error updating history table with visit aggregate columns";
+            return;
+        }
+
+        // Compute the aggregates of the entries that were saved before the columns existed
+        std::vector<int> visitIds;
+        auto queryVisitIds = m_database.prepare(R"(SELECT VisitID FROM History)");
+        while (queryVisitIds.next())
+        {
+            int visitId = 0;
+            queryVisitIds >> visitId;
+            visitIds.push_back(visitId);
+        }
+
+        if (!m_database.beginTransaction())
+        {
+            qWarning() << "HistoryStore::checkForUpdate - could not start transaction";
+            return;
+        }
+
+        updateAggregates(visitIds);
+
+        if (!m_database.commitTransaction())
+            qWarning() << "HistoryStore::checkForUpdate - could not commit transaction";
+    }
 }
 
 void HistoryStore::purgeOldEntries()
@@ -456,31 +614,92 @@ void HistoryStore::purgeOldEntries()
     {
         purgeDate -= tmp;
 
-        auto stmt = m_database.prepare(R"(DELETE FROM Visits WHERE Date < ?)");
-        stmt << purgeDate;
-        if (!stmt.execute())
+        if (!removeVisits(0, static_cast<qint64>(purgeDate) - 1))
+            qWarning() << "HistoryStore - Could not purge old history entries. Message: " << QString::fromStdString(m_database.getLastError());
+    }
+}
+
+bool HistoryStore::removeVisits(qint64 start, qint64 end)
+{
+    if (!m_database.beginTransaction())
+        return false;
+
+    // Find the entries losing visits before they are removed, so their aggregates can be updated afterwards
+    std::vector<int> visitIds;
+    auto queryVisitIds = m_database.prepare(R"(SELECT DISTINCT VisitID FROM Visits WHERE Date >= ? AND Date <= ?)");
+    queryVisitIds << start
+                  << end;
+    while (queryVisitIds.next())
+    {
+        int visitId = 0;
+        queryVisitIds >> visitId;
+        visitIds.push_back(visitId);
+    }
+
+    auto stmt = m_database.prepare(R"(DELETE FROM Visits WHERE Date >= ? AND Date <= ?)");
+    stmt << start
+         << end;
+    if (!stmt.execute()
+            || !m_database.execute(R"(DELETE FROM History WHERE VisitID NOT IN (SELECT DISTINCT VisitID FROM Visits))"))
+    {
+        m_database.rollbackTransaction();
+        return false;
+    }
+
+    updateAggregates(visitIds);
+
+    return m_database.commitTransaction();
+}
+
+void HistoryStore::updateAggregates(const std::vector<int> &visitIds)
+{
+    auto queryVisitDates = m_database.prepare(R"(SELECT Date FROM Visits WHERE VisitID = ?)");
+    auto updateEntry = m_database.prepare(R"(UPDATE History SET VisitCount = ?, LastVisit = ?, Frecency = ? WHERE VisitID = ?)");
+
+    std::vector<VisitEntry> visits;
+    for (int visitId : visitIds)
+    {
+        visits.clear();
+
+        queryVisitDates.reset();
+        queryVisitDates << visitId;
+        while (queryVisitDates.next())
         {
-            qWarning() << "HistoryStore - Could not purge old history entries.";
+            VisitEntry visit;
+            queryVisitDates >> visit;
+            visits.push_back(visit);
         }
 
-        if (!m_database.execute(R"(DELETE FROM History WHERE VisitID NOT IN (SELECT VisitID FROM Visits);)"))
-            qWarning() << "HistoryStore - Error purging unused history entries. Message: " << QString::fromStdString(m_database.getLastError());
+        // Entries left without any visits have already been removed
+        if (visits.empty())
+            continue;
+
+        const int numVisits = static_cast<int>(visits.size());
+        const VisitEntry lastVisit = *std::max_element(visits.begin(), visits.end());
+
+        updateEntry.reset();
+        updateEntry << numVisits
+                    << lastVisit
+                    << Frecency::getKey(visits)
+                    << visitId;
+        if (!updateEntry.execute())
+            qWarning() << "HistoryStore::updateAggregates - could not update visit count of entry " << visitId;
     }
 }
 
 std::vector<WebPageInformation> HistoryStore::loadMostVisitedEntries(int limit)
 {
+    flushVisits();
+
     std::vector<WebPageInformation> result;
     if (limit <= 0)
         return result;
 
     auto stmt =
-            m_database.prepare(R"(SELECT v.VisitID, COUNT(v.VisitID) AS NumVisits, h.URL, h.Title
-                               FROM Visits AS v
-                               JOIN History AS h
-                                 ON v.VisitID = h.VisitID
-                               GROUP BY v.VisitID
-                               ORDER BY NumVisits DESC LIMIT ?)");
+            m_database.prepare(R"(SELECT VisitID, VisitCount, URL, Title
+                               FROM History
+                               WHERE VisitCount > 0
+                               ORDER BY Frecency DESC LIMIT ?)");
     stmt << limit;
     if (!stmt.execute())
     {
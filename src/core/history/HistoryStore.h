@@ -12,15 +12,38 @@
 #include <QIcon>
 #include <QList>
 #include <QMetaType>
+#include <QSet>
 #include <QUrl>
 
+#include <atomic>
+#include <cstdint>
 #include <deque>
 #include <map>
 #include <vector>
 
+/**
+ * @struct VisitQueueStats
+ * @brief Counters of the visits that the \ref HistoryStore writes to its database in batches
+ */
+struct VisitQueueStats
+{
+    /// Number of visits that have been added to the write queue
+    uint64_t QueuedVisits;
+
+    /// Number of queued visits that have been written to the database
+    uint64_t FlushedVisits;
+
+    /// Number of transactions in which the queued visits were written
+    uint64_t Flushes;
+};
+
 /**
  * @class HistoryStore
  * @brief Maintains the state of the browsing history that belongs to a user profile
+ *
+ * Visits are queued in memory and written in a single transaction once enough of them have
+ * accumulated, when \ref flushVisits is called, before any query of the history, and when the
+ * store is destroyed.
  */
 class HistoryStore : public DatabaseWorker
 {
@@ -28,12 +51,13 @@ class HistoryStore : public DatabaseWorker
 
     enum class Statement
     {
-        CreateHistoryRecord,  /// INSERT OR REPLACE INTO History(VisitID, URL, Title, URLTypedCount) VALUES(?, ?, ?, ?)
-        UpdateHistoryRecord,  /// UPDATE History SET Title = ?, URLTypedCount = ? WHERE VisitID = ?
-        CreateVisitRecord,    /// INSERT INTO Visits(VisitID, Date) VALUES (?, ?)
-        CreateWordRecord,     /// INSERT OR IGNORE INTO Words(Word) VALUES(?)
-        CreateUrlWordRecord,  /// INSERT OR IGNORE INTO URLWords(HistoryID, WordID) VALUES(?, (SELECT WordID FROM Words WHERE Word = ?))
-        GetHistoryRecord      /// SELECT History.VisitID, History.URL, History.Title, History.URLTypedCount, V.NumVisits, ...
+        CreateHistoryRecord,   /// INSERT INTO History(VisitID, URL, Title, URLTypedCount) VALUES(?, ?, ?, ?)
+        UpdateHistoryRecord,   /// UPDATE History SET Title = ?, URLTypedCount = ? WHERE VisitID = ?
+        CreateVisitRecord,     /// INSERT INTO Visits(VisitID, Date) VALUES (?, ?)
+        AddVisitToAggregates,  /// UPDATE History SET VisitCount = VisitCount + 1, LastVisit = MAX(LastVisit, ?), Frecency = ? WHERE VisitID = ?
+        CreateWordRecord,      /// INSERT OR IGNORE INTO Words(Word) VALUES(?)
+        CreateUrlWordRecord,   /// INSERT OR IGNORE INTO URLWords(HistoryID, WordID) VALUES(?, (SELECT WordID FROM Words WHERE Word = ?))
+        GetHistoryRecord       /// SELECT VisitID, URL, Title, URLTypedCount, VisitCount, LastVisit, Frecency FROM History WHERE URL = ?
     };
 
 public:
@@ -54,7 +78,7 @@ class HistoryStore : public DatabaseWorker
 
     /// Returns true if the history contains the given url, false if else. Will return
     /// false if private browsing mode is enabled
-    bool contains(const QUrl &url) const;
+    bool contains(const QUrl &url);
 
     /// Returns a history record corresponding to the given URL, or an empty record if it was not found in the
     /// database
@@ -66,31 +90,40 @@ class HistoryStore : public DatabaseWorker
     /// Returns a queue of recently visited items, with the most recent visits being at the front of the queue
     std::deque<HistoryEntry> getRecentItems();
 
+    /// Returns every history entry, along with its visit count and the time of its most recent visit
+    std::vector<HistoryEntry> getAllEntries();
+
     /// Loads and returns a list of all \ref HistoryEntry items visited from the given start date to the present
-    std::vector<URLRecord> getHistoryFrom(const QDateTime &startDate) const;
+    std::vector<URLRecord> getHistoryFrom(const QDateTime &startDate);
 
     /// Loads and returns a list of all \ref HistoryEntry items visited between the given start date and end dates
-    std::vector<URLRecord> getHistoryBetween(const QDateTime &startDate, const QDateTime &endDate) const;
+    std::vector<URLRecord> getHistoryBetween(const QDateTime &startDate, const QDateTime &endDate);
 
     /// Returns the number of times the user has visited the given website by its hostname
-    int getTimesVisitedHost(const QUrl &url) const;
+    int getTimesVisitedHost(const QUrl &url);
 
     /// Returns the number of times that the given URL has been visited
-    int getTimesVisited(const QUrl &url) const;
+    int getTimesVisited(const QUrl &url);
 
     /// Returns all of the words stored in the words table
-    std::map<int, QString> getWords() const;
+    std::map<int, QString> getWords();
 
     /// Returns a mapping of history entries to the list of word IDs associated with them
-    std::map<int, std::vector<int>> getEntryWordMapping() const;
+    std::map<int, std::vector<int>> getEntryWordMapping();
 
-    /// Fetches the set of most frequently visited web pages, up to the given limit. This is used to
+    /// Fetches the set of web pages with the highest frecency, up to the given limit. This is used to
     /// determine which web pages' thumbnails to retrieve for the "New Tab" page
     std::vector<WebPageInformation> loadMostVisitedEntries(int limit = 10);
 
-    /// Adds an entry to the history data store, given the URL, page title, time of visit, and the requested URL
+    /// Queues a visit to be written to the history data store, given the URL, page title, time of visit, and the requested URL
     void addVisit(const QUrl &url, const QString &title, const QDateTime &visitTime, const QUrl &requestedUrl, bool wasTypedByUser);
 
+    /// Writes all queued visits to the database in a single transaction
+    void flushVisits();
+
+    /// Returns the counters of queued and written visits. May be called from any thread
+    VisitQueueStats getVisitQueueStats() const;
+
     /// Returns the last unique id of an entry in the visit database. This is an auto-incrementing value
     uint64_t getLastVisitId() const;
 
@@ -106,21 +139,69 @@ class HistoryStore : public DatabaseWorker
     void load() override;
 
 private:
-    /// Splits the given URL into distinct words, saving the association in the database
-    void tokenizeAndSaveUrl(int visitId, const QUrl &url, const QString &title);
+    /// A visit that has not yet been written to the database
+    struct PendingVisit
+    {
+        /// URL of the visited page
+        QUrl URL;
+
+        /// Title of the page
+        QString Title;
+
+        /// Time of the visit
+        QDateTime VisitTime;
+
+        /// True if the URL was typed by the user in the URL bar
+        bool WasTypedByUser;
+    };
+
+    /// Returns the history record corresponding to the given URL, or an empty record if it was not found in the
+    /// database, without writing the queued visits first
+    HistoryEntry findEntry(const QUrl &url);
+
+    /// Writes the given visit to the database, adding the words of the visited page to its entry in the word map
+    void saveVisit(const PendingVisit &visit, std::map<int, QSet<QString>> &wordsByEntry);
+
+    /// Splits the given URL and page title into distinct words, adding them to the given set
+    void tokenizeUrl(const QUrl &url, const QString &title, QSet<QString> &words);
+
+    /// Saves the words of each history entry, along with their association to the entry, in the database
+    void saveWords(const std::map<int, QSet<QString>> &wordsByEntry);
 
     /// Called during the load() routine, this checks if any of the table structures need to be updated
     void checkForUpdate();
 
-    /// Removes history items that are more than six months old
+    /// Removes history items that are more than eight weeks old
     void purgeOldEntries();
 
+    /// Removes all visits made between the given times, in milliseconds since the epoch and inclusive, along with
+    /// the entries that are left without visits. Returns true on success, false on failure
+    bool removeVisits(qint64 start, qint64 end);
+
+    /// Recomputes the visit count, time of last visit and frecency of the given entries from their visits
+    void updateAggregates(const std::vector<int> &visitIds);
+
 private:
     /// Stores the last visit ID that has been used to record browsing history. Auto increments for each new history item
     uint64_t m_lastVisitID;
 
     /// Cache of prepared statements
     std::map<Statement, sqlite::PreparedStatement> m_statements;
+
+    /// Visits waiting to be written to the database
+    std::vector<PendingVisit> m_pendingVisits;
+
+    /// Number of visits that have been queued
+    std::atomic<uint64_t> m_numQueuedVisits;
+
+    /// Number of queued visits that have been written to the database
+    std::atomic<uint64_t> m_numFlushedVisits;
+
+    /// Number of transactions used to write the queued visits
+    std::atomic<uint64_t> m_numFlushes;
+
+    /// Number of queued visits at which they are written to the database
+    static const std::size_t MaxPendingVisits;
 };
 
 #endif // HISTORYSTORE_H
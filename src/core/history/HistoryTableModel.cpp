@@ -71,6 +71,8 @@ void HistoryTableModel::onHistoryFetched(std::vector<URLRecord> &&entries)
 {
     QDateTime nextLoadedDate = m_loadedDate.addDays(-1);
 
+    const std::size_t firstNewItem = m_commonData.size();
+
     QMap<qint64, int> tmpVisitInfo; // Used to sort visits by date
     for (auto &it : entries)
     {
@@ -78,7 +80,7 @@ void HistoryTableModel::onHistoryFetched(std::vector<URLRecord> &&entries)
         HistoryTableItem tableItem;
         tableItem.Title = it.getTitle();
         tableItem.URL = it.getUrl().toString();
-        tableItem.Favicon = m_faviconManager->getFavicon(it.getUrl()).pixmap(16, 16);
+        tableItem.Favicon = QIcon(QLatin1String(":/blank_favicon.png")).pixmap(16, 16);
         m_commonData.push_back(tableItem);
 
         int itemIndex = static_cast<int>(m_commonData.size()) - 1;
@@ -109,6 +111,22 @@ void HistoryTableModel::onHistoryFetched(std::vector<URLRecord> &&entries)
 
     m_loadedDate = nextLoadedDate;
     endInsertRows();
+
+    // Favicons are read in the background, each item is updated once its icon is ready
+    for (std::size_t i = firstNewItem; i < m_commonData.size(); ++i)
+    {
+        const QString url = m_commonData.at(i).URL;
+        m_faviconManager->loadFavicon(QUrl(url), this, [this, i, url](const QIcon &icon) {
+            if (i >= m_commonData.size() || m_commonData.at(i).URL != url)
+                return;
+
+            m_commonData[i].Favicon = icon.pixmap(16, 16);
+
+            const int numRows = rowCount();
+            if (numRows > 0)
+                emit dataChanged(index(0, 0), index(numRows - 1, 0), { Qt::DecorationRole });
+        });
+    }
 }
 
 QVariant HistoryTableModel::data(const QModelIndex &index, int role) const
@@ -1,3 +1,4 @@
+#include "Frecency.h"
 #include "URLRecord.h"
 
 URLRecord::URLRecord(HistoryEntry &&entry, std::vector<VisitEntry> &&visits) noexcept :
@@ -27,6 +28,11 @@ int URLRecord::getUrlTypedCount() const
     return m_historyEntry.URLTypedCount;
 }
 
+double URLRecord::getFrecency() const
+{
+    return m_historyEntry.Frecency;
+}
+
 const QUrl &URLRecord::getUrl() const
 {
     return m_historyEntry.URL;
@@ -49,6 +55,7 @@ const std::vector<VisitEntry> &URLRecord::getVisits() const
 
 void URLRecord::addVisit(VisitEntry entry)
 {
+    m_historyEntry.Frecency = Frecency::addVisit(m_historyEntry.Frecency, m_historyEntry.NumVisits, entry);
     m_historyEntry.NumVisits++;
 
     if (entry > m_historyEntry.LastVisit)
@@ -37,8 +37,11 @@ struct HistoryEntry final : public sqlite::Row
     /// The number of times the URL associated with this entry was typed by the user in the URL bar
     int URLTypedCount;
 
+    /// Frecency key of the entry, combining the number of visits with their recency. See \ref Frecency
+    double Frecency;
+
     /// Default constructor
-    HistoryEntry() : URL(), Title(), VisitID(0), LastVisit(), NumVisits(0), URLTypedCount(0) {}
+    HistoryEntry() : URL(), Title(), VisitID(0), LastVisit(), NumVisits(0), URLTypedCount(0), Frecency(0.0) {}
 
     /// Copy constructor
     HistoryEntry(const HistoryEntry &other) :
@@ -47,7 +50,8 @@ struct HistoryEntry final : public sqlite::Row
         VisitID(other.VisitID),
         LastVisit(other.LastVisit),
         NumVisits(other.NumVisits),
-        URLTypedCount(other.URLTypedCount)
+        URLTypedCount(other.URLTypedCount),
+        Frecency(other.Frecency)
     {
     }
 
@@ -58,7 +62,8 @@ struct HistoryEntry final : public sqlite::Row
         VisitID(other.VisitID),
         LastVisit(other.LastVisit),
         NumVisits(other.NumVisits),
-        URLTypedCount(other.URLTypedCount)
+        URLTypedCount(other.URLTypedCount),
+        Frecency(other.Frecency)
     {
     }
 
@@ -75,6 +80,7 @@ struct HistoryEntry final : public sqlite::Row
             LastVisit = other.LastVisit;
             NumVisits = other.NumVisits;
             URLTypedCount = other.URLTypedCount;
+            Frecency = other.Frecency;
         }
 
         return *this;
@@ -91,6 +97,7 @@ struct HistoryEntry final : public sqlite::Row
             LastVisit = other.LastVisit;
             NumVisits = other.NumVisits;
             URLTypedCount = other.URLTypedCount;
+            Frecency = other.Frecency;
         }
 
         return *this;
@@ -117,7 +124,8 @@ struct HistoryEntry final : public sqlite::Row
              >> Title
              >> URLTypedCount
              >> NumVisits
-             >> LastVisit;
+             >> LastVisit
+             >> Frecency;
     }
 };
 
@@ -146,6 +154,9 @@ class URLRecord
     /// Returns the number of times this record was typed by the user in the URL bar
     int getUrlTypedCount() const;
 
+    /// Returns the frecency key of this record
+    double getFrecency() const;
+
     /// Returns the URL associated with the record
     const QUrl &getUrl() const;
 
@@ -162,7 +173,7 @@ class URLRecord
     /// Adds a visit to the record
     void addVisit(VisitEntry entry);
 
-    /// The history entry, containg the URL, title, last visit and visit count
+    /// The history entry, containg the URL, title, last visit, visit count and frecency
     HistoryEntry m_historyEntry;
 
     /// List of every visit stored in the database
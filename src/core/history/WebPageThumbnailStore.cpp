@@ -10,22 +10,39 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
-#include <set>
 #include <utility>
 #include <QBuffer>
+#include <QFutureWatcher>
 #include <QMimeType>
 #include <QPixmap>
-#include <QPointer>
+#include <QSet>
 #include <QTimer>
 #include <QTimerEvent>
+#include <QtConcurrent>
 
 #include <QDebug>
 
+/// Maximum size of a thumbnail
+static const QSize ThumbnailSize(375, 500);
+
+/// Maximum number of bytes of encoded thumbnails that are kept in memory
+static const size_t ThumbnailCacheBudget = 8 * 1024 * 1024;
+
+/// Number of most frequently visited web pages whose thumbnails are saved
+static const int MostVisitedLimit = 100;
+
+/// Signature at the start of PNG data, which distinguishes it from thumbnails that were stored in base-64
+static const QByteArray PngSignature = QByteArrayLiteral("\x89PNG");
+
 WebPageThumbnailStore::WebPageThumbnailStore(const ViperServiceLocator &serviceLocator, const QString &databaseFile, QObject *parent) :
     QObject(parent),
     DatabaseWorker(databaseFile),
     m_timerId(0),
-    m_thumbnails(),
+    m_thumbnailCache(ThumbnailCacheBudget),
+    m_unsavedThumbnails(),
+    m_unsavedBytes(0),
+    m_pendingRequests(),
+    m_requestMutex(),
     m_bookmarkManager(serviceLocator.getServiceAs<BookmarkManager>("BookmarkManager")),
     m_historyManager(serviceLocator.getServiceAs<HistoryManager>("HistoryManager")),
     m_mimeDatabase()
@@ -42,35 +59,14 @@ WebPageThumbnailStore::~WebPageThumbnailStore()
     killTimer(m_timerId);
 }
 
-QImage WebPageThumbnailStore::getThumbnail(const QUrl &url)
+void WebPageThumbnailStore::getThumbnail(const QUrl &url, QObject *receiver, std::function<void(const QByteArray&)> callback)
 {
-    const QString host = url.host().toLower();
-    if (host.isEmpty())
-        return QImage();
-
-    // First, check in-memory storage. Then check the database for a thumbnail.
-    auto it = m_thumbnails.find(host);
-    if (it != m_thumbnails.end())
-        return it.value();
-
-    auto stmt = m_database.prepare(R"(SELECT Thumbnail FROM Thumbnails WHERE Host = ?)");
-    stmt << host;
-    if (stmt.next())
-    {
-        QByteArray data;
-        stmt >> data;
-        QByteArray decoded = QByteArray::fromBase64(data);
-
-        QBuffer buffer(&decoded);
-        QImage image;
-        image.load(&buffer, "PNG");
-
-        m_thumbnails.insert(host, image);
+    std::lock_guard<std::mutex> lock(m_requestMutex);
 
-        return image;
-    }
-
-    return QImage();
+    // Requests made before the queue is processed are handled together
+    m_pendingRequests.push_back(ThumbnailRequest { url.host().toLower(), QPointer<QObject>(receiver), std::move(callback) });
+    if (m_pendingRequests.size() == 1)
+        QMetaObject::invokeMethod(this, "processThumbnailRequests", Qt::QueuedConnection);
 }
 
 void WebPageThumbnailStore::onPageLoaded(bool ok)
@@ -120,20 +116,91 @@ void WebPageThumbnailStore::onPageLoaded(bool ok)
             if (pixmap.isNull())
                 return;
 
-            const QImage image = pixmap.toImage();
-            if (image.allGray())
-                return;
-
+            QStringList hosts;
             for (const QUrl &url : urls)
             {
                 const QString host = url.host().toLower();
                 if (!host.isEmpty())
-                    m_thumbnails.insert(host, image);
+                    hosts.append(host);
             }
+
+            if (!hosts.isEmpty())
+                addThumbnail(pixmap.toImage(), hosts);
         }
     });
 }
 
+void WebPageThumbnailStore::processThumbnailRequests()
+{
+    std::vector<ThumbnailRequest> requests;
+    {
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        requests.swap(m_pendingRequests);
+    }
+
+    auto stmt = m_database.prepare(R"(SELECT Thumbnail FROM Thumbnails WHERE Host = ?)");
+    for (const ThumbnailRequest &request : requests)
+    {
+        if (request.Receiver.isNull())
+            continue;
+
+        request.Callback(findThumbnail(request.Host, stmt));
+    }
+}
+
+void WebPageThumbnailStore::saveThumbnails(const QStringList &mostVisitedHosts)
+{
+    QSet<QString> hostsToSave;
+    for (const QString &host : mostVisitedHosts)
+    {
+        if (m_unsavedThumbnails.contains(host))
+            hostsToSave.insert(host);
+    }
+
+    if (m_bookmarkManager)
+    {
+        for (auto it : *m_bookmarkManager)
+        {
+            if (it->getType() == BookmarkNode::Bookmark)
+            {
+                const QString host = it->getURL().host().toLower();
+                if (m_unsavedThumbnails.contains(host))
+                    hostsToSave.insert(host);
+            }
+        }
+    }
+
+    // Thumbnails of other pages are not worth keeping. They are moved into the cache, and remain available until evicted
+    QHash<QString, QByteArray> unsavedThumbnails;
+    unsavedThumbnails.swap(m_unsavedThumbnails);
+    m_unsavedBytes = 0;
+
+    if (!hostsToSave.isEmpty())
+    {
+        if (m_database.beginTransaction())
+        {
+            auto stmt = m_database.prepare(R"(INSERT OR REPLACE INTO Thumbnails(Host, Thumbnail) VALUES (?, ?))");
+            for (const QString &host : hostsToSave)
+            {
+                stmt.reset();
+                stmt << host
+                     << unsavedThumbnails.value(host);
+
+                if (!stmt.execute())
+                    qWarning() << "WebPageThumbnailStore - could not save thumbnail to database.";
+            }
+
+            if (!m_database.commitTransaction())
+                qWarning() << "WebPageThumbnailStore - could not commit thumbnails to database.";
+        }
+        else
+            qWarning() << "WebPageThumbnailStore - could not start transaction to save thumbnails.";
+    }
+
+    for (auto it = unsavedThumbnails.cbegin(); it != unsavedThumbnails.cend(); ++it)
+        m_thumbnailCache.put(it.key(), it.value(), static_cast<size_t>(it.value().size()));
+}
+
 void WebPageThumbnailStore::timerEvent(QTimerEvent *event)
 {
     if (event->timerId() == m_timerId)
@@ -164,63 +231,106 @@ void WebPageThumbnailStore::load()
     // load only when needed, not during instantiation
 }
 
-void WebPageThumbnailStore::onMostVisitedPagesLoaded(std::vector<WebPageInformation> &&results)
+void WebPageThumbnailStore::addThumbnail(const QImage &image, const QStringList &hosts)
 {
-    std::set<std::string> mostVisitedHosts;
+    QFutureWatcher<QByteArray> *watcher = new QFutureWatcher<QByteArray>(this);
+    connect(watcher, &QFutureWatcher<QByteArray>::finished, this, [this, watcher, hosts](){
+        const QByteArray data = watcher->result();
+        watcher->deleteLater();
 
-    // Load top history entries into set
-    for (const auto &entry : results)
-    {
-        const std::string host = entry.URL.host().toLower().toStdString();
-        if (!host.empty())
-            mostVisitedHosts.insert(host);
-    }
+        if (data.isEmpty())
+            return;
+
+        for (const QString &host : hosts)
+            addUnsavedThumbnail(host, data);
+    });
+    watcher->setFuture(QtConcurrent::run(&WebPageThumbnailStore::encodeThumbnail, image));
+}
+
+void WebPageThumbnailStore::addUnsavedThumbnail(const QString &host, const QByteArray &data)
+{
+    // The cached thumbnail of the host, if any, is out of date
+    m_thumbnailCache.remove(host);
 
-    // Load all bookmarks into set
-    for (auto it : *m_bookmarkManager)
+    auto it = m_unsavedThumbnails.find(host);
+    if (it != m_unsavedThumbnails.end())
     {
-        if (it->getType() == BookmarkNode::Bookmark)
-        {
-            const std::string host = it->getURL().host().toLower().toStdString();
-            if (!host.empty())
-                mostVisitedHosts.insert(host);
-        }
+        m_unsavedBytes -= static_cast<size_t>(it.value().size());
+        it.value() = data;
     }
+    else
+        m_unsavedThumbnails.insert(host, data);
 
-    // Save applicable thumbnails
-    auto stmt = m_database.prepare(R"(INSERT OR REPLACE INTO Thumbnails(Host, Thumbnail) VALUES (?, ?))");
+    // Save early rather than let unsaved thumbnails grow past the budget of the cache
+    const size_t previousBytes = m_unsavedBytes;
+    m_unsavedBytes += static_cast<size_t>(data.size());
+    if (previousBytes <= ThumbnailCacheBudget && m_unsavedBytes > ThumbnailCacheBudget)
+        save();
+}
 
-    for (auto it = m_thumbnails.begin(); it != m_thumbnails.end(); ++it)
-    {
-        const std::string host = it.key().toStdString();
-        if (mostVisitedHosts.find(host) == mostVisitedHosts.end())
-            continue;
+QByteArray WebPageThumbnailStore::findThumbnail(const QString &host, sqlite::PreparedStatement &stmt)
+{
+    if (host.isEmpty())
+        return QByteArray();
 
-        const QImage &image = it.value();
-        if (image.isNull())
-            continue;
+    auto unsavedIt = m_unsavedThumbnails.find(host);
+    if (unsavedIt != m_unsavedThumbnails.end())
+        return unsavedIt.value();
 
-        QByteArray data;
-        QBuffer buffer(&data);
-        image.save(&buffer, "PNG");
+    if (const QByteArray *cachedData = m_thumbnailCache.find(host))
+        return *cachedData;
 
-        data = data.toBase64();
-        stmt << host
-             << data;
+    QByteArray data;
 
-        if (!stmt.execute())
-            qWarning() << "WebPageThumbnailStore - could not save thumbnail to database.";
-    }
+    stmt.reset();
+    stmt << host;
+    if (stmt.next())
+        stmt >> data;
+
+    if (data.isEmpty())
+        return data;
+
+    // Older versions of the browser stored thumbnails in base-64
+    if (!data.startsWith(PngSignature))
+        data = QByteArray::fromBase64(data);
+
+    m_thumbnailCache.put(host, data, static_cast<size_t>(data.size()));
+    return data;
 }
 
 void WebPageThumbnailStore::save()
 {
-    // iterate through the in-memory collection, and if any of the hostnames of a page's thumbnail
-    // is (1) in the top 100 most visited web pages (see HistoryManager), or (2) is favorited by
-    // the user, or (3) is bookmarked, then save to the DB
-    if (!m_historyManager || !m_bookmarkManager)
+    // If any of the hostnames of the thumbnails captured since the last save is (1) in the top 100
+    // most visited web pages (see HistoryManager), or (2) is favorited by the user, or (3) is bookmarked,
+    // then save its thumbnail to the DB
+    if (!m_historyManager || !m_bookmarkManager || m_unsavedThumbnails.isEmpty())
         return;
 
-    int historyLimit = std::min(m_thumbnails.size(), 100);
-    m_historyManager->loadMostVisitedEntries(historyLimit, std::bind(&WebPageThumbnailStore::onMostVisitedPagesLoaded, this, std::placeholders::_1));
+    // The history is loaded on another thread, so the thumbnails are saved back on this one
+    m_historyManager->loadMostVisitedEntries(MostVisitedLimit, [this](std::vector<WebPageInformation> &&results){
+        QStringList mostVisitedHosts;
+        for (const auto &entry : results)
+        {
+            const QString host = entry.URL.host().toLower();
+            if (!host.isEmpty())
+                mostVisitedHosts.append(host);
+        }
+
+        QMetaObject::invokeMethod(this, "saveThumbnails", Qt::QueuedConnection, Q_ARG(QStringList, mostVisitedHosts));
+    });
+}
+
+QByteArray WebPageThumbnailStore::encodeThumbnail(const QImage &image)
+{
+    if (image.isNull() || image.allGray())
+        return QByteArray();
+
+    QImage thumbnail = image;
+    if (thumbnail.width() > ThumbnailSize.width() || thumbnail.height() > ThumbnailSize.height())
+        thumbnail = thumbnail.scaled(ThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    thumbnail.save(&buffer, "PNG");
+    return data;
 }
@@ -1,18 +1,24 @@
 #ifndef WEBPAGETHUMBNAILSTORE_H
 #define WEBPAGETHUMBNAILSTORE_H
 
+#include "CommonUtil.h"
 #include "DatabaseWorker.h"
 #include "HistoryManager.h"
 #include "ServiceLocator.h"
+#include "WeightedLRUCache.h"
 
+#include <functional>
+#include <mutex>
 #include <vector>
 
+#include <QByteArray>
 #include <QHash>
 #include <QImage>
 #include <QMimeDatabase>
 #include <QObject>
-#include <QPixmap>
+#include <QPointer>
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 
 class BookmarkManager;
@@ -23,11 +29,17 @@ class HistoryManager;
  * @brief A data store that contains thumbnails of web pages that are
  *        either commonly visited, bookmarked or otherwise favorited by
  *        the user.
+ *
+ * Thumbnails are downscaled and PNG-encoded on the global thread pool, and only
+ * the encoded images are kept in memory, in a cache with a fixed byte budget.
+ * Thumbnails that have not been saved yet are held outside of the cache, so that
+ * they cannot be evicted before they are written to the database.
  */
 class WebPageThumbnailStore : public QObject, private DatabaseWorker
 {
     friend class BrowserApplication;
     friend class DatabaseFactory;
+    friend class WebPageThumbnailStoreTest;
 
     Q_OBJECT
 
@@ -38,9 +50,14 @@ class WebPageThumbnailStore : public QObject, private DatabaseWorker
     /// Destructor
     ~WebPageThumbnailStore();
 
-    /// Attempts to find a thumbnail associated with the given URL, returning said thumbnail
-    /// as a QImage if found, or returning a null pixmap if it could not be found.
-    QImage getThumbnail(const QUrl &url);
+    /**
+     * @brief Requests the thumbnail of the web page with the given URL. This method may be called from any thread.
+     * @param url URL of the web page
+     * @param receiver Object that requested the thumbnail. The callback is not invoked if the receiver is deleted first
+     * @param callback Function that is given the PNG-encoded thumbnail, or an empty byte array if there is no thumbnail
+     *        of the page. It is invoked on the thread of the thumbnail store
+     */
+    void getThumbnail(const QUrl &url, QObject *receiver, std::function<void(const QByteArray&)> callback);
 
 public Q_SLOTS:
     /// Handles the loadFinished event which is emitted by a \ref WebWidget
@@ -61,20 +78,62 @@ public Q_SLOTS:
     /// the thumbnails are loaded as needed and so this does nothing
     void load() override;
 
+private Q_SLOTS:
+    /// Finds the thumbnails of all pending requests and passes them to their callbacks
+    void processThumbnailRequests();
+
+    /// Saves the new thumbnails of the given hosts, which are the hosts of the most frequently visited
+    /// web pages, and of all bookmarked hosts, in a single transaction
+    void saveThumbnails(const QStringList &mostVisitedHosts);
+
 private:
-    /// Callback registered during a call to save() - handles the query to fetch the most frequently
-    /// visited web pages
-    void onMostVisitedPagesLoaded(std::vector<WebPageInformation> &&results);
+    /// A request for the thumbnail of a host
+    struct ThumbnailRequest
+    {
+        /// Lower-case hostname
+        QString Host;
+
+        /// Object that made the request
+        QPointer<QObject> Receiver;
+
+        /// Function that is given the thumbnail
+        std::function<void(const QByteArray&)> Callback;
+    };
+
+    /// Downscales and encodes the thumbnail of a page on the thread pool, then stores it under each of the given hosts
+    void addThumbnail(const QImage &image, const QStringList &hosts);
+
+    /// Stores the PNG-encoded thumbnail of the given host until the next save
+    void addUnsavedThumbnail(const QString &host, const QByteArray &data);
+
+    /// Returns the PNG-encoded thumbnail of the given host from the cache or the database, or an empty byte array
+    QByteArray findThumbnail(const QString &host, sqlite::PreparedStatement &stmt);
 
     /// Saves thumbnails of web pages into the database
     void save();
 
+    /// Returns the given image scaled down to the thumbnail size and encoded as a PNG, or an
+    /// empty byte array if the image is blank
+    static QByteArray encodeThumbnail(const QImage &image);
+
 private:
     /// Identifier of the timer that is periodically invoked to call the save() method
     int m_timerId;
 
-    /// Hashmap of web hostnames to their corresponding thumbnails
-    QHash<QString, QImage> m_thumbnails;
+    /// Least recently used cache of web hostnames to their PNG-encoded thumbnails
+    WeightedLRUCache<QString, QByteArray> m_thumbnailCache;
+
+    /// Thumbnails that were captured since the last save, by hostname. These are moved into the cache once saved
+    QHash<QString, QByteArray> m_unsavedThumbnails;
+
+    /// Total size of the unsaved thumbnails, in bytes
+    size_t m_unsavedBytes;
+
+    /// Thumbnail requests that have not yet been processed
+    std::vector<ThumbnailRequest> m_pendingRequests;
+
+    /// Guards the pending thumbnail requests
+    std::mutex m_requestMutex;
 
     /// Pointer to the \ref BookmarkManager
     BookmarkManager *m_bookmarkManager;
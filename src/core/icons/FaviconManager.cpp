@@ -1,31 +1,47 @@
-#include "CommonUtil.h"
 #include "DatabaseFactory.h"
 #include "FaviconManager.h"
 #include "NetworkAccessManager.h"
 #include "URL.h"
 
 #include <functional>
-#include <stdexcept>
 
 #include <QBuffer>
 #include <QDebug>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QPainter>
+#include <QPointer>
 #include <QSvgRenderer>
 #include <QtConcurrent>
 
+/// Maximum number of bytes used by the images of decoded favicons
+static const std::size_t IconCacheBudget = 4 * 1024 * 1024;
+
+/// Maximum number of page URLs whose favicon IDs are kept in memory
+static const std::size_t PageIconIdCapacity = 16384;
+
+/// Maximum number of domains, hosts or page URLs that are remembered to have no favicon
+static const std::size_t MissingIconCapacity = 4096;
+
 FaviconManager::FaviconManager(const QString &databaseFile) :
     QObject(nullptr),
     m_faviconStore(nullptr),
     m_networkAccessManager(nullptr),
-    m_iconMap(),
-    m_iconCache(64),
-    m_mutex()
+    m_iconCache(IconCacheBudget),
+    m_pageIconIds(PageIconIdCapacity),
+    m_keysWithoutIcon(MissingIconCapacity),
+    m_unsavedIcons(),
+    m_pendingLoads(),
+    m_mutex(),
+    m_loadPool()
 {
     setObjectName(QLatin1String("FaviconManager"));
     m_faviconStore = DatabaseFactory::createWorker<FaviconStore>(databaseFile);
+
+    // Favicons are read and written one at a time, in the order they were requested
+    m_loadPool.setMaxThreadCount(1);
 }
 
 void FaviconManager::setNetworkAccessManager(NetworkAccessManager *networkAccessManager)
@@ -35,117 +51,166 @@ void FaviconManager::setNetworkAccessManager(NetworkAccessManager *networkAccess
 
 QIcon FaviconManager::getFavicon(const QUrl &url)
 {
-    QString pageUrl = getUrlAsString(url);
-    if (!m_faviconStore || pageUrl.isEmpty())
+    if (!m_faviconStore || url.isEmpty())
         return QIcon(QLatin1String(":/blank_favicon.png"));
 
-    const std::string urlStdStr = pageUrl.toStdString();
-
-    // Check for cache hit
-    try
-    {
-        if (m_iconCache.has(urlStdStr))
-        {
-            return m_iconCache.get(urlStdStr);
-        }
-    }
-    catch (std::out_of_range &err)
     {
-        qDebug() << "FaviconManager::getFavicon - caught error while fetching icon from cache. Error: " << err.what();
-    }
-
-    int iconId = m_faviconStore->getFaviconId(url);
-    if (iconId < 0)
-        return QIcon(QLatin1String(":/blank_favicon.png"));
+        std::lock_guard<std::mutex> lock(m_mutex);
 
-    auto it = m_iconMap.find(iconId);
-    if (it == m_iconMap.end())
-    {
-        auto &record = m_faviconStore->getDataRecord(iconId);
-        if (record.iconData.isEmpty())
-            return QIcon(QLatin1String(":/blank_favicon.png"));
-
-        QIcon icon = CommonUtil::iconFromBase64(record.iconData);
-        auto result = m_iconMap.emplace(std::make_pair(iconId, icon));
-        if (result.second)
-            it = result.first;
-        else
+        QIcon icon;
+        if (findCachedIcon(url, icon))
             return icon;
     }
 
-    try
+    // The favicon will be in the cache by the time it is requested again
+    requestLoad(url, nullptr, std::function<void(const QIcon&)>());
+    return QIcon(QLatin1String(":/blank_favicon.png"));
+}
+
+void FaviconManager::loadFavicon(const QUrl &url, QObject *receiver, std::function<void(const QIcon&)> callback)
+{
+    if (!m_faviconStore || url.isEmpty())
     {
-        std::lock_guard<std::mutex> _(m_mutex);
-        m_iconCache.put(urlStdStr, it->second);
+        if (callback)
+            callback(QIcon(QLatin1String(":/blank_favicon.png")));
+        return;
     }
-    catch (std::out_of_range &err)
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    QIcon icon;
+    if (findCachedIcon(url, icon))
     {
-        qDebug() << "FaviconManager::getFavicon - caught error while updating icon cache. Error: " << err.what();
+        lock.unlock();
+        if (callback)
+            callback(icon);
+        return;
     }
 
-    return it->second;
+    lock.unlock();
+    requestLoad(url, receiver, std::move(callback));
 }
 
-void FaviconManager::updateIcon(const QUrl &iconUrl, const QUrl &pageUrl, const QIcon &pageIcon)
+void FaviconManager::requestLoad(const QUrl &url, QObject *receiver, std::function<void(const QIcon&)> &&callback)
 {
-    if (!m_faviconStore
-            || iconUrl.isEmpty()
-            || iconUrl.scheme().startsWith(QLatin1String("data")))
-        return;
+    std::unique_lock<std::mutex> lock(m_mutex);
 
-    const QString pageUrlStr = getUrlAsString(pageUrl);
-    const std::string urlStdStr = pageUrlStr.toStdString();
+    // Requests for a favicon that is already being loaded wait for the same load
+    auto pendingIt = m_pendingLoads.find(url);
+    const bool isLoading = pendingIt != m_pendingLoads.end();
+    if (!isLoading)
+        pendingIt = m_pendingLoads.insert(url, std::vector<PendingCallback>());
+    if (callback)
+        pendingIt->push_back(PendingCallback { QPointer<QObject>(receiver), std::move(callback) });
 
-    QByteArray pageIconData = CommonUtil::iconToBase64(pageIcon);
+    lock.unlock();
 
-    if (!pageIconData.isEmpty() && m_iconCache.has(urlStdStr))
-    {
-        try
+    // The load is started in the manager's thread, which receives its result
+    if (!isLoading)
+        QMetaObject::invokeMethod(this, "startLoad", Qt::AutoConnection, Q_ARG(QUrl, url));
+}
+
+void FaviconManager::startLoad(const QUrl &url)
+{
+    QFutureWatcher<std::pair<int, QImage>> *watcher = new QFutureWatcher<std::pair<int, QImage>>(this);
+    connect(watcher, &QFutureWatcher<std::pair<int, QImage>>::finished, this, [this, watcher, url](){
+        const std::pair<int, QImage> result = watcher->result();
+        watcher->deleteLater();
+
+        QIcon icon(QLatin1String(":/blank_favicon.png"));
+        std::vector<PendingCallback> callbacks;
         {
-            std::lock_guard<std::mutex> _(m_mutex);
-            m_iconCache.put(urlStdStr, pageIcon);
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (result.first < 0)
+                m_keysWithoutIcon.put(getMissingIconKey(url), true, 1);
+            else
+                m_pageIconIds.put(getPageKey(url), result.first, 1);
+
+            if (!result.second.isNull())
+            {
+                icon = QIcon(QPixmap::fromImage(result.second));
+                cacheIcon(result.first, icon, result.second);
+            }
+
+            callbacks = m_pendingLoads.take(url);
         }
-        catch (std::out_of_range &err)
+
+        for (const PendingCallback &pendingCallback : callbacks)
         {
-            qDebug() << "FaviconManager::updateIcon - caught error while updating icon cache. Error: " << err.what();
+            if (!pendingCallback.Receiver.isNull())
+                pendingCallback.Callback(icon);
         }
-    }
+    });
+    watcher->setFuture(QtConcurrent::run(&m_loadPool, [this, url](){
+        return readIcon(url);
+    }));
+}
 
-    const int iconId = m_faviconStore->getFaviconIdForIconUrl(iconUrl);
-    FaviconData &dataRecord = m_faviconStore->getDataRecord(iconId);
-    if (dataRecord.iconData.isEmpty() || !pageIconData.isEmpty())
-        dataRecord.iconData = pageIconData;
+void FaviconManager::startSave(const QUrl &iconUrl, const QUrl &pageUrl, const QIcon &icon)
+{
+    // Pixmaps may only be used in the thread of the application, so the icon is converted here and encoded in the background
+    const QImage image = icon.isNull() ? QImage() : icon.pixmap(32, 32).toImage();
 
-    // add page url -> icon mapping to favicon store
-    m_faviconStore->addPageMapping(pageUrl, iconId);
+    QFutureWatcher<SaveResult> *watcher = new QFutureWatcher<SaveResult>(this);
+    connect(watcher, &QFutureWatcher<SaveResult>::finished, this, [this, watcher, iconUrl, pageUrl, icon, image](){
+        const SaveResult result = watcher->result();
+        watcher->deleteLater();
 
-    if (!dataRecord.iconData.isEmpty())
-    {
-        m_faviconStore->saveDataRecord(dataRecord);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (!pageUrl.isEmpty())
+            {
+                const QString pageKey = getPageKey(pageUrl);
+                m_pageIconIds.put(pageKey, result.IconId, 1);
+
+                // Pages of the same host or domain that had no favicon may now fall back to this one
+                m_keysWithoutIcon.remove(FaviconStore::getDomainKey(pageUrl));
+                m_keysWithoutIcon.remove(FaviconStore::getHostKey(pageUrl));
+                m_keysWithoutIcon.remove(pageUrl.toString());
+
+                // A newer icon of the page may have been given in the meantime, and is still being saved
+                auto unsavedIt = m_unsavedIcons.find(pageKey);
+                if (unsavedIt != m_unsavedIcons.end() && unsavedIt->cacheKey() == icon.cacheKey())
+                    m_unsavedIcons.erase(unsavedIt);
+            }
+
+            if (result.IsSaved)
+                cacheIcon(result.IconId, QIcon(QPixmap::fromImage(image)), image);
+        }
 
-        QIcon icon = CommonUtil::iconFromBase64(dataRecord.iconData);
-        auto it = m_iconMap.find(iconId);
-        if (it != m_iconMap.end())
-            it->second = icon;
-        else
-            m_iconMap.emplace(std::make_pair(iconId, icon));
+        if (result.NeedsDownload)
+            downloadIcon(iconUrl);
+    });
+    watcher->setFuture(QtConcurrent::run(&m_loadPool, [this, iconUrl, pageUrl, image](){
+        return writeIcon(iconUrl, pageUrl, image);
+    }));
+}
 
-        return;
-    }
+FaviconCacheStats FaviconManager::getCacheStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return FaviconCacheStats { m_iconCache.size(), m_iconCache.getWeight(), m_iconCache.capacity(),
+                               m_iconCache.getHitCount(), m_iconCache.getMissCount() + m_pageIconIds.getMissCount(),
+                               m_iconCache.getEvictionCount() };
+}
 
-    if (!m_networkAccessManager)
+void FaviconManager::updateIcon(const QUrl &iconUrl, const QUrl &pageUrl, const QIcon &pageIcon)
+{
+    if (!m_faviconStore
+            || iconUrl.isEmpty()
+            || iconUrl.scheme().startsWith(QLatin1String("data")))
         return;
 
-    QNetworkRequest request(iconUrl);
-    QNetworkReply *reply = m_networkAccessManager->get(request);
-    if (reply->isFinished())
-        onReplyFinished(reply);
-    else
+    // The page is shown with its new icon while the icon is being saved
+    if (!pageIcon.isNull() && !pageUrl.isEmpty())
     {
-        connect(reply, &QNetworkReply::finished, this, [this, reply](){
-            onReplyFinished(reply);
-        });
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_unsavedIcons.insert(getPageKey(pageUrl), pageIcon);
     }
+
+    startSave(iconUrl, pageUrl, pageIcon);
 }
 
 void FaviconManager::onReplyFinished(QNetworkReply *reply)
@@ -186,20 +251,7 @@ void FaviconManager::onReplyFinished(QNetworkReply *reply)
     }
 
     if (success)
-    {
-        QIcon icon(QPixmap::fromImage(img));
-        const int iconId = m_faviconStore->getFaviconIdForIconUrl(reply->url());
-        FaviconData &record = m_faviconStore->getDataRecord(iconId);
-        record.iconData = CommonUtil::iconToBase64(icon);
-
-        m_faviconStore->saveDataRecord(record);
-
-        auto it = m_iconMap.find(iconId);
-        if (it != m_iconMap.end())
-            it->second = icon;
-        else
-            m_iconMap.emplace(std::make_pair(iconId, icon));
-    }
+        startSave(reply->url(), QUrl(), QIcon(QPixmap::fromImage(img)));
     else
         qDebug() << "FaviconManager::onReplyFinished - failed to load image from response. Format was " << format;
 
@@ -210,3 +262,123 @@ QString FaviconManager::getUrlAsString(const QUrl &url) const
 {
     return url.toString(QUrl::RemoveUserInfo | QUrl::RemoveQuery | QUrl::RemoveFragment);
 }
+
+QString FaviconManager::getPageKey(const QUrl &url)
+{
+    return url.toString();
+}
+
+QString FaviconManager::getMissingIconKey(const QUrl &url)
+{
+    const QString domain = FaviconStore::getDomainKey(url);
+    if (!domain.isEmpty())
+        return domain;
+
+    const QString host = FaviconStore::getHostKey(url);
+    if (!host.isEmpty())
+        return host;
+
+    return url.toString();
+}
+
+bool FaviconManager::findCachedIcon(const QUrl &url, QIcon &icon)
+{
+    const QString pageKey = getPageKey(url);
+
+    auto unsavedIt = m_unsavedIcons.find(pageKey);
+    if (unsavedIt != m_unsavedIcons.end())
+    {
+        icon = *unsavedIt;
+        return true;
+    }
+
+    // Pages without a favicon are not counted as misses, since they are not loaded again
+    if (!m_pageIconIds.has(pageKey) && m_keysWithoutIcon.has(getMissingIconKey(url)))
+    {
+        icon = QIcon(QLatin1String(":/blank_favicon.png"));
+        return true;
+    }
+
+    const int *iconId = m_pageIconIds.find(pageKey);
+    if (iconId == nullptr)
+        return false;
+
+    if (const QIcon *cachedIcon = m_iconCache.find(*iconId))
+    {
+        icon = *cachedIcon;
+        return true;
+    }
+
+    return false;
+}
+
+std::pair<int, QImage> FaviconManager::readIcon(const QUrl &url)
+{
+    const int iconId = m_faviconStore->getFaviconId(url);
+    if (iconId < 0)
+        return std::make_pair(iconId, QImage());
+
+    const QByteArray iconData = m_faviconStore->getIconData(iconId);
+    if (iconData.isEmpty())
+        return std::make_pair(iconId, QImage());
+
+    return std::make_pair(iconId, decodeIcon(iconData));
+}
+
+FaviconManager::SaveResult FaviconManager::writeIcon(const QUrl &iconUrl, const QUrl &pageUrl, const QImage &image)
+{
+    SaveResult result { m_faviconStore->getFaviconIdForIconUrl(iconUrl), false, false };
+
+    // add page url -> icon mapping to favicon store
+    if (!pageUrl.isEmpty())
+        m_faviconStore->addPageMapping(pageUrl, result.IconId);
+
+    const QByteArray iconData = encodeIcon(image);
+    if (!iconData.isEmpty())
+    {
+        m_faviconStore->setIconData(result.IconId, iconData);
+        result.IsSaved = true;
+    }
+    else
+        result.NeedsDownload = m_faviconStore->getIconData(result.IconId).isEmpty();
+
+    return result;
+}
+
+void FaviconManager::cacheIcon(int iconId, const QIcon &icon, const QImage &image)
+{
+    const std::size_t numBytes = static_cast<std::size_t>(image.bytesPerLine()) * static_cast<std::size_t>(image.height());
+    m_iconCache.put(iconId, icon, numBytes);
+}
+
+void FaviconManager::downloadIcon(const QUrl &iconUrl)
+{
+    if (!m_networkAccessManager)
+        return;
+
+    QNetworkRequest request(iconUrl);
+    QNetworkReply *reply = m_networkAccessManager->get(request);
+    if (reply->isFinished())
+        onReplyFinished(reply);
+    else
+    {
+        connect(reply, &QNetworkReply::finished, this, [this, reply](){
+            onReplyFinished(reply);
+        });
+    }
+}
+
+QImage FaviconManager::decodeIcon(const QByteArray &iconData)
+{
+    return QImage::fromData(iconData, "PNG");
+}
+
+QByteArray FaviconManager::encodeIcon(const QImage &image)
+{
+    QByteArray iconData;
+    QBuffer buffer(&iconData);
+    if (image.isNull() || !image.save(&buffer, "PNG"))
+        return QByteArray();
+
+    return iconData;
+}
@@ -1,25 +1,58 @@
 #ifndef FAVICONMANAGER_H
 #define FAVICONMANAGER_H
 
+#include "CommonUtil.h"
 #include "DatabaseTaskScheduler.h"
 #include "DatabaseWorker.h"
 #include "FaviconStore.h"
 #include "FaviconTypes.h"
-#include "LRUCache.h"
+#include "WeightedLRUCache.h"
 
-#include <unordered_map>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <utility>
+#include <vector>
 
+#include <QByteArray>
 #include <QHash>
 #include <QIcon>
+#include <QImage>
 #include <QObject>
+#include <QPointer>
 #include <QString>
+#include <QThreadPool>
 #include <QUrl>
 
 class NetworkAccessManager;
 class QNetworkReply;
 
+/**
+ * @struct FaviconCacheStats
+ * @brief Usage statistics of the cache of decoded favicons
+ */
+struct FaviconCacheStats
+{
+    /// Number of favicons in the cache
+    std::size_t NumIcons;
+
+    /// Approximate number of bytes used by the decoded favicons
+    std::size_t NumBytes;
+
+    /// Maximum number of bytes that the decoded favicons may use
+    std::size_t Capacity;
+
+    /// Number of favicon requests that were answered from the cache
+    uint64_t Hits;
+
+    /// Number of favicon requests that required a favicon to be loaded from the database
+    uint64_t Misses;
+
+    /// Number of favicons removed from the cache to stay within its capacity
+    uint64_t Evictions;
+};
+
 /**
  * @class FaviconManager
  * @brief Acts as an interface between the \ref FaviconStore and the components
@@ -37,10 +70,23 @@ class FaviconManager : public QObject
     /// new icons as they are referenced by a web page.
     void setNetworkAccessManager(NetworkAccessManager *networkAccessManager);
 
-    /// Searches for a favicon associated with the given URL, returning either the favicon
-    /// or an empty favicon if it could not be found
+    /// Returns the cached favicon associated with the given URL without reading the database. If the favicon
+    /// has not been loaded yet, a placeholder is returned and the favicon is loaded in the background
     QIcon getFavicon(const QUrl &url);
 
+    /**
+     * @brief Searches for a favicon associated with the given URL without reading or decoding it on the calling thread.
+     *        The callback is called immediately if the favicon is cached or known not to exist, and otherwise
+     *        in the thread of the favicon manager once the favicon has been loaded, as long as the receiver still exists.
+     * @param url URL of the web page
+     * @param receiver Object that the callback refers to
+     * @param callback Called with the favicon, or an empty favicon if it could not be found
+     */
+    void loadFavicon(const QUrl &url, QObject *receiver, std::function<void(const QIcon&)> callback);
+
+    /// Returns the usage statistics of the decoded favicon cache
+    FaviconCacheStats getCacheStats() const;
+
     /**
      * @brief Attempts to update favicon for a specific URL in the database.
      * @param iconUrl The location in which the favicon is stored.
@@ -53,25 +99,107 @@ private Q_SLOTS:
     /// Called after the request for a favicon has been completed
     void onReplyFinished(QNetworkReply *reply);
 
+    /// Reads and decodes the favicon of the given page URL in the background, then passes it to the pending callbacks
+    void startLoad(const QUrl &url);
+
 private:
+    /// A callback waiting for a favicon to be loaded
+    struct PendingCallback
+    {
+        /// Object that the callback refers to
+        QPointer<QObject> Receiver;
+
+        /// Called with the loaded favicon
+        std::function<void(const QIcon&)> Callback;
+    };
+
+    /// Result of saving a favicon in the background
+    struct SaveResult
+    {
+        /// Identifier of the favicon in the \ref FaviconStore
+        int IconId;
+
+        /// True if the image of the favicon was written to the database
+        bool IsSaved;
+
+        /// True if the favicon has no image in the database, and should be downloaded
+        bool NeedsDownload;
+    };
+
     /// Returns the given URL in string form
     QString getUrlAsString(const QUrl &url) const;
 
+    /// Returns the key of the given page URL in \ref m_pageIconIds
+    static QString getPageKey(const QUrl &url);
+
+    /// Returns the key under which the given page URL is recorded in \ref m_keysWithoutIcon when it has no
+    /// favicon. This is its domain, or its host or the URL itself if it has none, since a page without a favicon
+    /// has none to fall back to on its host or domain either
+    static QString getMissingIconKey(const QUrl &url);
+
+    /// Sets the icon to the cached favicon of the given page URL, returning true if the favicon is
+    /// cached or known not to exist. Must be called with the mutex held
+    bool findCachedIcon(const QUrl &url, QIcon &icon);
+
+    /// Adds the callback to the pending load of the given page URL's favicon, starting the load if there is none
+    void requestLoad(const QUrl &url, QObject *receiver, std::function<void(const QIcon&)> &&callback);
+
+    /// Saves the favicon with the given URL in the background and maps the page URL to it, unless the page URL is
+    /// empty. The favicon is downloaded afterwards if neither the given icon nor the database has an image of it
+    void startSave(const QUrl &iconUrl, const QUrl &pageUrl, const QIcon &icon);
+
+    /// Reads the favicon ID of the given page URL and decodes its icon. Called from the load thread pool
+    std::pair<int, QImage> readIcon(const QUrl &url);
+
+    /// Writes the favicon and the page mapping of \ref startSave to the database. Called from the load thread pool
+    SaveResult writeIcon(const QUrl &iconUrl, const QUrl &pageUrl, const QImage &image);
+
+    /// Adds the given favicon to the cache, replacing any previous version of it. Must be called with the mutex held
+    void cacheIcon(int iconId, const QIcon &icon, const QImage &image);
+
+    /// Downloads the favicon at the given URL, which is saved once the reply has finished
+    void downloadIcon(const QUrl &iconUrl);
+
+    /// Returns the image that is encoded in the given icon data
+    static QImage decodeIcon(const QByteArray &iconData);
+
+    /// Returns the encoded form of the image, as it is stored in the database
+    static QByteArray encodeIcon(const QImage &image);
+
 private:
-    /// Favicon data store
+    /// Favicon data store. Only used by the tasks of \ref m_loadPool once the manager has been constructed
     std::unique_ptr<FaviconStore> m_faviconStore;
 
     /// Used to download icons when a new one is referenced
     NetworkAccessManager *m_networkAccessManager;
 
-    /// Mapping of favicon IDs (as stored in \ref FaviconStore ) to their corresponding QIcons
-    std::unordered_map<int, QIcon> m_iconMap;
+    /// Cache of the most recently used favicons, mapping their IDs (as stored in \ref FaviconStore ) to their
+    /// decoded icons. Weighted by the number of bytes in each icon's image
+    WeightedLRUCache<int, QIcon> m_iconCache;
 
-    /// Cache of most recently visited URLs and the icons associated with those pages
-    LRUCache<std::string, QIcon> m_iconCache;
+    /// Favicon IDs of the most recently used page URLs, including those that fall back to the icon of their
+    /// host or domain. Each page has a weight of one, so the capacity is a number of pages. Lookups of pages
+    /// that are not in the map are counted as cache misses
+    WeightedLRUCache<QString, int> m_pageIconIds;
 
-    /// Used when updating the LRU cache for thread safety
+    /// Domains, hosts or page URLs without a favicon (see \ref getMissingIconKey ), which are not looked up
+    /// again until a page that belongs to them is given a favicon
+    WeightedLRUCache<QString, bool> m_keysWithoutIcon;
+
+    /// Favicons given to \ref updateIcon that are still being saved, by page key
+    QHash<QString, QIcon> m_unsavedIcons;
+
+    /// Callbacks of the favicons being loaded in the background, by page URL
+    QHash<QUrl, std::vector<PendingCallback>> m_pendingLoads;
+
+    /// Guards the in-memory caches and maps above, since favicons are requested from multiple threads.
+    /// It is never held while the favicon store is in use
     mutable std::mutex m_mutex;
+
+    /// Reads, decodes, encodes and writes favicons in the background. It runs one task at a time, so the
+    /// favicon store is used in the order of the requests and needs no lock. Declared last, so that it waits
+    /// for its tasks before the rest of the manager is destroyed
+    QThreadPool m_loadPool;
 };
 
 #endif // FAVICONMANAGER_H
@@ -2,14 +2,25 @@
 #include "FaviconStore.h"
 #include "URL.h"
 
-#include <array>
+#include <utility>
+#include <vector>
+
 #include <QDebug>
 
+/// Value of the Encoding column of icon data that was saved as a base64 string
+static const int IconEncodingBase64 = 0;
+
+/// Value of the Encoding column of icon data that is saved as is
+static const int IconEncodingRaw = 1;
+
+const int FaviconStore::MaxCachedPageMappings = 16384;
+
 FaviconStore::FaviconStore(const QString &databaseFile) :
     DatabaseWorker(databaseFile),
-    m_originMap(),
-    m_iconDataMap(),
+    m_iconUrlMap(),
     m_webPageMap(),
+    m_hostMap(),
+    m_domainMap(),
     m_newFaviconID(1),
     m_newDataID(1),
     m_queryMap()
@@ -29,37 +40,39 @@ int FaviconStore::getFaviconId(const QUrl &url)
     if (it != m_webPageMap.end())
         return *it;
 
-    auto iconQuery = m_database.prepare(R"(SELECT FaviconID FROM FaviconMap WHERE PageURL LIKE ?)");
-
-    QString searchTemplate("%%1%");
-    std::array<QString, 2> searchTerms = { searchTemplate.arg(url.host()),
-                                           searchTemplate.arg(URL(url).getSecondLevelDomain()) };
-    for (size_t i = 0; i < searchTerms.size(); ++i)
+    sqlite::PreparedStatement &mapQuery = m_queryMap.at(StoredQuery::FindPageMapping);
+    mapQuery.reset();
+    mapQuery << url;
+    if (mapQuery.next())
     {
-        iconQuery << searchTerms.at(i);
+        int iconId = 0;
+        mapQuery >> iconId;
+        cachePageMapping(url, iconId);
+        return iconId;
+    }
 
-        if (iconQuery.next())
-        {
-            int iconId = 0;
-            iconQuery >> iconId;
-            return iconId;
-        }
+    // Fall back to the icon of another page on the same host, and then to one on the same domain
+    const QString host = getHostKey(url);
+    if (host.isEmpty())
+        return -1;
 
-        iconQuery.reset();
-    }
+    const int iconId = findFaviconIdByKey(StoredQuery::FindIconByHost, m_hostMap, host);
+    if (iconId >= 0)
+        return iconId;
 
-    return -1;
+    const QString domain = getDomainKey(url);
+    if (domain.isEmpty())
+        return -1;
+
+    return findFaviconIdByKey(StoredQuery::FindIconByDomain, m_domainMap, domain);
 }
 
 int FaviconStore::getFaviconIdForIconUrl(const QUrl &url)
 {
-    for (const auto &it : m_originMap)
-    {
-        if (CommonUtil::doUrlsMatch(url, it.second, true))
-            return it.first;
-        if (url.matches(it.second, QUrl::RemoveScheme | QUrl::RemoveQuery | QUrl::RemoveFragment))
-            return it.first;
-    }
+    const URLMatchKey iconUrlKey = getIconUrlKey(url);
+    auto it = m_iconUrlMap.find(iconUrlKey);
+    if (it != m_iconUrlMap.end())
+        return it->second;
 
     auto idQuery = m_database.prepare(R"(SELECT FaviconID FROM Favicons WHERE URL = ?)");
     idQuery << url;
@@ -79,45 +92,69 @@ int FaviconStore::getFaviconIdForIconUrl(const QUrl &url)
     if (!insertStmt.execute())
         qWarning() << "In FaviconStore::getFaviconIdForIconUrl - could not add favicon metadata to Favicons table.";
 
+    m_iconUrlMap.emplace(iconUrlKey, id);
     return id;
 }
 
-QByteArray FaviconStore::getIconData(int faviconId) const
+QByteArray FaviconStore::getIconData(int faviconId)
 {
-    auto it = m_iconDataMap.find(faviconId);
-    if (it != m_iconDataMap.end())
-        return it->second.iconData;
+    sqlite::PreparedStatement &stmt = m_queryMap.at(StoredQuery::FindIconData);
+    stmt.reset();
+    stmt << faviconId;
+    if (!stmt.next())
+        return QByteArray();
+
+    int dataId = 0, encoding = IconEncodingRaw;
+    QByteArray iconData;
+    stmt >> dataId
+         >> iconData
+         >> encoding;
+
+    // Icons saved by older versions of the browser are converted as they are read
+    if (encoding == IconEncodingBase64 && !iconData.isEmpty())
+    {
+        iconData = QByteArray::fromBase64(iconData);
+
+        sqlite::PreparedStatement &updateStmt = m_queryMap.at(StoredQuery::UpdateIconData);
+        updateStmt.reset();
+        updateStmt << iconData
+                   << dataId;
+        if (!updateStmt.execute())
+            qWarning() << "In FaviconStore::getIconData - could not convert favicon data.";
+    }
 
-    return QByteArray();
+    return iconData;
 }
 
-FaviconData &FaviconStore::getDataRecord(int faviconId)
+void FaviconStore::setIconData(int faviconId, const QByteArray &iconData)
 {
-    auto it = m_iconDataMap.find(faviconId);
-    if (it != m_iconDataMap.end())
-        return it->second;
-
-    FaviconData iconData;
-    iconData.faviconId = faviconId;
-    iconData.id = m_newDataID++;
-
-    sqlite::PreparedStatement &stmt = m_queryMap.at(StoredQuery::InsertIconData);
-    stmt.reset();
-    stmt << iconData;
-    if (!stmt.execute())
-        qWarning() << "In FaviconStore::getDataRecord - could not add favicon icon data to FaviconData table";
+    sqlite::PreparedStatement &findStmt = m_queryMap.at(StoredQuery::FindIconDataId);
+    findStmt.reset();
+    findStmt << faviconId;
+    if (findStmt.next())
+    {
+        int dataId = 0;
+        findStmt >> dataId;
+
+        sqlite::PreparedStatement &updateStmt = m_queryMap.at(StoredQuery::UpdateIconData);
+        updateStmt.reset();
+        updateStmt << iconData
+                   << dataId;
+        if (!updateStmt.execute())
+            qWarning() << "In FaviconStore::setIconData - could not update favicon data.";
+        return;
+    }
 
-    auto result = m_iconDataMap.emplace(std::make_pair(faviconId, iconData));
-    return result.first->second;
-}
+    FaviconData dataRecord;
+    dataRecord.id = m_newDataID++;
+    dataRecord.faviconId = faviconId;
+    dataRecord.iconData = iconData;
 
-void FaviconStore::saveDataRecord(FaviconData &dataRecord)
-{
-    auto stmt = m_database.prepare(R"(UPDATE FaviconData SET Data = ? WHERE DataID = ?)");
-    stmt << dataRecord.iconData
-         << dataRecord.id;
-    if (!stmt.execute())
-        qWarning() << "In FaviconStore::saveDataRecord - could not update favicon data.";
+    sqlite::PreparedStatement &insertStmt = m_queryMap.at(StoredQuery::InsertIconData);
+    insertStmt.reset();
+    insertStmt << dataRecord;
+    if (!insertStmt.execute())
+        qWarning() << "In FaviconStore::setIconData - could not add favicon icon data to FaviconData table";
 }
 
 void FaviconStore::addPageMapping(const QUrl &webPageUrl, int faviconId)
@@ -131,16 +168,71 @@ void FaviconStore::addPageMapping(const QUrl &webPageUrl, int faviconId)
         *it = faviconId;
     }
     else
-        m_webPageMap.insert(webPageUrl, faviconId);
+        cachePageMapping(webPageUrl, faviconId);
+
+    const QString host = getHostKey(webPageUrl);
+    const QString domain = getDomainKey(webPageUrl);
 
-    auto stmt = m_database.prepare(R"(INSERT OR REPLACE INTO FaviconMap(PageURL, FaviconID) VALUES (?, ?))");
+    // Pages on the same host or domain without their own mapping will now fall back to this icon
+    if (!host.isEmpty())
+        m_hostMap.insert(host, faviconId);
+    if (!domain.isEmpty())
+        m_domainMap.insert(domain, faviconId);
+
+    sqlite::PreparedStatement &stmt = m_queryMap.at(StoredQuery::InsertPageMapping);
+    stmt.reset();
     stmt << webPageUrl
-         << faviconId;
+         << faviconId
+         << host
+         << domain;
 
     if (!stmt.execute())
         qDebug() << "In FaviconStore::addPageMapping - could not update webpage mapping.";
 }
 
+void FaviconStore::cachePageMapping(const QUrl &webPageUrl, int faviconId)
+{
+    // The mappings are kept in the database, so a full map is dropped rather than growing with every page visited
+    if (m_webPageMap.size() >= MaxCachedPageMappings)
+        m_webPageMap.clear();
+
+    m_webPageMap.insert(webPageUrl, faviconId);
+}
+
+int FaviconStore::findFaviconIdByKey(StoredQuery query, QHash<QString, int> &cache, const QString &key)
+{
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return *it;
+
+    sqlite::PreparedStatement &stmt = m_queryMap.at(query);
+    stmt.reset();
+    stmt << key;
+
+    int iconId = -1;
+    if (stmt.next())
+        stmt >> iconId;
+
+    // Misses are cached as well, since the same hosts are looked up repeatedly
+    cache.insert(key, iconId);
+    return iconId;
+}
+
+QString FaviconStore::getHostKey(const QUrl &url)
+{
+    return url.host().toLower();
+}
+
+QString FaviconStore::getDomainKey(const QUrl &url)
+{
+    return URL(url).getSecondLevelDomain().toLower();
+}
+
+URLMatchKey FaviconStore::getIconUrlKey(const QUrl &url)
+{
+    return URLMatchKey(url.adjusted(QUrl::RemoveQuery | QUrl::RemoveFragment), true);
+}
+
 void FaviconStore::setupQueries()
 {
     m_queryMap.clear();
@@ -150,13 +242,31 @@ void FaviconStore::setupQueries()
                                m_database.prepare(R"(INSERT OR REPLACE INTO Favicons(FaviconID, URL) VALUES (?, ?))")));
     m_queryMap.insert(
                 std::make_pair(StoredQuery::InsertIconData,
-                               m_database.prepare(R"(INSERT OR REPLACE INTO FaviconData(DataID, FaviconID, Data) VALUES (?, ?, ?))")));
+                               m_database.prepare(R"(INSERT OR REPLACE INTO FaviconData(DataID, FaviconID, Data, Encoding) VALUES (?, ?, ?, 1))")));
     m_queryMap.insert(
                 std::make_pair(StoredQuery::FindIconExactURL,
                                m_database.prepare(R"(SELECT URL FROM Favicons WHERE FaviconID = (SELECT m.FaviconID FROM FaviconMap m WHERE m.PageURL = ?))")));
     m_queryMap.insert(
-                std::make_pair(StoredQuery::FindIconLikeURL,
-                               m_database.prepare(R"(SELECT URL FROM Favicons WHERE FaviconID IN (SELECT m.FaviconID FROM FaviconMap m WHERE m.PageURL LIKE ?))")));
+                std::make_pair(StoredQuery::FindIconByHost,
+                               m_database.prepare(R"(SELECT FaviconID FROM FaviconMap WHERE Host = ? LIMIT 1)")));
+    m_queryMap.insert(
+                std::make_pair(StoredQuery::FindIconByDomain,
+                               m_database.prepare(R"(SELECT FaviconID FROM FaviconMap WHERE Domain = ? LIMIT 1)")));
+    m_queryMap.insert(
+                std::make_pair(StoredQuery::InsertPageMapping,
+                               m_database.prepare(R"(INSERT OR REPLACE INTO FaviconMap(PageURL, FaviconID, Host, Domain) VALUES (?, ?, ?, ?))")));
+    m_queryMap.insert(
+                std::make_pair(StoredQuery::FindIconData,
+                               m_database.prepare(R"(SELECT DataID, Data, Encoding FROM FaviconData WHERE FaviconID = ? LIMIT 1)")));
+    m_queryMap.insert(
+                std::make_pair(StoredQuery::FindIconDataId,
+                               m_database.prepare(R"(SELECT DataID FROM FaviconData WHERE FaviconID = ? LIMIT 1)")));
+    m_queryMap.insert(
+                std::make_pair(StoredQuery::UpdateIconData,
+                               m_database.prepare(R"(UPDATE FaviconData SET Data = ?, Encoding = 1 WHERE DataID = ?)")));
+    m_queryMap.insert(
+                std::make_pair(StoredQuery::FindPageMapping,
+                               m_database.prepare(R"(SELECT FaviconID FROM FaviconMap WHERE PageURL = ?)")));
 }
 
 bool FaviconStore::hasProperStructure()
@@ -170,10 +280,10 @@ void FaviconStore::setup()
 {   
     // Setup table structures    
     exec(QLatin1String("CREATE TABLE IF NOT EXISTS Favicons(FaviconID INTEGER PRIMARY KEY, URL TEXT UNIQUE)"));
-    exec(QLatin1String("CREATE TABLE IF NOT EXISTS FaviconData(DataID INTEGER PRIMARY KEY, FaviconID INTEGER NOT NULL, Data BLOB, "
+    exec(QLatin1String("CREATE TABLE IF NOT EXISTS FaviconData(DataID INTEGER PRIMARY KEY, FaviconID INTEGER NOT NULL, Data BLOB, Encoding INTEGER DEFAULT 0, "
                "FOREIGN KEY(FaviconID) REFERENCES Favicons(FaviconID))"));
     exec(QLatin1String("CREATE TABLE IF NOT EXISTS FaviconMap(MapID INTEGER PRIMARY KEY, PageURL TEXT UNIQUE, FaviconID INTEGER NOT NULL, "
-               "FOREIGN KEY(FaviconID) REFERENCES Favicons(FaviconID))"));
+               "Host TEXT, Domain TEXT, FOREIGN KEY(FaviconID) REFERENCES Favicons(FaviconID))"));
 
     // Create indices
     exec(QLatin1String("CREATE INDEX IF NOT EXISTS favicons_url ON Favicons(URL)"));
@@ -181,12 +291,16 @@ void FaviconStore::setup()
     exec(QLatin1String("CREATE INDEX IF NOT EXISTS favicon_data_foreign_id ON FaviconData(FaviconID)"));
     exec(QLatin1String("CREATE INDEX IF NOT EXISTS favicon_map_url ON FaviconMap(PageURL)"));
     exec(QLatin1String("CREATE INDEX IF NOT EXISTS favicon_map_data_id ON FaviconMap(FaviconID)"));
+    exec(QLatin1String("CREATE INDEX IF NOT EXISTS favicon_map_host ON FaviconMap(Host)"));
+    exec(QLatin1String("CREATE INDEX IF NOT EXISTS favicon_map_domain ON FaviconMap(Domain)"));
 }
 
 void FaviconStore::load()
 {
+    checkForUpdate();
     setupQueries();
 
+    // Icon data and page mappings are read from the database as they are requested
     auto query = m_database.prepare(R"(SELECT FaviconID, URL FROM Favicons)");
     while (query.next())
     {
@@ -194,28 +308,7 @@ void FaviconStore::load()
         QUrl iconUrl;
         query >> iconId
               >> iconUrl;
-        m_originMap.emplace(std::make_pair(iconId, iconUrl));
-    }
-
-    query = m_database.prepare(R"(SELECT DataID, FaviconID, Data FROM FaviconData)");
-    while (query.next())
-    {
-        FaviconData data;
-        query >> data;
-
-        m_iconDataMap.emplace(std::make_pair(data.faviconId, data));
-    }
-
-    query = m_database.prepare(R"(SELECT PageURL, FaviconID FROM FaviconMap)");
-    while (query.next())
-    {
-        QUrl pageUrl;
-        int faviconId = 0;
-
-        query >> pageUrl
-              >> faviconId;
-
-        m_webPageMap.insert(pageUrl, faviconId);
+        m_iconUrlMap.emplace(getIconUrlKey(iconUrl), iconId);
     }
 
     // Fetch maximum favicon ID and data ID values so new entry IDs can be calculated with more ease
@@ -232,3 +325,93 @@ void FaviconStore::load()
         m_newDataID++;
     }
 }
+
+void FaviconStore::checkForUpdate()
+{
+    auto stmt = m_database.prepare(R"(PRAGMA table_info(FaviconData))");
+    if (!stmt.execute())
+        return;
+
+    bool hasEncodingColumn = false;
+    const QString encodingColumn("Encoding");
+
+    while (stmt.next())
+    {
+        int cid = 0;
+        QString colName;
+
+        stmt >> cid
+             >> colName;
+
+        if (colName.compare(encodingColumn) == 0)
+            hasEncodingColumn = true;
+    }
+
+    // Existing icon data is base64-encoded, and is converted by getIconData()
+    if (!hasEncodingColumn && !exec(QLatin1String("ALTER TABLE FaviconData ADD Encoding INTEGER DEFAULT 0")))
+        qDebug() << "Error updating favicon data table with encoding column";
+
+    stmt = m_database.prepare(R"(PRAGMA table_info(FaviconMap))");
+    if (!stmt.execute())
+        return;
+
+    bool hasHostColumn = false;
+    const QString hostColumn("Host");
+
+    while (stmt.next())
+    {
+        int cid = 0;
+        QString colName;
+
+        stmt >> cid
+             >> colName;
+
+        if (colName.compare(hostColumn) == 0)
+            hasHostColumn = true;
+    }
+
+    if (hasHostColumn)
+        return;
+
+    if (!exec(QLatin1String("ALTER TABLE FaviconMap ADD Host TEXT"))
+            || !exec(QLatin1String("ALTER TABLE FaviconMap ADD Domain TEXT")))
+    {
+        qDebug() << "Error updating favicon map table with host and domain columns";
+        return;
+    }
+
+    exec(QLatin1String("CREATE INDEX IF NOT EXISTS favicon_map_host ON FaviconMap(Host)"));
+    exec(QLatin1String("CREATE INDEX IF NOT EXISTS favicon_map_domain ON FaviconMap(Domain)"));
+
+    // Fill in the host and domain of each existing mapping
+    std::vector<std::pair<int, QUrl>> mappings;
+    auto queryMappings = m_database.prepare(R"(SELECT MapID, PageURL FROM FaviconMap)");
+    while (queryMappings.next())
+    {
+        int mapId = 0;
+        QUrl pageUrl;
+        queryMappings >> mapId
+                      >> pageUrl;
+        mappings.push_back(std::make_pair(mapId, pageUrl));
+    }
+
+    if (!m_database.beginTransaction())
+    {
+        qWarning() << "FaviconStore::checkForUpdate - could not start transaction";
+        return;
+    }
+
+    auto updateStmt = m_database.prepare(R"(UPDATE FaviconMap SET Host = ?, Domain = ? WHERE MapID = ?)");
+    for (const auto &mapping : mappings)
+    {
+        updateStmt.reset();
+        updateStmt << getHostKey(mapping.second)
+                   << getDomainKey(mapping.second)
+                   << mapping.first;
+        if (!updateStmt.execute())
+            qWarning() << "FaviconStore::checkForUpdate - could not set the host of a page mapping";
+    }
+
+    if (!m_database.commitTransaction())
+        qWarning() << "FaviconStore::checkForUpdate - could not commit transaction";
+}
@@ -1,12 +1,15 @@
 #ifndef FAVICONSTORAGE_H
 #define FAVICONSTORAGE_H
 
+#include "CommonUtil.h"
 #include "DatabaseWorker.h"
 #include "FaviconTypes.h"
 #include "LRUCache.h"
+#include "URLMatchKey.h"
 
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <QHash>
 #include <QIcon>
 #include <QSet>
@@ -37,24 +40,29 @@ class FaviconStore : public DatabaseWorker
     /// Returns the identifier of the favicon associated with the given data URL (ie the URL of the icon itself)
     int getFaviconIdForIconUrl(const QUrl &url);
 
-    /// Returns the icon data for the favicon with the given identifier, or an empty
-    /// byte array if it could not be found
-    QByteArray getIconData(int faviconId) const;
+    /// Reads the encoded image of the favicon with the given identifier from the database, returning
+    /// an empty byte array if the favicon has no image
+    QByteArray getIconData(int faviconId);
 
-    /// Returns a reference to the icon data structure associated with the given favicon ID,
-    /// inserting a new record if it was not found.
-    FaviconData &getDataRecord(int faviconId);
-
-    /// Saves the given record to the database
-    void saveDataRecord(FaviconData &dataRecord);
+    /// Saves the encoded image of the favicon with the given identifier
+    void setIconData(int faviconId, const QByteArray &iconData);
 
     /// Maps the given web page to a favicon, referenced by its unique ID
     void addPageMapping(const QUrl &webPageUrl, int faviconId);
 
+    /// Returns the key of the URL's host in the host column of the page mappings
+    static QString getHostKey(const QUrl &url);
+
+    /// Returns the key of the URL's domain in the domain column of the page mappings
+    static QString getDomainKey(const QUrl &url);
+
 private:
     /// Instantiates the stored query objects
     void setupQueries();
 
+    /// Checks if the table structure needs to be updated before loading any data
+    void checkForUpdate();
+
 protected:
     /// Returns true if the favicon database contains the table structure(s) needed for it to function properly,
     /// false if else.
@@ -73,19 +81,46 @@ class FaviconStore : public DatabaseWorker
         InsertFavicon,
         InsertIconData,
         FindIconExactURL,
-        FindIconLikeURL
+        FindIconByHost,
+        FindIconByDomain,
+        FindIconData,
+        FindIconDataId,
+        UpdateIconData,
+        FindPageMapping,
+        InsertPageMapping
     };
 
-private:
-    /// Mapping of unique favicon IDs to their respective data URLs
-    FaviconOriginMap m_originMap;
+    /// Looks up the favicon ID of a page with the given host or domain key, first in the given cache and then with
+    /// the given query. Returns -1 if there is no such page
+    int findFaviconIdByKey(StoredQuery query, QHash<QString, int> &cache, const QString &key);
+
+    /// Adds the favicon ID of the given page to the map of known page mappings, emptying the map first if it is full
+    void cachePageMapping(const QUrl &webPageUrl, int faviconId);
 
-    /// Mapping of unique favicon IDs to their icon data containers
-    FaviconDataMap m_iconDataMap;
+    /// Returns the normalized form of a favicon URL, which ignores its scheme, user info, "www." prefix,
+    /// trailing slash, query and fragment
+    static URLMatchKey getIconUrlKey(const QUrl &url);
 
-    /// Mapping of visited URLs to their corresponding favicon IDs
+private:
+    /// Mapping of the normalized URLs of all favicons (see \ref getIconUrlKey ) to their unique IDs
+    std::unordered_map<URLMatchKey, int> m_iconUrlMap;
+
+    /// Mapping of the visited URLs that have been looked up or added since the database was opened to their
+    /// corresponding favicon IDs. Other mappings stay in the database until they are requested, and the map
+    /// is emptied once it holds \ref MaxCachedPageMappings of them
     WebPageIconMap m_webPageMap;
 
+    /// Mapping of the hosts that have been looked up or added since the database was opened to a favicon ID
+    /// of one of their pages, or to -1 if none of their pages has a favicon
+    QHash<QString, int> m_hostMap;
+
+    /// Mapping of the domains that have been looked up or added since the database was opened to a favicon ID
+    /// of one of their pages, or to -1 if none of their pages has a favicon
+    QHash<QString, int> m_domainMap;
+
+    /// Largest number of page mappings kept in \ref m_webPageMap
+    static const int MaxCachedPageMappings;
+
     /// Used when adding new records to the favicon table
     int m_newFaviconID;
 
@@ -75,12 +75,6 @@ struct FaviconMap
     FaviconMap() : id(0), faviconId(0), pageUrl() {}
 };
 
-/// Represents the \ref FaviconOrigin structure as a map. Key = favicon Id, value = URL of icon
-using FaviconOriginMap = std::unordered_map<int, QUrl>;
-
-/// Represents the \ref FaviconData structure as a map. Key = favicon Id (same as FaviconOriginMap), value = FaviconData structure
-using FaviconDataMap = std::unordered_map<int, FaviconData>;
-
 /// Represents the \ref FaviconMap as a hash map. Key = URL of the web page, value = unique identifier of the favicon.
 using WebPageIconMap = QHash<QUrl, int>;
 
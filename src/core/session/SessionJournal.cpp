@@ -0,0 +1,410 @@
+#include "SessionJournal.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QJsonValue>
+#include <QSaveFile>
+
+const int SessionJournal::CompactionThreshold = 500;
+
+/// Returns a change of the given type, which affects the given window
+static QJsonObject createChange(const QString &type, int windowId)
+{
+    QJsonObject change;
+    change.insert(QLatin1String("type"), QJsonValue(type));
+    change.insert(QLatin1String("window"), QJsonValue(windowId));
+    return change;
+}
+
+/// Copies each property of the state into the target object
+static void mergeState(QJsonObject &target, const QJsonObject &state)
+{
+    for (auto it = state.constBegin(); it != state.constEnd(); ++it)
+        target.insert(it.key(), it.value());
+}
+
+SessionJournal::SessionJournal(const QString &sessionFile) :
+    m_sessionFile(sessionFile),
+    m_journalFile(sessionFile + QLatin1String(".journal")),
+    m_windows(),
+    m_tabs(),
+    m_pendingChanges(),
+    m_numJournaledChanges(0),
+    m_maxId(0),
+    m_mutex(),
+    m_condition(),
+    m_tasks(),
+    m_isBusy(false),
+    m_isStopping(false),
+    m_thread()
+{
+    m_thread = std::thread(&SessionJournal::run, this);
+}
+
+SessionJournal::~SessionJournal()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+QJsonObject SessionJournal::load()
+{
+    QJsonObject session;
+    bool hasJournaledChanges = false;
+    post([this, &session, &hasJournaledChanges](){
+        readSession();
+        session = getSession();
+        hasJournaledChanges = m_journalFile.size() > 0;
+    });
+    sync();
+
+    // Fold the journal into the snapshot, so that new changes are not appended after a partially written line
+    if (hasJournaledChanges)
+        compact();
+
+    return session;
+}
+
+void SessionJournal::clear()
+{
+    post([this](){
+        m_windows.clear();
+        m_tabs.clear();
+        writeSnapshot();
+    });
+}
+
+int SessionJournal::getMaxId() const
+{
+    return m_maxId;
+}
+
+void SessionJournal::updateTab(int windowId, int tabId, const QJsonObject &state)
+{
+    QJsonObject change = createChange(QLatin1String("tab"), windowId);
+    change.insert(QLatin1String("tab"), QJsonValue(tabId));
+    change.insert(QLatin1String("state"), QJsonValue(state));
+    post([this, change](){ record(change); });
+}
+
+void SessionJournal::removeTab(int windowId, int tabId)
+{
+    QJsonObject change = createChange(QLatin1String("remove_tab"), windowId);
+    change.insert(QLatin1String("tab"), QJsonValue(tabId));
+    post([this, change](){ record(change); });
+}
+
+void SessionJournal::setTabOrder(int windowId, const std::vector<int> &tabIds)
+{
+    QJsonArray tabArray;
+    for (int tabId : tabIds)
+        tabArray.append(QJsonValue(tabId));
+
+    QJsonObject change = createChange(QLatin1String("tab_order"), windowId);
+    change.insert(QLatin1String("tabs"), QJsonValue(tabArray));
+    post([this, change](){ record(change); });
+}
+
+void SessionJournal::updateWindow(int windowId, const QJsonObject &state)
+{
+    QJsonObject change = createChange(QLatin1String("window"), windowId);
+    change.insert(QLatin1String("state"), QJsonValue(state));
+    post([this, change](){ record(change); });
+}
+
+void SessionJournal::removeWindow(int windowId)
+{
+    const QJsonObject change = createChange(QLatin1String("remove_window"), windowId);
+    post([this, change](){ record(change); });
+}
+
+void SessionJournal::compact()
+{
+    post([this](){ writeSnapshot(); });
+}
+
+void SessionJournal::sync()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this](){ return m_tasks.empty() && !m_isBusy; });
+}
+
+void SessionJournal::post(std::function<void()> &&task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+
+    m_condition.notify_all();
+}
+
+void SessionJournal::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_condition.wait(lock, [this](){ return !m_tasks.empty() || m_isStopping; });
+        if (m_tasks.empty())
+            break;
+
+        std::deque<std::function<void()>> tasks;
+        tasks.swap(m_tasks);
+        m_isBusy = true;
+        lock.unlock();
+
+        // Changes that were recorded together are written to the journal at once
+        for (std::function<void()> &task : tasks)
+            task();
+
+        writeJournal();
+
+        lock.lock();
+        m_isBusy = false;
+        m_condition.notify_all();
+    }
+
+    m_journalFile.close();
+}
+
+void SessionJournal::record(const QJsonObject &change)
+{
+    apply(change);
+
+    m_pendingChanges.append(QJsonDocument(change).toJson(QJsonDocument::Compact));
+    m_pendingChanges.append('\n');
+    ++m_numJournaledChanges;
+}
+
+void SessionJournal::apply(const QJsonObject &change)
+{
+    const QString type = change.value(QLatin1String("type")).toString();
+    const int windowId = change.value(QLatin1String("window")).toInt();
+    const int tabId = change.value(QLatin1String("tab")).toInt();
+
+    if (type == QLatin1String("tab"))
+    {
+        mergeState(m_tabs[tabId], change.value(QLatin1String("state")).toObject());
+
+        const std::vector<int> &tabIds = getWindow(windowId).TabIds;
+        if (std::find(tabIds.begin(), tabIds.end(), tabId) == tabIds.end())
+            moveTab(windowId, tabId);
+    }
+    else if (type == QLatin1String("remove_tab"))
+    {
+        m_tabs.erase(tabId);
+        for (auto &window : m_windows)
+        {
+            std::vector<int> &tabIds = window.second.TabIds;
+            tabIds.erase(std::remove(tabIds.begin(), tabIds.end(), tabId), tabIds.end());
+        }
+    }
+    else if (type == QLatin1String("tab_order"))
+    {
+        const QJsonArray tabArray = change.value(QLatin1String("tabs")).toArray();
+        getWindow(windowId).TabIds.clear();
+        for (const QJsonValue &tabValue : tabArray)
+            moveTab(windowId, tabValue.toInt());
+    }
+    else if (type == QLatin1String("window"))
+    {
+        mergeState(getWindow(windowId).State, change.value(QLatin1String("state")).toObject());
+    }
+    else if (type == QLatin1String("remove_window"))
+    {
+        auto it = m_windows.find(windowId);
+        if (it == m_windows.end())
+            return;
+
+        for (int id : it->second.TabIds)
+            m_tabs.erase(id);
+
+        m_windows.erase(it);
+    }
+}
+
+SessionJournal::WindowRecord &SessionJournal::getWindow(int windowId)
+{
+    return m_windows[windowId];
+}
+
+void SessionJournal::moveTab(int windowId, int tabId)
+{
+    // A tab may be dragged from one window to another
+    for (auto &window : m_windows)
+    {
+        std::vector<int> &tabIds = window.second.TabIds;
+        tabIds.erase(std::remove(tabIds.begin(), tabIds.end(), tabId), tabIds.end());
+    }
+
+    getWindow(windowId).TabIds.push_back(tabId);
+}
+
+void SessionJournal::writeJournal()
+{
+    if (m_pendingChanges.isEmpty())
+        return;
+
+    if (m_journalFile.isOpen() || m_journalFile.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        m_journalFile.write(m_pendingChanges);
+        m_journalFile.flush();
+    }
+
+    m_pendingChanges.clear();
+
+    if (m_numJournaledChanges >= CompactionThreshold)
+        writeSnapshot();
+}
+
+void SessionJournal::readSession()
+{
+    m_windows.clear();
+    m_tabs.clear();
+    m_numJournaledChanges = 0;
+    m_maxId = 0;
+
+    QFile snapshotFile(m_sessionFile);
+    if (snapshotFile.open(QIODevice::ReadOnly))
+    {
+        const QJsonDocument sessionDoc = QJsonDocument::fromJson(snapshotFile.readAll());
+        snapshotFile.close();
+
+        const QJsonArray windowArray = sessionDoc.object().value(QLatin1String("windows")).toArray();
+
+        // Sessions saved by older versions of the browser do not identify their windows and tabs,
+        // so they are given identifiers above any that are in use
+        int maxId = 0;
+        for (const QJsonValue &windowValue : windowArray)
+        {
+            const QJsonObject windowObj = windowValue.toObject();
+            maxId = std::max(maxId, windowObj.value(QLatin1String("id")).toInt());
+
+            const QJsonArray tabArray = windowObj.value(QLatin1String("tabs")).toArray();
+            for (const QJsonValue &tabValue : tabArray)
+                maxId = std::max(maxId, tabValue.toObject().value(QLatin1String("id")).toInt());
+        }
+
+        for (const QJsonValue &windowValue : windowArray)
+        {
+            QJsonObject windowObj = windowValue.toObject();
+            const int windowId = windowObj.contains(QLatin1String("id")) ? windowObj.value(QLatin1String("id")).toInt() : ++maxId;
+            const QJsonArray tabArray = windowObj.value(QLatin1String("tabs")).toArray();
+
+            windowObj.remove(QLatin1String("id"));
+            windowObj.remove(QLatin1String("tabs"));
+
+            WindowRecord &window = getWindow(windowId);
+            window.State = windowObj;
+
+            for (const QJsonValue &tabValue : tabArray)
+            {
+                QJsonObject tabObj;
+                if (tabValue.isString())
+                    tabObj.insert(QLatin1String("url"), tabValue);
+                else
+                    tabObj = tabValue.toObject();
+
+                const int tabId = tabObj.contains(QLatin1String("id")) ? tabObj.value(QLatin1String("id")).toInt() : ++maxId;
+
+                // Favicons are no longer stored inline, they are looked up by the URL of their page
+                tabObj.remove(QLatin1String("id"));
+                tabObj.remove(QLatin1String("icon"));
+
+                m_tabs[tabId] = tabObj;
+                window.TabIds.push_back(tabId);
+            }
+        }
+    }
+
+    if (m_journalFile.isOpen())
+        m_journalFile.close();
+
+    if (m_journalFile.open(QIODevice::ReadOnly))
+    {
+        while (!m_journalFile.atEnd())
+        {
+            // A line that cannot be parsed was being written when the browser stopped, and is the last one
+            QJsonParseError parseError;
+            const QJsonDocument changeDoc = QJsonDocument::fromJson(m_journalFile.readLine(), &parseError);
+            if (parseError.error != QJsonParseError::NoError || !changeDoc.isObject())
+                break;
+
+            apply(changeDoc.object());
+            ++m_numJournaledChanges;
+        }
+
+        m_journalFile.close();
+    }
+
+    for (const auto &window : m_windows)
+    {
+        m_maxId = std::max(m_maxId, window.first);
+        for (int tabId : window.second.TabIds)
+            m_maxId = std::max(m_maxId, tabId);
+    }
+}
+
+QJsonObject SessionJournal::getSession() const
+{
+    QJsonArray windowArray;
+    for (const auto &window : m_windows)
+    {
+        QJsonArray tabArray;
+        for (int tabId : window.second.TabIds)
+        {
+            auto it = m_tabs.find(tabId);
+            if (it == m_tabs.end())
+                continue;
+
+            QJsonObject tabObj = it->second;
+            tabObj.insert(QLatin1String("id"), QJsonValue(tabId));
+            tabArray.append(QJsonValue(tabObj));
+        }
+
+        // Skip windows whose tabs have not been recorded yet
+        if (tabArray.isEmpty())
+            continue;
+
+        QJsonObject windowObj = window.second.State;
+        windowObj.insert(QLatin1String("id"), QJsonValue(window.first));
+        windowObj.insert(QLatin1String("tabs"), QJsonValue(tabArray));
+        windowArray.append(QJsonValue(windowObj));
+    }
+
+    QJsonObject sessionObj;
+    sessionObj.insert(QLatin1String("windows"), QJsonValue(windowArray));
+    return sessionObj;
+}
+
+void SessionJournal::writeSnapshot()
+{
+    QSaveFile snapshotFile(m_sessionFile);
+    if (!snapshotFile.open(QIODevice::WriteOnly))
+        return;
+
+    snapshotFile.write(QJsonDocument(getSession()).toJson(QJsonDocument::Compact));
+    if (!snapshotFile.commit())
+        return;
+
+    // The snapshot has replaced the session file and includes every change, so the journal can be emptied
+    m_pendingChanges.clear();
+
+    if (m_journalFile.isOpen())
+        m_journalFile.close();
+
+    if (m_journalFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        m_journalFile.flush();
+
+    m_numJournaledChanges = 0;
+}
@@ -0,0 +1,161 @@
+#ifndef SESSIONJOURNAL_H
+#define SESSIONJOURNAL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QJsonObject>
+#include <QString>
+
+/**
+ * @class SessionJournal
+ * @brief Records the browsing session as it changes, so that it can be restored even if the browser
+ *        does not exit normally.
+ *
+ * The session is kept in two files. The session file holds a snapshot of every window and tab, and the journal
+ * file next to it holds one line of JSON for each change made since the snapshot was written. Each change only
+ * describes the window or tab that it affects. Once enough changes have been journaled, the snapshot is rewritten
+ * by atomically replacing the session file, and the journal is emptied. Since every change describes a final state,
+ * replaying changes that are already part of the snapshot is harmless, and a crash between the two steps loses nothing.
+ *
+ * Windows and tabs are identified by integers chosen by the caller. Either load() or clear() must be called before
+ * any change is recorded. Methods may be called from any thread, and the files are written in order on the journal's
+ * own thread.
+ */
+class SessionJournal
+{
+public:
+    /// Constructs the session journal, given the path of the session file
+    explicit SessionJournal(const QString &sessionFile);
+
+    /// Writes the pending changes to the journal, and stops the thread of the journal
+    ~SessionJournal();
+
+    /**
+     * @brief Reads the saved session from the snapshot and journal, and resumes journaling from it
+     * @return An object with a "windows" array. Each window has an "id" and a "tabs" array, and each tab has an "id"
+     */
+    QJsonObject load();
+
+    /// Discards the saved session, and resumes journaling from an empty session
+    void clear();
+
+    /// Returns the largest window or tab identifier used by the saved session, as of the last call to load()
+    int getMaxId() const;
+
+    /// Records the state of a tab, belonging to the given window. Keys that are not in the state keep their previous value
+    void updateTab(int windowId, int tabId, const QJsonObject &state);
+
+    /// Records the removal of a tab
+    void removeTab(int windowId, int tabId);
+
+    /// Records the order of the tabs in a window
+    void setTabOrder(int windowId, const std::vector<int> &tabIds);
+
+    /// Records the state of a window, such as its geometry. Keys that are not in the state keep their previous value
+    void updateWindow(int windowId, const QJsonObject &state);
+
+    /// Records the removal of a window and its tabs
+    void removeWindow(int windowId);
+
+    /// Writes the session to the snapshot and empties the journal, once the pending changes have been written
+    void compact();
+
+    /// Blocks until every change recorded so far has been written
+    void sync();
+
+    /// Number of journaled changes after which the snapshot is rewritten
+    static const int CompactionThreshold;
+
+private:
+    /// State of a window in the session
+    struct WindowRecord
+    {
+        /// Properties of the window
+        QJsonObject State;
+
+        /// Identifiers of the window's tabs, in order
+        std::vector<int> TabIds;
+    };
+
+    /// Queues a task to run on the journal's thread
+    void post(std::function<void()> &&task);
+
+    /// Runs the queued tasks until the journal is destroyed
+    void run();
+
+    /// Applies the change to the session and adds it to the journal
+    void record(const QJsonObject &change);
+
+    /// Applies a journaled change to the session
+    void apply(const QJsonObject &change);
+
+    /// Returns the record of the given window, creating it if needed
+    WindowRecord &getWindow(int windowId);
+
+    /// Moves the tab to the end of the given window, removing it from any other window
+    void moveTab(int windowId, int tabId);
+
+    /// Writes the changes that were recorded since the last write to the journal file
+    void writeJournal();
+
+    /// Reads the snapshot and journal files into the session
+    void readSession();
+
+    /// Returns the session in the format of the snapshot
+    QJsonObject getSession() const;
+
+    /// Writes the session to the snapshot, then empties the journal
+    void writeSnapshot();
+
+private:
+    /// Path of the snapshot
+    const QString m_sessionFile;
+
+    /// Journal of the changes made since the last snapshot
+    QFile m_journalFile;
+
+    /// Windows of the session, by identifier
+    std::map<int, WindowRecord> m_windows;
+
+    /// State of each tab of the session, by identifier
+    std::unordered_map<int, QJsonObject> m_tabs;
+
+    /// Changes recorded since the last write to the journal file, one per line
+    QByteArray m_pendingChanges;
+
+    /// Number of changes recorded since the snapshot was last written
+    int m_numJournaledChanges;
+
+    /// Largest window or tab identifier found when the session was loaded
+    int m_maxId;
+
+    /// Guards the task queue
+    std::mutex m_mutex;
+
+    /// Signalled when a task is queued, or when the queue has been emptied
+    std::condition_variable m_condition;
+
+    /// Tasks waiting to run on the journal's thread
+    std::deque<std::function<void()>> m_tasks;
+
+    /// True while the journal's thread is running a batch of tasks
+    bool m_isBusy;
+
+    /// Set when the journal is being destroyed
+    bool m_isStopping;
+
+    /// Thread that writes the files
+    std::thread m_thread;
+};
+
+#endif // SESSIONJOURNAL_H
@@ -1,24 +1,72 @@
 #include "SessionManager.h"
 #include "BrowserApplication.h"
 #include "BrowserTabWidget.h"
-#include "CommonUtil.h"
+#include "FaviconManager.h"
 #include "MainWindow.h"
 #include "WebHistory.h"
 #include "WebWidget.h"
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <QByteArray>
-#include <QFile>
 #include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QJsonValue>
-#include <QString>
+#include <QRect>
 #include <QUrl>
 
+/// Delay, in milliseconds, between the first change to the session and the writing of the batch of changes
+static const int WriteDelay = 1000;
+
+/// Delay, in milliseconds, between the loading of two warmed up tabs
+static const int WarmUpInterval = 1500;
+
+/// Restored background tab that may be warmed up, with the information used to prioritize it
+struct WarmUpCandidate
+{
+    /// Web widget of the tab
+    WebWidget *Widget;
+
+    /// True if the tab is pinned
+    bool IsPinned;
+
+    /// Distance between the tab and the active tab of its window
+    int Distance;
+};
+
 SessionManager::SessionManager() :
+    QObject(nullptr),
     m_dataFile(),
-    m_savedSession(false)
+    m_savedSession(false),
+    m_faviconManager(nullptr),
+    m_journal(nullptr),
+    m_windowIds(),
+    m_tabIds(),
+    m_staleWindowIds(),
+    m_dirtyWindows(),
+    m_dirtyTabs(),
+    m_nextId(1),
+    m_writeTimer(),
+    m_warmUpTabCount(0),
+    m_warmUpQueue(),
+    m_warmUpTimer()
+{
+    m_writeTimer.setSingleShot(true);
+    m_writeTimer.setInterval(WriteDelay);
+    connect(&m_writeTimer, &QTimer::timeout, this, &SessionManager::writeChanges);
+
+    m_warmUpTimer.setInterval(WarmUpInterval);
+    connect(&m_warmUpTimer, &QTimer::timeout, this, &SessionManager::warmUpNextTab);
+}
+
+SessionManager::~SessionManager()
 {
+    // Changes still waiting for the write timer are given to the journal, whose destructor writes them to disk.
+    // Closed windows and tabs have already been removed from the dirty sets, so only live ones are written
+    if (!m_savedSession)
+        writeChanges();
+
+    m_journal.reset();
 }
 
 bool SessionManager::alreadySaved() const
@@ -31,108 +79,122 @@ void SessionManager::setSessionFile(const QString &fullPath)
     m_dataFile = fullPath;
 }
 
+void SessionManager::setFaviconManager(FaviconManager *faviconManager)
+{
+    m_faviconManager = faviconManager;
+}
+
+void SessionManager::setWarmUpTabCount(int count)
+{
+    m_warmUpTabCount = std::max(count, 0);
+}
+
+void SessionManager::addWindow(MainWindow *window)
+{
+    if (!window || window->isPrivate() || m_savedSession)
+        return;
+
+    if (!m_windowIds.contains(window))
+        m_windowIds.insert(window, m_nextId++);
+
+    BrowserTabWidget *tabWidget = window->getTabWidget();
+
+    connect(tabWidget, &BrowserTabWidget::newTabCreated, this, &SessionManager::addTab);
+    connect(tabWidget, &BrowserTabWidget::tabOrderChanged, this, [this, window](){
+        markWindowDirty(window);
+    });
+    connect(tabWidget, &BrowserTabWidget::currentChanged, this, [this, window](int){
+        markWindowDirty(window);
+    });
+    connect(tabWidget, &BrowserTabWidget::tabPinned, this, [this, tabWidget](int index, bool){
+        if (WebWidget *ww = tabWidget->getWebWidget(index))
+            markTabDirty(ww);
+    });
+    connect(tabWidget, &BrowserTabWidget::tabClosing, this, [this, window](WebWidget *ww){
+        auto it = m_tabIds.find(ww);
+        if (it == m_tabIds.end())
+            return;
+
+        m_dirtyTabs.remove(ww);
+        if (!m_savedSession)
+            getJournal()->removeTab(m_windowIds.value(window), it.value());
+        m_tabIds.erase(it);
+    });
+    connect(window, &MainWindow::destroyed, this, [this, window](){
+        const int windowId = m_windowIds.value(window);
+        m_windowIds.remove(window);
+        m_dirtyWindows.remove(window);
+
+        // Closing a window during the session removes it, closing the last one or quitting is handled by saveState()
+        if (!m_savedSession && m_journal)
+            m_journal->removeWindow(windowId);
+    });
+
+    for (int i = 0; i < tabWidget->count(); ++i)
+    {
+        if (WebWidget *ww = tabWidget->getWebWidget(i))
+            addTab(ww);
+    }
+
+    markWindowDirty(window);
+}
+
 void SessionManager::saveState(std::vector<MainWindow*> &windows)
 {
-    QFile dataFile(m_dataFile);
-    if (!dataFile.open(QIODevice::WriteOnly))
+    if (m_savedSession)
         return;
 
-    // Construct a QJsonDocument containing an array of windows corresponding to the container passed to this method
-    QJsonObject sessionObj;
-    QJsonArray windowArray;
+    // Record the final state of every window, since window geometry is only read when it is written
     for (MainWindow *win : windows)
     {
-        QJsonObject winObj;
-        QJsonArray tabArray;
+        if (!m_windowIds.contains(win))
+            addWindow(win);
+
+        m_dirtyWindows.insert(win);
 
-        // Add each tab's URL to the array
         BrowserTabWidget *tabWidget = win->getTabWidget();
-        int numTabs = tabWidget->count();
-        for (int i = 0; i < numTabs; ++i)
+        for (int i = 0; i < tabWidget->count(); ++i)
         {
-            WebWidget *ww = tabWidget->getWebWidget(i);
-            if (!ww)
-                continue;
-
-            QJsonObject tabInfoObj;
-            tabInfoObj.insert(QLatin1String("url"), QJsonValue(ww->url().toString()));
-            tabInfoObj.insert(QLatin1String("is_pinned"), QJsonValue(tabWidget->isTabPinned(i)));
-            tabInfoObj.insert(QLatin1String("is_hibernating"), QJsonValue(ww->isHibernating()));
-            tabInfoObj.insert(QLatin1String("title"), QJsonValue(ww->getTitle()));
-
-            QIcon icon = ww->getIcon();
-            if (icon.isNull())
-                icon = tabWidget->tabIcon(i);
-
-            QByteArray faviconB64 = CommonUtil::iconToBase64(icon);
-            auto faviconEncoded = QLatin1String(faviconB64.data());
-            tabInfoObj.insert(QLatin1String("icon"), QJsonValue(faviconEncoded));
-            tabInfoObj.insert(QLatin1String("icon_url"), QJsonValue(ww->getIconUrl().toString()));
-
-            QByteArray tabHistoryB64 = ww->getEncodedHistory().toBase64();
-            auto tabHistoryEncoded = QLatin1String(tabHistoryB64.data());
-            tabInfoObj.insert(QLatin1String("history"), QJsonValue(tabHistoryEncoded));
-
-            tabArray.append(QJsonValue(tabInfoObj));
+            if (WebWidget *ww = tabWidget->getWebWidget(i))
+                m_dirtyTabs.insert(ww);
         }
-
-        winObj.insert(QLatin1String("tabs"), QJsonValue(tabArray));
-        winObj.insert(QLatin1String("current_tab"), QJsonValue(tabWidget->currentIndex()));
-
-        // Store geometry of window
-        const QRect &winGeom = win->geometry();
-        winObj.insert(QLatin1String("geom_x"), QJsonValue(winGeom.x()));
-        winObj.insert(QLatin1String("geom_y"), QJsonValue(winGeom.y()));
-        winObj.insert(QLatin1String("geom_width"), QJsonValue(winGeom.width()));
-        winObj.insert(QLatin1String("geom_height"), QJsonValue(winGeom.height()));
-
-        winObj.insert(QLatin1String("is_maximized"), QJsonValue(win->isMaximized()));
-
-        windowArray.append(QJsonValue(winObj));
     }
-    sessionObj.insert(QLatin1String("windows"), QJsonValue(windowArray));
 
-    // Save to file
-    QJsonDocument sessionDoc(sessionObj);
-    dataFile.write(sessionDoc.toJson());
-    dataFile.close();
+    writeChanges();
+
+    SessionJournal *journal = getJournal();
+    journal->compact();
+    journal->sync();
 
     m_savedSession = true;
 }
 
 void SessionManager::restoreSession(MainWindow *firstWindow, BrowserApplication *browserApplication)
 {
-    QFile dataFile(m_dataFile);
-    if (!dataFile.exists() || !dataFile.open(QIODevice::ReadOnly))
-        return;
-
-    // Attempt to parse data file
-    QByteArray sessionData = dataFile.readAll();
-    dataFile.close();
-
-    QJsonDocument sessionDoc(QJsonDocument::fromJson(sessionData));
-    if (!sessionDoc.isObject())
-        return;
-
-    QJsonObject sessionObj = sessionDoc.object();
-    auto it = sessionObj.find(QLatin1String("windows"));
-    if (it == sessionObj.end())
-        return;
+    // Resume journaling from the saved session, so that a crash during the restore loses nothing
+    m_journal = std::make_unique<SessionJournal>(m_dataFile);
+    const QJsonObject sessionObj = m_journal->load();
+    m_nextId = std::max(m_nextId, m_journal->getMaxId() + 1);
 
     // Load each tab into the appropriate windows
+    std::vector<WarmUpCandidate> warmUpCandidates;
     bool isFirstWindow = true;
     MainWindow *currentWindow = firstWindow;
 
-    QJsonArray winArray = it.value().toArray();
+    const QJsonArray winArray = sessionObj.value(QLatin1String("windows")).toArray();
     for (auto winIt = winArray.constBegin(); winIt != winArray.constEnd(); ++winIt)
     {
+        QJsonObject winObject = winIt->toObject();
+
+        // The restored windows and tabs are recorded under new identifiers, and the saved ones are
+        // removed once the new ones are written
+        m_staleWindowIds.push_back(winObject.value(QLatin1String("id")).toInt());
+
         if (!isFirstWindow)
             currentWindow = browserApplication->getNewWindow();
 
         isFirstWindow = false;
 
-        QJsonObject winObject = winIt->toObject();
-
         // Restore window properties
         const bool isMaximized = winObject.value(QLatin1String("is_maximized")).toBool(false);
 
@@ -148,46 +210,243 @@ void SessionManager::restoreSession(MainWindow *firstWindow, BrowserApplication
             currentWindow->setGeometry(winGeom);
         }
 
-        // Restore tabs belonging to the window
+        // Restore tabs belonging to the window. Only the active tab is loaded, the others are placeholders
+        // that load their page once they are activated, so no render process is started for them
         BrowserTabWidget *tabWidget = currentWindow->getTabWidget();
-
         QJsonArray tabArray = winObject.value(QLatin1String("tabs")).toArray();
+
+        int currentTab = winObject.value(QLatin1String("current_tab")).toInt();
+        if (currentTab < 0 || currentTab >= tabArray.size())
+            currentTab = 0;
         int i = 0;
         for (auto tabIt = tabArray.constBegin(); tabIt != tabArray.constEnd(); ++tabIt)
         {
-            if (tabIt->isString())
-                tabWidget->openLinkInNewTab(QUrl::fromUserInput(tabIt->toString()));
-            else if (tabIt->isObject())
-            {
-                QJsonObject tabInfoObj = tabIt->toObject();
-
-                WebState webState;
-                webState.title = tabInfoObj.value(QLatin1String("title")).toString();
-                webState.iconUrl = QUrl::fromUserInput(tabInfoObj.value(QLatin1String("icon_url")).toString());
-                webState.url = QUrl::fromUserInput(tabInfoObj.value(QLatin1String("url")).toString());
+            QJsonObject tabInfoObj = tabIt->toObject();
 
-                const QByteArray faviconData = tabInfoObj.value(QLatin1String("icon")).toString().toLatin1();
-                if (!faviconData.isNull())
-                    webState.icon = CommonUtil::iconFromBase64(faviconData);
+            WebState webState;
+            webState.title = tabInfoObj.value(QLatin1String("title")).toString();
+            webState.iconUrl = QUrl::fromUserInput(tabInfoObj.value(QLatin1String("icon_url")).toString());
+            webState.url = QUrl::fromUserInput(tabInfoObj.value(QLatin1String("url")).toString());
 
-                const QByteArray encodedHistory = tabInfoObj.value(QLatin1String("history")).toString().toLatin1();
-                webState.pageHistory = QByteArray::fromBase64(encodedHistory);
+            const QByteArray encodedHistory = tabInfoObj.value(QLatin1String("history")).toString().toLatin1();
+            webState.pageHistory = QByteArray::fromBase64(encodedHistory);
 
-                WebWidget *ww = (i == 0) ? qobject_cast<WebWidget*>(tabWidget->widget(0)) : tabWidget->newBackgroundTabAtIndex(i);
+            const QUrl pageUrl = webState.url;
+            const bool isPinned = tabInfoObj.value(QLatin1String("is_pinned")).toBool();
 
-                tabWidget->setTabPinned(i,
-                                        tabInfoObj.value(QLatin1String("is_pinned")).toBool());
+            WebWidget *ww = (i == 0) ? qobject_cast<WebWidget*>(tabWidget->widget(0)) : tabWidget->newHibernatingTabAtIndex(i);
 
-                ww->setHibernation(tabInfoObj.value(QLatin1String("is_hibernating")).toBool());
+            tabWidget->setTabPinned(i, isPinned);
 
+            if (tabInfoObj.value(QLatin1String("is_hibernating")).toBool())
+            {
+                ww->setHibernation(true);
+                ww->setWebState(std::move(webState));
+            }
+            else if (i == 0 && currentTab == 0)
                 ww->setWebState(std::move(webState));
+            else
+            {
+                ww->setPlaceholderState(std::move(webState));
+                if (i != currentTab)
+                    warmUpCandidates.push_back({ ww, isPinned, std::abs(i - currentTab) });
+            }
 
-                ++i;
+            // Favicons are stored by reference, and decoded from the favicon database off the UI thread
+            if (m_faviconManager && ww->isHibernating())
+            {
+                m_faviconManager->loadFavicon(pageUrl, ww, [tabWidget, ww](const QIcon &icon){
+                    const int tabIndex = tabWidget->indexOf(ww);
+                    if (tabIndex >= 0 && ww->isHibernating() && !icon.isNull())
+                        tabWidget->setTabIcon(tabIndex, icon);
+                });
             }
+
+            ++i;
         }
 
-        // Set current tab to the last active tab
-        int currentTab = winObject.value(QLatin1String("current_tab")).toInt();
+        // Set current tab to the last active tab, which wakes up its placeholder
         tabWidget->setCurrentIndex(currentTab);
     }
+
+    // Pinned tabs are warmed up first, followed by the tabs nearest to the active tab of their window
+    std::stable_sort(warmUpCandidates.begin(), warmUpCandidates.end(), [](const WarmUpCandidate &a, const WarmUpCandidate &b){
+        if (a.IsPinned != b.IsPinned)
+            return a.IsPinned;
+        return a.Distance < b.Distance;
+    });
+
+    const std::size_t numWarmUpTabs = std::min(warmUpCandidates.size(), static_cast<std::size_t>(m_warmUpTabCount));
+    for (std::size_t i = 0; i < numWarmUpTabs; ++i)
+        m_warmUpQueue.push_back(warmUpCandidates.at(i).Widget);
+
+    if (!m_warmUpQueue.empty())
+        m_warmUpTimer.start();
+}
+
+void SessionManager::writeChanges()
+{
+    m_writeTimer.stop();
+
+    if (m_savedSession || (m_dirtyTabs.isEmpty() && m_dirtyWindows.isEmpty() && m_staleWindowIds.empty()))
+        return;
+
+    SessionJournal *journal = getJournal();
+
+    // Tabs are written before their window's tab order, so that the order refers to known tabs
+    for (WebWidget *ww : m_dirtyTabs)
+    {
+        MainWindow *window = getWindowOf(ww);
+        auto it = m_tabIds.find(ww);
+        if (!window || it == m_tabIds.end())
+            continue;
+
+        const int windowId = m_windowIds.value(window);
+        journal->updateTab(windowId, it.value(), getTabState(ww, window));
+        m_dirtyWindows.insert(window);
+    }
+
+    for (MainWindow *window : m_dirtyWindows)
+    {
+        const int windowId = m_windowIds.value(window);
+        BrowserTabWidget *tabWidget = window->getTabWidget();
+
+        std::vector<int> tabIds;
+        for (int i = 0; i < tabWidget->count(); ++i)
+        {
+            auto it = m_tabIds.find(tabWidget->getWebWidget(i));
+            if (it != m_tabIds.end())
+                tabIds.push_back(it.value());
+        }
+
+        journal->setTabOrder(windowId, tabIds);
+        journal->updateWindow(windowId, getWindowState(window));
+    }
+
+    m_dirtyTabs.clear();
+    m_dirtyWindows.clear();
+
+    // The windows of the restored session are removed only after their replacements have been journaled
+    for (int windowId : m_staleWindowIds)
+        journal->removeWindow(windowId);
+    m_staleWindowIds.clear();
+}
+
+void SessionManager::warmUpNextTab()
+{
+    // Skip the tabs that were closed or activated while waiting
+    while (!m_warmUpQueue.empty())
+    {
+        QPointer<WebWidget> ww = m_warmUpQueue.front();
+        m_warmUpQueue.erase(m_warmUpQueue.begin());
+
+        if (!ww.isNull() && ww->isPlaceholder())
+        {
+            ww->setHibernation(false);
+            break;
+        }
+    }
+
+    if (m_warmUpQueue.empty())
+        m_warmUpTimer.stop();
+}
+
+SessionJournal *SessionManager::getJournal()
+{
+    if (!m_journal)
+    {
+        m_journal = std::make_unique<SessionJournal>(m_dataFile);
+        m_journal->clear();
+    }
+
+    return m_journal.get();
+}
+
+void SessionManager::addTab(WebWidget *webWidget)
+{
+    if (!webWidget || m_tabIds.contains(webWidget))
+        return;
+
+    m_tabIds.insert(webWidget, m_nextId++);
+
+    auto markDirty = [this, webWidget](){ markTabDirty(webWidget); };
+    connect(webWidget, &WebWidget::urlChanged,       this, markDirty);
+    connect(webWidget, &WebWidget::titleChanged,     this, markDirty);
+    connect(webWidget, &WebWidget::iconUrlChanged,   this, markDirty);
+    connect(webWidget, &WebWidget::loadFinished,     this, markDirty);
+    connect(webWidget, &WebWidget::aboutToHibernate, this, markDirty);
+    connect(webWidget, &WebWidget::aboutToWake,      this, markDirty);
+    connect(webWidget, &WebWidget::destroyed,        this, [this, webWidget](){
+        m_tabIds.remove(webWidget);
+        m_dirtyTabs.remove(webWidget);
+    });
+
+    markTabDirty(webWidget);
+}
+
+void SessionManager::markTabDirty(WebWidget *webWidget)
+{
+    if (m_savedSession)
+        return;
+
+    m_dirtyTabs.insert(webWidget);
+    if (!m_writeTimer.isActive())
+        m_writeTimer.start();
+}
+
+void SessionManager::markWindowDirty(MainWindow *window)
+{
+    if (m_savedSession)
+        return;
+
+    m_dirtyWindows.insert(window);
+    if (!m_writeTimer.isActive())
+        m_writeTimer.start();
+}
+
+MainWindow *SessionManager::getWindowOf(WebWidget *webWidget) const
+{
+    for (auto it = m_windowIds.constBegin(); it != m_windowIds.constEnd(); ++it)
+    {
+        if (it.key()->getTabWidget()->indexOf(webWidget) >= 0)
+            return it.key();
+    }
+
+    return nullptr;
+}
+
+QJsonObject SessionManager::getTabState(WebWidget *webWidget, MainWindow *window) const
+{
+    BrowserTabWidget *tabWidget = window->getTabWidget();
+
+    QJsonObject tabInfoObj;
+    tabInfoObj.insert(QLatin1String("url"), QJsonValue(webWidget->url().toString()));
+    tabInfoObj.insert(QLatin1String("is_pinned"), QJsonValue(tabWidget->isTabPinned(tabWidget->indexOf(webWidget))));
+    // Placeholders of restored tabs are only hibernating until they are activated
+    tabInfoObj.insert(QLatin1String("is_hibernating"), QJsonValue(webWidget->isHibernating() && !webWidget->isPlaceholder()));
+    tabInfoObj.insert(QLatin1String("title"), QJsonValue(webWidget->getTitle()));
+    tabInfoObj.insert(QLatin1String("icon_url"), QJsonValue(webWidget->getIconUrl().toString()));
+
+    QByteArray tabHistoryB64 = webWidget->getEncodedHistory().toBase64();
+    auto tabHistoryEncoded = QLatin1String(tabHistoryB64.data());
+    tabInfoObj.insert(QLatin1String("history"), QJsonValue(tabHistoryEncoded));
+
+    return tabInfoObj;
+}
+
+QJsonObject SessionManager::getWindowState(MainWindow *window) const
+{
+    QJsonObject winObj;
+    winObj.insert(QLatin1String("current_tab"), QJsonValue(window->getTabWidget()->currentIndex()));
+
+    // Store geometry of window
+    const QRect &winGeom = window->geometry();
+    winObj.insert(QLatin1String("geom_x"), QJsonValue(winGeom.x()));
+    winObj.insert(QLatin1String("geom_y"), QJsonValue(winGeom.y()));
+    winObj.insert(QLatin1String("geom_width"), QJsonValue(winGeom.width()));
+    winObj.insert(QLatin1String("geom_height"), QJsonValue(winGeom.height()));
+
+    winObj.insert(QLatin1String("is_maximized"), QJsonValue(window->isMaximized()));
+
+    return winObj;
 }
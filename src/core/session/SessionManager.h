@@ -1,34 +1,65 @@
 #ifndef SESSIONMANAGER_H
 #define SESSIONMANAGER_H
 
-#include <QString>
+#include "SessionJournal.h"
+
+#include <memory>
 #include <vector>
 
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
 class BrowserApplication;
+class FaviconManager;
 class MainWindow;
+class WebWidget;
 
 /**
  * @class SessionManager
- * @brief Handles the serialization of active browsing sessions when the application is being closed, and the
- *        deserialization of a saved browsing session when the application is being initialized
+ * @brief Records the state of the browsing session in a \ref SessionJournal as windows and tabs change, and
+ *        restores the saved browsing session when the application is being initialized
+ *
+ * Changes to a tab, such as a navigation, a pin or hibernation, mark the tab as dirty. Dirty tabs and windows
+ * are written to the journal together after a short delay, so each tab is serialized at most once per delay
+ * no matter how many times it changes.
  */
-class SessionManager
+class SessionManager : public QObject
 {
+    Q_OBJECT
+
 public:
     /// Default constructor
     SessionManager();
 
+    /// Writes any pending changes before the session manager is destroyed
+    ~SessionManager();
+
     /// Returns true if the session has already been saved, false if else
     bool alreadySaved() const;
 
     /// Sets the path of the data file in which session information is stored
     void setSessionFile(const QString &fullPath);
 
-    /// Saves the state of each window in the container
+    /// Sets the favicon manager, which provides the icons of restored tabs
+    void setFaviconManager(FaviconManager *faviconManager);
+
+    /// Sets the number of background tabs that are loaded after the session is restored, in addition to the active tabs
+    void setWarmUpTabCount(int count);
+
+    /// Starts recording the state of the given window and its tabs
+    void addWindow(MainWindow *window);
+
+    /// Saves the final state of each window in the container, and stops recording changes to the session
     void saveState(std::vector<MainWindow*> &windows);
 
     /**
-     * @brief restoreSession Restores the previous browsing session
+     * @brief restoreSession Restores the previous browsing session. Only the active tab of each window is loaded,
+     *        the other tabs are placeholders that load their page once they are first activated or warmed up
      * @param firstWindow Pointer to the first browsing window, which is opened prior to this call
      *        while the application is initializing.
      * @param browserApplication Pointer to the browser application instance, which is used to spawn
@@ -36,12 +67,78 @@ class SessionManager
      */
     void restoreSession(MainWindow *firstWindow, BrowserApplication *browserApplication);
 
+private Q_SLOTS:
+    /// Writes the state of the dirty windows and tabs to the session journal
+    void writeChanges();
+
+    /// Loads the page of the next restored background tab waiting to be warmed up
+    void warmUpNextTab();
+
+private:
+    /// Returns the session journal, creating it with an empty session if the previous session was not restored
+    SessionJournal *getJournal();
+
+    /// Starts recording the state of the given tab
+    void addTab(WebWidget *webWidget);
+
+    /// Marks the tab as dirty, to be written to the journal with the next batch of changes
+    void markTabDirty(WebWidget *webWidget);
+
+    /// Marks the window as dirty, to be written to the journal with the next batch of changes
+    void markWindowDirty(MainWindow *window);
+
+    /// Returns the window that contains the given tab, or a nullptr if it is not a recorded window
+    MainWindow *getWindowOf(WebWidget *webWidget) const;
+
+    /// Returns the state of the given tab, as it is stored in the session
+    QJsonObject getTabState(WebWidget *webWidget, MainWindow *window) const;
+
+    /// Returns the state of the given window, as it is stored in the session
+    QJsonObject getWindowState(MainWindow *window) const;
+
 private:
     /// Path of the file in which session data is stored
     QString m_dataFile;
 
     /// True if session has already been saved, false if else
     bool m_savedSession;
+
+    /// Favicon manager
+    FaviconManager *m_faviconManager;
+
+    /// Journal of the session's changes
+    std::unique_ptr<SessionJournal> m_journal;
+
+    /// Identifiers of the recorded windows
+    QHash<MainWindow*, int> m_windowIds;
+
+    /// Identifiers of the recorded tabs
+    QHash<WebWidget*, int> m_tabIds;
+
+    /// Identifiers of the windows of the restored session, which are removed from the journal once the
+    /// restored windows have been recorded under their new identifiers
+    std::vector<int> m_staleWindowIds;
+
+    /// Windows whose state or tab order changed since the last batch of changes was written
+    QSet<MainWindow*> m_dirtyWindows;
+
+    /// Tabs whose state changed since the last batch of changes was written
+    QSet<WebWidget*> m_dirtyTabs;
+
+    /// Next identifier to give to a window or tab
+    int m_nextId;
+
+    /// Delays the writing of changes, so that the changes made in quick succession are written together
+    QTimer m_writeTimer;
+
+    /// Number of restored background tabs that are loaded before they are activated
+    int m_warmUpTabCount;
+
+    /// Restored background tabs to load before they are activated, in order of priority
+    std::vector<QPointer<WebWidget>> m_warmUpQueue;
+
+    /// Spaces out the loading of the warmed up tabs
+    QTimer m_warmUpTimer;
 };
 
 #endif // SESSIONMANAGER_H
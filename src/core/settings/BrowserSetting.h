@@ -130,6 +130,9 @@ enum class BrowserSetting
     /// Determines whether or not all new tabs should be opened in the background, without switching from the current tab
     OpenAllTabsInBackground,
 
+    /// Number of background tabs to load after a session is restored, in addition to the active tab of each window
+    SessionWarmUpTabs,
+
     /// Standard font
     StandardFont,
 
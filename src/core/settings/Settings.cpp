@@ -7,7 +7,7 @@
 #include <QWebEngineSettings>
 #include <QtWebEngineCoreVersion>
 
-const QString Settings::Version = QStringLiteral("1.0");
+const QString Settings::Version = QStringLiteral("1.1");
 
 Settings::Settings() :
     QObject(nullptr),
@@ -38,7 +38,8 @@ Settings::Settings() :
         { BrowserSetting::FantasyFont, QLatin1String("FantasyFont") },                { BrowserSetting::FixedFont, QLatin1String("FixedFont") },
         { BrowserSetting::StandardFontSize, QLatin1String("StandardFontSize") },      { BrowserSetting::EnableAutoFill, QLatin1String("EnableAutoFill") },
         { BrowserSetting::CachePath, QLatin1String("CachePath") },                    { BrowserSetting::ThumbnailPath, QLatin1String("ThumbnailPath") },
-        { BrowserSetting::FavoritePagesFile, QLatin1String("FavoritePagesFile") },    { BrowserSetting::Version, QLatin1String("Version") }
+        { BrowserSetting::FavoritePagesFile, QLatin1String("FavoritePagesFile") },    { BrowserSetting::Version, QLatin1String("Version") },
+        { BrowserSetting::SessionWarmUpTabs, QLatin1String("SessionWarmUpTabs") }
     }
 {
     setObjectName(QLatin1String("Settings"));
@@ -140,6 +141,7 @@ void Settings::setDefaults()
     m_settings.setValue(QLatin1String("HistoryStoragePolicy"), static_cast<int>(HistoryStoragePolicy::Remember));
     m_settings.setValue(QLatin1String("ScrollAnimatorEnabled"), false);
     m_settings.setValue(QLatin1String("OpenAllTabsInBackground"), false);
+    m_settings.setValue(QLatin1String("SessionWarmUpTabs"), 0);
 
     QWebEngineSettings *webSettings = QWebEngineSettings::defaultSettings();
     m_settings.setValue(QLatin1String("StandardFont"), webSettings->fontFamily(QWebEngineSettings::StandardFont));
@@ -175,6 +177,8 @@ void Settings::updateSettings()
         m_settings.setValue(QLatin1String("NewTabPage"), static_cast<int>(NewTabType::BlankPage));
         m_settings.setValue(QLatin1String("FavoritePagesFile"), QLatin1String("favorite_pages.json"));
     }
+    if (!ok || versionNumber < 1.1f)
+        m_settings.setValue(QLatin1String("SessionWarmUpTabs"), 0);
 
     m_settings.setValue(QLatin1String("Version"), Version);
 }
@@ -1,14 +1,16 @@
 #include "DatabaseFactory.h"
 #include "DatabaseTaskScheduler.h"
 
+#include <algorithm>
+#include <utility>
+
+const std::size_t DatabaseTaskScheduler::MaxThreadCount = 4;
+
 DatabaseTaskScheduler::DatabaseTaskScheduler() :
-    m_registry(),
-    m_workersToCreate(),
+    m_workers(),
     m_mutex(),
     m_cv(),
-    m_thread(nullptr),
-    m_tasks(),
-    m_initCallbacks(),
+    m_threads(),
     m_working(false)
 {
 }
@@ -20,82 +22,302 @@ DatabaseTaskScheduler::~DatabaseTaskScheduler()
 
 DatabaseWorker *DatabaseTaskScheduler::getWorker(const std::string &name) const
 {
-    const auto it = m_registry.find(name);
-    if (it != m_registry.end())
-        return it->second.get();
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_workers.find(name);
+    if (it != m_workers.end())
+        return it->second.Instance.get();
     return nullptr;
 }
 
-void DatabaseTaskScheduler::onInit(std::function<void()> &&callback)
+void DatabaseTaskScheduler::onInit(const std::string &workerName, std::function<void()> &&callback)
 {
-    m_initCallbacks.push_back(std::move(callback));
+    std::lock_guard<std::mutex> lock{m_mutex};
+    WorkerQueue &queue = getQueue(workerName);
+
+    // Once the worker exists, the callback must still run before any task posted after it
+    if (queue.IsInitialized)
+        enqueue(queue, Task { std::move(callback), std::string(), std::chrono::steady_clock::now() });
+    else
+        queue.InitCallbacks.push_back(std::move(callback));
 }
 
-void DatabaseTaskScheduler::post(std::function<void()> &&work)
+void DatabaseTaskScheduler::post(const std::string &workerName, std::function<void()> &&work)
 {
     std::lock_guard<std::mutex> lock{m_mutex};
-    m_tasks.push_back(std::move(work));
-    m_cv.notify_one();
+    enqueue(getQueue(workerName), Task { std::move(work), std::string(), std::chrono::steady_clock::now() });
+}
+
+void DatabaseTaskScheduler::postDelayed(const std::string &workerName, std::chrono::milliseconds delay, std::function<void()> &&work)
+{
+    postCoalesced(workerName, std::string(), delay, std::move(work));
+}
+
+void DatabaseTaskScheduler::postCoalesced(const std::string &workerName, const std::string &key,
+                                          std::chrono::milliseconds delay, std::function<void()> &&work)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    WorkerQueue &queue = getQueue(workerName);
+
+    if (!key.empty())
+    {
+        auto hasKey = [&key](const Task &task) {
+            return task.CoalescingKey == key;
+        };
+
+        auto readyIt = std::find_if(queue.Tasks.begin(), queue.Tasks.end(), hasKey);
+        if (readyIt != queue.Tasks.end())
+        {
+            readyIt->Work = std::move(work);
+            ++queue.Stats.NumTasksCoalesced;
+            return;
+        }
+
+        for (auto delayedIt = queue.DelayedTasks.begin(); delayedIt != queue.DelayedTasks.end(); ++delayedIt)
+        {
+            if (hasKey(delayedIt->second))
+            {
+                delayedIt->second.Work = std::move(work);
+                ++queue.Stats.NumTasksCoalesced;
+
+                // Work that is due now does not wait for the delay of the pending task
+                if (delay <= std::chrono::milliseconds(0))
+                {
+                    Task task = std::move(delayedIt->second);
+                    queue.DelayedTasks.erase(delayedIt);
+
+                    task.ReadyTime = std::chrono::steady_clock::now();
+                    enqueue(queue, std::move(task));
+                }
+                return;
+            }
+        }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (delay <= std::chrono::milliseconds(0))
+    {
+        enqueue(queue, Task { std::move(work), key, now });
+        return;
+    }
+
+    const auto dueTime = now + delay;
+    queue.DelayedTasks.emplace(dueTime, Task { std::move(work), key, dueTime });
+    updateQueueDepth(queue);
+    m_cv.notify_all();
 }
 
 void DatabaseTaskScheduler::addWorker(const std::string &name, std::function<std::unique_ptr<DatabaseWorker>()> construction)
 {
-    m_workersToCreate.push_back({name, construction});
+    std::lock_guard<std::mutex> lock{m_mutex};
+    WorkerQueue &queue = getQueue(name);
+    if (queue.Construction)
+        return;
+
+    queue.Construction = std::move(construction);
+
+    // Workers added after run() are constructed by the existing pool
+    m_cv.notify_all();
+}
+
+DatabaseWorkerStats DatabaseTaskScheduler::getStats(const std::string &workerName) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_workers.find(workerName);
+    if (it == m_workers.end())
+        return DatabaseWorkerStats { 0, 0, 0, 0, std::chrono::microseconds(0), std::chrono::microseconds(0),
+                                     std::chrono::microseconds(0), std::chrono::microseconds(0) };
+
+    const WorkerQueue &queue = it->second;
+    DatabaseWorkerStats stats = queue.Stats;
+    stats.QueueDepth = queue.Tasks.size() + queue.DelayedTasks.size();
+    if (stats.NumTasksRun > 0)
+    {
+        const auto numTasksRun = static_cast<std::chrono::microseconds::rep>(stats.NumTasksRun);
+        stats.AverageWaitTime = queue.TotalWaitTime / numTasksRun;
+        stats.AverageRunTime = queue.TotalRunTime / numTasksRun;
+    }
+    return stats;
 }
 
 void DatabaseTaskScheduler::run()
 {
-    if (m_thread != nullptr || m_working)
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!m_threads.empty() || m_working)
         return;
 
     m_working = true;
-    m_thread = new std::thread(&DatabaseTaskScheduler::workerThread, this);
+
+    // Each worker is served by at most one thread at a time, so more threads than workers would sit idle
+    const std::size_t numThreads = std::min(std::max(m_workers.size(), std::size_t(1)), MaxThreadCount);
+    for (std::size_t i = 0; i < numThreads; ++i)
+        m_threads.emplace_back(&DatabaseTaskScheduler::workerThread, this);
 }
 
 void DatabaseTaskScheduler::stop()
 {
-    if (m_thread != nullptr)
     {
-        m_working = false;
-        m_cv.notify_all();
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_threads.empty())
+            return;
 
-        if (m_thread->joinable())
-            m_thread->join();
+        m_working = false;
+    }
+    m_cv.notify_all();
 
-        delete m_thread;
-        m_thread = nullptr;
+    for (std::thread &thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
     }
+
+    m_threads.clear();
 }
 
-void DatabaseTaskScheduler::workerThread()
+DatabaseTaskScheduler::WorkerQueue &DatabaseTaskScheduler::getQueue(const std::string &workerName)
+{
+    auto it = m_workers.find(workerName);
+    if (it != m_workers.end())
+        return it->second;
+
+    WorkerQueue queue;
+    queue.IsInitialized = false;
+    queue.IsBusy = false;
+    queue.Stats = DatabaseWorkerStats { 0, 0, 0, 0, std::chrono::microseconds(0), std::chrono::microseconds(0),
+                                        std::chrono::microseconds(0), std::chrono::microseconds(0) };
+    queue.TotalWaitTime = std::chrono::microseconds(0);
+    queue.TotalRunTime = std::chrono::microseconds(0);
+    return m_workers.emplace(workerName, std::move(queue)).first->second;
+}
+
+void DatabaseTaskScheduler::enqueue(WorkerQueue &queue, Task &&task)
+{
+    queue.Tasks.push_back(std::move(task));
+    updateQueueDepth(queue);
+    m_cv.notify_one();
+}
+
+void DatabaseTaskScheduler::updateQueueDepth(WorkerQueue &queue)
+{
+    queue.Stats.MaxQueueDepth = std::max(queue.Stats.MaxQueueDepth, queue.Tasks.size() + queue.DelayedTasks.size());
+}
+
+std::chrono::steady_clock::time_point DatabaseTaskScheduler::promoteDelayedTasks()
 {
-    for (auto &&workerInfo : m_workersToCreate)
+    const auto now = std::chrono::steady_clock::now();
+    auto nextDueTime = std::chrono::steady_clock::time_point::max();
+
+    for (auto &worker : m_workers)
     {
-        m_registry[workerInfo.first] = workerInfo.second();
+        WorkerQueue &queue = worker.second;
+        while (!queue.DelayedTasks.empty() && (!m_working || queue.DelayedTasks.begin()->first <= now))
+        {
+            Task task = std::move(queue.DelayedTasks.begin()->second);
+            queue.DelayedTasks.erase(queue.DelayedTasks.begin());
+
+            // Tasks that are flushed early when stopping become ready now rather than at their due time
+            task.ReadyTime = std::min(task.ReadyTime, now);
+            queue.Tasks.push_back(std::move(task));
+        }
+
+        if (!queue.DelayedTasks.empty())
+            nextDueTime = std::min(nextDueTime, queue.DelayedTasks.begin()->first);
     }
 
-    for (auto &initCallback : m_initCallbacks)
-        initCallback();
+    return nextDueTime;
+}
+
+DatabaseTaskScheduler::WorkerQueue *DatabaseTaskScheduler::findNextQueue()
+{
+    WorkerQueue *result = nullptr;
+    for (auto &worker : m_workers)
+    {
+        WorkerQueue &queue = worker.second;
+        if (queue.IsBusy || !queue.Construction)
+            continue;
+
+        // Construct workers before serving any queue, so their init callbacks run as early as possible
+        if (!queue.IsInitialized)
+            return &queue;
+
+        if (queue.Tasks.empty())
+            continue;
+
+        if (result == nullptr || queue.Tasks.front().ReadyTime < result->Tasks.front().ReadyTime)
+            result = &queue;
+    }
 
-    m_initCallbacks.clear();
+    return result;
+}
 
+void DatabaseTaskScheduler::workerThread()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
     for (;;)
     {
-        std::unique_lock<std::mutex> lock{m_mutex};
-        m_cv.wait(lock, [this](){
-            return !m_tasks.empty() || !m_working;
-        });
+        const auto nextDueTime = promoteDelayedTasks();
+
+        WorkerQueue *queue = findNextQueue();
+        if (queue == nullptr)
+        {
+            // A busy worker is drained by the thread that is serving it
+            if (!m_working)
+                break;
 
-        if (!m_working && m_tasks.empty())
-            break;
+            if (nextDueTime == std::chrono::steady_clock::time_point::max())
+                m_cv.wait(lock);
+            else
+                m_cv.wait_until(lock, nextDueTime);
+            continue;
+        }
+
+        queue->IsBusy = true;
+
+        if (!queue->IsInitialized)
+        {
+            std::function<std::unique_ptr<DatabaseWorker>()> construction = queue->Construction;
+            lock.unlock();
+            std::unique_ptr<DatabaseWorker> instance = construction();
+            lock.lock();
+
+            queue->Instance = std::move(instance);
+
+            while (!queue->InitCallbacks.empty())
+            {
+                std::vector<std::function<void()>> initCallbacks;
+                initCallbacks.swap(queue->InitCallbacks);
+
+                lock.unlock();
+                for (auto &initCallback : initCallbacks)
+                    initCallback();
+                lock.lock();
+            }
+
+            queue->IsInitialized = true;
+            queue->IsBusy = false;
+            m_cv.notify_all();
+            continue;
+        }
+
+        Task task = std::move(queue->Tasks.front());
+        queue->Tasks.pop_front();
+
+        const auto startTime = std::chrono::steady_clock::now();
+        const auto waitTime = std::chrono::duration_cast<std::chrono::microseconds>(startTime - task.ReadyTime);
 
-        std::function<void()> task = std::move(m_tasks.front());
-        m_tasks.pop_front();
         lock.unlock();
+        task.Work();
+        lock.lock();
 
-        task();
+        const auto runTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime);
 
-        if (!m_working && m_tasks.empty())
-            break;
+        DatabaseWorkerStats &stats = queue->Stats;
+        ++stats.NumTasksRun;
+        stats.MaxWaitTime = std::max(stats.MaxWaitTime, waitTime);
+        stats.MaxRunTime = std::max(stats.MaxRunTime, runTime);
+        queue->TotalWaitTime += waitTime;
+        queue->TotalRunTime += runTime;
+
+        queue->IsBusy = false;
+        m_cv.notify_all();
     }
 }
@@ -1,28 +1,66 @@
 #ifndef DATABASETASKSCHEDULER_H
 #define DATABASETASKSCHEDULER_H
 
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
-#include <unordered_map>
 #include <vector>
 
 #include <QString>
 
 class DatabaseWorker;
 
+/**
+ * @struct DatabaseWorkerStats
+ * @brief Queue depth and task latency metrics of one database worker in the \ref DatabaseTaskScheduler
+ */
+struct DatabaseWorkerStats
+{
+    /// Number of tasks waiting to run, including delayed tasks
+    std::size_t QueueDepth;
+
+    /// Largest number of tasks that were waiting to run at the same time
+    std::size_t MaxQueueDepth;
+
+    /// Number of tasks that have finished running
+    uint64_t NumTasksRun;
+
+    /// Number of tasks that replaced a pending task with the same coalescing key, instead of being queued
+    uint64_t NumTasksCoalesced;
+
+    /// Average time between a task becoming ready to run and its start
+    std::chrono::microseconds AverageWaitTime;
+
+    /// Longest time between a task becoming ready to run and its start
+    std::chrono::microseconds MaxWaitTime;
+
+    /// Average time taken to run a task
+    std::chrono::microseconds AverageRunTime;
+
+    /// Longest time taken to run a task
+    std::chrono::microseconds MaxRunTime;
+};
+
 /**
  * @class DatabaseTaskScheduler
- * @brief Manages a collection of DatabaseWorkers
- *        that operate outside of the main thread
+ * @brief Manages a collection of DatabaseWorkers that operate outside of the main thread.
+ *
+ * Each worker has its own serial task queue, so the tasks of one worker run one at a time and in the
+ * order they were posted, while the tasks of different workers run concurrently on a small pool of threads.
+ * A free thread serves the worker whose next task has been waiting the longest.
  */
 class DatabaseTaskScheduler
 {
 public:
-    /// Constructs the task schedulerr
+    /// Constructs the task scheduler
     DatabaseTaskScheduler();
 
     /// Destructor
@@ -30,49 +68,125 @@ class DatabaseTaskScheduler
 
     /// Returns a database worker that has been registered with the given name
     /// Note: this function should *only* be called in a callback registered with
-    /// the onInit() method
+    /// the onInit() method, or in a task posted to the worker
     DatabaseWorker *getWorker(const std::string &name) const;
 
-    /// Registers a callback to be executed when the worker thread has started
-    void onInit(std::function<void()> &&callback);
+    /// Registers a callback to be executed on the pool once the worker with the given name has been
+    /// constructed, before any of its tasks
+    void onInit(const std::string &workerName, std::function<void()> &&callback);
 
     /**
-     * @brief Posts a task to the end of the work queue
+     * @brief Posts a task to the end of the given worker's queue
+     * @param workerName Name of the database worker
      * @param f Member function to be invoked
      * @param args Function arguments
      */
     template<class Fn, class ...Args>
-    void post(Fn &&f, Args &&...args)
+    void post(const std::string &workerName, Fn &&f, Args &&...args)
     {
-        std::lock_guard<std::mutex> lock{m_mutex};
-        m_tasks.push_back(std::bind(std::forward<Fn>(f), std::forward<Args>(args)...));
-        m_cv.notify_one();
+        post(workerName, std::function<void()>(std::bind(std::forward<Fn>(f), std::forward<Args>(args)...)));
     }
 
-    /// Posts a task to the end of the work queue
-    void post(std::function<void()> &&work);
+    /// Posts a task to the end of the given worker's queue
+    void post(const std::string &workerName, std::function<void()> &&work);
+
+    /// Posts a task to the end of the given worker's queue once the given delay has elapsed. Delayed
+    /// tasks that are still waiting when the scheduler is stopped are executed before the pool exits
+    void postDelayed(const std::string &workerName, std::chrono::milliseconds delay, std::function<void()> &&work);
 
-    /// Adds a database worker to the pool of workers. It will be constructed after calling the run() method.
-    /// Anything registered with this method after calling run() will not be instantiated
+    /// Posts a task like postDelayed(), unless a task with the same key is still pending for the worker.
+    /// In that case the pending task is given the new work and keeps its place in the queue. Without a delay, the
+    /// task is added to the end of the queue right away, and so is a delayed task that it is coalesced with
+    void postCoalesced(const std::string &workerName, const std::string &key,
+                       std::chrono::milliseconds delay, std::function<void()> &&work);
+
+    /// Adds a database worker to the scheduler. It will be constructed on the pool after calling the run() method
     void addWorker(const std::string &name, std::function<std::unique_ptr<DatabaseWorker>()> construction);
 
-    /// Starts the worker thread
+    /// Returns the queue and latency metrics of the worker with the given name
+    DatabaseWorkerStats getStats(const std::string &workerName) const;
+
+    /// Starts the thread pool
     void run();
 
-    /// Stops the worker thread
+    /// Stops the thread pool, after running every task that is still queued
     void stop();
 
 private:
-    /// Main loop of the worker thread
+    /// A unit of work in the queue of a database worker
+    struct Task
+    {
+        /// Function that performs the task
+        std::function<void()> Work;
+
+        /// Key used to coalesce the task with later tasks, or an empty string
+        std::string CoalescingKey;
+
+        /// Time at which the task became ready to run
+        std::chrono::steady_clock::time_point ReadyTime;
+    };
+
+    /// Serial task queue and metrics of a database worker
+    struct WorkerQueue
+    {
+        /// Constructs the database worker
+        std::function<std::unique_ptr<DatabaseWorker>()> Construction;
+
+        /// The database worker, once constructed
+        std::unique_ptr<DatabaseWorker> Instance;
+
+        /// True once the worker has been constructed and its init callbacks have been executed
+        bool IsInitialized;
+
+        /// True while a thread of the pool is constructing the worker or running one of its tasks
+        bool IsBusy;
+
+        /// Callbacks to be executed after constructing the worker
+        std::vector<std::function<void()>> InitCallbacks;
+
+        /// Tasks that are ready to run, in the order they will be executed
+        std::deque<Task> Tasks;
+
+        /// Tasks waiting to be added to the queue, ordered by the time at which they are due
+        std::multimap<std::chrono::steady_clock::time_point, Task> DelayedTasks;
+
+        /// Queue and latency metrics
+        DatabaseWorkerStats Stats;
+
+        /// Sum of the wait times of each task that has run
+        std::chrono::microseconds TotalWaitTime;
+
+        /// Sum of the run times of each task that has run
+        std::chrono::microseconds TotalRunTime;
+    };
+
+    /// Returns the queue of the worker with the given name, creating an empty one if needed. Called with the mutex held
+    WorkerQueue &getQueue(const std::string &workerName);
+
+    /// Adds a task to the end of a worker's queue. Called with the mutex held
+    void enqueue(WorkerQueue &queue, Task &&task);
+
+    /// Records the current queue depth of the worker. Called with the mutex held
+    void updateQueueDepth(WorkerQueue &queue);
+
+    /// Moves delayed tasks that are due into their worker's queue, or all of them when the scheduler is stopping.
+    /// Returns the time at which the next delayed task is due, or the maximum time point if there is none.
+    /// Called with the mutex held
+    std::chrono::steady_clock::time_point promoteDelayedTasks();
+
+    /// Returns the worker that the calling thread should serve next, or a nullptr if every worker is either
+    /// busy or idle. The worker whose next task became ready first is served first. Called with the mutex held
+    WorkerQueue *findNextQueue();
+
+    /// Main loop of each thread in the pool
     void workerThread();
 
 private:
-    /// Hashmap of database worker names to their corresponding instances
-    std::unordered_map<std::string, std::unique_ptr<DatabaseWorker>> m_registry;
+    /// Largest number of threads in the pool
+    static const std::size_t MaxThreadCount;
 
-    /// Vector of callbacks waiting to be executed in the run() method
-    std::vector<std::pair<std::string, 
-        std::function<std::unique_ptr<DatabaseWorker>()>>> m_workersToCreate;
+    /// Map of database worker names to their queues
+    std::map<std::string, WorkerQueue> m_workers;
 
     /// Mutex
     mutable std::mutex m_mutex;
@@ -80,16 +194,10 @@ class DatabaseTaskScheduler
     /// Condition variable
     std::condition_variable m_cv;
 
-    /// Worker thread
-    std::thread *m_thread;
-
-    /// Pending tasks
-    std::deque<std::function<void()>> m_tasks;
-
-    /// Callbacks to be executed after insantiating all of the database workers in the worker thread
-    std::vector<std::function<void()>> m_initCallbacks;
+    /// Thread pool
+    std::vector<std::thread> m_threads;
 
-    /// Worker flag - when set to false, the worker thread will halt
+    /// Worker flag - when set to false, the threads of the pool will halt once the queues are empty
     bool m_working;
 };
 
@@ -0,0 +1,279 @@
+#include "StartupGraph.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include <QStringList>
+#include <QtConcurrent>
+
+#include <QDebug>
+
+/// Converts the given duration to milliseconds, for the startup trace report
+static double toMilliseconds(std::chrono::microseconds duration)
+{
+    return static_cast<double>(duration.count()) / 1000.0;
+}
+
+StartupGraph::StartupGraph() :
+    m_tasks(),
+    m_taskIndices(),
+    m_mutex(),
+    m_cv(),
+    m_readyMainTasks(),
+    m_numFinished(0),
+    m_mainThreadId(),
+    m_startTime(),
+    m_totalTime(0),
+    m_trace()
+{
+}
+
+void StartupGraph::addTask(const QString &name, const std::vector<QString> &dependencies, StartupThread thread, std::function<void()> &&work)
+{
+    if (m_taskIndices.contains(name))
+    {
+        qWarning() << "StartupGraph - ignoring duplicate task " << name;
+        return;
+    }
+
+    m_taskIndices.insert(name, m_tasks.size());
+    m_tasks.push_back(Task { name, dependencies, thread, std::move(work), {}, 0,
+                             std::thread::id(), std::chrono::microseconds(0), std::chrono::microseconds(0) });
+}
+
+bool StartupGraph::run()
+{
+    if (!resolveDependencies())
+        return false;
+
+    m_mainThreadId = std::this_thread::get_id();
+    m_startTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_numFinished = 0;
+    m_readyMainTasks.clear();
+    for (std::size_t i = 0; i < m_tasks.size(); ++i)
+    {
+        if (m_tasks[i].NumPendingDependencies == 0)
+            scheduleTask(i);
+    }
+
+    while (m_numFinished < m_tasks.size())
+    {
+        if (m_readyMainTasks.empty())
+        {
+            m_cv.wait(lock);
+            continue;
+        }
+
+        const std::size_t taskIndex = m_readyMainTasks.front();
+        m_readyMainTasks.pop_front();
+
+        lock.unlock();
+        executeTask(taskIndex);
+        lock.lock();
+
+        finishTask(taskIndex);
+    }
+
+    m_totalTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startTime);
+    buildTrace();
+    return true;
+}
+
+const std::vector<StartupTaskTrace> &StartupGraph::getTrace() const
+{
+    return m_trace;
+}
+
+std::chrono::microseconds StartupGraph::getTotalTime() const
+{
+    return m_totalTime;
+}
+
+QString StartupGraph::formatTrace() const
+{
+    QString result = QStringLiteral("Startup trace: %1 tasks in %2 ms\n")
+            .arg(static_cast<int>(m_trace.size()))
+            .arg(toMilliseconds(m_totalTime), 0, 'f', 1);
+    result.append(QStringLiteral("   start(ms)  time(ms)  thread     task\n"));
+
+    QStringList criticalPath;
+    for (const StartupTaskTrace &trace : m_trace)
+    {
+        result.append(QStringLiteral(" %1 %2 %3  %4 %5\n")
+                      .arg(trace.OnCriticalPath ? QChar('*') : QChar(' '))
+                      .arg(toMilliseconds(trace.StartTime), 9, 'f', 1)
+                      .arg(toMilliseconds(trace.Duration), 9, 'f', 1)
+                      .arg(trace.Thread, -10)
+                      .arg(trace.Name));
+
+        if (trace.OnCriticalPath)
+            criticalPath.append(trace.Name);
+    }
+
+    result.append(QStringLiteral("Critical path (*): %1\n").arg(criticalPath.join(QLatin1String(" -> "))));
+    return result;
+}
+
+bool StartupGraph::resolveDependencies()
+{
+    for (Task &task : m_tasks)
+    {
+        task.Dependents.clear();
+        task.NumPendingDependencies = task.Dependencies.size();
+    }
+
+    for (std::size_t i = 0; i < m_tasks.size(); ++i)
+    {
+        for (const QString &dependency : m_tasks[i].Dependencies)
+        {
+            auto it = m_taskIndices.find(dependency);
+            if (it == m_taskIndices.end())
+            {
+                qWarning() << "StartupGraph - task " << m_tasks[i].Name << " depends on unknown task " << dependency;
+                return false;
+            }
+
+            m_tasks[it.value()].Dependents.push_back(i);
+        }
+    }
+
+    // Visit the tasks in topological order. Any task that is never visited is part of a cycle
+    std::vector<std::size_t> pendingCounts;
+    std::vector<std::size_t> queue;
+    pendingCounts.reserve(m_tasks.size());
+    for (std::size_t i = 0; i < m_tasks.size(); ++i)
+    {
+        pendingCounts.push_back(m_tasks[i].NumPendingDependencies);
+        if (pendingCounts[i] == 0)
+            queue.push_back(i);
+    }
+
+    for (std::size_t i = 0; i < queue.size(); ++i)
+    {
+        for (std::size_t dependent : m_tasks[queue[i]].Dependents)
+        {
+            if (--pendingCounts[dependent] == 0)
+                queue.push_back(dependent);
+        }
+    }
+
+    if (queue.size() != m_tasks.size())
+    {
+        qWarning() << "StartupGraph - the task dependencies form a cycle";
+        return false;
+    }
+
+    return true;
+}
+
+void StartupGraph::scheduleTask(std::size_t taskIndex)
+{
+    if (m_tasks[taskIndex].Thread == StartupThread::Main)
+    {
+        m_readyMainTasks.push_back(taskIndex);
+        m_cv.notify_one();
+        return;
+    }
+
+    QtConcurrent::run([this, taskIndex](){
+        executeTask(taskIndex);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finishTask(taskIndex);
+    });
+}
+
+void StartupGraph::executeTask(std::size_t taskIndex)
+{
+    Task &task = m_tasks[taskIndex];
+
+    const auto startTime = std::chrono::steady_clock::now();
+    task.ThreadId = std::this_thread::get_id();
+    task.StartTime = std::chrono::duration_cast<std::chrono::microseconds>(startTime - m_startTime);
+
+    if (task.Work)
+        task.Work();
+
+    task.Duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime);
+}
+
+void StartupGraph::finishTask(std::size_t taskIndex)
+{
+    ++m_numFinished;
+
+    for (std::size_t dependent : m_tasks[taskIndex].Dependents)
+    {
+        if (--m_tasks[dependent].NumPendingDependencies == 0)
+            scheduleTask(dependent);
+    }
+
+    m_cv.notify_one();
+}
+
+void StartupGraph::buildTrace()
+{
+    m_trace.clear();
+    if (m_tasks.empty())
+        return;
+
+    auto getEndTime = [this](std::size_t taskIndex) {
+        return m_tasks[taskIndex].StartTime + m_tasks[taskIndex].Duration;
+    };
+
+    // Walk back from the last task to finish, through the dependency of each task that finished last
+    std::vector<bool> onCriticalPath(m_tasks.size(), false);
+    std::size_t current = 0;
+    for (std::size_t i = 1; i < m_tasks.size(); ++i)
+    {
+        if (getEndTime(i) > getEndTime(current))
+            current = i;
+    }
+
+    for (;;)
+    {
+        onCriticalPath[current] = true;
+
+        const Task &task = m_tasks[current];
+        if (task.Dependencies.empty())
+            break;
+
+        std::size_t latest = m_taskIndices.value(task.Dependencies.front());
+        for (const QString &dependency : task.Dependencies)
+        {
+            const std::size_t dependencyIndex = m_taskIndices.value(dependency);
+            if (getEndTime(dependencyIndex) > getEndTime(latest))
+                latest = dependencyIndex;
+        }
+        current = latest;
+    }
+
+    std::vector<std::size_t> order(m_tasks.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+        return m_tasks[a].StartTime < m_tasks[b].StartTime;
+    });
+
+    // Pooled threads are numbered in the order in which they started their first task
+    std::unordered_map<std::thread::id, int> workerNumbers;
+    m_trace.reserve(m_tasks.size());
+    for (std::size_t taskIndex : order)
+    {
+        const Task &task = m_tasks[taskIndex];
+
+        QString threadName = QStringLiteral("main");
+        if (task.ThreadId != m_mainThreadId)
+        {
+            auto it = workerNumbers.find(task.ThreadId);
+            if (it == workerNumbers.end())
+                it = workerNumbers.insert(std::make_pair(task.ThreadId, static_cast<int>(workerNumbers.size()) + 1)).first;
+            threadName = QStringLiteral("worker-%1").arg(it->second);
+        }
+
+        m_trace.push_back(StartupTaskTrace { task.Name, threadName, task.StartTime, task.Duration, onCriticalPath[taskIndex] });
+    }
+}
@@ -0,0 +1,164 @@
+#ifndef STARTUPGRAPH_H
+#define STARTUPGRAPH_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+/// Thread on which a task of the \ref StartupGraph is run
+enum class StartupThread
+{
+    /// The thread that runs the graph, which is the GUI thread during application startup
+    Main,
+
+    /// A thread of the global thread pool
+    Worker
+};
+
+/**
+ * @struct StartupTaskTrace
+ * @brief Timing information of a task that was run by the \ref StartupGraph
+ */
+struct StartupTaskTrace
+{
+    /// Name of the task
+    QString Name;
+
+    /// Name of the thread that ran the task, either "main" or "worker-N"
+    QString Thread;
+
+    /// Time at which the task started, relative to the start of the graph
+    std::chrono::microseconds StartTime;
+
+    /// Wall time taken by the task
+    std::chrono::microseconds Duration;
+
+    /// True if the task is on the critical path of the graph, which is the chain of dependencies
+    /// that ends with the last task to finish
+    bool OnCriticalPath;
+};
+
+/**
+ * @class StartupGraph
+ * @brief Runs a set of initialization tasks in the order of their declared dependencies.
+ *
+ * Each task runs either on the thread that calls run(), or on the global thread pool. A task starts as soon
+ * as all of its dependencies have finished, so independent tasks on the thread pool run concurrently with
+ * each other and with the tasks of the main thread. The wall time and thread of every task are recorded.
+ */
+class StartupGraph
+{
+public:
+    /// Constructs an empty startup graph
+    StartupGraph();
+
+    /**
+     * @brief Adds a task to the graph
+     * @param name Unique name of the task
+     * @param dependencies Names of the tasks that must finish before this task starts
+     * @param thread Thread on which the task is run
+     * @param work Function that performs the task
+     */
+    void addTask(const QString &name, const std::vector<QString> &dependencies, StartupThread thread, std::function<void()> &&work);
+
+    /// Runs all tasks of the graph, returning once they have finished. Returns false without running
+    /// any task if a task depends on an unknown task, or if the dependencies form a cycle
+    bool run();
+
+    /// Returns the timing information of each task, ordered by start time, after a call to run()
+    const std::vector<StartupTaskTrace> &getTrace() const;
+
+    /// Returns the wall time taken by the last call to run()
+    std::chrono::microseconds getTotalTime() const;
+
+    /// Returns a human-readable report of the startup trace
+    QString formatTrace() const;
+
+private:
+    /// A task in the graph
+    struct Task
+    {
+        /// Name of the task
+        QString Name;
+
+        /// Names of the tasks that must finish first
+        std::vector<QString> Dependencies;
+
+        /// Thread on which the task is run
+        StartupThread Thread;
+
+        /// Function that performs the task
+        std::function<void()> Work;
+
+        /// Indices of the tasks that depend on this task
+        std::vector<std::size_t> Dependents;
+
+        /// Number of dependencies that have not yet finished
+        std::size_t NumPendingDependencies;
+
+        /// Identifier of the thread that ran the task
+        std::thread::id ThreadId;
+
+        /// Time at which the task started, relative to the start of the graph
+        std::chrono::microseconds StartTime;
+
+        /// Wall time taken by the task
+        std::chrono::microseconds Duration;
+    };
+
+    /// Links each task to its dependents, and returns true if every dependency is known and the graph is acyclic
+    bool resolveDependencies();
+
+    /// Either queues the task for the main thread or starts it on the thread pool. Called with the mutex held
+    void scheduleTask(std::size_t taskIndex);
+
+    /// Runs the task with the given index, recording its thread and timing
+    void executeTask(std::size_t taskIndex);
+
+    /// Schedules each dependent of the task that has no more pending dependencies. Called with the mutex held
+    void finishTask(std::size_t taskIndex);
+
+    /// Builds the trace of each task and marks the critical path
+    void buildTrace();
+
+private:
+    /// Tasks of the graph, in the order they were added
+    std::vector<Task> m_tasks;
+
+    /// Map of task names to their indices
+    QHash<QString, std::size_t> m_taskIndices;
+
+    /// Guards the scheduling state while the graph is running
+    std::mutex m_mutex;
+
+    /// Notifies the main thread when a task has finished or a main thread task is ready
+    std::condition_variable m_cv;
+
+    /// Tasks that are ready to run on the main thread
+    std::deque<std::size_t> m_readyMainTasks;
+
+    /// Number of tasks that have finished
+    std::size_t m_numFinished;
+
+    /// Identifier of the thread that called run()
+    std::thread::id m_mainThreadId;
+
+    /// Time at which run() was called
+    std::chrono::steady_clock::time_point m_startTime;
+
+    /// Wall time taken by the last call to run()
+    std::chrono::microseconds m_totalTime;
+
+    /// Timing information of each task, ordered by start time
+    std::vector<StartupTaskTrace> m_trace;
+};
+
+#endif // STARTUPGRAPH_H
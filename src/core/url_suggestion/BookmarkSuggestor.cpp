@@ -6,6 +6,8 @@
 #include "HistoryManager.h"
 #include "Settings.h"
 
+#include <algorithm>
+
 void BookmarkSuggestor::setServiceLocator(const ViperServiceLocator &serviceLocator)
 {
     m_bookmarkManager = serviceLocator.getServiceAs<BookmarkManager>("BookmarkManager");
@@ -69,6 +71,53 @@ std::vector<URLSuggestion> BookmarkSuggestor::getSuggestions(const std::atomic_b
     return result;
 }
 
+std::vector<URLSuggestion> BookmarkSuggestor::getQuickSuggestions(const std::atomic_bool &working, const QString &searchTerm)
+{
+    std::vector<URLSuggestion> result;
+    if (!m_bookmarkManager || !m_historyManager)
+        return result;
+
+    const std::size_t maxToSuggest = 5;
+
+    const QRegularExpression prefixExpr = QRegularExpression(QLatin1String("^WWW\\."));
+    const bool inputStartsWithWww = searchTerm.size() >= 3 && searchTerm.startsWith(QLatin1String("WWW"));
+
+    // Probe the bookmark indices by shortcut and by host, rather than comparing the input to each bookmark.
+    // The lookups return copies, since the bookmarks can be changed or removed on the UI thread meanwhile
+    std::vector<BookmarkSnapshot> shortcutMatches = m_bookmarkManager->findBookmarksWithShortcutIn(searchTerm);
+    std::vector<BookmarkSnapshot> hostMatches = m_bookmarkManager->findBookmarksWithHostPrefix(searchTerm, maxToSuggest);
+
+    for (const BookmarkSnapshot &bookmark : shortcutMatches)
+    {
+        if (!working.load() || result.size() >= maxToSuggest)
+            return result;
+
+        QString suggestionHost = bookmark.URL.host().toUpper();
+        if (!inputStartsWithWww)
+            suggestionHost = suggestionHost.replace(prefixExpr, QString());
+
+        URLSuggestion suggestion { bookmark, m_historyManager->getEntry(bookmark.URL), MatchType::Shortcut };
+        suggestion.IsHostMatch = suggestionHost.startsWith(searchTerm);
+        result.push_back(suggestion);
+    }
+
+    for (const BookmarkSnapshot &bookmark : hostMatches)
+    {
+        if (!working.load() || result.size() >= maxToSuggest)
+            return result;
+
+        auto isSameBookmark = [&bookmark](const BookmarkSnapshot &other) { return other.UniqueId == bookmark.UniqueId; };
+        if (std::any_of(shortcutMatches.begin(), shortcutMatches.end(), isSameBookmark))
+            continue;
+
+        URLSuggestion suggestion { bookmark, m_historyManager->getEntry(bookmark.URL), MatchType::URL };
+        suggestion.IsHostMatch = true;
+        result.push_back(suggestion);
+    }
+
+    return result;
+}
+
 MatchType BookmarkSuggestor::getMatchType(const QString &searchTerm,
                                           const QStringList &searchTermParts,
                                           const FastHashParameters &hashParams,
@@ -27,6 +27,9 @@ class BookmarkSuggestor final : public IURLSuggestor
                                               const QStringList &searchTermParts,
                                               const FastHashParameters &hashParams) override;
 
+    /// Suggests the bookmarks whose shortcut or host matches the given input
+    std::vector<URLSuggestion> getQuickSuggestions(const std::atomic_bool &working, const QString &searchTerm) override;
+
 private:
     /// Checks if an item with the given page title, url and optionally shortcut matches the search term, returning
     /// the corresponding type after evaluating all criteria. Returns MatchType::None when there is no match
@@ -1,37 +1,17 @@
-#include "BookmarkManager.h"
-#include "FastHash.h"
 #include "FaviconManager.h"
+#include "HistoryManager.h"
 #include "HistorySuggestor.h"
-#include "Settings.h"
 #include "URLRecord.h"
 
-#include "SQLiteWrapper.h"
-
 #include <algorithm>
-#include <numeric>
-#include <thread>
 
 #include <QDateTime>
-#include <QRandomGenerator>
 #include <QRegularExpression>
-#include <QSet>
-
-#include <QDebug>
 
 void HistorySuggestor::setServiceLocator(const ViperServiceLocator &serviceLocator)
 {
-    m_bookmarkManager = serviceLocator.getServiceAs<BookmarkManager>("BookmarkManager");
-    m_faviconManager  = serviceLocator.getServiceAs<FaviconManager>("FaviconManager");
-
-    if (Settings *settings = serviceLocator.getServiceAs<Settings>("Settings"))
-    {
-        m_historyDatabaseFile = settings->getPathValue(BrowserSetting::HistoryPath);
-    }
-}
-
-void HistorySuggestor::setHistoryFile(const QString &historyDbFile)
-{
-    m_historyDatabaseFile = historyDbFile;
+    m_historyManager = serviceLocator.getServiceAs<HistoryManager>("HistoryManager");
+    m_faviconManager = serviceLocator.getServiceAs<FaviconManager>("FaviconManager");
 }
 
 std::vector<URLSuggestion> HistorySuggestor::getSuggestions(const std::atomic_bool &working,
@@ -41,29 +21,15 @@ std::vector<URLSuggestion> HistorySuggestor::getSuggestions(const std::atomic_bo
 {
     std::vector<URLSuggestion> result;
 
-    if (!m_faviconManager || m_historyDatabaseFile.isEmpty())
+    if (!m_faviconManager || !m_historyManager)
         return result;
 
-    if (!m_historyDb)
-        setupConnection();
+    const URLSearchIndex &searchIndex = m_historyManager->getSearchIndex();
 
-    if (!m_historyDb || !m_historyDb->isValid())
+    result = getSuggestionsFromResults(working, searchTerm, MatchType::URL, searchIndex.findEntriesContaining(searchTerm, 25));
+    if (!working.load())
         return result;
 
-    const QString fullTermParam = QString("%%1%").arg(searchTerm);
-
-    sqlite::PreparedStatement &stmt = m_statements.at(Statement::SearchByWholeInput);
-    stmt.reset();
-    stmt << fullTermParam
-         << fullTermParam;
-    if (stmt.execute())
-    {
-        auto fullTermResult = getSuggestionsFromQuery(working, searchTerm, MatchType::URL, stmt);
-        result.insert(result.end(), std::make_move_iterator(fullTermResult.begin()), std::make_move_iterator(fullTermResult.end()));
-        if (!working.load())
-            return result;
-    }
-
     if (searchTermParts.size() == 1)
         return result;
 
@@ -77,24 +43,13 @@ std::vector<URLSuggestion> HistorySuggestor::getSuggestions(const std::atomic_bo
         return a.length() > b.length();
     });
 
-    sqlite::PreparedStatement &stmtWords = m_statements.at(Statement::SearchBySingleWord);
-
     for (const QString &word : searchWords)
     {
         if (!working.load())
             return result;
 
-        QString wordTemp = word.size() < 4 ? QString("%%1%") : QString("%1%");
-        wordTemp = wordTemp.arg(word.trimmed().toUpper());
-        const std::string wordStdBinding = wordTemp.toStdString();
-
-        stmtWords.reset();
-        stmtWords << wordStdBinding;
-
-        if (!stmtWords.execute())
-            continue;
-
-        auto wordQueryResult = getSuggestionsFromQuery(working, searchTerm, MatchType::SearchWords, stmtWords);
+        auto wordQueryResult = getSuggestionsFromResults(working, searchTerm, MatchType::SearchWords,
+                                                         searchIndex.findEntriesWithWord(word.trimmed().toUpper(), 5));
         for (auto& suggestion : wordQueryResult)
         {
             auto match = std::find_if(result.begin(), result.end(), [&suggestion](const URLSuggestion &other){
@@ -108,6 +63,7 @@ std::vector<URLSuggestion> HistorySuggestor::getSuggestions(const std::atomic_bo
 
     return result;
 }
+
     /*
                 std::vector<QString> historyWords = getHistoryEntryWords(record.getVisitId());
                 for (const QString &searchWord : searchWords)
@@ -149,14 +105,28 @@ std::vector<URLSuggestion> HistorySuggestor::getSuggestions(const std::atomic_bo
             }
     */
 
-std::vector<URLSuggestion> HistorySuggestor::getSuggestionsFromQuery(const std::atomic_bool &working,
-                                                                     const QString &searchTerm,
-                                                                     MatchType queryMatchType,
-                                                                     sqlite::PreparedStatement &query)
+std::vector<URLSuggestion> HistorySuggestor::getQuickSuggestions(const std::atomic_bool &working, const QString &searchTerm)
 {
-    constexpr int maxToSuggest = 25;
-    int numSuggested = 0;
+    std::vector<URLSuggestion> result;
 
+    if (!m_faviconManager || !m_historyManager)
+        return result;
+
+    const URLSearchIndex &searchIndex = m_historyManager->getSearchIndex();
+
+    result = getSuggestionsFromResults(working, searchTerm, MatchType::URL, searchIndex.findEntriesContaining(searchTerm, 5));
+    result.erase(std::remove_if(result.begin(), result.end(), [](const URLSuggestion &suggestion) {
+        return !suggestion.IsHostMatch;
+    }), result.end());
+
+    return result;
+}
+
+std::vector<URLSuggestion> HistorySuggestor::getSuggestionsFromResults(const std::atomic_bool &working,
+                                                                       const QString &searchTerm,
+                                                                       MatchType queryMatchType,
+                                                                       std::vector<URLSearchResult> &&searchResults)
+{
     // Strip www prefix from urls when user does not also have this in the search term
     const QRegularExpression prefixExpr = QRegularExpression(QLatin1String("^WWW\\."));
     const bool inputStartsWithWww = searchTerm.size() >= 3 && searchTerm.startsWith(QLatin1String("WWW"));
@@ -165,14 +135,12 @@ std::vector<URLSuggestion> HistorySuggestor::getSuggestionsFromQuery(const std::
 
     std::vector<URLSuggestion> result;
 
-    while (query.next())
+    for (URLSearchResult &searchResult : searchResults)
     {
         if (!working.load())
             return result;
 
-        HistoryEntry entry;
-        query >> entry;
-
+        HistoryEntry &entry = searchResult.Entry;
         if (entry.URLTypedCount < 1
                 && entry.NumVisits < 4
                 && entry.LastVisit < cutoffTime)
@@ -182,6 +150,7 @@ std::vector<URLSuggestion> HistorySuggestor::getSuggestionsFromQuery(const std::
         URLRecord urlRecord{ std::move(entry), std::move(emptyVisits) };
 
         URLSuggestion suggestion { urlRecord, m_faviconManager->getFavicon(urlRecord.getUrl()), queryMatchType };
+        suggestion.IsBookmark = searchResult.IsBookmark;
 
         QString suggestionHost = urlRecord.getUrl().host().toUpper();
         if (!inputStartsWithWww)
@@ -189,30 +158,6 @@ std::vector<URLSuggestion> HistorySuggestor::getSuggestionsFromQuery(const std::
         suggestion.IsHostMatch = searchTerm.startsWith(suggestionHost);
 
         result.push_back(suggestion);
-        if (++numSuggested >= maxToSuggest)
-            return result;
     }
     return result;
 }
-
-void HistorySuggestor::setupConnection()
-{
-    m_historyDb = std::make_unique<sqlite::Database>(m_historyDatabaseFile.toStdString());
-    m_statements.insert(std::make_pair(Statement::SearchByWholeInput,
-                                       m_historyDb->prepare(R"(SELECT H.VisitID, H.URL, H.Title, H.URLTypedCount, V.VisitCount, V.RecentVisit
-                                                            FROM History AS H INNER JOIN
-                                                            (SELECT VisitID, MAX(Date) AS RecentVisit, COUNT(Date) AS VisitCount FROM Visits INDEXED BY Visit_ID_Index GROUP BY VisitID) AS V
-                                                            ON H.VisitID = V.VisitID
-                                                            WHERE H.Title LIKE ? OR H.URL LIKE ?
-                                                            ORDER BY V.VisitCount DESC, H.URLTypedCount DESC LIMIT 25)")));
-    m_statements.insert(std::make_pair(Statement::SearchBySingleWord,
-                                       m_historyDb->prepare(R"(SELECT U.HistoryID, H.URL, H.Title, H.URLTypedCount, V.VisitCount, V.RecentVisit
-                                                            FROM URLWords AS U INNER JOIN Words
-                                                              ON U.WordID = Words.WordID
-                                                            INNER JOIN History AS H
-                                                              ON U.HistoryID = H.VisitID
-                                                            INNER JOIN (SELECT VisitID, MAX(Date) AS RecentVisit, COUNT(Date) AS VisitCount FROM Visits INDEXED BY Visit_ID_Index GROUP BY VisitID) AS V
-                                                              ON H.VisitID = V.VisitID
-                                                            WHERE Words.Word LIKE ?
-                                                            ORDER BY V.VisitCount DESC, V.RecentVisit DESC, H.URLTypedCount DESC LIMIT 5)")));
-}
@@ -29,7 +29,9 @@ struct FastHashParameters
  * @class IURLSuggestor
  * @brief Interface for any classes that feed
  *        suggestions to the \ref URLSuggestionWorker for
- *        URL entries that are based on some user input.
+ *        URL entries that are based on some user input. The
+ *        methods of a suggestor may be called from any thread,
+ *        and for several search terms at once.
  */
 class IURLSuggestor
 {
@@ -56,6 +58,16 @@ class IURLSuggestor
                                                       const QString &searchTerm,
                                                       const QStringList &searchTermParts,
                                                       const FastHashParameters &hashParams) = 0;
+
+    /**
+     * @brief getQuickSuggestions Finds the recommendations that can be determined almost instantly, such as bookmark
+     *        shortcuts or URLs whose host matches the user input. These are shown before the result of \ref getSuggestions
+     *        is known, and may be included in it again
+     * @param working Flag indicating whether or not the calling suggestion worker is still active
+     * @param searchTerm User input string
+     * @return A vector of \ref URLSuggestion objects, which can be empty if no suggestions are found
+     */
+    virtual std::vector<URLSuggestion> getQuickSuggestions(const std::atomic_bool &working, const QString &searchTerm) = 0;
 };
 
 #endif // IURLSUGGESTOR_H
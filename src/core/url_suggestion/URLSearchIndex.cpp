@@ -0,0 +1,316 @@
+#include "Frecency.h"
+#include "URLSearchIndex.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <QReadLocker>
+#include <QWriteLocker>
+
+/// Flag set on the keys of one- and two-character grams, which distinguishes them from the keys of trigrams
+static const uint64_t ShortGramFlag = uint64_t{1} << 48;
+
+URLSearchIndex::URLSearchIndex() :
+    m_lock(),
+    m_entries(),
+    m_entryIds(),
+    m_postings(),
+    m_bookmarkedUrls()
+{
+}
+
+void URLSearchIndex::clear()
+{
+    QWriteLocker lock(&m_lock);
+
+    m_entries.clear();
+    m_entryIds.clear();
+    m_postings.clear();
+}
+
+void URLSearchIndex::load(std::vector<HistoryEntry> &&entries)
+{
+    // Prepare the search text of each entry before taking the lock, so visits are not held up for long
+    std::vector<std::pair<QString, QString>> urlsAndTexts = getUrlsAndSearchTexts(entries);
+
+    QWriteLocker lock(&m_lock);
+    insertEntries(std::move(entries), std::move(urlsAndTexts));
+}
+
+void URLSearchIndex::reload(std::vector<HistoryEntry> &&entries)
+{
+    std::vector<std::pair<QString, QString>> urlsAndTexts = getUrlsAndSearchTexts(entries);
+
+    // Readers either see the old entries or the new ones, never an empty index
+    QWriteLocker lock(&m_lock);
+
+    m_entries.clear();
+    m_entryIds.clear();
+    m_postings.clear();
+    insertEntries(std::move(entries), std::move(urlsAndTexts));
+}
+
+void URLSearchIndex::addVisit(const HistoryEntry &entry, bool wasTypedByUser)
+{
+    const QString url = entry.URL.toString().toUpper();
+
+    QWriteLocker lock(&m_lock);
+
+    auto it = m_entryIds.find(url);
+    if (it == m_entryIds.end())
+    {
+        const uint32_t entryId = static_cast<uint32_t>(m_entries.size());
+        m_entries.push_back(IndexedEntry { entry, getSearchText(entry), m_bookmarkedUrls.contains(url) });
+        m_entryIds.insert(std::make_pair(url, entryId));
+        indexEntry(entryId);
+        return;
+    }
+
+    const uint32_t entryId = it->second;
+    IndexedEntry &indexedEntry = m_entries[entryId];
+    HistoryEntry &existing = indexedEntry.Entry;
+
+    existing.Frecency = Frecency::addVisit(existing.Frecency, existing.NumVisits, entry.LastVisit);
+    existing.NumVisits++;
+    if (wasTypedByUser)
+        existing.URLTypedCount++;
+    if (entry.LastVisit > existing.LastVisit)
+        existing.LastVisit = entry.LastVisit;
+
+    if (!entry.Title.isEmpty() && entry.Title.compare(existing.Title) != 0)
+    {
+        unindexEntry(entryId);
+        existing.Title = entry.Title;
+        indexedEntry.SearchText = getSearchText(existing);
+        indexEntry(entryId);
+    }
+}
+
+void URLSearchIndex::setBookmarkedUrls(const QSet<QString> &urls)
+{
+    QWriteLocker lock(&m_lock);
+
+    m_bookmarkedUrls = urls;
+    for (const auto &it : m_entryIds)
+        m_entries[it.second].IsBookmark = m_bookmarkedUrls.contains(it.first);
+}
+
+std::size_t URLSearchIndex::size() const
+{
+    QReadLocker lock(&m_lock);
+    return m_entries.size();
+}
+
+std::vector<URLSearchResult> URLSearchIndex::findEntriesContaining(const QString &term, std::size_t limit) const
+{
+    QReadLocker lock(&m_lock);
+
+    std::vector<uint32_t> entryIds = getCandidates(term);
+    entryIds.erase(std::remove_if(entryIds.begin(), entryIds.end(), [&](uint32_t entryId) {
+        return !m_entries[entryId].SearchText.contains(term);
+    }), entryIds.end());
+
+    return getTopResults(entryIds, limit, [](const HistoryEntry &a, const HistoryEntry &b) {
+        if (a.Frecency != b.Frecency)
+            return a.Frecency > b.Frecency;
+        return a.URLTypedCount > b.URLTypedCount;
+    });
+}
+
+std::vector<URLSearchResult> URLSearchIndex::findEntriesWithWord(const QString &word, std::size_t limit) const
+{
+    QReadLocker lock(&m_lock);
+
+    std::vector<uint32_t> entryIds = getCandidates(word);
+    const bool matchAnywhere = word.size() < 4;
+    entryIds.erase(std::remove_if(entryIds.begin(), entryIds.end(), [&](uint32_t entryId) {
+        const QString &searchText = m_entries[entryId].SearchText;
+        return matchAnywhere ? !searchText.contains(word) : !hasWordStartingWith(searchText, word);
+    }), entryIds.end());
+
+    return getTopResults(entryIds, limit, [](const HistoryEntry &a, const HistoryEntry &b) {
+        if (a.Frecency != b.Frecency)
+            return a.Frecency > b.Frecency;
+        return a.URLTypedCount > b.URLTypedCount;
+    });
+}
+
+std::vector<uint32_t> URLSearchIndex::getCandidates(const QString &term) const
+{
+    if (term.isEmpty())
+        return {};
+
+    if (term.size() < 3)
+    {
+        auto it = m_postings.find(getShortGramKey(term.constData(), term.size()));
+        return it != m_postings.end() ? it->second : std::vector<uint32_t>();
+    }
+
+    // Every trigram of the term must be present, and the entries of the rarest one are the candidates
+    const std::vector<uint32_t> *rarest = nullptr;
+    const QChar *data = term.constData();
+    for (int i = 0; i + 3 <= term.size(); ++i)
+    {
+        auto it = m_postings.find(getTrigramKey(data + i));
+        if (it == m_postings.end())
+            return {};
+
+        if (rarest == nullptr || it->second.size() < rarest->size())
+            rarest = &it->second;
+    }
+
+    return *rarest;
+}
+
+void URLSearchIndex::insertEntries(std::vector<HistoryEntry> &&entries, std::vector<std::pair<QString, QString>> &&urlsAndTexts)
+{
+    m_entries.reserve(m_entries.size() + entries.size());
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        HistoryEntry &entry = entries[i];
+        const QString &url = urlsAndTexts[i].first;
+
+        auto it = m_entryIds.find(url);
+        if (it != m_entryIds.end())
+        {
+            // The page was visited after the database was read, so its visits are not part of the loaded entry
+            HistoryEntry &existing = m_entries[it->second].Entry;
+            existing.VisitID = entry.VisitID;
+            existing.Frecency = Frecency::combine(existing.Frecency, existing.NumVisits, entry.Frecency, entry.NumVisits);
+            existing.NumVisits += entry.NumVisits;
+            existing.URLTypedCount += entry.URLTypedCount;
+            if (entry.LastVisit > existing.LastVisit)
+                existing.LastVisit = entry.LastVisit;
+            continue;
+        }
+
+        const uint32_t entryId = static_cast<uint32_t>(m_entries.size());
+        m_entries.push_back(IndexedEntry { std::move(entry), std::move(urlsAndTexts[i].second), m_bookmarkedUrls.contains(url) });
+        m_entryIds.insert(std::make_pair(url, entryId));
+        indexEntry(entryId);
+    }
+}
+
+std::vector<std::pair<QString, QString>> URLSearchIndex::getUrlsAndSearchTexts(const std::vector<HistoryEntry> &entries)
+{
+    std::vector<std::pair<QString, QString>> urlsAndTexts;
+    urlsAndTexts.reserve(entries.size());
+    for (const HistoryEntry &entry : entries)
+        urlsAndTexts.push_back(std::make_pair(entry.URL.toString().toUpper(), getSearchText(entry)));
+    return urlsAndTexts;
+}
+
+void URLSearchIndex::indexEntry(uint32_t entryId)
+{
+    for (uint64_t key : getKeys(m_entries[entryId].SearchText))
+    {
+        std::vector<uint32_t> &entryIds = m_postings[key];
+        if (entryIds.empty() || entryIds.back() < entryId)
+        {
+            entryIds.push_back(entryId);
+            continue;
+        }
+
+        auto it = std::lower_bound(entryIds.begin(), entryIds.end(), entryId);
+        if (it == entryIds.end() || *it != entryId)
+            entryIds.insert(it, entryId);
+    }
+}
+
+void URLSearchIndex::unindexEntry(uint32_t entryId)
+{
+    for (uint64_t key : getKeys(m_entries[entryId].SearchText))
+    {
+        auto postingIt = m_postings.find(key);
+        if (postingIt == m_postings.end())
+            continue;
+
+        std::vector<uint32_t> &entryIds = postingIt->second;
+        auto it = std::lower_bound(entryIds.begin(), entryIds.end(), entryId);
+        if (it != entryIds.end() && *it == entryId)
+            entryIds.erase(it);
+
+        if (entryIds.empty())
+            m_postings.erase(postingIt);
+    }
+}
+
+std::vector<uint64_t> URLSearchIndex::getKeys(const QString &searchText)
+{
+    std::vector<uint64_t> keys;
+
+    const QChar *data = searchText.constData();
+    const int length = searchText.size();
+    keys.reserve(static_cast<std::size_t>(length) * 3);
+
+    for (int i = 0; i < length; ++i)
+    {
+        keys.push_back(getShortGramKey(data + i, 1));
+        if (i + 2 <= length)
+            keys.push_back(getShortGramKey(data + i, 2));
+        if (i + 3 <= length)
+            keys.push_back(getTrigramKey(data + i));
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+uint64_t URLSearchIndex::getTrigramKey(const QChar *data)
+{
+    return (static_cast<uint64_t>(data[0].unicode()) << 32)
+            | (static_cast<uint64_t>(data[1].unicode()) << 16)
+            | static_cast<uint64_t>(data[2].unicode());
+}
+
+uint64_t URLSearchIndex::getShortGramKey(const QChar *data, int length)
+{
+    uint64_t key = ShortGramFlag | (static_cast<uint64_t>(data[0].unicode()) << 16);
+    if (length > 1)
+        key |= static_cast<uint64_t>(data[1].unicode());
+    return key;
+}
+
+QString URLSearchIndex::getSearchText(const HistoryEntry &entry)
+{
+    return entry.URL.toString().toUpper() + QChar('\n') + entry.Title.toUpper();
+}
+
+bool URLSearchIndex::hasWordStartingWith(const QString &searchText, const QString &word)
+{
+    int pos = searchText.indexOf(word);
+    while (pos >= 0)
+    {
+        if (pos == 0 || !searchText.at(pos - 1).isLetterOrNumber())
+            return true;
+
+        pos = searchText.indexOf(word, pos + 1);
+    }
+    return false;
+}
+
+template <typename Compare>
+std::vector<URLSearchResult> URLSearchIndex::getTopResults(std::vector<uint32_t> &entryIds, std::size_t limit, Compare compare) const
+{
+    auto compareIds = [this, &compare](uint32_t a, uint32_t b) {
+        return compare(m_entries[a].Entry, m_entries[b].Entry);
+    };
+
+    if (entryIds.size() > limit)
+    {
+        std::partial_sort(entryIds.begin(), entryIds.begin() + static_cast<std::ptrdiff_t>(limit), entryIds.end(), compareIds);
+        entryIds.resize(limit);
+    }
+    else
+        std::sort(entryIds.begin(), entryIds.end(), compareIds);
+
+    std::vector<URLSearchResult> result;
+    result.reserve(entryIds.size());
+    for (uint32_t entryId : entryIds)
+    {
+        const IndexedEntry &indexedEntry = m_entries[entryId];
+        result.push_back(URLSearchResult { indexedEntry.Entry, indexedEntry.IsBookmark });
+    }
+    return result;
+}
@@ -0,0 +1,147 @@
+#ifndef URLSEARCHINDEX_H
+#define URLSEARCHINDEX_H
+
+#include "CommonUtil.h"
+#include "URLRecord.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+
+/**
+ * @struct URLSearchResult
+ * @brief A history entry found by the \ref URLSearchIndex
+ */
+struct URLSearchResult
+{
+    /// History entry, including its visit count, typed count, time of last visit and frecency
+    HistoryEntry Entry;
+
+    /// Flag indicating whether or not the URL of the entry is bookmarked
+    bool IsBookmark;
+};
+
+/**
+ * @class URLSearchIndex
+ * @brief Resident full-text index of the browsing history, used to suggest URLs as the user
+ *        types into the URL bar.
+ *
+ * Each entry is indexed by the trigrams of its upper-case URL and title, and by the one and
+ * two character grams of the same text, so that short terms can also match anywhere. The visit count, typed count, time of last visit and
+ * frecency are kept alongside each entry, so that a search never needs to go to the history database.
+ * The index is updated by the \ref HistoryManager on each visit and bookmark change, and may be
+ * searched from other threads.
+ */
+class URLSearchIndex
+{
+public:
+    /// Constructs an empty index
+    URLSearchIndex();
+
+    /// Removes all entries from the index
+    void clear();
+
+    /// Adds the given entries, which were loaded from the history database, to the index. If an entry's URL
+    /// has already been visited since the database was read, the visit counts of the two are combined
+    void load(std::vector<HistoryEntry> &&entries);
+
+    /// Replaces all entries of the index with the given entries, which were loaded from the history database
+    void reload(std::vector<HistoryEntry> &&entries);
+
+    /// Records a visit to the URL of the given entry, inserting the entry if it is not yet in the index
+    void addVisit(const HistoryEntry &entry, bool wasTypedByUser);
+
+    /// Sets the URLs, in upper case, of all bookmarks
+    void setBookmarkedUrls(const QSet<QString> &urls);
+
+    /// Returns the number of entries in the index
+    std::size_t size() const;
+
+    /**
+     * @brief Searches for entries whose URL or title contains the given term
+     * @param term Search term, in upper case
+     * @param limit Maximum number of results
+     * @return Matching entries, ordered by their frecency and then by their typed count
+     */
+    std::vector<URLSearchResult> findEntriesContaining(const QString &term, std::size_t limit) const;
+
+    /**
+     * @brief Searches for entries with a word in their URL or title that matches the given word. Words shorter than
+     *        four characters may match anywhere within the URL or title, while longer words must match the start of a word
+     * @param word Search word, in upper case
+     * @param limit Maximum number of results
+     * @return Matching entries, ordered by their frecency and then by their typed count
+     */
+    std::vector<URLSearchResult> findEntriesWithWord(const QString &word, std::size_t limit) const;
+
+private:
+    /// An entry in the index
+    struct IndexedEntry
+    {
+        /// History entry
+        HistoryEntry Entry;
+
+        /// Upper-case URL and title of the entry, separated by a line break
+        QString SearchText;
+
+        /// True if the URL of the entry is bookmarked
+        bool IsBookmark;
+    };
+
+    /// Returns the indices of all entries that may contain the given term. The candidates must still be verified
+    std::vector<uint32_t> getCandidates(const QString &term) const;
+
+    /// Adds the entries loaded from the history database, along with their upper-case URLs and search texts. Must be called with the write lock held
+    void insertEntries(std::vector<HistoryEntry> &&entries, std::vector<std::pair<QString, QString>> &&urlsAndTexts);
+
+    /// Adds the grams of the entry's search text to the posting lists
+    void indexEntry(uint32_t entryId);
+
+    /// Removes the grams of the entry's search text from the posting lists
+    void unindexEntry(uint32_t entryId);
+
+    /// Returns the upper-case URL and the search text of each of the given entries
+    static std::vector<std::pair<QString, QString>> getUrlsAndSearchTexts(const std::vector<HistoryEntry> &entries);
+
+    /// Returns the sorted, de-duplicated gram keys of the given search text
+    static std::vector<uint64_t> getKeys(const QString &searchText);
+
+    /// Returns the key of the trigram starting at the given position
+    static uint64_t getTrigramKey(const QChar *data);
+
+    /// Returns the key of the gram of one or two characters starting at the given position
+    static uint64_t getShortGramKey(const QChar *data, int length);
+
+    /// Returns the search text of the given history entry
+    static QString getSearchText(const HistoryEntry &entry);
+
+    /// Returns true if a word of the search text starts with the given word
+    static bool hasWordStartingWith(const QString &searchText, const QString &word);
+
+    /// Converts the given entry indices into search results, keeping the first entries in the order given by the comparator
+    template <typename Compare>
+    std::vector<URLSearchResult> getTopResults(std::vector<uint32_t> &entryIds, std::size_t limit, Compare compare) const;
+
+private:
+    /// Guards the index, which is written to on the UI thread and read from the URL suggestion thread
+    mutable QReadWriteLock m_lock;
+
+    /// Entries of the index
+    std::vector<IndexedEntry> m_entries;
+
+    /// Map of upper-case URLs to the indices of their entries
+    std::unordered_map<QString, uint32_t> m_entryIds;
+
+    /// Map of gram keys to the sorted indices of the entries that contain them
+    std::unordered_map<uint64_t, std::vector<uint32_t>> m_postings;
+
+    /// Upper-case URLs of all bookmarks
+    QSet<QString> m_bookmarkedUrls;
+};
+
+#endif // URLSEARCHINDEX_H
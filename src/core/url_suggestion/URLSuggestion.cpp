@@ -2,13 +2,14 @@
 #include "URLRecord.h"
 #include "URLSuggestion.h"
 
-URLSuggestion::URLSuggestion(const BookmarkNode *bookmark, const HistoryEntry &historyEntry, MatchType matchType) :
-    Favicon(bookmark->getIcon()),
-    Title(bookmark->getName()),
-    URL(bookmark->getURL().toString()),
+URLSuggestion::URLSuggestion(const BookmarkSnapshot &bookmark, const HistoryEntry &historyEntry, MatchType matchType) :
+    Favicon(bookmark.Icon),
+    Title(bookmark.Name),
+    URL(bookmark.URL.toString()),
     LastVisit(historyEntry.LastVisit),
     URLTypedCount(historyEntry.URLTypedCount),
     VisitCount(historyEntry.NumVisits),
+    Frecency(historyEntry.Frecency),
     PercentMatch(0),
     IsHostMatch(false),
     IsBookmark(true),
@@ -24,6 +25,7 @@ URLSuggestion::URLSuggestion(const URLRecord &record, const QIcon &icon, MatchTy
     LastVisit(record.getLastVisit()),
     URLTypedCount(record.getUrlTypedCount()),
     VisitCount(record.getNumVisits()),
+    Frecency(record.getFrecency()),
     PercentMatch(0),
     IsHostMatch(false),
     IsBookmark(false),
@@ -6,7 +6,7 @@
 #include <QMetaType>
 #include <QString>
 
-class BookmarkNode;
+struct BookmarkSnapshot;
 struct HistoryEntry;
 class URLRecord;
 
@@ -37,8 +37,8 @@ struct URLSuggestion
     /// Default constructor
     URLSuggestion() = default;
 
-    /// Constructs the URL suggestion given a bookmark node, its corresponding history entry and the type of search term match
-    URLSuggestion(const BookmarkNode *bookmark, const HistoryEntry &historyEntry, MatchType matchType);
+    /// Constructs the URL suggestion given a copy of a bookmark, its corresponding history entry and the type of search term match
+    URLSuggestion(const BookmarkSnapshot &bookmark, const HistoryEntry &historyEntry, MatchType matchType);
 
     /// Constructs the URL suggestion from a history record, an icon and the type of search term match
     URLSuggestion(const URLRecord &record, const QIcon &icon, MatchType matchType);
@@ -61,6 +61,9 @@ struct URLSuggestion
     /// Number of visits to the page with this url
     int VisitCount;
 
+    /// Frecency key of the url, combining its number of visits with their recency
+    double Frecency;
+
     /// Percent match (0-100), applicable only for match type "SearchWords"
     int PercentMatch;
 
@@ -10,12 +10,13 @@
 #include "URLSuggestionWorker.h"
 
 #include <algorithm>
-#include <chrono>
+#include <condition_variable>
 #include <iterator>
 
+#include <QMetaObject>
 #include <QSet>
-#include <QTimer>
 #include <QUrl>
+#include <QtConcurrent>
 
 #include <QDebug>
 
@@ -26,10 +27,9 @@ bool compareUrlSuggestions(const URLSuggestion &a, const URLSuggestion &b)
     // 1) Number of times the URL was previously typed into the URL bar (ignore this check if a and b have never been typed into the bar)
     // 2) Closeness of the url to the user input (ex: search="viper.com", a="vipers-are-cool.com", b="viper.com/faq", choose b)
     // 2a) Closeness of search term components to url and title components, where applicable
-    // 3) Number of visits to the urls
-    // 4) Most recent visit
-    // [disabled] 5) Type of match to the search term (ex: the page title vs the URL)
-    // 5) Alphabetical ordering
+    // 3) Frecency of the urls, which combines the number of visits with how recent they were
+    // [disabled] 4) Type of match to the search term (ex: the page title vs the URL)
+    // 4) Alphabetical ordering
 
     if (!a.URLTypedCount != !b.URLTypedCount)
         return a.URLTypedCount > b.URLTypedCount;
@@ -41,11 +41,8 @@ bool compareUrlSuggestions(const URLSuggestion &a, const URLSuggestion &b)
     if (a.Type == b.Type && a.Type == MatchType::SearchWords && a.PercentMatch != b.PercentMatch)
         return a.PercentMatch > b.PercentMatch;
 
-    if (a.VisitCount != b.VisitCount)
-        return a.VisitCount > b.VisitCount;
-
-    if (a.LastVisit != b.LastVisit)
-        return a.LastVisit < b.LastVisit;
+    if (a.Frecency != b.Frecency)
+        return a.Frecency > b.Frecency;
 
     //if (a.Type != b.Type)
     //    return static_cast<int>(a.Type) < static_cast<int>(b.Type);
@@ -53,27 +50,87 @@ bool compareUrlSuggestions(const URLSuggestion &a, const URLSuggestion &b)
     return a.URL < b.URL;
 }
 
+/// Maximum number of suggestions that are shown to the user
+static const std::size_t MaxSuggestions = 25;
+
 URLSuggestionWorker::URLSuggestionWorker(QObject *parent) :
     QObject(parent),
     m_working(false),
+    m_pendingMutex(),
+    m_pendingText(),
+    m_hasPendingSearch(false),
+    m_isSearchScheduled(false),
     m_searchTerm(),
     m_searchWords(),
     m_suggestions(),
+    m_hits(),
+    m_reusedSuggestions(),
+    m_previousSearchTerm(),
+    m_previousSuggestions(),
     m_searchTermWideStr(),
     m_differenceHash(0),
     m_searchTermHash(0),
-    m_handlers()
+    m_handlers(),
+    m_searchPool()
 {
     m_handlers.push_back(std::make_unique<BookmarkSuggestor>());
     m_handlers.push_back(std::make_unique<HistorySuggestor>());
+
+    m_searchPool.setMaxThreadCount(static_cast<int>(m_handlers.size()));
 }
 
 void URLSuggestionWorker::stopWork()
 {
+    std::lock_guard<std::mutex> lock{m_pendingMutex};
+    m_hasPendingSearch = false;
     m_working.store(false);
 }
 
 void URLSuggestionWorker::findSuggestionsFor(const QString &text)
+{
+    std::lock_guard<std::mutex> lock{m_pendingMutex};
+    m_pendingText = text;
+    m_hasPendingSearch = true;
+    m_working.store(false);
+
+    // Keystrokes made while a search is queued or in progress only replace the pending search term
+    if (!m_isSearchScheduled)
+    {
+        m_isSearchScheduled = true;
+        QMetaObject::invokeMethod(this, "processPendingSearches", Qt::QueuedConnection);
+    }
+}
+
+void URLSuggestionWorker::setServiceLocator(const ViperServiceLocator &serviceLocator)
+{
+    for (auto &handler : m_handlers)
+        handler->setServiceLocator(serviceLocator);
+}
+
+void URLSuggestionWorker::processPendingSearches()
+{
+    for (;;)
+    {
+        QString text;
+        {
+            std::lock_guard<std::mutex> lock{m_pendingMutex};
+            if (!m_hasPendingSearch)
+            {
+                m_isSearchScheduled = false;
+                return;
+            }
+
+            text = m_pendingText;
+            m_hasPendingSearch = false;
+            m_working.store(true);
+        }
+
+        setSearchTerm(text);
+        searchForHits();
+    }
+}
+
+void URLSuggestionWorker::setSearchTerm(const QString &text)
 {
     m_searchTerm = text.toUpper().trimmed();
 
@@ -87,49 +144,138 @@ void URLSuggestionWorker::findSuggestionsFor(const QString &text)
     m_searchWords = CommonUtil::tokenizePossibleUrl(m_searchTerm);
 
     hashSearchTerm();
-    searchForHits();
-}
-
-void URLSuggestionWorker::setServiceLocator(const ViperServiceLocator &serviceLocator)
-{
-    for (auto &handler : m_handlers)
-        handler->setServiceLocator(serviceLocator);
 }
 
 void URLSuggestionWorker::searchForHits()
 {
-    m_working.store(true);
     m_suggestions.clear();
+    m_hits.clear();
+
+    reusePreviousSuggestions();
 
-    QSet<QString> hits;
-    FastHashParameters hashParams { m_searchTermWideStr, m_differenceHash, m_searchTermHash };
     for (auto &handler : m_handlers)
     {
         if (!m_working.load())
             return;
 
-        std::vector<URLSuggestion> suggestions
-                = handler->getSuggestions(m_working, m_searchTerm, m_searchWords, hashParams);
-        for (auto &&suggestion : suggestions)
+        mergeSuggestions(handler->getQuickSuggestions(m_working, m_searchTerm));
+    }
+
+    if (!m_working.load())
+        return;
+
+    if (!m_suggestions.empty())
+        emit suggestionsUpdated(getRankedSuggestions(true));
+
+    // Run the full search of each suggestor concurrently, merging their results in the order in which they finish
+    struct CompletedSearches
+    {
+        std::mutex Mutex;
+        std::condition_variable Condition;
+        std::vector<std::vector<URLSuggestion>> Results;
+    };
+
+    CompletedSearches completed;
+    const FastHashParameters hashParams { m_searchTermWideStr, m_differenceHash, m_searchTermHash };
+    for (auto &handler : m_handlers)
+    {
+        IURLSuggestor *suggestor = handler.get();
+        QtConcurrent::run(&m_searchPool, [this, suggestor, &hashParams, &completed](){
+            std::vector<URLSuggestion> suggestions = suggestor->getSuggestions(m_working, m_searchTerm, m_searchWords, hashParams);
+
+            std::lock_guard<std::mutex> lock{completed.Mutex};
+            completed.Results.push_back(std::move(suggestions));
+            completed.Condition.notify_one();
+        });
+    }
+
+    // Every search must finish before returning, since they refer to the state of this search. Once cancelled,
+    // they return almost immediately
+    for (std::size_t numCompleted = 1; numCompleted <= m_handlers.size(); ++numCompleted)
+    {
+        std::vector<URLSuggestion> suggestions;
         {
-            const auto urlUpper = suggestion.URL.toUpper();
-            if (hits.contains(urlUpper))
-                continue;
+            std::unique_lock<std::mutex> lock{completed.Mutex};
+            completed.Condition.wait(lock, [&completed](){
+                return !completed.Results.empty();
+            });
 
-            hits.insert(urlUpper);
-            m_suggestions.emplace_back(suggestion);
+            suggestions = std::move(completed.Results.back());
+            completed.Results.pop_back();
         }
+
+        if (!m_working.load())
+            continue;
+
+        mergeSuggestions(std::move(suggestions));
+        if (numCompleted < m_handlers.size())
+            emit suggestionsUpdated(getRankedSuggestions(true));
     }
 
     if (!m_working.load())
         return;
 
-    std::sort(m_suggestions.begin(), m_suggestions.end(), compareUrlSuggestions);
-    if (m_suggestions.size() > 25)
-        m_suggestions.erase(m_suggestions.begin() + 25, m_suggestions.end());
+    m_previousSearchTerm = m_searchTerm;
+    m_previousSuggestions = m_suggestions;
 
+    m_suggestions = getRankedSuggestions(false);
     emit finishedSearch(m_suggestions);
-    m_working.store(false);
+}
+
+void URLSuggestionWorker::reusePreviousSuggestions()
+{
+    m_reusedSuggestions.clear();
+
+    if (m_previousSearchTerm.isEmpty() || !m_searchTerm.startsWith(m_previousSearchTerm))
+        return;
+
+    // Every suggestion for the new term contains the previous one, so the previous suggestions that still match
+    // can be shown until the new results are known
+    for (const URLSuggestion &suggestion : m_previousSuggestions)
+    {
+        if (suggestion.URL.toUpper().contains(m_searchTerm) || suggestion.Title.toUpper().contains(m_searchTerm))
+            m_reusedSuggestions.push_back(suggestion);
+    }
+
+    if (!m_reusedSuggestions.empty())
+        emit suggestionsUpdated(getRankedSuggestions(true));
+}
+
+void URLSuggestionWorker::mergeSuggestions(std::vector<URLSuggestion> &&suggestions)
+{
+    for (auto &&suggestion : suggestions)
+    {
+        const auto urlUpper = suggestion.URL.toUpper();
+        if (m_hits.contains(urlUpper))
+            continue;
+
+        m_hits.insert(urlUpper);
+        m_suggestions.push_back(std::move(suggestion));
+    }
+}
+
+std::vector<URLSuggestion> URLSuggestionWorker::getRankedSuggestions(bool includeReused) const
+{
+    std::vector<URLSuggestion> result = m_suggestions;
+
+    if (includeReused)
+    {
+        for (const URLSuggestion &suggestion : m_reusedSuggestions)
+        {
+            if (!m_hits.contains(suggestion.URL.toUpper()))
+                result.push_back(suggestion);
+        }
+    }
+
+    if (result.size() > MaxSuggestions)
+    {
+        std::partial_sort(result.begin(), result.begin() + MaxSuggestions, result.end(), compareUrlSuggestions);
+        result.erase(result.begin() + MaxSuggestions, result.end());
+    }
+    else
+        std::sort(result.begin(), result.end(), compareUrlSuggestions);
+
+    return result;
 }
 
 void URLSuggestionWorker::hashSearchTerm()
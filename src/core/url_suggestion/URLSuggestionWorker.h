@@ -8,20 +8,31 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include <QObject>
+#include <QSet>
 #include <QString>
 #include <QStringList>
+#include <QThreadPool>
 
 /**
  * @class URLSuggestionWorker
  * @brief Fetches URL suggestions to populate into the \ref URLSuggestionWidget as the
  *        user types a string of text into the \ref URLLineEdit widget
+ *
+ * Searches run in the thread of the worker. Requests made while a search is in progress cancel it,
+ * and only the most recent request is searched for once the worker is free. Each search first
+ * emits the previous results that still match, when the search term extends the previous one,
+ * followed by the quick suggestions of every suggestor. The full searches of the suggestors run
+ * concurrently in a thread pool of the worker, and their results are emitted as each of them finishes.
  */
 class URLSuggestionWorker : public QObject
 {
+    friend class URLSuggestionWorkerTest;
+
     Q_OBJECT
 public:
     /// Constructs the URL suggestion worker
@@ -31,29 +42,60 @@ class URLSuggestionWorker : public QObject
     /// (namely, the \ref HistoryManager , \ref BookmarkManager , and \ref FaviconStore )
     void setServiceLocator(const ViperServiceLocator &serviceLocator);
 
-    /// Sets the internal "is working" flag to false, in order to prevent unnecessary suggestion determinations
+    /// Cancels the search in progress, along with any search that has been requested but not yet started
     void stopWork();
 
-public Q_SLOTS:
-    /// Begins a new search operation for suggestions related to the given string.
-    /// Cancels any operations in progress at the time this method is called
+    /// Requests a search for suggestions related to the given string, cancelling any search in progress at the
+    /// time this method is called. May be called from any thread
     void findSuggestionsFor(const QString &text);
 
 Q_SIGNALS:
+    /// Emitted as suggestions are found for the current search term, passing the best suggestions found so far
+    void suggestionsUpdated(const std::vector<URLSuggestion> &results);
+
     /// Emitted when a suggestion search is finished, passing a reference to each URL matching the input pattern
     void finishedSearch(const std::vector<URLSuggestion> &results);
 
+private Q_SLOTS:
+    /// Searches for the most recently requested search term until no more searches are pending
+    void processPendingSearches();
+
 private:
+    /// Prepares the search term, its words and hashes from the user's input
+    void setSearchTerm(const QString &text);
+
     /// The suggestion search operation working in a separate thread
     void searchForHits();
 
+    /// Emits the suggestions of the previous search term that also match the current one, if the current term extends it
+    void reusePreviousSuggestions();
+
+    /// Adds the given suggestions to the result set, skipping those whose URL is already part of it
+    void mergeSuggestions(std::vector<URLSuggestion> &&suggestions);
+
+    /// Returns the best suggestions of the result set, in order of their relevance. The suggestions reused from the previous
+    /// search term are included when they have not been found again and the given flag is true
+    std::vector<URLSuggestion> getRankedSuggestions(bool includeReused) const;
+
     /// Generates a hash of the search term before looking for suggestions
     void hashSearchTerm();
 
 private:
-    /// True if the worker thread is active, false if else
+    /// True while the current search should continue. Cleared to cancel it
     std::atomic_bool m_working;
 
+    /// Guards the pending search state, which is written to by the thread requesting searches
+    std::mutex m_pendingMutex;
+
+    /// Most recently requested search term
+    QString m_pendingText;
+
+    /// True if a search has been requested and has not yet started
+    bool m_hasPendingSearch;
+
+    /// True if a call to processPendingSearches() has been queued and has not yet finished
+    bool m_isSearchScheduled;
+
     /// The search term used to find suggestions
     QString m_searchTerm;
 
@@ -63,6 +105,18 @@ public Q_SLOTS:
     /// Stores the suggested URLs based on the current input
     std::vector<URLSuggestion> m_suggestions;
 
+    /// Upper-case URLs of the suggestions found for the current input
+    QSet<QString> m_hits;
+
+    /// Suggestions of the previous search term that match the current input, shown until the search is finished
+    std::vector<URLSuggestion> m_reusedSuggestions;
+
+    /// Search term of the most recent search that ran to completion
+    QString m_previousSearchTerm;
+
+    /// All suggestions found by the most recent search that ran to completion
+    std::vector<URLSuggestion> m_previousSuggestions;
+
     /// Wide-string equivalent to m_searchTerm
     std::wstring m_searchTermWideStr;
 
@@ -74,6 +128,10 @@ public Q_SLOTS:
 
     /// URL suggestion implementations
     std::vector<std::unique_ptr<IURLSuggestor>> m_handlers;
+
+    /// Runs the full search of each suggestor. The worker's thread waits for these searches, so they are kept
+    /// apart from the global thread pool, where unrelated tasks could hold them up
+    QThreadPool m_searchPool;
 };
 
 #endif // URLSUGGESTIONWORKER_H
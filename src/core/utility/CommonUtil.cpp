@@ -1,4 +1,5 @@
 #include "CommonUtil.h"
+#include "URLMatchKey.h"
 
 #include <array>
 #include <QBuffer>
@@ -149,29 +150,7 @@ namespace CommonUtil
 
     bool doUrlsMatch(const QUrl &a, const QUrl &b, bool ignoreScheme)
     {
-        QString aString = a.toString().toLower(), bString = b.toString().toLower();
-
-        if (ignoreScheme)
-        {
-            QRegularExpression schemeExpr{QLatin1String("^[a-zA-Z]+://")};
-            aString.remove(schemeExpr);
-            bString.remove(schemeExpr);
-        }
-
-        QRegularExpression userInfoExpr{QLatin1String("^.*:.*@")};
-        aString.remove(userInfoExpr);
-        bString.remove(userInfoExpr);
-
-        QRegularExpression wwwExpr{QLatin1String("^www\\.")};
-        aString.remove(wwwExpr);
-        bString.remove(wwwExpr);
-
-        if (aString.endsWith(QLatin1Char('/')))
-            aString = aString.left(aString.size() - 1);
-        if (bString.endsWith(QLatin1Char('/')))
-            bString = bString.left(bString.size() - 1);
-
-        return (aString.compare(bString) == 0);
+        return URLMatchKey(a, ignoreScheme) == URLMatchKey(b, ignoreScheme);
     }
 
     QStringList tokenizePossibleUrl(QString str)
@@ -51,7 +51,8 @@ namespace CommonUtil
     /// See https://developer.chrome.com/extensions/match_patterns for match pattern specification
     QRegularExpression getRegExpForMatchPattern(const QString &str);
 
-    /// Returns true if the two URLs are the same, false otherwise.
+    /// Returns true if the two URLs are the same, false otherwise. When comparing a URL to many others,
+    /// compute its \ref URLMatchKey once instead
     bool doUrlsMatch(const QUrl &a, const QUrl &b, bool ignoreScheme = false);
 
     /// Tokenizes the given input string into a list of words
@@ -0,0 +1,203 @@
+#include "PublicSuffixList.h"
+
+#include <array>
+#include <utility>
+
+#include <QByteArray>
+#include <QUrl>
+
+#include "PublicSuffixData.inc"
+
+/// Number of hosts cached by each thread. Must be a power of two
+static const uint HostCacheSize = 64;
+
+/// Host name and its domain parts, cached by the thread that looked it up
+struct CachedHost
+{
+    /// Host name
+    QString Host;
+
+    /// Domain parts of the host
+    HostDomainParts Parts;
+};
+
+const PublicSuffixList &PublicSuffixList::instance()
+{
+    static PublicSuffixList publicSuffixList;
+    return publicSuffixList;
+}
+
+PublicSuffixList::PublicSuffixList() :
+    m_ruleText(),
+    m_rules()
+{
+    std::vector<std::pair<QString, RuleFlag>> rules;
+    rules.reserve(PublicSuffixRuleCount);
+
+    for (int i = 0; i < PublicSuffixRuleCount; ++i)
+    {
+        QString domain = QString::fromUtf8(PublicSuffixRules[i]);
+        RuleFlag flag = NormalRule;
+        if (domain.startsWith(QLatin1Char('!')))
+        {
+            flag = ExceptionRule;
+            domain = domain.mid(1);
+        }
+        else if (domain.startsWith(QLatin1String("*.")))
+        {
+            flag = WildcardRule;
+            domain = domain.mid(2);
+        }
+
+        // Internationalized host names may be given in either their Unicode or ASCII compatible form
+        const QString aceDomain = QString::fromLatin1(QUrl::toAce(domain));
+        if (!aceDomain.isEmpty() && aceDomain != domain)
+            rules.push_back(std::make_pair(aceDomain, flag));
+
+        rules.push_back(std::make_pair(std::move(domain), flag));
+    }
+
+    std::size_t capacity = 1024;
+    while (capacity < rules.size() * 4 / 3)
+        capacity *= 2;
+
+    m_rules.resize(capacity, Rule { 0, -1, 0, 0 });
+    for (const auto &rule : rules)
+        addRule(rule.first, rule.second);
+
+    m_ruleText.squeeze();
+}
+
+HostDomainParts PublicSuffixList::getDomainParts(const QString &host) const
+{
+    static thread_local std::array<CachedHost, HostCacheSize> hostCache;
+
+    CachedHost &cachedHost = hostCache[qHash(host) & (HostCacheSize - 1)];
+    if (cachedHost.Host != host || cachedHost.Host.isNull())
+    {
+        cachedHost.Host = host;
+        cachedHost.Parts = findDomainParts(host);
+    }
+
+    return cachedHost.Parts;
+}
+
+QStringRef PublicSuffixList::getPublicSuffix(const QString &host) const
+{
+    const HostDomainParts parts = getDomainParts(host);
+    if (parts.SuffixPosition < 0)
+        return QStringRef();
+
+    return host.midRef(parts.SuffixPosition, parts.Length - parts.SuffixPosition);
+}
+
+QStringRef PublicSuffixList::getRegistrableDomain(const QString &host) const
+{
+    const HostDomainParts parts = getDomainParts(host);
+    if (parts.RegistrableDomainPosition < 0)
+        return QStringRef();
+
+    return host.midRef(parts.RegistrableDomainPosition, parts.Length - parts.RegistrableDomainPosition);
+}
+
+bool PublicSuffixList::isThirdParty(const QString &host, const QString &otherHost) const
+{
+    QStringRef site = getRegistrableDomain(host);
+    if (site.isEmpty())
+        site = QStringRef(&host);
+
+    QStringRef otherSite = getRegistrableDomain(otherHost);
+    if (otherSite.isEmpty())
+        otherSite = QStringRef(&otherHost);
+
+    return site != otherSite;
+}
+
+void PublicSuffixList::addRule(const QString &domain, RuleFlag flag)
+{
+    const QStringRef domainRef(&domain);
+    const uint hash = qHash(domainRef);
+    const std::size_t mask = m_rules.size() - 1;
+
+    for (std::size_t i = hash & mask; ; i = (i + 1) & mask)
+    {
+        Rule &rule = m_rules[i];
+        if (rule.Position < 0)
+        {
+            rule = Rule { hash, m_ruleText.size(), domain.size(), static_cast<uint8_t>(flag) };
+            m_ruleText.append(domain);
+            return;
+        }
+
+        if (rule.Hash == hash && m_ruleText.midRef(rule.Position, rule.Length) == domainRef)
+        {
+            rule.Flags |= flag;
+            return;
+        }
+    }
+}
+
+uint8_t PublicSuffixList::getRuleFlags(const QStringRef &domain) const
+{
+    const uint hash = qHash(domain);
+    const std::size_t mask = m_rules.size() - 1;
+
+    for (std::size_t i = hash & mask; ; i = (i + 1) & mask)
+    {
+        const Rule &rule = m_rules[i];
+        if (rule.Position < 0)
+            return 0;
+
+        if (rule.Hash == hash && m_ruleText.midRef(rule.Position, rule.Length) == domain)
+            return rule.Flags;
+    }
+}
+
+HostDomainParts PublicSuffixList::findDomainParts(const QString &host) const
+{
+    int length = host.size();
+    if (length > 0 && host.at(length - 1) == QLatin1Char('.'))
+        --length;
+
+    HostDomainParts result { -1, -1, length };
+    if (length == 0)
+        return result;
+
+    // No public suffix ends with a digit, so treat such hosts, and IPv6 addresses, as IP addresses
+    if (host.at(length - 1).isDigit() || host.indexOf(QLatin1Char(':')) >= 0)
+    {
+        result.RegistrableDomainPosition = 0;
+        return result;
+    }
+
+    // Visit each candidate suffix, from the whole host to its last label. The first candidate that
+    // matches a rule is the longest match, and the label before the suffix completes the registrable domain
+    int previousPosition = -1;
+    int position = 0;
+    uint8_t flags = getRuleFlags(host.midRef(0, length));
+    for (;;)
+    {
+        const int dotPosition = host.indexOf(QLatin1Char('.'), position);
+        const int nextPosition = (dotPosition >= 0 && dotPosition < length - 1) ? dotPosition + 1 : -1;
+        const uint8_t nextFlags = nextPosition >= 0 ? getRuleFlags(host.midRef(nextPosition, length - nextPosition)) : 0;
+
+        if ((flags & ExceptionRule) && nextPosition >= 0)
+        {
+            result.SuffixPosition = nextPosition;
+            result.RegistrableDomainPosition = position;
+            return result;
+        }
+
+        // Without a matching rule, the last label is the public suffix
+        if ((flags & NormalRule) || (nextFlags & WildcardRule) || nextPosition < 0)
+        {
+            result.SuffixPosition = position;
+            result.RegistrableDomainPosition = previousPosition;
+            return result;
+        }
+
+        previousPosition = position;
+        position = nextPosition;
+        flags = nextFlags;
+    }
+}
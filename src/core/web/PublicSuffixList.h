@@ -0,0 +1,107 @@
+#ifndef PUBLICSUFFIXLIST_H
+#define PUBLICSUFFIXLIST_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QString>
+
+/**
+ * @struct HostDomainParts
+ * @brief Positions of the public suffix and the registrable domain within a host name.
+ *
+ * For the host "www.example.co.uk", the public suffix "co.uk" starts at position 12
+ * and the registrable domain "example.co.uk" starts at position 4.
+ */
+struct HostDomainParts
+{
+    /// Position at which the public suffix starts, or -1 if the host has no public suffix (ex: an IP address)
+    int SuffixPosition;
+
+    /// Position at which the registrable domain starts, or -1 if the host is itself a public suffix
+    int RegistrableDomainPosition;
+
+    /// Length of the host, excluding a trailing dot
+    int Length;
+};
+
+/**
+ * @class PublicSuffixList
+ * @brief Finds the public suffix and registrable domain of host names, using the rules of the
+ *        public suffix list (https://publicsuffix.org) that are compiled into the application.
+ *
+ * Host names are expected to be in lowercase, as returned by QUrl::host(). Results are returned
+ * as references into the given host, so lookups do not allocate memory. The last hosts to be
+ * looked up by each thread are cached.
+ */
+class PublicSuffixList
+{
+public:
+    /// Returns the public suffix list, building its rule table on first use
+    static const PublicSuffixList &instance();
+
+    /// Returns the positions of the public suffix and registrable domain of the given host
+    HostDomainParts getDomainParts(const QString &host) const;
+
+    /// Returns the public suffix of the host (ex: "co.uk" for "www.example.co.uk")
+    QStringRef getPublicSuffix(const QString &host) const;
+
+    /// Returns the registrable domain of the host (ex: "example.co.uk" for "www.example.co.uk"). Returns an empty
+    /// reference if the host is itself a public suffix, or the whole host if it is an IP address
+    QStringRef getRegistrableDomain(const QString &host) const;
+
+    /// Returns true if the hosts belong to different sites. Hosts without a registrable domain
+    /// are compared as a whole
+    bool isThirdParty(const QString &host, const QString &otherHost) const;
+
+private:
+    /// Types of rules that apply to a domain name
+    enum RuleFlag : uint8_t
+    {
+        /// The domain is a public suffix (ex: "co.uk")
+        NormalRule    = 0x01,
+
+        /// Every child of the domain is a public suffix (ex: "*.ck")
+        WildcardRule  = 0x02,
+
+        /// The domain is not a public suffix, despite a wildcard rule (ex: "!www.ck")
+        ExceptionRule = 0x04
+    };
+
+    /// Entry of the rule table
+    struct Rule
+    {
+        /// Hash of the domain name
+        uint Hash;
+
+        /// Position of the domain name in the rule text, or -1 if the slot of the table is empty
+        int Position;
+
+        /// Length of the domain name
+        int Length;
+
+        /// Combination of the \ref RuleFlag values that apply to the domain name
+        uint8_t Flags;
+    };
+
+    /// Builds the rule table from the compiled public suffix list
+    PublicSuffixList();
+
+    /// Adds the rule flag to the given domain name
+    void addRule(const QString &domain, RuleFlag flag);
+
+    /// Returns the flags of the rules that apply to the given domain name, or 0 if there are none
+    uint8_t getRuleFlags(const QStringRef &domain) const;
+
+    /// Finds the domain parts of a host, without using the cache
+    HostDomainParts findDomainParts(const QString &host) const;
+
+private:
+    /// Domain names of every rule, concatenated
+    QString m_ruleText;
+
+    /// Open addressing hash table of rules, with a power of two size
+    std::vector<Rule> m_rules;
+};
+
+#endif // PUBLICSUFFIXLIST_H
@@ -19,7 +19,8 @@ class URL : public QUrl
     /// Constructs a URL from the given string a parsing mode
     URL(const QString &url, ParsingMode parsingMode = URL::TolerantMode);
 
-    /// Returns the second-level domain of the URL (ex: websiteA.com; websiteB.co.uk)
+    /// Returns the registrable domain of the URL's host (ex: websiteA.com; websiteB.co.uk), or an empty string
+    /// if the host is itself a public suffix. See \ref PublicSuffixList
     QString getSecondLevelDomain() const;
 };
 
@@ -0,0 +1,74 @@
+#include "URLMatchKey.h"
+
+URLMatchKey::URLMatchKey() :
+    m_key(),
+    m_hash(qHash(m_key))
+{
+}
+
+URLMatchKey::URLMatchKey(const QUrl &url, bool ignoreScheme) :
+    m_key(),
+    m_hash(0)
+{
+    const QString host = url.host();
+    if (host.isEmpty())
+    {
+        // URLs without a host, such as about:blank, are only identified by their scheme and path
+        m_key = url.toString(QUrl::RemoveUserInfo).toLower();
+    }
+    else
+    {
+        const int hostStart = host.startsWith(QLatin1String("www."), Qt::CaseInsensitive) ? 4 : 0;
+        const QString pathAndQuery = url.toString(QUrl::RemoveScheme | QUrl::RemoveAuthority);
+        const QString scheme = ignoreScheme ? QString() : url.scheme();
+
+        m_key.reserve(scheme.size() + 3 + host.size() + 6 + pathAndQuery.size());
+        if (!scheme.isEmpty())
+        {
+            m_key.append(scheme);
+            m_key.append(QLatin1String("://"));
+        }
+
+        m_key.append(host.midRef(hostStart));
+
+        const int port = url.port();
+        if (port >= 0)
+        {
+            m_key.append(QLatin1Char(':'));
+            m_key.append(QString::number(port));
+        }
+
+        m_key.append(pathAndQuery);
+        m_key = m_key.toLower();
+    }
+
+    if (m_key.endsWith(QLatin1Char('/')))
+        m_key.chop(1);
+
+    m_hash = qHash(m_key);
+}
+
+bool URLMatchKey::isEmpty() const
+{
+    return m_key.isEmpty();
+}
+
+uint URLMatchKey::getHash() const
+{
+    return m_hash;
+}
+
+const QString &URLMatchKey::toString() const
+{
+    return m_key;
+}
+
+bool URLMatchKey::operator==(const URLMatchKey &other) const
+{
+    return m_hash == other.m_hash && m_key == other.m_key;
+}
+
+bool URLMatchKey::operator!=(const URLMatchKey &other) const
+{
+    return !(*this == other);
+}
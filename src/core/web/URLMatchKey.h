@@ -0,0 +1,69 @@
+#ifndef URLMATCHKEY_H
+#define URLMATCHKEY_H
+
+#include <cstddef>
+#include <functional>
+
+#include <QHash>
+#include <QString>
+#include <QUrl>
+
+/**
+ * @class URLMatchKey
+ * @brief Canonical form of a URL that is used to find out whether two URLs refer to the same page.
+ *
+ * The key is the lower-case form of the URL without its user info, "www." prefix or trailing slash,
+ * and optionally without its scheme. It is computed once, along with its hash, so that URLs can be
+ * compared and placed in hash tables without being normalized again.
+ */
+class URLMatchKey
+{
+public:
+    /// Constructs an empty key
+    URLMatchKey();
+
+    /// Constructs the key of the given URL. If ignoreScheme is true, URLs that only differ by their scheme have equal keys
+    explicit URLMatchKey(const QUrl &url, bool ignoreScheme);
+
+    /// Returns true if the key was made from an empty URL
+    bool isEmpty() const;
+
+    /// Returns the precomputed hash of the key
+    uint getHash() const;
+
+    /// Returns the canonical form of the URL
+    const QString &toString() const;
+
+    /// Returns true if both keys were made from matching URLs
+    bool operator==(const URLMatchKey &other) const;
+
+    /// Returns true if the keys were made from URLs that do not match
+    bool operator!=(const URLMatchKey &other) const;
+
+private:
+    /// Canonical form of the URL
+    QString m_key;
+
+    /// Hash of the canonical form
+    uint m_hash;
+};
+
+/// Returns the precomputed hash of the key, for use in a QHash
+inline uint qHash(const URLMatchKey &key, uint seed = 0)
+{
+    return key.getHash() ^ seed;
+}
+
+namespace std
+{
+    /// Allows use of URLMatchKey in standard hashmaps, using its precomputed hash
+    template<> struct hash<URLMatchKey>
+    {
+        std::size_t operator()(const URLMatchKey &key) const
+        {
+            return static_cast<std::size_t>(key.getHash());
+        }
+    };
+}
+
+#endif // URLMATCHKEY_H
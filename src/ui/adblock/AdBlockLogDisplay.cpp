@@ -50,14 +50,16 @@ void AdBlockLogDisplay::setLogTableFor(const QUrl &url)
     m_sourceUrl = url;
     ui->comboBoxLogSource->setCurrentIndex(0);
     ui->comboBoxLogSource->setItemText(0, url.toString());
-    m_sourceModel->setLogEntries(m_adBlockManager->getLog()->getEntriesFor(url));
+    const adblock::AdBlockLog *log = m_adBlockManager->getLog();
+    m_sourceModel->setLogEntries(log, log->getEntriesFor(url));
     ui->tableView->resizeColumnsToContents();
 }
 
 void AdBlockLogDisplay::showAllLogs()
 {
     ui->comboBoxLogSource->setCurrentIndex(1);
-    m_sourceModel->setLogEntries(m_adBlockManager->getLog()->getAllEntries());
+    const adblock::AdBlockLog *log = m_adBlockManager->getLog();
+    m_sourceModel->setLogEntries(log, log->getAllEntries());
     ui->tableView->resizeColumnsToContents();
 }
 
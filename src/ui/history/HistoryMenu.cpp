@@ -42,6 +42,7 @@ void HistoryMenu::addHistoryItem(const QUrl &url, const QString &title, const QI
 {
     QAction *historyItem = new QAction(title);
     historyItem->setIcon(favicon);
+    historyItem->setData(url);
     connect(historyItem, &QAction::triggered, this, [this, url](){
         emit loadUrl(url);
     });
@@ -51,7 +52,7 @@ void HistoryMenu::addHistoryItem(const QUrl &url, const QString &title, const QI
     clearOldestEntries();
 }
 
-void HistoryMenu::prependHistoryItem(const QUrl &url, const QString &title, const QIcon &favicon)
+QAction *HistoryMenu::prependHistoryItem(const QUrl &url, const QString &title, const QIcon &favicon)
 {
     QList<QAction*> menuActions = actions();
 
@@ -61,6 +62,7 @@ void HistoryMenu::prependHistoryItem(const QUrl &url, const QString &title, cons
 
     QAction *historyItem = new QAction(title);
     historyItem->setIcon(favicon);
+    historyItem->setData(url);
     connect(historyItem, &QAction::triggered, this, [this, url](){
         emit loadUrl(url);
     });
@@ -68,6 +70,7 @@ void HistoryMenu::prependHistoryItem(const QUrl &url, const QString &title, cons
     insertAction(beforeItem, historyItem);
 
     clearOldestEntries();
+    return historyItem;
 }
 
 void HistoryMenu::clearItems()
@@ -95,7 +98,23 @@ void HistoryMenu::resetItems()
             continue;
 
         if (m_faviconManager)
-            addHistoryItem(it->URL, it->Title, m_faviconManager->getFavicon(it->URL));
+            addHistoryItem(it->URL, it->Title, QIcon(QLatin1String(":/blank_favicon.png")));
+    }
+
+    if (!m_faviconManager)
+        return;
+
+    // Favicons are decoded in the background, and shown once they are ready
+    const QList<QAction*> menuActions = actions();
+    for (QAction *historyItem : menuActions)
+    {
+        const QUrl url = historyItem->data().toUrl();
+        if (url.isEmpty())
+            continue;
+
+        m_faviconManager->loadFavicon(url, historyItem, [historyItem](const QIcon &icon){
+            historyItem->setIcon(icon);
+        });
     }
 }
 
@@ -107,7 +126,10 @@ void HistoryMenu::onPageVisited(const QUrl &url, const QString &title)
         return;
     }
 
-    prependHistoryItem(url, title, m_faviconManager->getFavicon(url));
+    QAction *historyItem = prependHistoryItem(url, title, QIcon(QLatin1String(":/blank_favicon.png")));
+    m_faviconManager->loadFavicon(url, historyItem, [historyItem](const QIcon &icon){
+        historyItem->setIcon(icon);
+    });
 }
 
 void HistoryMenu::setup()
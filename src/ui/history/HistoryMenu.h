@@ -37,8 +37,8 @@ class HistoryMenu : public QMenu
     /// Adds an item to the history menu, given a name, title and favicon
     void addHistoryItem(const QUrl &url, const QString &title, const QIcon &favicon);
 
-    /// Adds an item to the top of the history menu, given a name, title and favicon
-    void prependHistoryItem(const QUrl &url, const QString &title, const QIcon &favicon);
+    /// Adds an item to the top of the history menu, given a name, title and favicon, and returns the item
+    QAction *prependHistoryItem(const QUrl &url, const QString &title, const QIcon &favicon);
 
     /// Clears the history entries from the menu
     void clearItems();
@@ -45,7 +45,7 @@ URLSuggestionWidget::URLSuggestionWidget(QWidget *parent) :
     m_worker = new URLSuggestionWorker;
     m_worker->moveToThread(&m_workerThread);
     connect(&m_workerThread, &QThread::finished, m_worker, &QObject::deleteLater);
-    connect(this, &URLSuggestionWidget::determineSuggestions, m_worker, &URLSuggestionWorker::findSuggestionsFor);
+    connect(m_worker, &URLSuggestionWorker::suggestionsUpdated, m_model, &URLSuggestionListModel::setSuggestions);
     connect(m_worker, &URLSuggestionWorker::finishedSearch, m_model, &URLSuggestionListModel::setSuggestions);
 
     // Setup layout
@@ -218,7 +218,9 @@ void URLSuggestionWidget::alignAndShow(const QPoint &urlBarPos, const QRect &url
 
 void URLSuggestionWidget::suggestForInput(const QString &text)
 {
-    if (m_searchTerm.isEmpty() || !m_searchTerm.startsWith(text))
+    // Keep the current suggestions on screen while the input extends the previous input, as the worker
+    // narrows them down until the new search is finished
+    if (m_searchTerm.isEmpty() || !text.startsWith(m_searchTerm))
         m_model->setSuggestions(std::vector<URLSuggestion>());
 
     if (text.isEmpty())
@@ -229,9 +231,7 @@ void URLSuggestionWidget::suggestForInput(const QString &text)
     }
 
     m_searchTerm = text;
-    //m_worker->findSuggestionsFor(text);
-    m_worker->stopWork();
-    emit determineSuggestions(text);
+    m_worker->findSuggestionsFor(text);
 
     if (!isVisible() && m_lineEdit != nullptr)
         alignAndShow(m_lineEdit->mapToGlobal(m_lineEdit->pos()), m_lineEdit->frameGeometry());
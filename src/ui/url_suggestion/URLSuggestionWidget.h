@@ -60,9 +60,6 @@ class URLSuggestionWidget final : public QWidget
      */
     void noSuggestionChosen(const QString &originalText);
 
-    /// Bound to the suggestion worker's findSuggestionsFor(...) slot
-    void determineSuggestions(const QString &text);
-
 private Q_SLOTS:
     /// Called when an item in the suggestion list at the given index is clicked
     void onSuggestionClicked(const QModelIndex &index);
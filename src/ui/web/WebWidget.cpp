@@ -14,6 +14,7 @@
 #include "WebView.h"
 
 #include <chrono>
+#include <utility>
 #include <QAction>
 #include <QHideEvent>
 #include <QMouseEvent>
@@ -24,7 +25,7 @@
 
 #include <QDebug>
 
-WebWidget::WebWidget(const ViperServiceLocator &serviceLocator, bool privateMode, QWidget *parent) :
+WebWidget::WebWidget(const ViperServiceLocator &serviceLocator, bool privateMode, QWidget *parent, bool hibernating) :
     QWidget(parent),
     m_serviceLocator(serviceLocator),
     m_adBlockManager(serviceLocator.getServiceAs<adblock::AdBlockManager>("AdBlockManager")),
@@ -43,6 +44,7 @@ WebWidget::WebWidget(const ViperServiceLocator &serviceLocator, bool privateMode
     m_contextMenuPosRelative(),
     m_viewFocusProxy(nullptr),
     m_hibernating(false),
+    m_placeholder(false),
     m_savedState(),
     m_lastTypedUrl()
 {
@@ -50,15 +52,23 @@ WebWidget::WebWidget(const ViperServiceLocator &serviceLocator, bool privateMode
 
     m_mainWindow = qobject_cast<MainWindow*>(window());
 
-    setupWebView();
-
     QVBoxLayout *vLayout = new QVBoxLayout(this);
     vLayout->setContentsMargins(0, 0, 0, 0);
     vLayout->setSpacing(0);
-    vLayout->addWidget(m_view);
     setLayout(vLayout);
 
-    setFocusProxy(m_view);
+    if (hibernating)
+    {
+        m_hibernating = true;
+        setCursor(Qt::PointingHandCursor);
+        setAutoFillBackground(true);
+    }
+    else
+    {
+        setupWebView();
+        vLayout->addWidget(m_view);
+        setFocusProxy(m_view);
+    }
 
     if (BrowserTabWidget *tabWidget = qobject_cast<BrowserTabWidget*>(parentWidget()))
     {
@@ -103,6 +113,11 @@ bool WebWidget::isHibernating() const
     return m_hibernating;
 }
 
+bool WebWidget::isPlaceholder() const
+{
+    return m_placeholder;
+}
+
 bool WebWidget::isOnBlankPage() const
 {
     if (m_hibernating)
@@ -213,6 +228,7 @@ void WebWidget::setHibernation(bool on)
     else
     {
         m_hibernating = false;
+        m_placeholder = false;
         setAutoFillBackground(false);
 
         setupWebView();
@@ -247,6 +263,13 @@ void WebWidget::setWebState(WebState &&state)
         emit loadFinished(false);
 }
 
+void WebWidget::setPlaceholderState(WebState &&state)
+{
+    setHibernation(true);
+    m_placeholder = true;
+    setWebState(std::move(state));
+}
+
 const QUrl &WebWidget::getLastTypedUrl() const
 {
     return m_lastTypedUrl;
@@ -48,8 +48,9 @@ class WebWidget : public QWidget
      * @param serviceLocator Web browser service registry / locator
      * @param privateMode Set to true if the web view should be off-the-record, false if a regular web view
      * @param parent Pointer to the parent widget
+     * @param hibernating Set to true if the widget should start in hibernation mode, without creating its web view
      */
-    explicit WebWidget(const ViperServiceLocator &serviceLocator, bool privateMode, QWidget *parent = nullptr);
+    explicit WebWidget(const ViperServiceLocator &serviceLocator, bool privateMode, QWidget *parent = nullptr, bool hibernating = false);
 
     /// WebWidget destructor
     ~WebWidget();
@@ -63,6 +64,9 @@ class WebWidget : public QWidget
     /// Returns true if the web widget is in hibernation mode, false if else
     bool isHibernating() const;
 
+    /// Returns true if the web widget is a placeholder for a restored tab, whose page has not been loaded yet
+    bool isPlaceholder() const;
+
     /// Returns true if the view's page is blank, with no resources being loaded
     bool isOnBlankPage() const;
 
@@ -119,6 +123,9 @@ class WebWidget : public QWidget
     /// Sets the state of the web widget as it was during a hibernation event
     void setWebState(WebState &&state);
 
+    /// Hibernates the web widget with the given state, as a placeholder that wakes up once its tab is first activated
+    void setPlaceholderState(WebState &&state);
+
     /// Returns the last url that was manually typed by the user, or an empty url if not applicable
     const QUrl &getLastTypedUrl() const;
 
@@ -268,6 +275,9 @@ private Q_SLOTS:
     /// True if the widget is in hibernation mode, false if else
     bool m_hibernating;
 
+    /// True if the widget is hibernating as the placeholder of a restored tab, false if else
+    bool m_placeholder;
+
     /// Current state of the web page (icon, page title, url, etc.) in order to transition in and out of hibernation mode, close and re-open a tab, etc
     WebState m_savedState;
 
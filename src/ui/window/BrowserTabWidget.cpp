@@ -43,6 +43,9 @@ BrowserTabWidget::BrowserTabWidget(const ViperServiceLocator &serviceLocator, bo
 
     connect(m_tabBar, &BrowserTabBar::tabPinned,           this, &BrowserTabWidget::tabPinned);
     connect(m_tabBar, &BrowserTabBar::duplicateTabRequest, this, &BrowserTabWidget::duplicateTab);
+    connect(m_tabBar, &BrowserTabBar::tabMoved,            this, [this](int, int){
+        emit tabOrderChanged();
+    });
     connect(m_tabBar, &BrowserTabBar::newTabRequest,       this, [this](){
         static_cast<void>(newBackgroundTab());
     });
@@ -197,13 +200,14 @@ void BrowserTabWidget::duplicateTab(int index)
         openLinkInNewBackgroundTab(ww->url());
 }
 
-WebWidget *BrowserTabWidget::createWebWidget()
+WebWidget *BrowserTabWidget::createWebWidget(bool hibernating)
 {
-    WebWidget *ww = new WebWidget(m_serviceLocator, m_privateBrowsing, this);
+    WebWidget *ww = new WebWidget(m_serviceLocator, m_privateBrowsing, this, hibernating);
     if (m_mainWindow)
     {
         ww->setMaximumWidth(m_mainWindow->maximumWidth());
-        ww->view()->setMaximumWidth(m_mainWindow->maximumWidth());
+        if (!hibernating)
+            ww->view()->setMaximumWidth(m_mainWindow->maximumWidth());
     }
 
     // Connect web view signals to functionalty
@@ -238,6 +242,9 @@ WebWidget *BrowserTabWidget::createWebWidget()
         });
     }
 
+    if (hibernating)
+        return ww;
+
     auto newTabPage = static_cast<NewTabType>(m_settings->getValue(BrowserSetting::NewTabPage).toInt());
     switch (newTabPage)
     {
@@ -293,26 +300,38 @@ WebWidget *BrowserTabWidget::newBackgroundTab()
 
 WebWidget *BrowserTabWidget::newBackgroundTabAtIndex(int index)
 {
-    WebWidget *ww = createWebWidget();
+    WebWidget *ww = insertBackgroundTab(createWebWidget(), index);
+    ww->view()->resize(ww->size());
+    //ww->show();
+
+    emit newTabCreated(ww);
+    return ww;
+}
 
+WebWidget *BrowserTabWidget::newHibernatingTabAtIndex(int index)
+{
+    WebWidget *ww = insertBackgroundTab(createWebWidget(true), index);
+
+    emit newTabCreated(ww);
+    return ww;
+}
+
+WebWidget *BrowserTabWidget::insertBackgroundTab(WebWidget *webWidget, int index)
+{
     if (index >= 0)
     {
         if (index > count())
             index = count();
 
-        index = insertTab(index, ww, QLatin1String("New Tab"));
+        index = insertTab(index, webWidget, QLatin1String("New Tab"));
         if (index <= m_nextTabIndex)
             ++m_nextTabIndex;
     }
     else
-        m_nextTabIndex = insertTab(m_nextTabIndex, ww, QLatin1String("New Tab")) + 1;
+        m_nextTabIndex = insertTab(m_nextTabIndex, webWidget, QLatin1String("New Tab")) + 1;
 
-    ww->resize(currentWidget()->size());
-    ww->view()->resize(ww->size());
-    //ww->show();
-
-    emit newTabCreated(ww);
-    return ww;
+    webWidget->resize(currentWidget()->size());
+    return webWidget;
 }
 
 void BrowserTabWidget::onIconChanged(const QIcon &icon)
@@ -323,7 +342,7 @@ void BrowserTabWidget::onIconChanged(const QIcon &icon)
         return;
 
     if (icon.isNull())
-        setTabIcon(tabIndex, m_faviconManager->getFavicon(ww->url()));
+        loadTabIcon(ww, ww->url());
     else
         setTabIcon(tabIndex, icon);
 }
@@ -391,6 +410,18 @@ void BrowserTabWidget::zoomOutCurrentView()
         ww->view()->zoomOut();
 }
 
+void BrowserTabWidget::tabInserted(int index)
+{
+    QTabWidget::tabInserted(index);
+    emit tabOrderChanged();
+}
+
+void BrowserTabWidget::tabRemoved(int index)
+{
+    QTabWidget::tabRemoved(index);
+    emit tabOrderChanged();
+}
+
 void BrowserTabWidget::onCurrentChanged(int index)
 {
     WebWidget *ww = getWebWidget(index);
@@ -400,6 +431,10 @@ void BrowserTabWidget::onCurrentChanged(int index)
     if (m_activeView && m_activeView != ww && getWebWidget(m_lastTabIndex) != nullptr)
         m_activeView->hide();
 
+    // Restored tabs load their page once they are first activated
+    if (ww->isPlaceholder())
+        ww->setHibernation(false);
+
     ww->show();
 
     m_activeView = ww;
@@ -461,7 +496,16 @@ void BrowserTabWidget::onUrlChanged(const QUrl &url)
         emit urlChanged(url);
 
     if (!url.isEmpty())
-        setTabIcon(indexOf(ww), m_faviconManager->getFavicon(url));
+        loadTabIcon(ww, url);
+}
+
+void BrowserTabWidget::loadTabIcon(WebWidget *view, const QUrl &url)
+{
+    m_faviconManager->loadFavicon(url, view, [this, view](const QIcon &icon){
+        const int tabIndex = indexOf(view);
+        if (tabIndex >= 0)
+            setTabIcon(tabIndex, icon);
+    });
 }
 
 void BrowserTabWidget::onViewCloseRequested()
@@ -59,6 +59,9 @@ class BrowserTabWidget : public QTabWidget
     /// Emitted when the pinned state of a tab at the given index has changed (i.e., from pin -> unpin or unpin -> pin)
     void tabPinned(int index, bool value);
 
+    /// Emitted when a tab has been added, removed or moved to another position
+    void tabOrderChanged();
+
     /// Emitted when the title of the active tab's web page has changed
     void titleChanged(const QString &title);
 
@@ -113,6 +116,14 @@ public Q_SLOTS:
      */
     WebWidget *newBackgroundTabAtIndex(int index);
 
+    /**
+     * @brief Creates a new tab in the background, with a hibernating \ref WebWidget at the given index. The widget
+     *        does not create its web view until it is woken up. Used to restore tabs without loading their pages
+     * @param index The index at which, if valid, the tab will be inserted.
+     * @return A pointer to the tab's WebWidget
+     */
+    WebWidget *newHibernatingTabAtIndex(int index);
+
     /// Called when the icon for a web view has changed
     void onIconChanged(const QIcon &icon);
 
@@ -143,6 +154,13 @@ public Q_SLOTS:
     /// Decreases the zoom factor of the active tab's \ref WebView by 10% of the base value
     void zoomOutCurrentView();
 
+protected:
+    /// Called after a tab is inserted at the given index
+    void tabInserted(int index) override;
+
+    /// Called after the tab at the given index is removed
+    void tabRemoved(int index) override;
+
 private Q_SLOTS:
     /// Called when the current tab has been changed
     void onCurrentChanged(int index);
@@ -164,12 +182,19 @@ private Q_SLOTS:
 
 private:
     /// Creates a new \ref WebWidget, binding its signals to the appropriate handlers, setting up properties of the widget, etc.
-    /// and returning a pointer to the widget. Used during creation of a new tab
-    WebWidget *createWebWidget();
+    /// and returning a pointer to the widget. Used during creation of a new tab. If hibernating is true, the widget is
+    /// created in hibernation mode and does not load the new tab page
+    WebWidget *createWebWidget(bool hibernating = false);
+
+    /// Inserts the widget in a tab at the given index, without switching to it, and returns the widget
+    WebWidget *insertBackgroundTab(WebWidget *webWidget, int index);
 
     /// Saves the tab at the given index before closing it
     void saveTab(int index);
 
+    /// Sets the icon of the view's tab to the stored favicon of the given URL, once it has been loaded
+    void loadTabIcon(WebWidget *view, const QUrl &url);
+
 private:
     /// Browser settings
     Settings *m_settings;
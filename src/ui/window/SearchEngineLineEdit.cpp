@@ -70,11 +70,13 @@ void SearchEngineLineEdit::loadSearchEngines()
     for (const auto &engineName : searchEngines)
     {
         // Add search engine to the options menu
-        QIcon icon = m_faviconManager->getFavicon(QUrl(manager.getQueryString(engineName)));
-        QAction *action = m_searchEngineMenu->addAction(icon, engineName);
+        QAction *action = m_searchEngineMenu->addAction(engineName);
         connect(action, &QAction::triggered, [=]() {
             setSearchEngine(action->text());
         });
+        m_faviconManager->loadFavicon(QUrl(manager.getQueryString(engineName)), action, [action](const QIcon &icon){
+            action->setIcon(icon);
+        });
     }
 
     m_searchButton->setMenu(m_searchEngineMenu);
@@ -99,11 +101,13 @@ void SearchEngineLineEdit::addSearchEngine(const QString &name)
     if (!m_faviconManager)
         return;
 
-    QIcon icon = m_faviconManager->getFavicon(QUrl(SearchEngineManager::instance().getQueryString(name)));
-    QAction *action = m_searchEngineMenu->addAction(icon, name);
+    QAction *action = m_searchEngineMenu->addAction(name);
     connect(action, &QAction::triggered, [=]() {
         setSearchEngine(action->text());
     });
+    m_faviconManager->loadFavicon(QUrl(SearchEngineManager::instance().getQueryString(name)), action, [action](const QIcon &icon){
+        action->setIcon(icon);
+    });
 }
 
 void SearchEngineLineEdit::removeSearchEngine(const QString &name)
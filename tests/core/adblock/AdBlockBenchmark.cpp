@@ -0,0 +1,358 @@
+#include "AdBlockFilter.h"
+#include "AdBlockFilterContainer.h"
+#include "AdBlockFilterParser.h"
+#include "AdBlockRequestHandler.h"
+#include "AdBlockSubscription.h"
+#include "FilterEngine.h"
+#include "FilterSegment.h"
+#include "PublicSuffixList.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QUrl>
+
+#include <cstdio>
+
+namespace adblock
+{
+
+/// A network request from the replay corpus
+struct ReplayRequest
+{
+    /// URL of the page that made the request
+    QUrl FirstPartyUrl;
+
+    /// URL of the request itself
+    QUrl RequestUrl;
+
+    /// Element type(s) of the request, including the third party flag
+    ElementType Type;
+};
+
+/**
+ * @class AdBlockBenchmark
+ * @brief Measures how long it takes to build the filters from a set of filter lists, and how quickly
+ *        a recorded corpus of network requests is matched against them.
+ *
+ * Each request of the corpus is compared against the filters in the same way \ref RequestHandler does
+ * when its decision cache misses. The results are written as a JSON document, so they can be compared
+ * between releases.
+ */
+class AdBlockBenchmark
+{
+public:
+    /// Constructs the benchmark with the filter lists to load, the request corpus to replay, and the number of times to replay it
+    AdBlockBenchmark(const QStringList &filterLists, const QString &corpusFile, int iterations);
+
+    /// Runs the benchmark, returning the results. Returns an empty object if the fixtures could not be loaded
+    QJsonObject run();
+
+private:
+    /// Loads the request corpus. Each line is made up of a first party URL, a request URL and a resource type, separated by tabs
+    bool loadCorpus();
+
+    /// Loads the given filter lists, and moves their filters into a new container. The number of filters is stored in numFilters
+    std::shared_ptr<FilterContainer> buildFilters(const QStringList &filePaths, std::size_t &numFilters);
+
+    /// Returns the element type of the request, determined by the resource type name (using the names of filter options) and the URLs
+    ElementType getRequestType(const QString &typeName, const QUrl &firstPartyUrl, const QUrl &requestUrl) const;
+
+    /// Returns the value of the given field of /proc/self/status in kilobytes, or -1 if not available
+    static qint64 getMemoryUsage(const char *field);
+
+private:
+    /// Paths of the filter lists
+    QStringList m_filterLists;
+
+    /// Path of the request corpus
+    QString m_corpusFile;
+
+    /// Number of times the corpus is replayed
+    int m_iterations;
+
+    /// Requests of the corpus
+    std::vector<ReplayRequest> m_requests;
+};
+
+AdBlockBenchmark::AdBlockBenchmark(const QStringList &filterLists, const QString &corpusFile, int iterations) :
+    m_filterLists(filterLists),
+    m_corpusFile(corpusFile),
+    m_iterations(std::max(iterations, 1)),
+    m_requests()
+{
+}
+
+QJsonObject AdBlockBenchmark::run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    if (!loadCorpus())
+        return QJsonObject();
+
+    const qint64 initialMemory = getMemoryUsage("VmRSS:");
+
+    // Copy the filter lists to a temporary directory, so the first build has to parse them
+    // and the second build can load them from the caches written by the first one
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+        return QJsonObject();
+
+    QStringList filePaths;
+    for (const QString &filterList : m_filterLists)
+    {
+        const QString copyPath = tempDir.filePath(QString("%1-%2").arg(filePaths.size()).arg(QFileInfo(filterList).fileName()));
+        if (!QFile::copy(filterList, copyPath))
+        {
+            fprintf(stderr, "Could not read filter list %s\n", qPrintable(filterList));
+            return QJsonObject();
+        }
+        filePaths.append(copyPath);
+    }
+
+    std::size_t numFilters = 0;
+    Clock::time_point buildStart = Clock::now();
+    std::shared_ptr<FilterContainer> filters = buildFilters(filePaths, numFilters);
+    const double parseMs = std::chrono::duration<double, std::milli>(Clock::now() - buildStart).count();
+
+    filters.reset();
+    buildStart = Clock::now();
+    filters = buildFilters(filePaths, numFilters);
+    const double cachedMs = std::chrono::duration<double, std::milli>(Clock::now() - buildStart).count();
+
+    const qint64 builtMemory = getMemoryUsage("VmRSS:");
+
+    FilterEngine engine;
+    engine.publish(filters);
+    RequestHandler handler(engine, nullptr, nullptr);
+
+    // Replay the corpus, timing each request the same way the request interceptor would see it
+    std::vector<qint64> latencies;
+    latencies.reserve(m_requests.size() * static_cast<std::size_t>(m_iterations));
+
+    quint64 numBlocked = 0, numAllowed = 0;
+    const std::shared_ptr<const FilterContainer> snapshot = engine.getFilters();
+    const Clock::time_point replayStart = Clock::now();
+    for (int i = 0; i < m_iterations; ++i)
+    {
+        for (const ReplayRequest &request : m_requests)
+        {
+            const Clock::time_point requestStart = Clock::now();
+
+            const QString requestUrlStr = request.RequestUrl.toString(QUrl::FullyEncoded).toLower();
+            const QString baseUrl = request.FirstPartyUrl.host().toLower();
+            const RequestHandler::Decision decision = handler.findDecision(snapshot, baseUrl, request.RequestUrl, requestUrlStr, request.Type);
+
+            latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - requestStart).count());
+
+            if (decision.MatchingFilter != nullptr && decision.Action != FilterAction::Allow)
+                ++numBlocked;
+            else
+                ++numAllowed;
+        }
+    }
+    const double replaySeconds = std::chrono::duration<double>(Clock::now() - replayStart).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) -> qint64 {
+        if (latencies.empty())
+            return 0;
+        const std::size_t index = static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1) + 0.5);
+        return latencies.at(index);
+    };
+
+    QJsonArray filterListArray;
+    for (const QString &filterList : m_filterLists)
+        filterListArray.append(filterList);
+
+    QJsonObject buildObj;
+    buildObj.insert(QLatin1String("num_filters"), static_cast<qint64>(numFilters));
+    buildObj.insert(QLatin1String("parse_ms"), parseMs);
+    buildObj.insert(QLatin1String("cached_ms"), cachedMs);
+
+    QJsonObject latencyObj;
+    latencyObj.insert(QLatin1String("p50"), percentile(0.5));
+    latencyObj.insert(QLatin1String("p99"), percentile(0.99));
+    latencyObj.insert(QLatin1String("max"), latencies.empty() ? 0 : latencies.back());
+
+    QJsonObject replayObj;
+    replayObj.insert(QLatin1String("num_requests"), static_cast<qint64>(latencies.size()));
+    replayObj.insert(QLatin1String("iterations"), m_iterations);
+    replayObj.insert(QLatin1String("requests_per_second"), replaySeconds > 0.0 ? static_cast<double>(latencies.size()) / replaySeconds : 0.0);
+    replayObj.insert(QLatin1String("latency_ns"), latencyObj);
+    replayObj.insert(QLatin1String("blocked"), static_cast<qint64>(numBlocked));
+    replayObj.insert(QLatin1String("allowed"), static_cast<qint64>(numAllowed));
+
+    QJsonObject memoryObj;
+    memoryObj.insert(QLatin1String("rss_initial_kb"), initialMemory);
+    memoryObj.insert(QLatin1String("rss_filters_kb"), builtMemory);
+    memoryObj.insert(QLatin1String("rss_peak_kb"), getMemoryUsage("VmHWM:"));
+
+    // Measured after the replay, so the report includes the regular expressions that the corpus compiled
+    const FilterMemoryReport report = snapshot->getMemoryReport();
+    QJsonObject filterMemoryObj;
+    filterMemoryObj.insert(QLatin1String("num_filters"), static_cast<qint64>(report.NumFilters));
+    filterMemoryObj.insert(QLatin1String("filter_bytes"), static_cast<qint64>(report.FilterBytes));
+    filterMemoryObj.insert(QLatin1String("rule_bytes"), static_cast<qint64>(report.RuleBytes));
+    filterMemoryObj.insert(QLatin1String("eval_string_bytes"), static_cast<qint64>(report.EvalStringBytes));
+    filterMemoryObj.insert(QLatin1String("domain_list_bytes"), static_cast<qint64>(report.DomainListBytes));
+    filterMemoryObj.insert(QLatin1String("num_interned_domains"), static_cast<qint64>(report.NumInternedDomains));
+    filterMemoryObj.insert(QLatin1String("interned_domain_bytes"), static_cast<qint64>(report.InternedDomainBytes));
+    filterMemoryObj.insert(QLatin1String("num_regexp_filters"), static_cast<qint64>(report.NumRegExpFilters));
+    filterMemoryObj.insert(QLatin1String("num_compiled_regexps"), static_cast<qint64>(report.NumCompiledRegExps));
+    filterMemoryObj.insert(QLatin1String("index_bytes"), static_cast<qint64>(report.IndexBytes));
+    filterMemoryObj.insert(QLatin1String("stylesheet_bytes"), static_cast<qint64>(report.StylesheetBytes));
+    filterMemoryObj.insert(QLatin1String("total_bytes"), static_cast<qint64>(report.getTotalBytes()));
+    memoryObj.insert(QLatin1String("filters"), filterMemoryObj);
+
+    QJsonObject result;
+    result.insert(QLatin1String("filter_lists"), filterListArray);
+    result.insert(QLatin1String("corpus"), m_corpusFile);
+    result.insert(QLatin1String("build"), buildObj);
+    result.insert(QLatin1String("replay"), replayObj);
+    result.insert(QLatin1String("memory"), memoryObj);
+    return result;
+}
+
+bool AdBlockBenchmark::loadCorpus()
+{
+    QFile corpus(m_corpusFile);
+    if (!corpus.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        fprintf(stderr, "Could not read request corpus %s\n", qPrintable(m_corpusFile));
+        return false;
+    }
+
+    QString line;
+    QTextStream stream(&corpus);
+    while (stream.readLineInto(&line))
+    {
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+            continue;
+
+        const QStringList fields = line.split(QLatin1Char('\t'));
+        if (fields.size() < 3)
+            continue;
+
+        const QUrl firstPartyUrl(fields.at(0)), requestUrl(fields.at(1));
+        m_requests.push_back({ firstPartyUrl, requestUrl, getRequestType(fields.at(2).trimmed().toLower(), firstPartyUrl, requestUrl) });
+    }
+
+    return !m_requests.empty();
+}
+
+std::shared_ptr<FilterContainer> AdBlockBenchmark::buildFilters(const QStringList &filePaths, std::size_t &numFilters)
+{
+    numFilters = 0;
+
+    std::vector< std::shared_ptr<const FilterSegment> > segments;
+    for (const QString &filePath : filePaths)
+    {
+        Subscription subscription(filePath);
+        subscription.load(nullptr);
+        segments.push_back(std::make_shared<FilterSegment>(subscription));
+        numFilters += segments.back()->size();
+    }
+
+    std::shared_ptr<FilterContainer> filters = std::make_shared<FilterContainer>();
+    filters->extractFilters(segments, nullptr);
+    return filters;
+}
+
+ElementType AdBlockBenchmark::getRequestType(const QString &typeName, const QUrl &firstPartyUrl, const QUrl &requestUrl) const
+{
+    ElementType elemType = ElementType::Other;
+
+    auto it = eOptionMap.find(typeName);
+    if (it != eOptionMap.end())
+        elemType = *it;
+
+    if (firstPartyUrl.isEmpty() || PublicSuffixList::instance().isThirdParty(requestUrl.host(), firstPartyUrl.host()))
+        elemType |= ElementType::ThirdParty;
+
+    return elemType;
+}
+
+qint64 AdBlockBenchmark::getMemoryUsage(const char *field)
+{
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+
+    const QList<QByteArray> lines = status.readAll().split('\n');
+    for (const QByteArray &line : lines)
+    {
+        if (!line.startsWith(field))
+            continue;
+
+        // Format is "VmRSS:     1234 kB"
+        const QList<QByteArray> parts = line.mid(static_cast<int>(qstrlen(field))).simplified().split(' ');
+        bool ok = false;
+        const qint64 value = parts.isEmpty() ? 0 : parts.at(0).toLongLong(&ok);
+        return ok ? value : -1;
+    }
+
+    return -1;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QLatin1String("AdBlockBenchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Replays recorded network requests through the ad block filters, and reports the results as JSON"));
+    parser.addHelpOption();
+
+    QCommandLineOption filterListOption(QStringList() << QLatin1String("f") << QLatin1String("filters"),
+                                        QLatin1String("Filter list to load. May be given more than once."), QLatin1String("file"));
+    QCommandLineOption corpusOption(QStringList() << QLatin1String("r") << QLatin1String("requests"),
+                                    QLatin1String("Request corpus to replay, one tab-separated request per line."), QLatin1String("file"));
+    QCommandLineOption iterationOption(QStringList() << QLatin1String("n") << QLatin1String("iterations"),
+                                       QLatin1String("Number of times to replay the request corpus."), QLatin1String("count"), QLatin1String("10"));
+    QCommandLineOption outputOption(QStringList() << QLatin1String("o") << QLatin1String("output"),
+                                    QLatin1String("File to write the results to, instead of the standard output."), QLatin1String("file"));
+    parser.addOption(filterListOption);
+    parser.addOption(corpusOption);
+    parser.addOption(iterationOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    QStringList filterLists = parser.values(filterListOption);
+    if (filterLists.isEmpty())
+        filterLists.append(QLatin1String(ADBLOCK_FIXTURE_DIR "/filters.txt"));
+
+    QString corpusFile = parser.value(corpusOption);
+    if (corpusFile.isEmpty())
+        corpusFile = QLatin1String(ADBLOCK_FIXTURE_DIR "/requests.tsv");
+
+    adblock::AdBlockBenchmark benchmark(filterLists, corpusFile, parser.value(iterationOption).toInt());
+    const QJsonObject result = benchmark.run();
+    if (result.isEmpty())
+        return 1;
+
+    const QByteArray json = QJsonDocument(result).toJson();
+    if (parser.isSet(outputOption))
+    {
+        QFile outputFile(parser.value(outputOption));
+        if (!outputFile.open(QIODevice::WriteOnly) || outputFile.write(json) != json.size())
+            return 1;
+    }
+    else
+        fwrite(json.constData(), 1, static_cast<std::size_t>(json.size()), stdout);
+
+    return 0;
+}
@@ -1,8 +1,20 @@
 #include "AdBlockFilter.h"
+#include "AdBlockFilterContainer.h"
 #include "AdBlockFilterParser.h"
+#include "AdBlockSubscription.h"
+#include "FilterDomainIndex.h"
+#include "FilterEngine.h"
+#include "FilterPatternMatcher.h"
+#include "FilterSegment.h"
+#include "FilterTokenIndex.h"
 
 #include <memory>
+#include <vector>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
 #include <QString>
+#include <QTemporaryDir>
 #include <QtTest>
 #include <QUrl>
 
@@ -21,6 +33,13 @@ private Q_SLOTS:
     void testCosmeticFilterMatch();
     void testFilterOptionMatches();
     void testRedirectFilterMatch();
+    void testTokenIndexMatch();
+    void testPatternMatcherMatch();
+    void testFilterSerialization();
+    void testDomainIndexMatch();
+    void testFilterEngineSnapshot();
+    void testDomainInterning();
+    void testMatchedRule();
 
 private:
     std::unique_ptr<Filter> domainCSSFilter;
@@ -128,6 +147,234 @@ void AdBlockFilterTest::testRedirectFilterMatch()
     QVERIFY2(redirectScriptRule->isMatch(baseUrl, requestUrlStr, domain, elemType), "Block rule should match the request");
 }
 
+void AdBlockFilterTest::testTokenIndexMatch()
+{
+    FilterParser parser(nullptr);
+
+    std::vector<std::unique_ptr<Filter>> filters;
+    filters.push_back(parser.makeFilter(QLatin1String("/adframe.")));
+    filters.push_back(parser.makeFilter(QLatin1String("||ads.example.com/banner/*.gif")));
+    filters.push_back(parser.makeFilter(QLatin1String("-ad-banner-")));
+    filters.push_back(parser.makeFilter(QLatin1String("adserv")));
+
+    FilterTokenIndex index;
+    for (std::unique_ptr<Filter> &filter : filters)
+        index.add(filter.get());
+    index.build();
+
+    QCOMPARE(index.size(), filters.size());
+
+    const QString baseUrl = QLatin1String("news.site.com");
+    const ElementType elemType = ElementType::Image | ElementType::ThirdParty;
+
+    Filter *match = index.findMatch(baseUrl, QLatin1String("https://cdn.site.com/adframe.js"), QLatin1String("cdn.site.com"), elemType);
+    QVERIFY2(match == filters.at(0).get(), "Token index should match the filter sharing a token with the request");
+
+    match = index.findMatch(baseUrl, QLatin1String("https://ads.example.com/banner/top.gif"), QLatin1String("ads.example.com"), elemType);
+    QVERIFY2(match == filters.at(1).get(), "Token index should match the anchored wildcard filter");
+
+    match = index.findMatch(baseUrl, QLatin1String("https://cdn.site.com/img/myadserver.png"), QLatin1String("cdn.site.com"), elemType);
+    QVERIFY2(match == filters.at(3).get(), "Filters without a safe token should be checked against every request");
+
+    match = index.findMatch(baseUrl, QLatin1String("https://cdn.site.com/img/logo.png"), QLatin1String("cdn.site.com"), elemType);
+    QVERIFY2(match == nullptr, "Token index should not match an unrelated request");
+}
+
+void AdBlockFilterTest::testPatternMatcherMatch()
+{
+    FilterParser parser(nullptr);
+
+    std::vector<std::unique_ptr<Filter>> filters;
+    filters.push_back(parser.makeFilter(QLatin1String("/adframe.")));
+    filters.push_back(parser.makeFilter(QLatin1String("frame.js$image")));
+    filters.push_back(parser.makeFilter(QLatin1String("ame.j")));
+    filters.push_back(parser.makeFilter(QLatin1String("-ad-banner-")));
+
+    FilterPatternMatcher matcher;
+    for (std::unique_ptr<Filter> &filter : filters)
+        matcher.add(filter.get());
+    matcher.build();
+
+    QCOMPARE(matcher.size(), filters.size());
+
+    const QString baseUrl = QLatin1String("news.site.com");
+    const QString domain = QLatin1String("cdn.site.com");
+
+    Filter *match = matcher.findMatch(baseUrl, QLatin1String("https://cdn.site.com/adframe.js"), domain, ElementType::Script);
+    QVERIFY2(match == filters.at(0).get(), "Pattern matcher should report the first needle found in the request");
+
+    match = matcher.findMatch(baseUrl, QLatin1String("https://cdn.site.com/iframe.js"), domain, ElementType::Script);
+    QVERIFY2(match == filters.at(2).get(), "Pattern matcher should skip candidates whose options do not match the request");
+
+    match = matcher.findMatch(baseUrl, QLatin1String("https://cdn.site.com/img/top-ad-banner-1.png"), domain, ElementType::Image);
+    QVERIFY2(match == filters.at(3).get(), "Pattern matcher should find needles through failure links");
+
+    match = matcher.findMatch(baseUrl, QLatin1String("https://cdn.site.com/img/logo.png"), domain, ElementType::Image);
+    QVERIFY2(match == nullptr, "Pattern matcher should not match an unrelated request");
+
+    FilterPatternMatcher caseMatcher;
+    std::unique_ptr<Filter> matchCaseFilter = parser.makeFilter(QLatin1String("/BannerAd.$match-case"));
+    caseMatcher.add(matchCaseFilter.get());
+    caseMatcher.build();
+
+    match = caseMatcher.findMatch(baseUrl, QLatin1String("https://cdn.site.com/BannerAd.gif"), domain, ElementType::Image);
+    QVERIFY2(match == matchCaseFilter.get(), "Pattern matcher should match a match-case filter containing upper case letters");
+
+    match = caseMatcher.findMatch(baseUrl, QLatin1String("https://cdn.site.com/bannerad.gif"), domain, ElementType::Image);
+    QVERIFY2(match == nullptr, "Pattern matcher should not match a match-case filter whose case differs from the request");
+}
+
+void AdBlockFilterTest::testFilterSerialization()
+{
+    FilterParser parser(nullptr);
+
+    std::vector<std::unique_ptr<Filter>> filters;
+    filters.push_back(parser.makeFilter(QLatin1String("@@||good.com^$script,domain=a.com|~b.com")));
+    filters.push_back(parser.makeFilter(QLatin1String("/banner[0-9]+/$image,match-case")));
+    filters.push_back(parser.makeFilter(QLatin1String("example.com##.ad")));
+
+    QByteArray buffer;
+    QDataStream out(&buffer, QIODevice::WriteOnly);
+    for (std::unique_ptr<Filter> &filter : filters)
+        out << *filter;
+
+    QDataStream in(buffer);
+    for (std::unique_ptr<Filter> &filter : filters)
+    {
+        Filter copy(QString{});
+        in >> copy;
+
+        QVERIFY2(in.status() == QDataStream::Ok, "Filter should be deserialized without error");
+        QCOMPARE(copy.getRule(), filter->getRule());
+        QCOMPARE(copy.getCategory(), filter->getCategory());
+        QCOMPARE(copy.getEvalString(), filter->getEvalString());
+        QCOMPARE(copy.isException(), filter->isException());
+    }
+
+    QDataStream matchStream(buffer);
+    Filter copy(QString{});
+    matchStream >> copy;
+    QVERIFY2(copy.isMatch(QLatin1String("a.com"), QLatin1String("https://good.com/script.js"), QLatin1String("good.com"), ElementType::Script),
+             "Deserialized filter should match the same requests as the original");
+    QVERIFY2(!copy.isMatch(QLatin1String("b.com"), QLatin1String("https://good.com/script.js"), QLatin1String("good.com"), ElementType::Script),
+             "Deserialized filter should keep its domain restrictions");
+
+    matchStream >> copy;
+    QVERIFY2(copy.isMatch(QLatin1String("a.com"), QLatin1String("https://cdn.com/banner12.png"), QLatin1String("cdn.com"), ElementType::Image),
+             "Deserialized regular expression filter should match the same requests as the original");
+    QVERIFY2(!copy.isMatch(QLatin1String("a.com"), QLatin1String("https://cdn.com/BANNER12.png"), QLatin1String("cdn.com"), ElementType::Image),
+             "Deserialized regular expression filter should keep its case sensitivity");
+}
+
+void AdBlockFilterTest::testDomainIndexMatch()
+{
+    FilterParser parser(nullptr);
+
+    std::vector<std::unique_ptr<Filter>> filters;
+    filters.push_back(parser.makeFilter(QLatin1String("example.com,~shop.example.com##.ad")));
+    filters.push_back(parser.makeFilter(QLatin1String("google.*##.sponsored")));
+    filters.push_back(parser.makeFilter(QLatin1String("news.site.com##.banner")));
+    filters.push_back(parser.makeFilter(QLatin1String("~example.com##.promo")));
+
+    FilterDomainIndex index;
+    for (std::unique_ptr<Filter> &filter : filters)
+        index.add(filter.get());
+
+    QCOMPARE(index.size(), filters.size());
+
+    std::vector<Filter*> matches = index.findMatches(QLatin1String("a.b.example.com"));
+    QVERIFY2(matches.size() == 1 && matches.at(0) == filters.at(0).get(), "Domain index should match filters of parent domains");
+
+    matches = index.findMatches(QLatin1String("shop.example.com"));
+    QVERIFY2(matches.empty(), "Domain index should respect excluded domains");
+
+    matches = index.findMatches(QLatin1String("www.google.co"));
+    QVERIFY2(matches.size() == 1 && matches.at(0) == filters.at(1).get(), "Domain index should match entity filters");
+
+    matches = index.findMatches(QLatin1String("site.com"));
+    QVERIFY2(matches.empty(), "Domain index should not match filters of subdomains");
+
+    matches = index.findMatches(QLatin1String("notexample.com"));
+    QVERIFY2(matches.empty(), "Domain index should only match whole domain labels");
+}
+
+void AdBlockFilterTest::testFilterEngineSnapshot()
+{
+    FilterEngine engine;
+
+    std::shared_ptr<const FilterContainer> snapshot = engine.getFilters();
+    QVERIFY2(snapshot != nullptr, "Filter engine should start with an empty filter container");
+
+    std::shared_ptr<const FilterContainer> rebuilt = std::make_shared<FilterContainer>();
+    engine.publish(rebuilt);
+    QVERIFY2(engine.getFilters() == rebuilt, "Filter engine should return the most recently published filters");
+    QVERIFY2(snapshot.use_count() == 1, "Snapshot should remain valid after its filters have been replaced");
+    QVERIFY2(rebuilt->getGeneration() != snapshot->getGeneration(), "Each filter container should have its own generation");
+
+    engine.publish(nullptr);
+    QVERIFY2(engine.getFilters() != nullptr, "Filter engine should never publish a null filter container");
+
+    FilterParser parser(nullptr);
+    std::unique_ptr<Filter> filter = parser.makeFilter(QLatin1String("||ads.example.com^"));
+    filter->recordHit();
+    filter->recordHit();
+
+    Filter copy(*filter);
+    QCOMPARE(copy.getHitCount(), quint32(2));
+}
+
+void AdBlockFilterTest::testDomainInterning()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+
+    const QString filePath = tempDir.filePath(QLatin1String("interning.txt"));
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("a.com,b.com##.ad\n"
+               "a.com##.banner\n"
+               "||x.com^$script,domain=a.com|~b.com\n"
+               "||y.com^$image,domain=b.com\n");
+    file.close();
+
+    // The first load parses the file and writes its cache, the second one reads the cache
+    for (int i = 0; i < 2; ++i)
+    {
+        Subscription subscription(filePath);
+        subscription.load(nullptr);
+
+        std::vector< std::shared_ptr<const FilterSegment> > segments;
+        segments.push_back(std::make_shared<FilterSegment>(subscription));
+
+        FilterContainer filters;
+        filters.extractFilters(segments, nullptr);
+
+        const FilterMemoryReport report = filters.getMemoryReport();
+        QCOMPARE(report.NumInternedDomains, std::size_t(2));
+    }
+}
+
+void AdBlockFilterTest::testMatchedRule()
+{
+    FilterParser parser(nullptr);
+    std::unique_ptr<Filter> filter = parser.makeFilter(QLatin1String("||ads.example.com^$script"));
+
+    const QString &rule = filter->getMatchedRule();
+    QCOMPARE(rule, filter->getRule());
+    QVERIFY2(&filter->getMatchedRule() == &rule, "Matched rule should only be decoded once");
+
+    Filter copy(*filter);
+    QCOMPARE(copy.getMatchedRule(), filter->getRule());
+
+    QByteArray buffer;
+    QDataStream out(&buffer, QIODevice::WriteOnly);
+    out << *parser.makeFilter(QLatin1String("@@||good.com^"));
+
+    QDataStream in(buffer);
+    in >> copy;
+    QCOMPARE(copy.getMatchedRule(), QLatin1String("@@||good.com^"));
+}
+
 QTEST_APPLESS_MAIN(AdBlockFilterTest)
 
 #include "AdBlockFilterTest.moc"
@@ -0,0 +1,181 @@
+#include "AdBlockLog.h"
+#include "LogStringTable.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <QString>
+#include <QUrl>
+#include <QtTest>
+
+using namespace adblock;
+
+class AdBlockLogTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    AdBlockLogTest() :
+        QObject(nullptr)
+    {
+    }
+
+private Q_SLOTS:
+    void testThatEntriesAreResolvedFromRecords()
+    {
+        AdBlockLog log;
+        log.addEntry(FilterAction::Block, QUrl(QLatin1String("https://example.com/")), QUrl(QLatin1String("https://ads.example.net/ad.js")),
+                     ElementType::Script, QLatin1String("||ads.example.net^"));
+        log.addEntry(FilterAction::Allow, QUrl(QLatin1String("https://other.com/")), QUrl(QLatin1String("https://cdn.other.com/lib.js")),
+                     ElementType::Script, QLatin1String("@@||cdn.other.com^"));
+
+        const std::vector<LogRecord> records = log.getAllEntries();
+        QCOMPARE(static_cast<int>(records.size()), 2);
+
+        const LogEntry entry = log.getEntry(records.at(0));
+        QVERIFY(entry.Action == FilterAction::Block);
+        QVERIFY(entry.ResourceType == ElementType::Script);
+        QCOMPARE(entry.FirstPartyUrl, QUrl(QLatin1String("https://example.com/")));
+        QCOMPARE(entry.RequestUrl, QUrl(QLatin1String("https://ads.example.net/ad.js")));
+        QCOMPARE(entry.Rule, QLatin1String("||ads.example.net^"));
+        QVERIFY(entry.Timestamp.isValid());
+
+        const std::vector<LogRecord> otherRecords = log.getEntriesFor(QUrl(QLatin1String("https://other.com/")));
+        QCOMPARE(static_cast<int>(otherRecords.size()), 1);
+        QVERIFY(log.getEntry(otherRecords.at(0)).Action == FilterAction::Allow);
+    }
+
+    void testThatOldestRecordsAreOverwritten()
+    {
+        AdBlockLog log;
+        const QUrl firstPartyUrl(QLatin1String("https://example.com/"));
+        const int numEntries = static_cast<int>(AdBlockLog::Capacity) + 100;
+        for (int i = 0; i < numEntries; ++i)
+        {
+            log.addEntry(FilterAction::Block, firstPartyUrl, QUrl(QString("https://ads.example.net/%1").arg(i)),
+                         ElementType::Image, QLatin1String("||ads.example.net^"));
+        }
+
+        const std::vector<LogRecord> records = log.getAllEntries();
+        QCOMPARE(records.size(), AdBlockLog::Capacity);
+        QCOMPARE(log.getEntry(records.front()).RequestUrl, QUrl(QLatin1String("https://ads.example.net/100")));
+        QCOMPARE(log.getEntry(records.back()).RequestUrl, QUrl(QString("https://ads.example.net/%1").arg(numEntries - 1)));
+
+        // Repeated strings share a single copy in the string table
+        QVERIFY(records.front().FirstPartyUrlId == records.back().FirstPartyUrlId);
+        QVERIFY(records.front().RuleId == records.back().RuleId);
+    }
+
+    void testThatOverwrittenStringsAreNotResolved()
+    {
+        LogStringTable strings(4096, 16);
+        const uint64_t handle = strings.intern(QLatin1String("https://example.com/"));
+        QCOMPARE(strings.lookup(handle), QLatin1String("https://example.com/"));
+        QVERIFY(strings.intern(QString()) == LogStringTable::EmptyHandle);
+
+        for (int i = 0; i < 1000; ++i)
+            strings.intern(QString("https://example.com/%1").arg(i));
+
+        QVERIFY(strings.lookup(handle).isNull());
+    }
+
+    void testThatLiveRecordsResolveAfterTheTextWraps()
+    {
+        AdBlockLog log;
+        const QUrl firstPartyUrl(QLatin1String("https://example.com/"));
+        const QString rule = QLatin1String("||ads.example.net^");
+        const QString longPath(1000, QLatin1Char('a'));
+
+        // The long request URLs would wrap the text buffer several times over if they were stored in full
+        const int numEntries = 3 * static_cast<int>(AdBlockLog::Capacity);
+        for (int i = 0; i < numEntries; ++i)
+        {
+            log.addEntry(FilterAction::Block, firstPartyUrl, QUrl(QString("https://ads.example.net/%1/%2").arg(i).arg(longPath)),
+                         ElementType::Image, rule);
+        }
+
+        const std::vector<LogRecord> records = log.getEntriesFor(firstPartyUrl);
+        QCOMPARE(records.size(), AdBlockLog::Capacity);
+
+        int numUnresolvedRecords = 0;
+        for (const LogRecord &record : records)
+        {
+            const LogEntry entry = log.getEntry(record);
+            if (entry.FirstPartyUrl != firstPartyUrl || entry.Rule != rule || entry.RequestUrl.isEmpty())
+                ++numUnresolvedRecords;
+        }
+        QVERIFY2(numUnresolvedRecords == 0, "Expected every live record to resolve all of its strings");
+
+        const QString lastRequestUrl = log.getEntry(records.back()).RequestUrl.toString();
+        QVERIFY(lastRequestUrl.startsWith(QString("https://ads.example.net/%1/").arg(numEntries - 1)));
+        QVERIFY(lastRequestUrl.size() < longPath.size());
+    }
+
+    void testThatRecordsAreFoundAfterTheirFirstPartyUrlIsOverwritten()
+    {
+        AdBlockLog log;
+        const QUrl firstPartyUrl(QLatin1String("https://example.com/"));
+        log.addEntry(FilterAction::Block, firstPartyUrl, QUrl(QLatin1String("https://ads.example.net/ad.js")),
+                     ElementType::Script, QLatin1String("||ads.example.net^"));
+
+        // Distinct long rules wrap the text buffer while the first record is still in the log
+        for (int i = 0; i < 600; ++i)
+        {
+            const QString rule = QString("/%1/%2").arg(i).arg(QString(LogStringTable::MaxStringLength, QLatin1Char('r')));
+            log.addEntry(FilterAction::Block, QUrl(QLatin1String("https://other.com/")), QUrl(QLatin1String("https://ads.other.com/")),
+                         ElementType::Image, rule);
+        }
+
+        const std::vector<LogRecord> records = log.getEntriesFor(firstPartyUrl);
+        QCOMPARE(static_cast<int>(records.size()), 1);
+        QVERIFY(log.getEntry(records.at(0)).Action == FilterAction::Block);
+
+        QCOMPARE(static_cast<int>(log.getEntriesFor(QUrl(QLatin1String("https://other.com/"))).size()), 600);
+    }
+
+    void testThatConcurrentWritersProduceConsistentRecords()
+    {
+        AdBlockLog log;
+        std::atomic<int> numInconsistentRecords(0);
+        std::atomic<bool> isWriting(true);
+
+        std::thread reader([&]() {
+            while (isWriting.load())
+            {
+                for (const LogRecord &record : log.getAllEntries())
+                {
+                    const LogEntry entry = log.getEntry(record);
+                    if (!entry.Rule.isEmpty() && !entry.RequestUrl.toString().endsWith(entry.Rule))
+                        ++numInconsistentRecords;
+                }
+            }
+        });
+
+        std::vector<std::thread> writers;
+        for (int i = 0; i < 4; ++i)
+        {
+            writers.emplace_back([&log, i]() {
+                for (int j = 0; j < 5000; ++j)
+                {
+                    const QString rule = QString("/%1/%2").arg(i).arg(j % 10);
+                    log.addEntry(FilterAction::Block, QUrl(QString("https://site%1.com/").arg(j % 20)),
+                                 QUrl(QString("https://ads.example.net%1").arg(rule)), ElementType::Image, rule);
+                }
+            });
+        }
+
+        for (std::thread &writer : writers)
+            writer.join();
+
+        isWriting.store(false);
+        reader.join();
+
+        QVERIFY2(numInconsistentRecords == 0, "Expected every record to be read in a consistent state");
+        QCOMPARE(log.getAllEntries().size(), AdBlockLog::Capacity);
+    }
+};
+
+QTEST_APPLESS_MAIN(AdBlockLogTest)
+
+#include "AdBlockLogTest.moc"
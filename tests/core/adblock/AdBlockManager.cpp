@@ -25,7 +25,8 @@ class AdBlockModel
 
 AdBlockManager::AdBlockManager(const ViperServiceLocator &, QObject *parent) :
     QObject(parent),
-    m_filterContainer(),
+    m_filterEngine(),
+    m_filterGeneration(0),
     m_downloadManager(nullptr),
     m_enabled(false),
     m_configFile("AdBlockStub.json"),
@@ -34,6 +35,7 @@ AdBlockManager::AdBlockManager(const ViperServiceLocator &, QObject *parent) :
     m_subscriptions(),
     m_resourceMap(),
     m_resourceContentTypeMap(),
+    m_resourceLock(),
     m_domainStylesheetCache(24),
     m_jsInjectionCache(24),
     m_emptyStr(),
@@ -57,7 +59,7 @@ void AdBlockManager::setEnabled(bool value)
 
     clearFilters();
     if (value)
-        extractFilters();
+        rebuildFilters();
 }
 
 void AdBlockManager::updateSubscriptions()
@@ -91,9 +93,9 @@ AdBlockModel *AdBlockManager::getModel()
     return nullptr;
 }
 
-const QString &AdBlockManager::getStylesheet(const URL &/*url*/) const
+QString AdBlockManager::getStylesheet(const URL &/*url*/) const
 {
-    return m_emptyStr;
+    return QString();
 }
 
 const QString &AdBlockManager::getDomainStylesheet(const URL &/*url*/)
@@ -180,7 +182,7 @@ void AdBlockManager::removeSubscription(int index)
 void AdBlockManager::reloadSubscriptions()
 {
     clearFilters();
-    extractFilters();
+    rebuildFilters();
 }
 
 QString AdBlockManager::getSecondLevelDomain(const QUrl &url) const
@@ -328,22 +330,34 @@ void AdBlockManager::loadSubscriptions()
         m_subscriptions.push_back(std::move(subscription));
     }
 
-    extractFilters();
+    rebuildFilters();
 }
 
 void AdBlockManager::clearFilters()
 {
-    m_filterContainer.clearFilters();
+    ++m_filterGeneration;
+    m_filterEngine.publish(std::make_shared<FilterContainer>());
 }
 
-void AdBlockManager::extractFilters()
+// The tests build the filters on the calling thread, so they are ready as soon as the subscriptions are loaded
+void AdBlockManager::rebuildFilters()
 {
-    for (Subscription &s : m_subscriptions)
+    ++m_filterGeneration;
+
+    std::vector< std::shared_ptr<const FilterSegment> > segments;
+    for (const Subscription &s : m_subscriptions)
     {
-        // calling load() does nothing if subscription is disabled
-        s.load(this);
+        if (!s.isEnabled())
+            continue;
+
+        Subscription subscription = s.copySettings();
+        subscription.load(this);
+        segments.push_back(std::make_shared<FilterSegment>(subscription));
     }
-    m_filterContainer.extractFilters(m_subscriptions);
+
+    std::shared_ptr<FilterContainer> filters = std::make_shared<FilterContainer>();
+    filters->extractFilters(segments, m_filterEngine.getFilters().get());
+    m_filterEngine.publish(filters);
 }
 
 void AdBlockManager::save()
@@ -7,6 +7,7 @@
 #include <chrono>
 #include <memory>
 #include <thread>
+#include <vector>
 
 #include <QObject>
 #include <QString>
@@ -35,6 +36,8 @@ private slots:
 
     void testBookmarkCheckWithTrailingSlash();
 
+    void testBookmarkLookupAfterChanges();
+
 private:
     /// Root node/folder used in bookmark management tests
     std::shared_ptr<BookmarkNode> m_root;
@@ -236,6 +239,44 @@ void BookmarkManagerTest::testBookmarkCheckWithTrailingSlash()
     QVERIFY2(m_manager->isBookmarked(compareToUrl), "Bookmark manager should ignore trailing slashes when checking if a URL is bookmarked");
 }
 
+void BookmarkManagerTest::testBookmarkLookupAfterChanges()
+{
+    QUrl bookmarkUrl { QLatin1String("https://www.lookup-test.org/start") };
+    QUrl movedUrl { QLatin1String("https://docs.lookup-test.org/start") };
+
+    m_manager->appendBookmark(QLatin1String("Lookup Test"), bookmarkUrl, m_root.get());
+    m_manager->appendBookmark(QLatin1String("Other Page"), QUrl(QLatin1String("https://lookup-test.org/other")), m_root.get());
+
+    std::vector<BookmarkSnapshot> hostMatches = m_manager->findBookmarksWithHostPrefix(QLatin1String("LOOKUP-TE"), 10);
+    QVERIFY2(hostMatches.size() == 2, "Bookmarks should be found by their host, ignoring the www prefix");
+
+    BookmarkNode *bookmark = m_manager->getBookmark(QUrl(QLatin1String("http://lookup-test.org/start/")));
+    QVERIFY2(bookmark != nullptr, "Bookmark lookups should ignore the scheme, www prefix and trailing slash");
+
+    m_manager->setBookmarkShortcut(bookmark, QLatin1String("lt"));
+    std::vector<BookmarkSnapshot> shortcutMatches = m_manager->findBookmarksWithShortcutIn(QLatin1String("LT SEARCH"));
+    QVERIFY2(shortcutMatches.size() == 1 && shortcutMatches[0].URL == bookmarkUrl, "Bookmark should be found by its shortcut");
+
+    m_manager->setBookmarkURL(bookmark, movedUrl);
+    QVERIFY2(!m_manager->isBookmarked(bookmarkUrl), "Bookmark should no longer be found by its old URL");
+    QVERIFY2(m_manager->getBookmark(movedUrl) == bookmark, "Bookmark should be found by its new URL");
+    QVERIFY2(m_manager->findBookmarksWithHostPrefix(QLatin1String("docs.lookup"), 10).size() == 1, "Bookmark should be found by its new host");
+
+    // Moving a bookmark within its folder replaces its node
+    m_manager->setBookmarkPosition(bookmark, 0);
+    bookmark = m_manager->getBookmark(movedUrl);
+    QVERIFY2(bookmark != nullptr && bookmark->getPosition() == 0, "Bookmark should be found in its new position");
+
+    m_manager->removeBookmark(bookmark);
+    QVERIFY2(!m_manager->isBookmarked(movedUrl), "Bookmark should not be found after being removed");
+    QVERIFY2(m_manager->findBookmarksWithShortcutIn(QLatin1String("LT SEARCH")).empty(), "Removed bookmark should not be found by its shortcut");
+    QVERIFY2(m_manager->findBookmarksWithHostPrefix(QLatin1String("LOOKUP-TE"), 10).size() == 1, "Only the remaining bookmark should be found by its host");
+
+    const BookmarkSnapshot &removedBookmark = shortcutMatches[0];
+    QVERIFY2(removedBookmark.Name == QLatin1String("Lookup Test") && removedBookmark.Shortcut == QLatin1String("lt"),
+             "Copies returned by the lookups should outlive the bookmark");
+}
+
 QTEST_APPLESS_MAIN(BookmarkManagerTest)
 
 #include "BookmarkManagerTest.moc"
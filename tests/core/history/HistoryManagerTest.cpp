@@ -3,6 +3,10 @@
 #include "HistoryStore.h"
 #include "ServiceLocator.h"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <QDateTime>
 #include <QFile>
 #include <QObject>
@@ -148,6 +152,50 @@ private slots:
         QCOMPARE(spy.count(), 2);
     }
 
+    /// Tests that a visit made while a range of the history is being cleared stays in the search index
+    void testThatVisitsDuringAClearStayInTheSearchIndex()
+    {
+        DatabaseTaskScheduler taskScheduler;
+        taskScheduler.addWorker("HistoryStore", std::bind(DatabaseFactory::createDBWorker<HistoryStore>, "HistoryManagerTest.db"));
+
+        ViperServiceLocator serviceLocator;
+
+        m_historyManager = new HistoryManager(serviceLocator, taskScheduler);
+
+        taskScheduler.run();
+
+        // Let initialization routine complete
+        QTest::qWait(500);
+
+        const QDateTime oldDate = QDateTime::currentDateTime().addDays(-5);
+        const QUrl oldUrl { QUrl::fromUserInput("https://old-page.website.net/") };
+        m_historyManager->addVisit(oldUrl, QLatin1String("Old Page"), oldDate, oldUrl, false);
+
+        // Hold the history database worker, so the visit below is made before the clear has reloaded the index
+        std::atomic<bool> isReleased(false);
+        taskScheduler.post("HistoryStore", [&isReleased](){
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!isReleased && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        });
+
+        QSignalSpy spy(m_historyManager, &HistoryManager::historyCleared);
+        m_historyManager->clearHistoryInRange(std::make_pair(oldDate.addSecs(-60), QDateTime::currentDateTime().addDays(-1)));
+
+        const QUrl newUrl { QUrl::fromUserInput("https://new-page.website.net/") };
+        m_historyManager->addVisit(newUrl, QLatin1String("New Page"), QDateTime::currentDateTime(), newUrl, false);
+        isReleased = true;
+
+        QVERIFY(spy.wait(5500));
+
+        const URLSearchIndex &searchIndex = m_historyManager->getSearchIndex();
+        QVERIFY2(searchIndex.findEntriesContaining(QLatin1String("OLD-PAGE"), 10).empty(), "Expected the cleared visit to be removed from the index");
+
+        const std::vector<URLSearchResult> results = searchIndex.findEntriesContaining(QLatin1String("NEW-PAGE"), 10);
+        QCOMPARE(results.size(), std::size_t(1));
+        QCOMPARE(results.at(0).Entry.NumVisits, 1);
+    }
+
     /// Tests that the reported visit count matches the expected values
     void testVisitCount()
     {
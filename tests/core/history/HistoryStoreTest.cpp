@@ -132,15 +132,86 @@ private slots:
         QCOMPARE(records.at(1).getUrl(), secondUrlRequested);
     }
 
+    /// Tests that the most visited entries are ordered by their frecency, and that the visit count
+    /// and time of last visit of an entry are kept up to date as its visits are cleared
+    void testMostVisitedEntries()
+    {
+        std::unique_ptr<HistoryStore> historyStore = DatabaseFactory::createWorker<HistoryStore>(m_dbFile);
+
+        const QDateTime now = QDateTime::currentDateTime();
+
+        QUrl firstUrl { QUrl::fromUserInput("https://viper-browser.com") };
+        historyStore->addVisit(firstUrl, QLatin1String("Viper Browser"), now.addDays(-50), firstUrl, false);
+        historyStore->addVisit(firstUrl, QLatin1String("Viper Browser"), now.addDays(-40), firstUrl, false);
+        historyStore->addVisit(firstUrl, QLatin1String("Viper Browser"), now.addDays(-30), firstUrl, false);
+
+        QUrl secondUrl { QUrl::fromUserInput("https://a.datacenter.website.net/landing") };
+        historyStore->addVisit(secondUrl, QLatin1String("Some Website"), now.addSecs(-60), secondUrl, false);
+        historyStore->addVisit(secondUrl, QLatin1String("Some Website"), now, secondUrl, false);
+
+        // Two visits today outweigh three visits made more than a month ago
+        std::vector<WebPageInformation> entries = historyStore->loadMostVisitedEntries(10);
+        QCOMPARE(static_cast<int>(entries.size()), 2);
+        QCOMPARE(entries.at(0).URL, secondUrl);
+        QCOMPARE(entries.at(1).URL, firstUrl);
+
+        QCOMPARE(historyStore->getTimesVisited(firstUrl), 3);
+        QCOMPARE(historyStore->getTimesVisited(secondUrl), 2);
+
+        historyStore->clearHistoryInRange({now.addDays(-45), now.addDays(-35)});
+
+        HistoryEntry entry = historyStore->getEntry(firstUrl);
+        QCOMPARE(entry.NumVisits, 2);
+        QCOMPARE(entry.LastVisit, now.addDays(-30));
+
+        historyStore->clearHistoryFrom(now.addDays(-1));
+
+        entries = historyStore->loadMostVisitedEntries(10);
+        QCOMPARE(static_cast<int>(entries.size()), 1);
+        QCOMPARE(entries.at(0).URL, firstUrl);
+        QCOMPARE(historyStore->getTimesVisited(secondUrl), 0);
+    }
+
+    /// Tests that visits are queued and written to the database together
+    void testVisitsAreWrittenInBatches()
+    {
+        std::unique_ptr<HistoryStore> historyStore = DatabaseFactory::createWorker<HistoryStore>(m_dbFile);
+
+        QUrl firstUrl { QUrl::fromUserInput("https://viper-browser.com") };
+        QUrl secondUrl { QUrl::fromUserInput("https://a.datacenter.website.net/landing") };
+        historyStore->addVisit(firstUrl, QLatin1String("Viper Browser"), QDateTime::currentDateTime().addSecs(-2), firstUrl, false);
+        historyStore->addVisit(secondUrl, QLatin1String("Some Website"), QDateTime::currentDateTime().addSecs(-1), secondUrl, false);
+        historyStore->addVisit(firstUrl, QLatin1String("Viper Browser"), QDateTime::currentDateTime(), firstUrl, true);
+
+        VisitQueueStats stats = historyStore->getVisitQueueStats();
+        QCOMPARE(stats.QueuedVisits, uint64_t{3});
+        QCOMPARE(stats.FlushedVisits, uint64_t{0});
+
+        historyStore->flushVisits();
+
+        stats = historyStore->getVisitQueueStats();
+        QCOMPARE(stats.FlushedVisits, uint64_t{3});
+        QCOMPARE(stats.Flushes, uint64_t{1});
+
+        QCOMPARE(historyStore->getTimesVisited(firstUrl), 2);
+        QCOMPARE(historyStore->getEntry(firstUrl).URLTypedCount, 1);
+
+        // The words of each page are associated with its entry
+        const int firstId = historyStore->getEntry(firstUrl).VisitID;
+        const std::map<int, std::vector<int>> wordMapping = historyStore->getEntryWordMapping();
+        QVERIFY2(wordMapping.find(firstId) != wordMapping.end(), "Expected the words of the page to be saved");
+
+        // Queries write any queued visits first
+        historyStore->addVisit(secondUrl, QLatin1String("Some Website"), QDateTime::currentDateTime().addSecs(1), secondUrl, false);
+        QCOMPARE(historyStore->getTimesVisited(secondUrl), 2);
+        QCOMPARE(historyStore->getVisitQueueStats().Flushes, uint64_t{2});
+    }
+
     /*
      * todo: test cases for:
 
     /// Returns a queue of recently visited items, with the most recent visits being at the front of the queue
     std::deque<HistoryEntry> getRecentItems();
-
-    /// Fetches the set of most frequently visited web pages, up to the given limit. This is used to
-    /// determine which web pages' thumbnails to retrieve for the "New Tab" page
-    std::vector<WebPageInformation> loadMostVisitedEntries(int limit = 10);
     */
 
 private:
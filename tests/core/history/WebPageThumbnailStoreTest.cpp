@@ -0,0 +1,226 @@
+#include "DatabaseFactory.h"
+#include "FavoritePagesManager.h"
+#include "ServiceLocator.h"
+#include "WebPageThumbnailStore.h"
+
+#include <memory>
+
+#include <QByteArray>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QObject>
+#include <QSignalSpy>
+#include <QString>
+#include <QStringList>
+#include <QTest>
+#include <QUrl>
+#include <QVariantMap>
+
+/// Test cases for the \ref WebPageThumbnailStore class
+class WebPageThumbnailStoreTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    WebPageThumbnailStoreTest() :
+        QObject(nullptr),
+        m_dbFile(QLatin1String("WebPageThumbnailStoreTest.db")),
+        m_favoritesFile(QLatin1String("WebPageThumbnailStoreTest.json")),
+        m_serviceLocator()
+    {
+    }
+
+private:
+    /// Returns a PNG-encoded thumbnail of the given size, in bytes, filled with the given character
+    static QByteArray createThumbnail(int numBytes, char fill)
+    {
+        QByteArray data = QByteArrayLiteral("\x89PNG");
+        data.append(QByteArray(numBytes - data.size(), fill));
+        return data;
+    }
+
+    /// Returns the name of the i'th host used by the tests
+    static QString getHost(int i)
+    {
+        return QString("host%1.com").arg(i);
+    }
+
+    /// Creates and returns a thumbnail store using the test database
+    std::unique_ptr<WebPageThumbnailStore> createStore()
+    {
+        return DatabaseFactory::createWorker<WebPageThumbnailStore>(m_serviceLocator, m_dbFile);
+    }
+
+    /// Requests the thumbnail of the given host from the store, and waits for it to be returned
+    static QByteArray loadThumbnail(WebPageThumbnailStore &store, const QString &host)
+    {
+        bool isLoaded = false;
+        QByteArray result;
+        store.getThumbnail(QUrl(QString("https://%1/").arg(host)), &store, [&](const QByteArray &thumbnail){
+            result = thumbnail;
+            isLoaded = true;
+        });
+
+        for (int i = 0; i < 100 && !isLoaded; ++i)
+            QTest::qWait(50);
+
+        return result;
+    }
+
+private slots:
+    /// Called before every test function, removes the files of the previous test
+    void init()
+    {
+        QFile::remove(m_dbFile);
+        QFile::remove(m_favoritesFile);
+    }
+
+    /// Called after every test function
+    void cleanup()
+    {
+        QFile::remove(m_dbFile);
+        QFile::remove(m_favoritesFile);
+    }
+
+    /// Verifies that thumbnails are not evicted before they are saved, and that the cache stays within its
+    /// budget once they are
+    void testThatUnsavedThumbnailsAreNotEvicted()
+    {
+        auto store = createStore();
+
+        const int numThumbnails = 12;
+        const int thumbnailSize = 1024 * 1024;
+
+        QStringList hosts;
+        for (int i = 0; i < numThumbnails; ++i)
+        {
+            hosts.append(getHost(i));
+            store->addUnsavedThumbnail(getHost(i), createThumbnail(thumbnailSize, static_cast<char>('a' + i)));
+        }
+
+        QCOMPARE(store->m_unsavedThumbnails.size(), numThumbnails);
+        QCOMPARE(store->m_thumbnailCache.size(), size_t(0));
+
+        store->saveThumbnails(hosts);
+
+        QVERIFY(store->m_unsavedThumbnails.isEmpty());
+        QVERIFY2(store->m_thumbnailCache.getWeight() <= store->m_thumbnailCache.capacity(),
+                 "Expected the saved thumbnails to be moved into the cache within its budget");
+        QVERIFY2(!store->m_thumbnailCache.has(getHost(0)), "Expected the least recent thumbnails to be evicted");
+        QVERIFY(store->m_thumbnailCache.has(getHost(numThumbnails - 1)));
+
+        // Every thumbnail was written to the database, including those that are no longer cached
+        for (int i = 0; i < numThumbnails; ++i)
+            QCOMPARE(loadThumbnail(*store, getHost(i)), createThumbnail(thumbnailSize, static_cast<char>('a' + i)));
+    }
+
+    /// Verifies that an evicted thumbnail is read from the database when it is requested, and cached again
+    void testThatEvictedThumbnailsAreLoadedLazily()
+    {
+        auto store = createStore();
+
+        const int numThumbnails = 10;
+        const int thumbnailSize = 1024 * 1024;
+
+        QStringList hosts;
+        for (int i = 0; i < numThumbnails; ++i)
+        {
+            hosts.append(getHost(i));
+            store->addUnsavedThumbnail(getHost(i), createThumbnail(thumbnailSize, static_cast<char>('a' + i)));
+        }
+        store->saveThumbnails(hosts);
+
+        QVERIFY(!store->m_thumbnailCache.has(getHost(0)));
+        const uint64_t numEvictions = store->m_thumbnailCache.getEvictionCount();
+
+        QCOMPARE(loadThumbnail(*store, getHost(0)), createThumbnail(thumbnailSize, 'a'));
+        QVERIFY2(store->m_thumbnailCache.has(getHost(0)), "Expected the loaded thumbnail to be cached");
+        QCOMPARE(store->m_thumbnailCache.getEvictionCount(), numEvictions + 1);
+        QVERIFY(store->m_thumbnailCache.getWeight() <= store->m_thumbnailCache.capacity());
+    }
+
+    /// Verifies that only the thumbnails of the given hosts are saved, while the others remain available until evicted
+    void testThatOnlyThumbnailsOfFavoriteHostsAreSaved()
+    {
+        const QByteArray firstThumbnail = createThumbnail(1024, 'a');
+        const QByteArray secondThumbnail = createThumbnail(1024, 'b');
+
+        {
+            auto store = createStore();
+            store->addUnsavedThumbnail(getHost(0), firstThumbnail);
+            store->addUnsavedThumbnail(getHost(1), secondThumbnail);
+
+            // Thumbnails that are not saved yet are found without reaching the database
+            QCOMPARE(loadThumbnail(*store, getHost(1)), secondThumbnail);
+
+            store->saveThumbnails({ getHost(0) });
+            QCOMPARE(loadThumbnail(*store, getHost(1)), secondThumbnail);
+        }
+
+        auto store = createStore();
+        QCOMPARE(loadThumbnail(*store, getHost(0)), firstThumbnail);
+        QVERIFY(loadThumbnail(*store, getHost(1)).isEmpty());
+    }
+
+    /// Verifies that the favorite pages manager signals when the thumbnail of a page has been loaded
+    void testThatFavoritePagesAreNotifiedOfLoadedThumbnails()
+    {
+        const QByteArray thumbnail = createThumbnail(1024, 'a');
+        const QUrl pageUrl(QString("https://%1/").arg(getHost(0)));
+
+        {
+            auto store = createStore();
+            store->addUnsavedThumbnail(getHost(0), thumbnail);
+            store->saveThumbnails({ getHost(0) });
+        }
+
+        QJsonObject pageObj;
+        pageObj.insert(QLatin1String("position"), QJsonValue(0));
+        pageObj.insert(QLatin1String("title"), QJsonValue(QLatin1String("Host")));
+        pageObj.insert(QLatin1String("url"), QJsonValue(pageUrl.toString()));
+
+        QJsonArray favoriteArray;
+        favoriteArray.append(QJsonValue(pageObj));
+
+        QJsonObject rootObj;
+        rootObj.insert(QLatin1String("version"), QJsonValue(QLatin1String("1.1")));
+        rootObj.insert(QLatin1String("favorites"), QJsonValue(favoriteArray));
+
+        QFile favoritesFile(m_favoritesFile);
+        QVERIFY(favoritesFile.open(QIODevice::WriteOnly));
+        favoritesFile.write(QJsonDocument(rootObj).toJson());
+        favoritesFile.close();
+
+        auto store = createStore();
+        FavoritePagesManager favoritesManager(nullptr, store.get(), m_favoritesFile);
+
+        QSignalSpy thumbnailSpy(&favoritesManager, &FavoritePagesManager::thumbnailLoaded);
+        QVERIFY(thumbnailSpy.wait(5000));
+        QCOMPARE(thumbnailSpy.count(), 1);
+        QCOMPARE(thumbnailSpy.at(0).at(0).toUrl(), pageUrl);
+
+        const QString expectedThumbnail = QLatin1String("data:image/png;base64, ") + QString::fromLatin1(thumbnail.toBase64());
+        QCOMPARE(thumbnailSpy.at(0).at(1).toString(), expectedThumbnail);
+
+        const QVariantList favorites = favoritesManager.getFavorites();
+        QCOMPARE(favorites.size(), 1);
+        QCOMPARE(favorites.at(0).toMap().value(QLatin1String("thumbnail")).toString(), expectedThumbnail);
+    }
+
+private:
+    /// Path of the thumbnail database used by the tests
+    const QString m_dbFile;
+
+    /// Path of the favorite pages data file used by the tests
+    const QString m_favoritesFile;
+
+    /// Empty service locator given to the thumbnail store
+    ViperServiceLocator m_serviceLocator;
+};
+
+QTEST_GUILESS_MAIN(WebPageThumbnailStoreTest)
+
+#include "WebPageThumbnailStoreTest.moc"
@@ -3,9 +3,11 @@
 #include "FaviconManager.h"
 #include "NetworkAccessManager.h"
 
+#include <QColor>
 #include <QCryptographicHash>
 #include <QDateTime>
 #include <QFile>
+#include <QImage>
 #include <QObject>
 #include <QSignalSpy>
 #include <QString>
@@ -23,6 +25,22 @@ class FaviconManagerTest : public QObject
     {
     }
 
+private:
+    /// Loads the favicon of the given page URL, waiting for it to be read in the background
+    QIcon loadIcon(const QUrl &url)
+    {
+        bool isLoaded = false;
+        QIcon loadedIcon;
+        m_faviconManager->loadFavicon(url, this, [&](const QIcon &result){
+            isLoaded = true;
+            loadedIcon = result;
+        });
+
+        for (int i = 0; i < 100 && !isLoaded; ++i)
+            QTest::qWait(50);
+        return loadedIcon;
+    }
+
 private slots:
     /// Called before any tests are executed
     void initTestCase()
@@ -73,6 +91,128 @@ private slots:
         m_faviconManager->setNetworkAccessManager(nullptr);
     }
 
+    void testIconsAreLoadedOnDemand()
+    {
+        QImage image(32, 32, QImage::Format_ARGB32);
+        image.fill(Qt::red);
+        QIcon icon(QPixmap::fromImage(image));
+
+        const QUrl iconUrl = QUrl(QLatin1String("https://viper-browser.com/favicon.png"));
+        const QUrl pageUrl = QUrl(QLatin1String("https://viper-browser.com/about"));
+
+        m_faviconManager = new FaviconManager(m_dbFile);
+        m_faviconManager->updateIcon(iconUrl, pageUrl, icon);
+        delete m_faviconManager;
+
+        // Reopen the database, so the icon is read and decoded when it is first requested
+        m_faviconManager = new FaviconManager(m_dbFile);
+        QVERIFY2(m_faviconManager->getCacheStats().NumIcons == 0, "Icons should not be loaded until they are requested");
+
+        bool isLoaded = false;
+        QIcon loadedIcon;
+        m_faviconManager->loadFavicon(pageUrl, this, [&](const QIcon &result){
+            isLoaded = true;
+            loadedIcon = result;
+        });
+        QTRY_VERIFY(isLoaded);
+        QCOMPARE(loadedIcon.pixmap(32, 32).toImage().pixelColor(16, 16), QColor(Qt::red));
+
+        FaviconCacheStats stats = m_faviconManager->getCacheStats();
+        QVERIFY2(stats.NumIcons == 1 && stats.Misses == 1 && stats.Hits == 0, "Decoded icon should be cached");
+        QVERIFY2(stats.NumBytes > 0 && stats.NumBytes <= stats.Capacity, "Cached icon should count towards the cache budget");
+
+        QVERIFY(!m_faviconManager->getFavicon(pageUrl).isNull());
+        QVERIFY2(m_faviconManager->getCacheStats().Hits == 1, "Second request should be answered from the cache");
+    }
+
+    void testIconIsFoundByHostAndDomain()
+    {
+        QImage image(32, 32, QImage::Format_ARGB32);
+        image.fill(Qt::blue);
+        QIcon icon(QPixmap::fromImage(image));
+
+        m_faviconManager = new FaviconManager(m_dbFile);
+        m_faviconManager->updateIcon(QUrl(QLatin1String("https://www.example.com/favicon.ico")),
+                                     QUrl(QLatin1String("https://www.example.com/index.html")), icon);
+        delete m_faviconManager;
+
+        m_faviconManager = new FaviconManager(m_dbFile);
+
+        QIcon favicon = loadIcon(QUrl(QLatin1String("https://www.example.com/other/page.html")));
+        QCOMPARE(favicon.pixmap(32, 32).toImage().pixelColor(16, 16), QColor(Qt::blue));
+
+        favicon = loadIcon(QUrl(QLatin1String("https://news.example.com/")));
+        QCOMPARE(favicon.pixmap(32, 32).toImage().pixelColor(16, 16), QColor(Qt::blue));
+
+        favicon = loadIcon(QUrl(QLatin1String("https://example.org/")));
+        QVERIFY2(favicon.pixmap(32, 32).toImage().pixelColor(16, 16) != QColor(Qt::blue), "Pages on other domains should not share the icon");
+    }
+
+    void testGetFaviconOnlyReturnsCachedIcons()
+    {
+        QImage image(32, 32, QImage::Format_ARGB32);
+        image.fill(Qt::green);
+        QIcon icon(QPixmap::fromImage(image));
+
+        const QUrl pageUrl = QUrl(QLatin1String("https://viper-browser.com/"));
+
+        m_faviconManager = new FaviconManager(m_dbFile);
+        m_faviconManager->updateIcon(QUrl(QLatin1String("https://viper-browser.com/favicon.png")), pageUrl, icon);
+        delete m_faviconManager;
+
+        m_faviconManager = new FaviconManager(m_dbFile);
+
+        // The first request returns a placeholder and loads the icon in the background
+        QIcon favicon = m_faviconManager->getFavicon(pageUrl);
+        QVERIFY2(favicon.pixmap(32, 32).toImage().pixelColor(16, 16) != QColor(Qt::green), "Uncached icons should not be read on the calling thread");
+
+        QTRY_COMPARE(m_faviconManager->getFavicon(pageUrl).pixmap(32, 32).toImage().pixelColor(16, 16), QColor(Qt::green));
+        QCOMPARE(m_faviconManager->getCacheStats().NumIcons, std::size_t(1));
+
+        // Concurrent requests for the same page share a single load
+        bool firstLoaded = false, secondLoaded = false;
+        const QUrl otherPageUrl = QUrl(QLatin1String("https://viper-browser.com/about"));
+        m_faviconManager->loadFavicon(otherPageUrl, this, [&](const QIcon &){ firstLoaded = true; });
+        m_faviconManager->loadFavicon(otherPageUrl, this, [&](const QIcon &){ secondLoaded = true; });
+        QTRY_VERIFY(firstLoaded && secondLoaded);
+    }
+
+    void testThatAMissIsCountedOnce()
+    {
+        QImage image(32, 32, QImage::Format_ARGB32);
+        image.fill(Qt::yellow);
+        QIcon icon(QPixmap::fromImage(image));
+
+        const QUrl pageUrl = QUrl(QLatin1String("https://viper-browser.com/"));
+
+        m_faviconManager = new FaviconManager(m_dbFile);
+        m_faviconManager->updateIcon(QUrl(QLatin1String("https://viper-browser.com/favicon.png")), pageUrl, icon);
+        delete m_faviconManager;
+
+        m_faviconManager = new FaviconManager(m_dbFile);
+        m_faviconManager->getFavicon(pageUrl);
+        QTRY_COMPARE(m_faviconManager->getCacheStats().NumIcons, std::size_t(1));
+
+        QCOMPARE(m_faviconManager->getCacheStats().Misses, uint64_t(1));
+    }
+
+    void testThatPagesWithoutIconFallBackToANewIcon()
+    {
+        QImage image(32, 32, QImage::Format_ARGB32);
+        image.fill(Qt::red);
+        QIcon icon(QPixmap::fromImage(image));
+
+        m_faviconManager = new FaviconManager(m_dbFile);
+
+        const QUrl otherPageUrl = QUrl(QLatin1String("https://news.example.net/"));
+        QVERIFY(loadIcon(otherPageUrl).pixmap(32, 32).toImage().pixelColor(16, 16) != QColor(Qt::red));
+
+        // Once a page of the same domain is given an icon, the other page is no longer known to have none
+        m_faviconManager->updateIcon(QUrl(QLatin1String("https://www.example.net/favicon.ico")),
+                                     QUrl(QLatin1String("https://www.example.net/")), icon);
+        QTRY_COMPARE(loadIcon(otherPageUrl).pixmap(32, 32).toImage().pixelColor(16, 16), QColor(Qt::red));
+    }
+
     void testCanDownloadIconFromUrl()
     {
         //todo: this
@@ -0,0 +1,209 @@
+#include "SessionJournal.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <QtTest>
+
+class SessionJournalTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    SessionJournalTest() :
+        QObject(nullptr),
+        m_sessionFile(QLatin1String("SessionJournalTest.json")),
+        m_journalFile(QLatin1String("SessionJournalTest.json.journal"))
+    {
+    }
+
+private:
+    /// Returns a tab state with the given URL
+    static QJsonObject createTabState(const QString &url)
+    {
+        QJsonObject state;
+        state.insert(QLatin1String("url"), QJsonValue(url));
+        return state;
+    }
+
+    /// Returns the size of the file at the given path
+    static qint64 getFileSize(const QString &path)
+    {
+        QFile file(path);
+        return file.exists() ? file.size() : 0;
+    }
+
+private Q_SLOTS:
+    /// Called before every test function, removes the files of the previous test
+    void init()
+    {
+        QFile::remove(m_sessionFile);
+        QFile::remove(m_journalFile);
+    }
+
+    void testThatJournaledChangesAreRestoredWithoutASnapshot()
+    {
+        {
+            SessionJournal journal(m_sessionFile);
+            journal.clear();
+            journal.updateTab(1, 2, createTabState(QLatin1String("https://a.com/")));
+            journal.updateTab(1, 3, createTabState(QLatin1String("https://b.com/")));
+            journal.setTabOrder(1, { 3, 2 });
+            journal.sync();
+        }
+
+        QVERIFY2(getFileSize(m_journalFile) > 0, "Expected the changes to be written to the journal");
+
+        SessionJournal journal(m_sessionFile);
+        const QJsonArray windows = journal.load().value(QLatin1String("windows")).toArray();
+        QCOMPARE(windows.size(), 1);
+
+        const QJsonArray tabs = windows.at(0).toObject().value(QLatin1String("tabs")).toArray();
+        QCOMPARE(tabs.size(), 2);
+        QCOMPARE(tabs.at(0).toObject().value(QLatin1String("id")).toInt(), 3);
+        QCOMPARE(tabs.at(0).toObject().value(QLatin1String("url")).toString(), QLatin1String("https://b.com/"));
+        QCOMPARE(tabs.at(1).toObject().value(QLatin1String("id")).toInt(), 2);
+        QCOMPARE(journal.getMaxId(), 3);
+    }
+
+    void testThatTabStatesAreMerged()
+    {
+        {
+            SessionJournal journal(m_sessionFile);
+            journal.clear();
+
+            QJsonObject state = createTabState(QLatin1String("https://a.com/"));
+            state.insert(QLatin1String("is_pinned"), QJsonValue(true));
+            journal.updateTab(1, 2, state);
+            journal.updateTab(1, 2, createTabState(QLatin1String("https://a.com/page")));
+        }
+
+        SessionJournal journal(m_sessionFile);
+        const QJsonArray windows = journal.load().value(QLatin1String("windows")).toArray();
+        const QJsonObject tab = windows.at(0).toObject().value(QLatin1String("tabs")).toArray().at(0).toObject();
+        QCOMPARE(tab.value(QLatin1String("url")).toString(), QLatin1String("https://a.com/page"));
+        QVERIFY2(tab.value(QLatin1String("is_pinned")).toBool(), "Expected properties missing from a change to keep their value");
+    }
+
+    void testThatAPartiallyWrittenChangeIsIgnored()
+    {
+        {
+            SessionJournal journal(m_sessionFile);
+            journal.clear();
+            journal.updateTab(1, 2, createTabState(QLatin1String("https://a.com/")));
+        }
+
+        QFile journalFile(m_journalFile);
+        QVERIFY(journalFile.open(QIODevice::WriteOnly | QIODevice::Append));
+        journalFile.write("{\"type\":\"remove_tab\",\"window\":1,\"ta");
+        journalFile.close();
+
+        SessionJournal journal(m_sessionFile);
+        const QJsonArray windows = journal.load().value(QLatin1String("windows")).toArray();
+        QCOMPARE(windows.size(), 1);
+        QCOMPARE(windows.at(0).toObject().value(QLatin1String("tabs")).toArray().size(), 1);
+
+        // The journal is folded into the snapshot on load, so new changes do not follow the partial line
+        journal.sync();
+        QCOMPARE(getFileSize(m_journalFile), qint64(0));
+    }
+
+    void testThatTheSnapshotIsCompactedAfterTheThreshold()
+    {
+        SessionJournal journal(m_sessionFile);
+        journal.clear();
+        for (int i = 0; i < SessionJournal::CompactionThreshold; ++i)
+            journal.updateTab(1, 2, createTabState(QString("https://a.com/%1").arg(i)));
+        journal.sync();
+
+        QCOMPARE(getFileSize(m_journalFile), qint64(0));
+
+        QFile snapshotFile(m_sessionFile);
+        QVERIFY(snapshotFile.open(QIODevice::ReadOnly));
+        const QJsonArray windows = QJsonDocument::fromJson(snapshotFile.readAll()).object().value(QLatin1String("windows")).toArray();
+        const QJsonObject tab = windows.at(0).toObject().value(QLatin1String("tabs")).toArray().at(0).toObject();
+        QCOMPARE(tab.value(QLatin1String("url")).toString(), QString("https://a.com/%1").arg(SessionJournal::CompactionThreshold - 1));
+    }
+
+    void testThatRemovedWindowsAndTabsAreNotRestored()
+    {
+        {
+            SessionJournal journal(m_sessionFile);
+            journal.clear();
+            journal.updateTab(1, 2, createTabState(QLatin1String("https://a.com/")));
+            journal.updateTab(1, 3, createTabState(QLatin1String("https://b.com/")));
+            journal.updateTab(4, 5, createTabState(QLatin1String("https://c.com/")));
+            journal.removeTab(1, 2);
+            journal.removeWindow(4);
+        }
+
+        SessionJournal journal(m_sessionFile);
+        const QJsonArray windows = journal.load().value(QLatin1String("windows")).toArray();
+        QCOMPARE(windows.size(), 1);
+
+        const QJsonArray tabs = windows.at(0).toObject().value(QLatin1String("tabs")).toArray();
+        QCOMPARE(tabs.size(), 1);
+        QCOMPARE(tabs.at(0).toObject().value(QLatin1String("id")).toInt(), 3);
+    }
+
+    void testThatSessionsOfOlderVersionsAreLoaded()
+    {
+        QJsonObject tabObj = createTabState(QLatin1String("https://a.com/"));
+        tabObj.insert(QLatin1String("icon"), QJsonValue(QLatin1String("aWNvbg==")));
+
+        QJsonArray tabArray;
+        tabArray.append(QJsonValue(tabObj));
+        tabArray.append(QJsonValue(QLatin1String("https://b.com/")));
+
+        QJsonObject windowObj;
+        windowObj.insert(QLatin1String("tabs"), QJsonValue(tabArray));
+        windowObj.insert(QLatin1String("current_tab"), QJsonValue(1));
+
+        QJsonArray windowArray;
+        windowArray.append(QJsonValue(windowObj));
+
+        QJsonObject sessionObj;
+        sessionObj.insert(QLatin1String("windows"), QJsonValue(windowArray));
+
+        QFile snapshotFile(m_sessionFile);
+        QVERIFY(snapshotFile.open(QIODevice::WriteOnly));
+        snapshotFile.write(QJsonDocument(sessionObj).toJson());
+        snapshotFile.close();
+
+        SessionJournal journal(m_sessionFile);
+        const QJsonArray windows = journal.load().value(QLatin1String("windows")).toArray();
+        QCOMPARE(windows.size(), 1);
+
+        const QJsonObject window = windows.at(0).toObject();
+        QCOMPARE(window.value(QLatin1String("current_tab")).toInt(), 1);
+
+        const QJsonArray tabs = window.value(QLatin1String("tabs")).toArray();
+        QCOMPARE(tabs.size(), 2);
+        QVERIFY2(!tabs.at(0).toObject().contains(QLatin1String("icon")), "Expected inline favicons to be dropped");
+        QCOMPARE(tabs.at(1).toObject().value(QLatin1String("url")).toString(), QLatin1String("https://b.com/"));
+
+        const int windowId = window.value(QLatin1String("id")).toInt();
+        const int firstTabId = tabs.at(0).toObject().value(QLatin1String("id")).toInt();
+        const int secondTabId = tabs.at(1).toObject().value(QLatin1String("id")).toInt();
+        QVERIFY2(windowId > 0 && firstTabId > 0 && secondTabId > 0, "Expected windows and tabs to be given identifiers");
+        QVERIFY2(windowId != firstTabId && firstTabId != secondTabId && windowId != secondTabId, "Expected identifiers to be unique");
+        QCOMPARE(journal.getMaxId(), std::max(windowId, std::max(firstTabId, secondTabId)));
+    }
+
+private:
+    /// Path of the session file used by the tests
+    const QString m_sessionFile;
+
+    /// Path of the journal file of the session
+    const QString m_journalFile;
+};
+
+QTEST_APPLESS_MAIN(SessionJournalTest)
+
+#include "SessionJournalTest.moc"
@@ -0,0 +1,145 @@
+#include "BrowserApplication.h"
+#include "BrowserSetting.h"
+#include "BrowserTabBar.h"
+#include "BrowserTabWidget.h"
+#include "MainWindow.h"
+#include "SchemeRegistry.h"
+#include "SessionManager.h"
+#include "Settings.h"
+#include "URLSuggestion.h"
+#include "WebState.h"
+#include "WebWidget.h"
+
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include <QTemporaryDir>
+#include <QUrl>
+#include <QtTest>
+
+/// Test cases for the \ref SessionManager class. They run in a browser application whose user data is kept
+/// in a temporary directory
+class SessionManagerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    SessionManagerTest(BrowserApplication *browserApplication, const QString &dataDir) :
+        QObject(nullptr),
+        m_browserApplication(browserApplication),
+        m_sessionFile(QDir(dataDir).filePath(QLatin1String("SessionManagerTest.json"))),
+        m_journalFile(m_sessionFile + QLatin1String(".journal"))
+    {
+    }
+
+private:
+    /// Opens a tab at the end of the given tab widget, which is given the URL without loading it
+    static WebWidget *addTab(BrowserTabWidget *tabWidget, const QUrl &url)
+    {
+        WebWidget *ww = tabWidget->newHibernatingTabAtIndex(tabWidget->count());
+
+        WebState state;
+        state.url = url;
+        state.title = url.host();
+        ww->setPlaceholderState(std::move(state));
+        return ww;
+    }
+
+    /// Returns the size of the file at the given path
+    static qint64 getFileSize(const QString &path)
+    {
+        QFile file(path);
+        return file.exists() ? file.size() : 0;
+    }
+
+private Q_SLOTS:
+    /// Called before every test function, removes the files of the previous test
+    void init()
+    {
+        QFile::remove(m_sessionFile);
+        QFile::remove(m_journalFile);
+    }
+
+    void testThatTabChangesAreRestored()
+    {
+        const QUrl firstUrl(QLatin1String("https://a.com/"));
+        const QUrl secondUrl(QLatin1String("https://b.com/"));
+        const QUrl thirdUrl(QLatin1String("https://c.com/"));
+
+        MainWindow *window = m_browserApplication->getNewWindow();
+        {
+            SessionManager sessionManager;
+            sessionManager.setSessionFile(m_sessionFile);
+            sessionManager.addWindow(window);
+
+            BrowserTabWidget *tabWidget = window->getTabWidget();
+            addTab(tabWidget, firstUrl);
+            WebWidget *secondTab = addTab(tabWidget, secondUrl);
+            addTab(tabWidget, thirdUrl);
+            QCOMPARE(tabWidget->count(), 4);
+
+            // Move the first page to the end, then close the second: the window's first tab is followed by c.com and a.com
+            tabWidget->tabBar()->moveTab(1, 3);
+            tabWidget->closeTab(tabWidget->indexOf(secondTab));
+            QCOMPARE(tabWidget->count(), 3);
+
+            // The changes are still waiting for the write timer when the session manager is destroyed
+        }
+
+        QVERIFY2(getFileSize(m_journalFile) > 0, "Expected the pending changes to be written to the journal");
+
+        MainWindow *restoredWindow = m_browserApplication->getNewWindow();
+        {
+            SessionManager sessionManager;
+            sessionManager.setSessionFile(m_sessionFile);
+            sessionManager.restoreSession(restoredWindow, m_browserApplication);
+        }
+
+        BrowserTabWidget *restoredTabWidget = restoredWindow->getTabWidget();
+        QCOMPARE(restoredTabWidget->count(), 3);
+        QCOMPARE(restoredTabWidget->getWebWidget(1)->url(), thirdUrl);
+        QCOMPARE(restoredTabWidget->getWebWidget(2)->url(), firstUrl);
+
+        window->close();
+        restoredWindow->close();
+    }
+
+private:
+    /// Browser application, used to create the windows
+    BrowserApplication *m_browserApplication;
+
+    /// Path of the session file used by the tests
+    const QString m_sessionFile;
+
+    /// Path of the journal file of the session
+    const QString m_journalFile;
+};
+
+int main(int argc, char **argv)
+{
+    // Keep the settings and databases of the browser out of the user's directories
+    QTemporaryDir dataDir;
+    qputenv("HOME", dataDir.path().toLocal8Bit());
+    qputenv("XDG_CONFIG_HOME", QDir(dataDir.path()).filePath(QLatin1String(".config")).toLocal8Bit());
+    qputenv("XDG_DATA_HOME", QDir(dataDir.path()).filePath(QLatin1String(".local/share")).toLocal8Bit());
+    qputenv("XDG_CACHE_HOME", QDir(dataDir.path()).filePath(QLatin1String(".cache")).toLocal8Bit());
+
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    qputenv("QTWEBENGINE_DISABLE_SANDBOX", "1");
+
+    SchemeRegistry::registerSchemes();
+    qRegisterMetaType<URLSuggestion>();
+    qRegisterMetaType<std::vector<URLSuggestion>>();
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts, true);
+
+    BrowserApplication browserApplication(nullptr, argc, argv);
+    browserApplication.getSettings()->setValue(BrowserSetting::StartupMode, static_cast<int>(StartupMode::LoadBlankPage));
+
+    SessionManagerTest test(&browserApplication, dataDir.path());
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "SessionManagerTest.moc"
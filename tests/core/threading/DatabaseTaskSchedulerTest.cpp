@@ -0,0 +1,191 @@
+#include "DatabaseTaskScheduler.h"
+#include "DatabaseWorker.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QtTest>
+
+class DatabaseTaskSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    DatabaseTaskSchedulerTest() :
+        QObject(nullptr)
+    {
+    }
+
+private:
+    /// Returns a worker construction that does not open a database, for tests of the scheduling alone
+    static std::unique_ptr<DatabaseWorker> createEmptyWorker()
+    {
+        return std::unique_ptr<DatabaseWorker>();
+    }
+
+private Q_SLOTS:
+    void testThatTasksOfAWorkerRunInOrder()
+    {
+        std::vector<int> order;
+        bool ranInitCallback = false;
+        bool initCallbackRanFirst = false;
+
+        DatabaseTaskScheduler scheduler;
+        scheduler.addWorker("First", &DatabaseTaskSchedulerTest::createEmptyWorker);
+        scheduler.onInit("First", [&](){
+            ranInitCallback = true;
+            initCallbackRanFirst = order.empty();
+        });
+
+        for (int i = 0; i < 50; ++i)
+            scheduler.post("First", [&order, i](){ order.push_back(i); });
+
+        scheduler.run();
+        scheduler.stop();
+
+        QVERIFY2(ranInitCallback && initCallbackRanFirst, "Expected the init callback to run before the tasks of the worker");
+        QVERIFY2(order.size() == 50, "Expected every task to run");
+        for (int i = 0; i < 50; ++i)
+            QVERIFY2(order.at(i) == i, "Expected the tasks of a worker to run in the order they were posted");
+    }
+
+    void testThatWorkersRunConcurrently()
+    {
+        std::atomic<bool> ranSecondTask(false);
+        std::atomic<bool> secondRanDuringFirst(false);
+
+        DatabaseTaskScheduler scheduler;
+        scheduler.addWorker("First", &DatabaseTaskSchedulerTest::createEmptyWorker);
+        scheduler.addWorker("Second", &DatabaseTaskSchedulerTest::createEmptyWorker);
+
+        // A long task of one worker must not hold back the tasks of another
+        scheduler.post("First", [&](){
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!ranSecondTask && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            secondRanDuringFirst = ranSecondTask.load();
+        });
+        scheduler.post("Second", [&](){
+            ranSecondTask = true;
+        });
+
+        scheduler.run();
+        scheduler.stop();
+
+        QVERIFY2(secondRanDuringFirst, "Expected the tasks of different workers to run concurrently");
+    }
+
+    void testThatPendingTasksAreCoalesced()
+    {
+        std::mutex mutex;
+        std::vector<int> values;
+        auto recordValue = [&](int value) {
+            return [&, value](){
+                std::lock_guard<std::mutex> lock(mutex);
+                values.push_back(value);
+            };
+        };
+
+        DatabaseTaskScheduler scheduler;
+        scheduler.addWorker("First", &DatabaseTaskSchedulerTest::createEmptyWorker);
+        scheduler.postCoalesced("First", "write", std::chrono::milliseconds(0), recordValue(1));
+        scheduler.postCoalesced("First", "write", std::chrono::milliseconds(0), recordValue(2));
+        scheduler.postCoalesced("First", "other", std::chrono::milliseconds(0), recordValue(3));
+        scheduler.postCoalesced("First", "write", std::chrono::milliseconds(0), recordValue(4));
+
+        DatabaseWorkerStats stats = scheduler.getStats("First");
+        QVERIFY2(stats.QueueDepth == 2, "Expected coalesced tasks to share a place in the queue");
+        QVERIFY2(stats.NumTasksCoalesced == 2, "Expected two tasks to be coalesced");
+
+        scheduler.run();
+        scheduler.stop();
+
+        QVERIFY2(values.size() == 2, "Expected one task to run for each key");
+        QVERIFY2(values.at(0) == 4 && values.at(1) == 3, "Expected the latest work of a key to run in place of the first task");
+    }
+
+    void testThatCoalescedTasksWithoutDelayAreQueuedImmediately()
+    {
+        std::vector<int> order;
+
+        DatabaseTaskScheduler scheduler;
+        scheduler.addWorker("First", &DatabaseTaskSchedulerTest::createEmptyWorker);
+        scheduler.post("First", [&order](){ order.push_back(1); });
+        scheduler.postCoalesced("First", "write", std::chrono::milliseconds(0), [&order](){ order.push_back(2); });
+        scheduler.post("First", [&order](){ order.push_back(3); });
+
+        scheduler.run();
+        scheduler.stop();
+
+        QVERIFY2(order == std::vector<int>({ 1, 2, 3 }), "Expected a task without a delay to keep its place in the queue");
+    }
+
+    void testThatCoalescingWithoutDelayRunsAPendingDelayedTask()
+    {
+        std::atomic<int> value(0);
+
+        DatabaseTaskScheduler scheduler;
+        scheduler.addWorker("First", &DatabaseTaskSchedulerTest::createEmptyWorker);
+        scheduler.run();
+
+        scheduler.postCoalesced("First", "write", std::chrono::hours(1), [&value](){ value = 1; });
+        scheduler.postCoalesced("First", "write", std::chrono::milliseconds(0), [&value](){ value = 2; });
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (value == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        const int valueBeforeStop = value;
+        scheduler.stop();
+
+        QVERIFY2(valueBeforeStop == 2, "Expected the coalesced work to run without waiting for the delay");
+        QVERIFY2(scheduler.getStats("First").NumTasksRun == 1, "Expected the coalesced tasks to run once");
+    }
+
+    void testThatDelayedTasksRunWhenStopping()
+    {
+        bool ranDelayedTask = false;
+
+        DatabaseTaskScheduler scheduler;
+        scheduler.addWorker("First", &DatabaseTaskSchedulerTest::createEmptyWorker);
+        scheduler.run();
+        scheduler.postDelayed("First", std::chrono::hours(1), [&ranDelayedTask](){ ranDelayedTask = true; });
+        scheduler.stop();
+
+        QVERIFY2(ranDelayedTask, "Expected the delayed task to run before the scheduler stopped");
+    }
+
+    void testThatStatsAreRecordedPerWorker()
+    {
+        DatabaseTaskScheduler scheduler;
+        scheduler.addWorker("First", &DatabaseTaskSchedulerTest::createEmptyWorker);
+        scheduler.addWorker("Second", &DatabaseTaskSchedulerTest::createEmptyWorker);
+
+        for (int i = 0; i < 3; ++i)
+            scheduler.post("First", [](){ std::this_thread::sleep_for(std::chrono::milliseconds(10)); });
+        scheduler.post("Second", [](){});
+
+        scheduler.run();
+        scheduler.stop();
+
+        DatabaseWorkerStats stats = scheduler.getStats("First");
+        QVERIFY(stats.QueueDepth == 0);
+        QVERIFY(stats.MaxQueueDepth == 3);
+        QVERIFY(stats.NumTasksRun == 3);
+        QVERIFY(stats.MaxRunTime >= std::chrono::milliseconds(10));
+        QVERIFY(stats.AverageRunTime >= std::chrono::milliseconds(10));
+        QVERIFY2(stats.MaxWaitTime >= std::chrono::milliseconds(10), "Expected the last task to wait for the first two");
+
+        stats = scheduler.getStats("Second");
+        QVERIFY(stats.MaxQueueDepth == 1);
+        QVERIFY(stats.NumTasksRun == 1);
+    }
+};
+
+QTEST_APPLESS_MAIN(DatabaseTaskSchedulerTest)
+
+#include "DatabaseTaskSchedulerTest.moc"
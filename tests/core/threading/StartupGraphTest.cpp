@@ -0,0 +1,139 @@
+#include "StartupGraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QString>
+#include <QtTest>
+
+class StartupGraphTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    StartupGraphTest() :
+        QObject(nullptr)
+    {
+    }
+
+private Q_SLOTS:
+    void testThatTasksRunAfterTheirDependencies()
+    {
+        std::mutex mutex;
+        std::vector<QString> order;
+        auto recordTask = [&](const QString &name) {
+            return [&, name]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(name);
+            };
+        };
+
+        StartupGraph graph;
+        graph.addTask(QLatin1String("Database"), {}, StartupThread::Worker, recordTask(QLatin1String("Database")));
+        graph.addTask(QLatin1String("Settings"), {}, StartupThread::Main, recordTask(QLatin1String("Settings")));
+        graph.addTask(QLatin1String("Manager"), { QLatin1String("Database"), QLatin1String("Settings") },
+                      StartupThread::Main, recordTask(QLatin1String("Manager")));
+        graph.addTask(QLatin1String("Index"), { QLatin1String("Manager") }, StartupThread::Worker, recordTask(QLatin1String("Index")));
+
+        QVERIFY2(graph.run(), "Expected the graph to run");
+        QVERIFY2(order.size() == 4, "Expected every task to run once");
+
+        auto positionOf = [&order](const QString &name) {
+            return std::find(order.begin(), order.end(), name) - order.begin();
+        };
+        QVERIFY2(positionOf(QLatin1String("Manager")) > positionOf(QLatin1String("Database")), "Expected a task to run after its dependencies");
+        QVERIFY2(positionOf(QLatin1String("Manager")) > positionOf(QLatin1String("Settings")), "Expected a task to run after its dependencies");
+        QVERIFY2(positionOf(QLatin1String("Index")) == 3, "Expected a task to run after its dependencies");
+    }
+
+    void testThatIndependentTasksRunConcurrently()
+    {
+        const std::thread::id mainThreadId = std::this_thread::get_id();
+        std::atomic<int> numRunning(0);
+        std::atomic<int> maxRunning(0);
+        std::atomic<bool> ranWorkerTaskOnMainThread(false);
+
+        auto task = [&](bool isWorkerTask) {
+            return [&, isWorkerTask]() {
+                if (isWorkerTask && std::this_thread::get_id() == mainThreadId)
+                    ranWorkerTaskOnMainThread = true;
+
+                const int running = ++numRunning;
+                int expected = maxRunning.load();
+                while (running > expected && !maxRunning.compare_exchange_weak(expected, running)) {}
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                --numRunning;
+            };
+        };
+
+        StartupGraph graph;
+        graph.addTask(QLatin1String("First"), {}, StartupThread::Worker, task(true));
+        graph.addTask(QLatin1String("Second"), {}, StartupThread::Worker, task(true));
+        graph.addTask(QLatin1String("Third"), {}, StartupThread::Main, task(false));
+
+        QVERIFY2(graph.run(), "Expected the graph to run");
+        QVERIFY2(!ranWorkerTaskOnMainThread, "Expected worker tasks to run on the thread pool");
+        QVERIFY2(maxRunning > 1, "Expected independent tasks to overlap");
+    }
+
+    void testThatTraceMarksCriticalPath()
+    {
+        auto sleepFor = [](int milliseconds) {
+            return [milliseconds]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+            };
+        };
+
+        StartupGraph graph;
+        graph.addTask(QLatin1String("Slow"), {}, StartupThread::Worker, sleepFor(60));
+        graph.addTask(QLatin1String("Fast"), {}, StartupThread::Main, sleepFor(5));
+        graph.addTask(QLatin1String("Window"), { QLatin1String("Slow"), QLatin1String("Fast") }, StartupThread::Main, sleepFor(5));
+
+        QVERIFY2(graph.run(), "Expected the graph to run");
+
+        const std::vector<StartupTaskTrace> &trace = graph.getTrace();
+        QVERIFY2(trace.size() == 3, "Expected the trace to contain every task");
+
+        for (const StartupTaskTrace &taskTrace : trace)
+        {
+            if (taskTrace.Name == QLatin1String("Fast"))
+            {
+                QVERIFY2(!taskTrace.OnCriticalPath, "Expected the fast task not to be on the critical path");
+                QVERIFY2(taskTrace.Thread == QLatin1String("main"), "Expected the task to be traced on the main thread");
+            }
+            else
+                QVERIFY2(taskTrace.OnCriticalPath, "Expected the slow task and its dependent to be on the critical path");
+        }
+
+        QVERIFY(trace.back().Name == QLatin1String("Window"));
+        QVERIFY(graph.getTotalTime() >= std::chrono::milliseconds(65));
+        QVERIFY(graph.formatTrace().contains(QLatin1String("Slow -> Window")));
+    }
+
+    void testThatInvalidGraphsAreRejected()
+    {
+        bool ranTask = false;
+
+        StartupGraph unknownDependency;
+        unknownDependency.addTask(QLatin1String("Manager"), { QLatin1String("Missing") }, StartupThread::Main, [&ranTask](){ ranTask = true; });
+        QVERIFY2(!unknownDependency.run(), "Expected a graph with an unknown dependency to be rejected");
+
+        StartupGraph cycle;
+        cycle.addTask(QLatin1String("Root"), {}, StartupThread::Main, [&ranTask](){ ranTask = true; });
+        cycle.addTask(QLatin1String("First"), { QLatin1String("Root"), QLatin1String("Second") }, StartupThread::Main, [&ranTask](){ ranTask = true; });
+        cycle.addTask(QLatin1String("Second"), { QLatin1String("First") }, StartupThread::Worker, [&ranTask](){ ranTask = true; });
+        QVERIFY2(!cycle.run(), "Expected a graph with a cycle to be rejected");
+
+        QVERIFY2(!ranTask, "Expected no task of an invalid graph to run");
+    }
+};
+
+QTEST_APPLESS_MAIN(StartupGraphTest)
+
+#include "StartupGraphTest.moc"
@@ -89,7 +89,6 @@ private Q_SLOTS:
         // Finally instantiate the history suggestor
         HistorySuggestor suggestor;
         suggestor.setServiceLocator(serviceLocator);
-        suggestor.setHistoryFile(TEST_DB_FILE);
 
         std::atomic_bool working { true };
 
@@ -166,7 +165,6 @@ private Q_SLOTS:
         // Finally instantiate the history suggestor
         HistorySuggestor suggestor;
         suggestor.setServiceLocator(serviceLocator);
-        suggestor.setHistoryFile(TEST_DB_FILE);
 
         std::atomic_bool working { true };
 
@@ -0,0 +1,206 @@
+#include "Frecency.h"
+#include "URLRecord.h"
+#include "URLSearchIndex.h"
+
+#include <vector>
+
+#include <QDateTime>
+#include <QSet>
+#include <QString>
+#include <QUrl>
+#include <QtTest>
+
+class URLSearchIndexTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    URLSearchIndexTest() :
+        QObject(nullptr)
+    {
+    }
+
+private:
+    HistoryEntry makeEntry(int visitId, const QString &url, const QString &title, int numVisits, int typedCount, const QDateTime &lastVisit)
+    {
+        HistoryEntry entry;
+        entry.VisitID = visitId;
+        entry.URL = QUrl(url);
+        entry.Title = title;
+        entry.NumVisits = numVisits;
+        entry.URLTypedCount = typedCount;
+        entry.LastVisit = lastVisit;
+        for (int i = 0; i < numVisits; ++i)
+            entry.Frecency = Frecency::addVisit(entry.Frecency, i, lastVisit);
+        return entry;
+    }
+
+private Q_SLOTS:
+    void testThatEntriesMatchBySubstring()
+    {
+        const QDateTime now = QDateTime::currentDateTime();
+
+        URLSearchIndex index;
+        std::vector<HistoryEntry> entries;
+        entries.push_back(makeEntry(1, QLatin1String("https://viper-browser.com"), QLatin1String("Viper Browser"), 3, 0, now));
+        entries.push_back(makeEntry(2, QLatin1String("https://a.datacenter.website.net/landing"), QLatin1String("Other Webpage"), 8, 1, now));
+        entries.push_back(makeEntry(3, QLatin1String("https://randomblog.com"), QLatin1String("Reliable News"), 1, 0, now));
+        index.load(std::move(entries));
+
+        QVERIFY2(index.size() == 3, "Expected the index to contain every loaded entry");
+
+        std::vector<URLSearchResult> result = index.findEntriesContaining(QLatin1String("BROWSER.COM"), 25);
+        QVERIFY2(result.size() == 1, "Expected result set to have a single entry");
+        QVERIFY2(result[0].Entry.VisitID == 1, "Expected the entry to match by URL");
+
+        result = index.findEntriesContaining(QLatin1String("LIABLE NE"), 25);
+        QVERIFY2(result.size() == 1, "Expected result set to have a single entry");
+        QVERIFY2(result[0].Entry.VisitID == 3, "Expected the entry to match by title");
+
+        // Entries visited at the same time are ordered by their visit count
+        result = index.findEntriesContaining(QLatin1String(".COM"), 25);
+        QVERIFY2(result.size() == 2, "Expected result set to have two entries");
+        QVERIFY2(result[0].Entry.VisitID == 1 && result[1].Entry.VisitID == 3, "Expected entries to be ordered by frecency");
+
+        result = index.findEntriesContaining(QLatin1String(".COM"), 1);
+        QVERIFY2(result.size() == 1 && result[0].Entry.VisitID == 1, "Expected result set to be limited to the most visited entry");
+
+        result = index.findEntriesContaining(QLatin1String("DOESNT MATCH"), 25);
+        QVERIFY2(result.empty(), "Expected result set to be empty");
+    }
+
+    void testThatEntriesMatchByWord()
+    {
+        const QDateTime now = QDateTime::currentDateTime();
+
+        URLSearchIndex index;
+        std::vector<HistoryEntry> entries;
+        entries.push_back(makeEntry(1, QLatin1String("https://charity.org/faq"), QLatin1String("Donate Today | FAQ"), 1, 0, now));
+        entries.push_back(makeEntry(2, QLatin1String("https://example.com/redonate"), QLatin1String("Example"), 1, 0, now));
+        index.load(std::move(entries));
+
+        // Words of four or more characters must match the start of a word
+        std::vector<URLSearchResult> result = index.findEntriesWithWord(QLatin1String("DONA"), 5);
+        QVERIFY2(result.size() == 1 && result[0].Entry.VisitID == 1, "Expected only the entry with a word starting with the search word");
+
+        // Shorter words may match anywhere
+        result = index.findEntriesWithWord(QLatin1String("ONA"), 5);
+        QVERIFY2(result.size() == 2, "Expected both entries to contain the search word");
+
+        // Words of one or two characters also match anywhere, including the middle of a word
+        result = index.findEntriesWithWord(QLatin1String("AR"), 5);
+        QVERIFY2(result.size() == 1 && result[0].Entry.VisitID == 1, "Expected a two-character word to match in the middle of a word");
+
+        result = index.findEntriesContaining(QLatin1String("AR"), 5);
+        QVERIFY2(result.size() == 1 && result[0].Entry.VisitID == 1, "Expected a two-character term to match in the middle of a word");
+
+        result = index.findEntriesContaining(QLatin1String("Q"), 5);
+        QVERIFY2(result.size() == 1 && result[0].Entry.VisitID == 1, "Expected a one-character term to match in the middle of a word");
+
+        result = index.findEntriesContaining(QLatin1String("T"), 5);
+        QVERIFY2(result.size() == 2, "Expected both entries to contain the search term");
+    }
+
+    void testThatReloadReplacesEntries()
+    {
+        const QDateTime now = QDateTime::currentDateTime();
+
+        URLSearchIndex index;
+        std::vector<HistoryEntry> entries;
+        entries.push_back(makeEntry(1, QLatin1String("https://viper-browser.com"), QLatin1String("Viper Browser"), 3, 0, now));
+        entries.push_back(makeEntry(2, QLatin1String("https://randomblog.com"), QLatin1String("Reliable News"), 1, 0, now));
+        index.load(std::move(entries));
+
+        entries.clear();
+        entries.push_back(makeEntry(2, QLatin1String("https://randomblog.com"), QLatin1String("Reliable News"), 1, 0, now));
+        index.reload(std::move(entries));
+
+        QVERIFY2(index.size() == 1, "Expected the index to only contain the reloaded entries");
+        QVERIFY2(index.findEntriesContaining(QLatin1String("VIPER"), 25).empty(), "Expected removed entries not to be found");
+
+        std::vector<URLSearchResult> result = index.findEntriesContaining(QLatin1String("BLOG"), 25);
+        QVERIFY2(result.size() == 1 && result[0].Entry.NumVisits == 1, "Expected reloaded entries not to be merged with the old ones");
+    }
+
+    void testThatRecentVisitsOutrankOldVisits()
+    {
+        const QDateTime now = QDateTime::currentDateTime();
+
+        URLSearchIndex index;
+        std::vector<HistoryEntry> entries;
+        entries.push_back(makeEntry(1, QLatin1String("https://old-news.com"), QLatin1String("News"), 4, 0, now.addDays(-120)));
+        entries.push_back(makeEntry(2, QLatin1String("https://new-news.com"), QLatin1String("News"), 1, 0, now));
+        entries.push_back(makeEntry(3, QLatin1String("https://other-news.com"), QLatin1String("News"), 3, 0, now));
+        index.load(std::move(entries));
+
+        // Four visits made four half-lives ago are worth a quarter of a visit today
+        std::vector<URLSearchResult> result = index.findEntriesContaining(QLatin1String("NEWS.COM"), 25);
+        QVERIFY2(result.size() == 3, "Expected result set to have three entries");
+        QVERIFY2(result[0].Entry.VisitID == 3 && result[1].Entry.VisitID == 2 && result[2].Entry.VisitID == 1,
+                 "Expected entries to be ordered by frecency");
+
+        // A visit adds to the frecency of an entry
+        index.addVisit(makeEntry(2, QLatin1String("https://new-news.com"), QLatin1String("News"), 1, 0, now), false);
+        index.addVisit(makeEntry(2, QLatin1String("https://new-news.com"), QLatin1String("News"), 1, 0, now), false);
+        index.addVisit(makeEntry(2, QLatin1String("https://new-news.com"), QLatin1String("News"), 1, 0, now), false);
+
+        result = index.findEntriesWithWord(QLatin1String("NEWS"), 5);
+        QVERIFY2(result.size() == 3 && result[0].Entry.VisitID == 2, "Expected the most frequently visited entry to be first");
+        QVERIFY(qAbs(Frecency::getScore(result[0].Entry.Frecency, now) - 4.0) < 0.001);
+    }
+
+    void testThatVisitsUpdateEntries()
+    {
+        const QDateTime now = QDateTime::currentDateTime();
+
+        URLSearchIndex index;
+        index.addVisit(makeEntry(1, QLatin1String("https://viper-browser.com"), QLatin1String("Viper"), 1, 1, now.addDays(-1)), true);
+        index.addVisit(makeEntry(1, QLatin1String("https://viper-browser.com"), QLatin1String("Viper Browser"), 1, 0, now), false);
+
+        QVERIFY2(index.size() == 1, "Expected visits to the same URL to share an entry");
+
+        std::vector<URLSearchResult> result = index.findEntriesContaining(QLatin1String("BROWSER"), 25);
+        QVERIFY2(result.size() == 1, "Expected the entry to be found by its new title");
+        QVERIFY(result[0].Entry.NumVisits == 2);
+        QVERIFY(result[0].Entry.URLTypedCount == 1);
+        QVERIFY(result[0].Entry.LastVisit == now);
+        QVERIFY(result[0].Entry.Title.compare(QLatin1String("Viper Browser")) == 0);
+
+        // Entries loaded from the database after a visit are merged with that visit
+        std::vector<HistoryEntry> entries;
+        entries.push_back(makeEntry(1, QLatin1String("https://viper-browser.com"), QLatin1String("Viper"), 4, 2, now.addDays(-2)));
+        index.load(std::move(entries));
+
+        result = index.findEntriesContaining(QLatin1String("BROWSER"), 25);
+        QVERIFY2(result.size() == 1, "Expected result set to have a single entry");
+        QVERIFY(result[0].Entry.NumVisits == 6);
+        QVERIFY(result[0].Entry.URLTypedCount == 3);
+        QVERIFY(result[0].Entry.LastVisit == now);
+
+        index.clear();
+        QVERIFY2(index.findEntriesContaining(QLatin1String("BROWSER"), 25).empty(), "Expected the index to be empty after being cleared");
+    }
+
+    void testThatBookmarksAreFlagged()
+    {
+        const QDateTime now = QDateTime::currentDateTime();
+
+        URLSearchIndex index;
+        index.addVisit(makeEntry(1, QLatin1String("https://viper-browser.com"), QLatin1String("Viper Browser"), 1, 0, now), false);
+
+        QSet<QString> bookmarkedUrls;
+        bookmarkedUrls.insert(QLatin1String("HTTPS://VIPER-BROWSER.COM"));
+        index.setBookmarkedUrls(bookmarkedUrls);
+
+        std::vector<URLSearchResult> result = index.findEntriesContaining(QLatin1String("VIPER"), 25);
+        QVERIFY2(result.size() == 1 && result[0].IsBookmark, "Expected the entry to be flagged as a bookmark");
+
+        index.setBookmarkedUrls(QSet<QString>());
+        result = index.findEntriesContaining(QLatin1String("VIPER"), 25);
+        QVERIFY2(result.size() == 1 && !result[0].IsBookmark, "Expected the entry to no longer be flagged as a bookmark");
+    }
+};
+
+QTEST_APPLESS_MAIN(URLSearchIndexTest)
+
+#include "URLSearchIndexTest.moc"
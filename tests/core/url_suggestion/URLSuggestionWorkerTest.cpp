@@ -0,0 +1,211 @@
+#include "IURLSuggestor.h"
+#include "URLSuggestion.h"
+#include "URLSuggestionWorker.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QSignalSpy>
+#include <QString>
+#include <QStringList>
+#include <QtTest>
+
+/// Returns a suggestion for the given URL
+static URLSuggestion makeSuggestion(const QString &url)
+{
+    URLSuggestion suggestion;
+    suggestion.Title = url;
+    suggestion.URL = url;
+    suggestion.LastVisit = QDateTime::currentDateTime();
+    suggestion.URLTypedCount = 0;
+    suggestion.VisitCount = 1;
+    suggestion.Frecency = 1.0;
+    suggestion.PercentMatch = 0;
+    suggestion.IsHostMatch = false;
+    suggestion.IsBookmark = false;
+    suggestion.Type = MatchType::URL;
+    suggestion.HistoryId = 0;
+    return suggestion;
+}
+
+/// Suggests a fixed set of URLs that contain the search term, and records the terms it was asked for
+class FakeSuggestor final : public IURLSuggestor
+{
+public:
+    FakeSuggestor(const QStringList &urls, const QStringList &quickUrls) :
+        m_urls(urls),
+        m_quickUrls(quickUrls),
+        m_searchTerms(),
+        m_mutex()
+    {
+    }
+
+    void setServiceLocator(const ViperServiceLocator &/*serviceLocator*/) override
+    {
+    }
+
+    std::vector<URLSuggestion> getSuggestions(const std::atomic_bool &/*working*/,
+                                              const QString &searchTerm,
+                                              const QStringList &/*searchTermParts*/,
+                                              const FastHashParameters &/*hashParams*/) override
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_searchTerms.append(searchTerm);
+        }
+        return getMatches(m_urls, searchTerm);
+    }
+
+    std::vector<URLSuggestion> getQuickSuggestions(const std::atomic_bool &/*working*/, const QString &searchTerm) override
+    {
+        return getMatches(m_quickUrls, searchTerm);
+    }
+
+    /// Returns the search terms of every full search
+    QStringList getSearchTerms()
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_searchTerms;
+    }
+
+private:
+    static std::vector<URLSuggestion> getMatches(const QStringList &urls, const QString &searchTerm)
+    {
+        std::vector<URLSuggestion> result;
+        for (const QString &url : urls)
+        {
+            if (url.toUpper().contains(searchTerm))
+                result.push_back(makeSuggestion(url));
+        }
+        return result;
+    }
+
+private:
+    QStringList m_urls;
+    QStringList m_quickUrls;
+    QStringList m_searchTerms;
+    std::mutex m_mutex;
+};
+
+class URLSuggestionWorkerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    URLSuggestionWorkerTest() :
+        QObject(nullptr)
+    {
+        qRegisterMetaType<std::vector<URLSuggestion>>();
+    }
+
+private:
+    /// Replaces the suggestors of the worker with the given ones
+    static void setSuggestors(URLSuggestionWorker &worker, std::vector<std::unique_ptr<IURLSuggestor>> &&suggestors)
+    {
+        worker.m_handlers = std::move(suggestors);
+    }
+
+    /// Returns the URLs of the given suggestions
+    static QStringList getUrls(const std::vector<URLSuggestion> &suggestions)
+    {
+        QStringList urls;
+        for (const URLSuggestion &suggestion : suggestions)
+            urls.append(suggestion.URL);
+        urls.sort();
+        return urls;
+    }
+
+private Q_SLOTS:
+    void testThatRequestsAreCoalesced()
+    {
+        URLSuggestionWorker worker;
+        FakeSuggestor *suggestor = new FakeSuggestor({ QLatin1String("https://viper-browser.com") }, {});
+
+        std::vector<std::unique_ptr<IURLSuggestor>> suggestors;
+        suggestors.emplace_back(suggestor);
+        setSuggestors(worker, std::move(suggestors));
+
+        QSignalSpy finishedSpy(&worker, &URLSuggestionWorker::finishedSearch);
+
+        // Every request is made before the worker gets to run, so only the last one is searched for
+        worker.findSuggestionsFor(QLatin1String("v"));
+        worker.findSuggestionsFor(QLatin1String("vi"));
+        worker.findSuggestionsFor(QLatin1String("vip"));
+
+        QVERIFY(finishedSpy.wait(5000));
+        QTest::qWait(100);
+
+        QCOMPARE(finishedSpy.count(), 1);
+        QCOMPARE(suggestor->getSearchTerms(), QStringList { QLatin1String("VIP") });
+
+        const std::vector<URLSuggestion> results = finishedSpy.at(0).at(0).value<std::vector<URLSuggestion>>();
+        QCOMPARE(getUrls(results), QStringList { QLatin1String("https://viper-browser.com") });
+    }
+
+    void testThatPartialResultsAreStreamed()
+    {
+        URLSuggestionWorker worker;
+
+        std::vector<std::unique_ptr<IURLSuggestor>> suggestors;
+        suggestors.emplace_back(new FakeSuggestor({ QLatin1String("https://a.com/viper") }, { QLatin1String("https://viper.com") }));
+        suggestors.emplace_back(new FakeSuggestor({ QLatin1String("https://b.com/viper") }, {}));
+        setSuggestors(worker, std::move(suggestors));
+
+        QSignalSpy updatedSpy(&worker, &URLSuggestionWorker::suggestionsUpdated);
+        QSignalSpy finishedSpy(&worker, &URLSuggestionWorker::finishedSearch);
+
+        worker.findSuggestionsFor(QLatin1String("viper"));
+        QVERIFY(finishedSpy.wait(5000));
+
+        // The quick suggestions come first, followed by the results of the first full search to finish
+        QCOMPARE(updatedSpy.count(), 2);
+
+        const std::vector<URLSuggestion> quickResults = updatedSpy.at(0).at(0).value<std::vector<URLSuggestion>>();
+        QCOMPARE(getUrls(quickResults), QStringList { QLatin1String("https://viper.com") });
+
+        const std::vector<URLSuggestion> partialResults = updatedSpy.at(1).at(0).value<std::vector<URLSuggestion>>();
+        QCOMPARE(partialResults.size(), std::size_t(2));
+
+        const std::vector<URLSuggestion> results = finishedSpy.at(0).at(0).value<std::vector<URLSuggestion>>();
+        QCOMPARE(getUrls(results), QStringList({ QLatin1String("https://a.com/viper"), QLatin1String("https://b.com/viper"),
+                                                 QLatin1String("https://viper.com") }));
+    }
+
+    void testThatPreviousResultsAreReusedForALongerTerm()
+    {
+        URLSuggestionWorker worker;
+        FakeSuggestor *suggestor = new FakeSuggestor({ QLatin1String("https://viper-browser.com"), QLatin1String("https://vim.org") }, {});
+
+        std::vector<std::unique_ptr<IURLSuggestor>> suggestors;
+        suggestors.emplace_back(suggestor);
+        setSuggestors(worker, std::move(suggestors));
+
+        QSignalSpy updatedSpy(&worker, &URLSuggestionWorker::suggestionsUpdated);
+        QSignalSpy finishedSpy(&worker, &URLSuggestionWorker::finishedSearch);
+
+        worker.findSuggestionsFor(QLatin1String("vi"));
+        QVERIFY(finishedSpy.wait(5000));
+        QCOMPARE(finishedSpy.at(0).at(0).value<std::vector<URLSuggestion>>().size(), std::size_t(2));
+
+        updatedSpy.clear();
+        worker.findSuggestionsFor(QLatin1String("vip"));
+        QVERIFY(finishedSpy.wait(5000));
+
+        // The previous results that still match are shown before the new search has found anything
+        QVERIFY(updatedSpy.count() >= 1);
+        const std::vector<URLSuggestion> reusedResults = updatedSpy.at(0).at(0).value<std::vector<URLSuggestion>>();
+        QCOMPARE(getUrls(reusedResults), QStringList { QLatin1String("https://viper-browser.com") });
+
+        // A term that does not extend the previous one starts from nothing
+        updatedSpy.clear();
+        worker.findSuggestionsFor(QLatin1String("org"));
+        QVERIFY(finishedSpy.wait(5000));
+        QCOMPARE(updatedSpy.count(), 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(URLSuggestionWorkerTest)
+
+#include "URLSuggestionWorkerTest.moc"
@@ -0,0 +1,116 @@
+#include "PublicSuffixList.h"
+#include "URL.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <QString>
+#include <QtTest>
+
+class PublicSuffixListTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    PublicSuffixListTest() :
+        QObject(nullptr)
+    {
+    }
+
+private:
+    /// Returns the registrable domain of the host as a string, or a null string if it has none
+    QString getRegistrableDomain(const QString &host) const
+    {
+        const QStringRef domain = PublicSuffixList::instance().getRegistrableDomain(host);
+        return domain.isEmpty() ? QString() : domain.toString();
+    }
+
+private Q_SLOTS:
+    void testThatNormalRulesAreMatched()
+    {
+        QVERIFY(getRegistrableDomain(QLatin1String("com")).isNull());
+        QCOMPARE(getRegistrableDomain(QLatin1String("example.com")), QLatin1String("example.com"));
+        QCOMPARE(getRegistrableDomain(QLatin1String("a.b.example.com")), QLatin1String("example.com"));
+        QCOMPARE(getRegistrableDomain(QLatin1String("www.example.co.uk")), QLatin1String("example.co.uk"));
+        QVERIFY(getRegistrableDomain(QLatin1String("k12.ak.us")).isNull());
+        QCOMPARE(getRegistrableDomain(QLatin1String("www.test.k12.ak.us")), QLatin1String("test.k12.ak.us"));
+
+        QCOMPARE(PublicSuffixList::instance().getPublicSuffix(QLatin1String("www.example.co.uk")).toString(), QLatin1String("co.uk"));
+    }
+
+    void testThatWildcardAndExceptionRulesAreMatched()
+    {
+        // *.ck is a public suffix, except for www.ck
+        QVERIFY(getRegistrableDomain(QLatin1String("test.ck")).isNull());
+        QCOMPARE(getRegistrableDomain(QLatin1String("b.test.ck")), QLatin1String("b.test.ck"));
+        QCOMPARE(getRegistrableDomain(QLatin1String("www.ck")), QLatin1String("www.ck"));
+        QCOMPARE(getRegistrableDomain(QLatin1String("www.www.ck")), QLatin1String("www.ck"));
+
+        // *.kobe.jp is a public suffix, except for city.kobe.jp
+        QVERIFY(getRegistrableDomain(QLatin1String("c.kobe.jp")).isNull());
+        QCOMPARE(getRegistrableDomain(QLatin1String("b.c.kobe.jp")), QLatin1String("b.c.kobe.jp"));
+        QCOMPARE(getRegistrableDomain(QLatin1String("www.city.kobe.jp")), QLatin1String("city.kobe.jp"));
+    }
+
+    void testThatUnlistedAndSpecialHostsAreHandled()
+    {
+        // The default rule treats the last label as the public suffix
+        QVERIFY(getRegistrableDomain(QLatin1String("localhost")).isNull());
+        QCOMPARE(getRegistrableDomain(QLatin1String("b.example.unlistedtld")), QLatin1String("example.unlistedtld"));
+
+        QCOMPARE(getRegistrableDomain(QLatin1String("www.example.com.")), QLatin1String("example.com"));
+        QCOMPARE(getRegistrableDomain(QLatin1String("192.168.0.1")), QLatin1String("192.168.0.1"));
+        QVERIFY(getRegistrableDomain(QString()).isNull());
+    }
+
+    void testThatInternationalizedRulesAreMatched()
+    {
+        QCOMPARE(getRegistrableDomain(QString::fromUtf8("www.\xe9\xa3\x9f\xe7\x8b\xae.\xe5\x85\xac\xe5\x8f\xb8.cn")),
+                 QString::fromUtf8("\xe9\xa3\x9f\xe7\x8b\xae.\xe5\x85\xac\xe5\x8f\xb8.cn"));
+        QCOMPARE(getRegistrableDomain(QLatin1String("www.xn--85x722f.xn--55qx5d.cn")), QLatin1String("xn--85x722f.xn--55qx5d.cn"));
+        QVERIFY(getRegistrableDomain(QLatin1String("xn--55qx5d.cn")).isNull());
+    }
+
+    void testThatThirdPartyRelationComparesSites()
+    {
+        const PublicSuffixList &publicSuffixList = PublicSuffixList::instance();
+        QVERIFY(!publicSuffixList.isThirdParty(QLatin1String("cdn.example.co.uk"), QLatin1String("www.example.co.uk")));
+        QVERIFY(publicSuffixList.isThirdParty(QLatin1String("example.co.uk"), QLatin1String("other.co.uk")));
+        QVERIFY(publicSuffixList.isThirdParty(QLatin1String("ads.tracker.com"), QLatin1String("example.com")));
+        QVERIFY(!publicSuffixList.isThirdParty(QLatin1String("localhost"), QLatin1String("localhost")));
+
+        QCOMPARE(URL(QLatin1String("https://www.example.co.uk/page")).getSecondLevelDomain(), QLatin1String("example.co.uk"));
+    }
+
+    void testThatLookupsAreConsistentAcrossThreads()
+    {
+        const std::vector<QString> hosts { QLatin1String("a.example.com"), QLatin1String("b.example.co.uk"),
+                                           QLatin1String("c.test.ck"), QLatin1String("www.city.kobe.jp") };
+        const std::vector<QString> expected { QLatin1String("example.com"), QLatin1String("example.co.uk"),
+                                              QLatin1String("c.test.ck"), QLatin1String("city.kobe.jp") };
+
+        std::atomic<int> numMismatches(0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back([&](){
+                for (int j = 0; j < 1000; ++j)
+                {
+                    const std::size_t index = static_cast<std::size_t>(j) % hosts.size();
+                    if (PublicSuffixList::instance().getRegistrableDomain(hosts[index]) != expected[index])
+                        ++numMismatches;
+                }
+            });
+        }
+
+        for (std::thread &thread : threads)
+            thread.join();
+
+        QVERIFY2(numMismatches == 0, "Expected cached lookups to match on every thread");
+    }
+};
+
+QTEST_APPLESS_MAIN(PublicSuffixListTest)
+
+#include "PublicSuffixListTest.moc"